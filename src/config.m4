@@ -7,10 +7,14 @@ if test "$PHP_MG_PHP" != "no"; then
   AC_DEFINE([HAVE_MG_PHP],1 ,[whether to enable mg_php support])
   AC_HEADER_STDC
 
+  dnl static tracepoints (USDT) where sys/sdt.h (systemtap-sdt-dev) is available
+  MG_PHP_CFLAGS=""
+  AC_CHECK_HEADER([sys/sdt.h], [MG_PHP_CFLAGS="-DMG_USDT"])
+
 PHP_NEW_EXTENSION(mg_php,
 	  mg_php.c \
 	  mg_dba.c,
-	  $ext_shared)
+	  $ext_shared, , $MG_PHP_CFLAGS)
   PHP_INSTALL_HEADERS([ext/mg_php], [php_mg_php.h mg_dba.h mg_dbasys.h])
   PHP_ADD_MAKEFILE_FRAGMENT()
   PHP_SUBST(MG_PHP_SHARED_LIBADD)
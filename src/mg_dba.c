@@ -113,6 +113,38 @@ Version 1.5.23 16 April 2024:
    Ensure that the connection mode is correctly set in the legacy open and release connection functions.
    Ensure that connection allocation is adequately protected in the legacy open and release connection functions.
       mg_db_connect() and mg_db_disconnect()
+
+Version 1.6.24 19 October 2026:
+   Introduce native (in-process) implementations of the bulk commands for API based connectivity.
+   - Batched $Order: mg_api_order() (command 'N').
+   - Batched $Query: mg_api_query() (command 'Q').
+   - Global directory listing: mg_api_globals() (command 'E').
+   - Incremental lock and unlock of one or more nodes with millisecond timeouts: mg_api_lock() and mg_api_unlock() (commands 'L' and 'U').
+   Introduce a persistent (process-wide) API binding that later requests reuse: mg_bind_server_api(p_srv, DBX_API_PERSISTENT).
+   Introduce per-thread API contexts for multi-threaded hosts: mg_bind_server_api(p_srv, DBX_API_THREADED).
+   - Each thread has its own connection and DBXMETH buffers (and its own call-in session for InterSystems databases).
+   - YottaDB is called through its threaded API (the _st functions with a transaction token) where available.
+   YottaDB transactions (API mode) are run by a pool of long-lived worker threads.
+   - Work is handed to, and results collected from, a worker through a spin-then-futex mailbox (mg_mbox_*) instead of polled condition variables.
+   YottaDB call-ins are dispatched through cached call-in descriptors (ydb_cip) instead of by name (ydb_ci).
+   Copy long (> 32K) InterSystems request and response strings in bulk rather than byte by byte.
+   Vectorize the ASCII runs in UTF-8/UTF-16 transcoding (SSE2, or AVX2 where the CPU supports it) and validate UTF-8 trailing bytes.
+   Native global to global merge for API based connectivity (command 'R').
+      The key buffers used by dbx_merge_ex() are allocated once per connection rather than for each merge.
+   Native subtree aggregation for API based connectivity (command 'C'): count the children or descendants of a node, or total its data size.
+   The batched $Query command ('Q') can include the node at the seed reference itself (flag 'i').
+   Log events are queued in per-thread ring buffers and written out by a background thread (batched writev() to a log file that is held open).
+   - This replaces opening, locking and closing the log file for every event, and also the attempt to release the lock after the file had been closed.
+   Time the connect, send and wait phases of each request (and count the bytes sent and received) for the function statistics reported by m_stats().
+   Count connections opened, connections in use, connection failures, response timeouts and read errors (dbx_pool_stat).
+   - The host may point dbx_pool_stat at memory shared between worker processes.
+   Static tracepoints (USDT, sys/sdt.h) at connect, send, receive and API invocation carrying the command, connection, byte count and duration (MG_USDT).
+   Ensure that the receive buffer is extended (without losing data already received) for responses exceeding its size.
+   Introduce a binary wire capture (mg_capture_open()): each request and response frame is written, with its time, connection and command, to a file for each process.
+   - The file format (MGCAPHEAD then MGCAPREC records) is read by the replayer (tools/mg_replay.c).
+   Implement dbx_benchmark() (previously a stub): micro-benchmarks of the protocol codec, buffers and array (MG_TX_AREC) encoding and decoding (mg_benchmark()).
+   - These, and round trips to a DB Server, are run by the benchmark program (tools/mg_bench.c).
+   - Call-in dispatch by name (ydb_ci) and through a descriptor (ydb_cip) is compared where YottaDB can be loaded ($ydb_dist and $ydb_ci).
 */
 
 
@@ -125,6 +157,24 @@ extern int errno;
 
 static NETXSOCK      netx_so        = {0, 0, 0, 0, 0, 0, 0, {'\0'}};
 static DBXCON *      connection[DBX_MAXCONS] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+static DBXCON *      api_connection = NULL; /* v1.6.24 persistent API bindings (list) */
+static DBX_TLS DBXCON * api_connection_thread = NULL; /* v1.6.24 this thread's persistent API binding */
+static DBXMUTEX      api_mutex; /* v1.6.24 serializes API calls when the database cannot be called from many threads */
+static DBXYDBSO      ydb_thread_so; /* v1.6.24 YottaDB threaded API entry points */
+static DBX_TLS ydb_uint64_t ydb_tptoken = YDB_NOTTP; /* v1.6.24 this thread's YottaDB transaction token */
+static DBXTHRT *     ydb_tp_pool[YDB_MAX_TP]; /* v1.6.24 idle transaction worker threads */
+static int           ydb_tp_pool_size = 0;
+static DBXLOGQ       dbx_logq; /* v1.6.24 asynchronous log writer */
+static DBX_TLS DBXLOGRING * dbx_log_ring = NULL; /* v1.6.24 this thread's log ring */
+static MGCAPTURE     dbx_capture; /* v1.6.24 wire capture */
+static volatile unsigned long mg_benchmark_sink = 0; /* v1.6.24 */
+static DBXCON *      mg_benchmark_pcon = NULL; /* v1.6.24 YottaDB connection for the call-in benchmarks */
+static int           mg_benchmark_ydb_tried = 0;
+#if !defined(_WIN32)
+static pthread_mutex_t dbx_log_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t dbx_log_ring_once = PTHREAD_ONCE_INIT; /* v1.6.24 */
+static pthread_key_t dbx_log_ring_key; /* v1.6.24 releases the ring when its thread ends */
+#endif
 
 #define dbx_isutf(c) (((c)&0xC0) != 0x80)
 
@@ -148,6 +198,9 @@ MG_MALLOC            dbx_ext_malloc = NULL;
 MG_REALLOC           dbx_ext_realloc = NULL;
 MG_FREE              dbx_ext_free = NULL;
 
+static MGPOOLSTAT    dbx_pool_stat_local = {0, 0, 0, 0, 0, 0};
+MGPOOLSTAT *         dbx_pool_stat = &dbx_pool_stat_local; /* v1.6.24 */
+
 #if defined(_WIN32)
 CRITICAL_SECTION  dbx_global_mutex;
 #else
@@ -679,6 +732,11 @@ dbx_close_tcp:
    strcpy(pcon->output_device, "");
    strcpy(pcon->debug_str, "");
 
+   if (pcon->merge_keys) { /* v1.6.24 */
+      mg_free((void *) pcon->merge_keys, 0);
+      pcon->merge_keys = NULL;
+   }
+
    rc = mg_mutex_destroy(pcon->p_db_mutex);
 
    rc = CACHE_SUCCESS;
@@ -1946,15 +2004,12 @@ DBX_EXTFUN(int) dbx_merge_ex(DBXMETH *pmeth)
       from_global.len_alloc = 256;
       from_global.buf_addr = from_global_buffer;
 
-      from_keys_buf0 = (char *) mg_malloc(CACHE_MAXLOSTSZ + 7, 0);
-      if (!from_keys_buf0)
-         goto dbx_merge_ex_exit;
-      from_keys_buf = (char *) mg_malloc(CACHE_MAXLOSTSZ + 7, 0);
-      if (!from_keys_buf)
-         goto dbx_merge_ex_exit;
-      to_keys_buf = (char *) mg_malloc(CACHE_MAXLOSTSZ + 7, 0);
-      if (!to_keys_buf)
+      /* v1.6.24 the key buffers are held by the connection and reused */
+      if (!mg_merge_buffers(pcon))
          goto dbx_merge_ex_exit;
+      from_keys_buf0 = pcon->merge_keys;
+      from_keys_buf = pcon->merge_keys + DBX_MERGEKEYSIZE;
+      to_keys_buf = pcon->merge_keys + (DBX_MERGEKEYSIZE * 2);
 
       p1 = from_keys_buf0;
       p2 = from_keys_buf;
@@ -2145,9 +2200,8 @@ DBX_EXTFUN(int) dbx_merge_ex(DBXMETH *pmeth)
          }
          else {
             pmeth->args[0].cvalue.pstr = (void *) pcon->p_isc_so->p_CacheExStrNew((CACHE_EXSTRP) &(pmeth->args[0].cvalue.zstr), netbuf_used + 1);
-            for (ne = 0; ne < (unsigned int) netbuf_used; ne ++) {
-               pmeth->args[0].cvalue.zstr.str.ch[ne] = (char) netbuf[ne];
-            }
+            ne = (unsigned int) netbuf_used; /* v1.6.24 bulk copy */
+            memcpy((void *) pmeth->args[0].cvalue.zstr.str.ch, (void *) netbuf, (size_t) ne * sizeof(pmeth->args[0].cvalue.zstr.str.ch[0]));
             pmeth->args[0].cvalue.zstr.str.ch[ne] = (char) 0;
             pmeth->args[0].cvalue.zstr.len = netbuf_used;
             rc = pcon->p_isc_so->p_CachePushExStr((CACHE_EXSTRP) &(pmeth->args[0].cvalue.zstr));
@@ -2193,13 +2247,13 @@ DBX_EXTFUN(int) dbx_merge_ex(DBXMETH *pmeth)
       if (pmeth->args[n].sort == DBX_DSORT_GLOBAL) {
          if (n > 0) {
             rc = pcon->p_isc_so->p_CacheAddGlobalDescriptor(narg);
-            if (pmeth->args[n].svalue.buf_addr[n] == '^')
+            if (pmeth->args[n].svalue.buf_addr[0] == '^') /* v1.6.24 */
                rc = pcon->p_isc_so->p_CacheAddGlobal((int) pmeth->args[n].svalue.len_used - 1, (Callin_char_t *) pmeth->args[n].svalue.buf_addr + 1);
             else
                rc = pcon->p_isc_so->p_CacheAddGlobal((int) pmeth->args[n].svalue.len_used, (Callin_char_t *) pmeth->args[n].svalue.buf_addr);
          }
          else {
-            if (pmeth->args[n].svalue.buf_addr[n] == '^')
+            if (pmeth->args[n].svalue.buf_addr[0] == '^')
                rc = pcon->p_isc_so->p_CachePushGlobal((int) pmeth->args[n].svalue.len_used - 1, (Callin_char_t *) pmeth->args[n].svalue.buf_addr + 1);
             else
                rc = pcon->p_isc_so->p_CachePushGlobal((int) pmeth->args[n].svalue.len_used, (Callin_char_t *) pmeth->args[n].svalue.buf_addr);
@@ -2224,9 +2278,8 @@ DBX_EXTFUN(int) dbx_merge_ex(DBXMETH *pmeth)
                   rc = CACHE_FAILURE;
                   break;
                }
-               for (ne = 0; ne < pmeth->args[n].svalue.len_used; ne ++) {
-                  pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) pmeth->args[n].svalue.buf_addr[ne];
-               }
+               ne = pmeth->args[n].svalue.len_used; /* v1.6.24 bulk copy */
+               memcpy((void *) pmeth->args[n].cvalue.zstr.str.ch, (void *) pmeth->args[n].svalue.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.ch[0]));
                pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue.len_used;
 
                rc = pcon->p_isc_so->p_CachePushExStr((CACHE_EXSTRP) &(pmeth->args[n].cvalue.zstr));
@@ -2249,13 +2302,6 @@ DBX_EXTFUN(int) dbx_merge_ex(DBXMETH *pmeth)
 
 dbx_merge_ex_exit:
 
-   if (from_keys_buf0)
-      mg_free((void *) from_keys_buf0, 0);
-   if (from_keys_buf)
-      mg_free((void *) from_keys_buf, 0);
-   if (to_keys_buf)
-      mg_free((void *) to_keys_buf, 0);
-
    mg_create_string(pmeth, (void *) &rc, DBX_DTYPE_INT);
 
    return rc;
@@ -3621,9 +3667,31 @@ DBX_EXTFUN(int) dbx_sleep(int period_ms)
 }
 
 
+/* v1.6.24 input: <benchmark>[#<iterations>]; output: <benchmark>#<operations>#<nanoseconds> (see mg_benchmark()) */
+
 DBX_EXTFUN(int) dbx_benchmark(unsigned char *inputstr, unsigned char *outputstr)
 {
-   strcpy((char *) inputstr, "Output String");
+   unsigned long iterations, ops;
+   unsigned long long ns;
+   char name[64], *p;
+
+   strncpy(name, (char *) inputstr, sizeof(name) - 1);
+   name[sizeof(name) - 1] = '\0';
+   iterations = 1000000;
+   p = strchr(name, '#');
+   if (p) {
+      *p = '\0';
+      iterations = strtoul(p + 1, NULL, 10);
+   }
+
+   ops = 0;
+   ns = mg_benchmark(name, iterations, &ops);
+   if (!ops) {
+      sprintf((char *) outputstr, "%s#0#0", name);
+      return -1;
+   }
+   sprintf((char *) outputstr, "%s#%lu#%llu", name, ops, ns);
+
    return 0;
 }
 
@@ -4555,10 +4623,9 @@ int isc_pop_value(DBXCON *pcon, DBXVAL *value, int required_type)
 */
    }
    else {
-      for (n = 0; n < len; n ++) {
-         if (n > max)
-            break;
-         pstr8[n + offset] = (char) outstr8[n];
+      n = (len > max) ? max : len; /* v1.6.24 bulk copy */
+      if (n > 0) {
+         memcpy((void *) (pstr8 + offset), (void *) outstr8, (size_t) n);
       }
       pstr8[n + offset] = '\0';
       value->svalue.len_used += n;
@@ -4952,6 +5019,10 @@ int ydb_load_library(DBXCON *pcon)
    sprintf(fun, "%s_tp_s", pcon->p_ydb_so->funprfx);
    pcon->p_ydb_so->p_ydb_tp_s = (int (*) (ydb_tpfnptr_t, void *, const char *, int, ydb_buffer_t *)) mg_dso_sym(pcon->p_ydb_so->p_library, (char *) fun);
 
+   /* v1.6.24 use the threaded API (where available) for multi-threaded hosts */
+   if (pcon->threaded) {
+      ydb_load_threaded(pcon);
+   }
 
    pcon->pid = mg_current_process_id();
 
@@ -4970,6 +5041,137 @@ ydb_load_library_exit:
 }
 
 
+/* v1.6.24 Load the YottaDB threaded API (r1.24 and later) and route the simple API entry points through it */
+int ydb_load_threaded(DBXCON *pcon)
+{
+   char fun[64];
+   DBXYDBSO *p_ydb_so;
+
+   p_ydb_so = pcon->p_ydb_so;
+
+   sprintf(fun, "%s_data_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_data_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, unsigned int *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_delete_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_delete_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, int)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_set_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_set_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_get_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_get_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_subscript_next_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_subscript_next_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_subscript_previous_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_subscript_previous_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_node_next_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_node_next_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, int *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_node_previous_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_node_previous_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, int *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_incr_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_incr_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *, ydb_buffer_t *, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_cip_t", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_cip_t = (int (*) (ydb_uint64_t, ydb_buffer_t *, ci_name_descriptor *, ...)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_lock_incr_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_lock_incr_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, unsigned long long, ydb_buffer_t *, int, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_lock_decr_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_lock_decr_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_buffer_t *, int, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+   sprintf(fun, "%s_tp_st", p_ydb_so->funprfx);
+   p_ydb_so->p_ydb_tp_st = (int (*) (ydb_uint64_t, ydb_buffer_t *, ydb_tp2fnptr_t, void *, const char *, int, ydb_buffer_t *)) mg_dso_sym(p_ydb_so->p_library, (char *) fun);
+
+   if (!p_ydb_so->p_ydb_data_st || !p_ydb_so->p_ydb_delete_st || !p_ydb_so->p_ydb_set_st || !p_ydb_so->p_ydb_get_st ||
+         !p_ydb_so->p_ydb_subscript_next_st || !p_ydb_so->p_ydb_subscript_previous_st || !p_ydb_so->p_ydb_node_next_st || !p_ydb_so->p_ydb_node_previous_st ||
+         !p_ydb_so->p_ydb_incr_st || !p_ydb_so->p_ydb_cip_t || !p_ydb_so->p_ydb_lock_incr_st || !p_ydb_so->p_ydb_lock_decr_st || !p_ydb_so->p_ydb_tp_st) {
+      return 0; /* earlier release: calls will be serialized instead */
+   }
+
+   /* the library is process-wide, so are its threaded entry points */
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   memcpy((void *) &ydb_thread_so, (void *) p_ydb_so, sizeof(DBXYDBSO));
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   p_ydb_so->p_ydb_data_s = ydb_thread_data;
+   p_ydb_so->p_ydb_delete_s = ydb_thread_delete;
+   p_ydb_so->p_ydb_set_s = ydb_thread_set;
+   p_ydb_so->p_ydb_get_s = ydb_thread_get;
+   p_ydb_so->p_ydb_subscript_next_s = ydb_thread_subscript_next;
+   p_ydb_so->p_ydb_subscript_previous_s = ydb_thread_subscript_previous;
+   p_ydb_so->p_ydb_node_next_s = ydb_thread_node_next;
+   p_ydb_so->p_ydb_node_previous_s = ydb_thread_node_previous;
+   p_ydb_so->p_ydb_incr_s = ydb_thread_incr;
+   p_ydb_so->p_ydb_lock_incr_s = ydb_thread_lock_incr;
+   p_ydb_so->p_ydb_lock_decr_s = ydb_thread_lock_decr;
+   p_ydb_so->threaded = 1;
+
+   return 1;
+}
+
+
+/* v1.6.24 Simple API entry points routed through the threaded API using this thread's transaction token */
+
+int ydb_thread_data(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, unsigned int *ret_value)
+{
+   return ydb_thread_so.p_ydb_data_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_value);
+}
+
+
+int ydb_thread_delete(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int deltype)
+{
+   return ydb_thread_so.p_ydb_delete_st(ydb_tptoken, NULL, varname, subs_used, subsarray, deltype);
+}
+
+
+int ydb_thread_set(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *value)
+{
+   return ydb_thread_so.p_ydb_set_st(ydb_tptoken, NULL, varname, subs_used, subsarray, value);
+}
+
+
+int ydb_thread_get(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value)
+{
+   return ydb_thread_so.p_ydb_get_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_value);
+}
+
+
+int ydb_thread_subscript_next(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value)
+{
+   return ydb_thread_so.p_ydb_subscript_next_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_value);
+}
+
+
+int ydb_thread_subscript_previous(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value)
+{
+   return ydb_thread_so.p_ydb_subscript_previous_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_value);
+}
+
+
+int ydb_thread_node_next(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray)
+{
+   return ydb_thread_so.p_ydb_node_next_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_subs_used, ret_subsarray);
+}
+
+
+int ydb_thread_node_previous(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray)
+{
+   return ydb_thread_so.p_ydb_node_previous_st(ydb_tptoken, NULL, varname, subs_used, subsarray, ret_subs_used, ret_subsarray);
+}
+
+
+int ydb_thread_incr(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *increment, ydb_buffer_t *ret_value)
+{
+   return ydb_thread_so.p_ydb_incr_st(ydb_tptoken, NULL, varname, subs_used, subsarray, increment, ret_value);
+}
+
+
+int ydb_thread_lock_incr(unsigned long long timeout_nsec, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray)
+{
+   return ydb_thread_so.p_ydb_lock_incr_st(ydb_tptoken, NULL, timeout_nsec, varname, subs_used, subsarray);
+}
+
+
+int ydb_thread_lock_decr(ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray)
+{
+   return ydb_thread_so.p_ydb_lock_decr_st(ydb_tptoken, NULL, varname, subs_used, subsarray);
+}
+
+
 int ydb_open(DBXMETH *pmeth)
 {
    int rc, result;
@@ -5224,20 +5426,52 @@ int ydb_function(DBXMETH *pmeth, DBXFUN *pfun)
 int ydb_function_ex(DBXMETH *pmeth, DBXFUN *pfun)
 {
    int rc;
+   ci_name_descriptor desc, *pdesc;
    DBXCON *pcon = pmeth->pcon;
 
+   /* v1.6.24 dispatch through a cached call-in descriptor (ydb_cip) rather than by name (ydb_ci) */
+   pdesc = ydb_ci_descriptor(pcon, pfun->label);
+   if (!pdesc) {
+      desc.rtn_name.address = pfun->label;
+      desc.rtn_name.length = (unsigned long) strlen(pfun->label);
+      desc.handle = NULL;
+      pdesc = &desc;
+   }
+
+   if (pcon->p_ydb_so->threaded) { /* v1.6.24 */
+      switch (pfun->argc) {
+         case 1:
+            rc = pcon->p_ydb_so->p_ydb_cip_t(ydb_tptoken, NULL, pdesc, &(pfun->out));
+            break;
+         case 2:
+            rc = pcon->p_ydb_so->p_ydb_cip_t(ydb_tptoken, NULL, pdesc, &(pfun->out), &(pfun->in[1]));
+            break;
+         case 3:
+            rc = pcon->p_ydb_so->p_ydb_cip_t(ydb_tptoken, NULL, pdesc, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]));
+            break;
+         case 4:
+            rc = pcon->p_ydb_so->p_ydb_cip_t(ydb_tptoken, NULL, pdesc, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]), &(pfun->in[3]));
+            break;
+         default:
+            rc = CACHE_SUCCESS;
+            pfun->out.length = 0;
+            break;
+      }
+      return rc;
+   }
+
    switch (pfun->argc) {
       case 1:
-         rc = pcon->p_ydb_so->p_ydb_ci(pfun->label, &(pfun->out));
+         rc = pcon->p_ydb_so->p_ydb_cip(pdesc, &(pfun->out));
          break;
       case 2:
-         rc = pcon->p_ydb_so->p_ydb_ci(pfun->label, &(pfun->out), &(pfun->in[1]));
+         rc = pcon->p_ydb_so->p_ydb_cip(pdesc, &(pfun->out), &(pfun->in[1]));
          break;
       case 3:
-         rc = pcon->p_ydb_so->p_ydb_ci(pfun->label, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]));
+         rc = pcon->p_ydb_so->p_ydb_cip(pdesc, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]));
          break;
       case 4:
-         rc = pcon->p_ydb_so->p_ydb_ci(pfun->label, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]), &(pfun->in[3]));
+         rc = pcon->p_ydb_so->p_ydb_cip(pdesc, &(pfun->out), &(pfun->in[1]), &(pfun->in[2]), &(pfun->in[3]));
          break;
       default:
          rc = CACHE_SUCCESS;
@@ -5249,15 +5483,45 @@ int ydb_function_ex(DBXMETH *pmeth, DBXFUN *pfun)
 }
 
 
+/* v1.6.24 Find (or add) the connection's call-in descriptor for a label: YottaDB fills in the handle on first use */
+ci_name_descriptor * ydb_ci_descriptor(DBXCON *pcon, char *label)
+{
+   int n, len;
+   DBXCIDESC *pcid;
+
+   len = (int) strlen(label);
+   if (len >= DBX_MAXCILABEL) {
+      return NULL;
+   }
+
+   for (n = 0; n < pcon->ci_desc_no; n ++) {
+      pcid = &(pcon->ci_desc[n]);
+      if ((int) pcid->desc.rtn_name.length == len && !strcmp(pcid->label, label)) {
+         return &(pcid->desc);
+      }
+   }
+
+   if (pcon->ci_desc_no >= DBX_MAXCIDESC) {
+      return NULL;
+   }
+
+   pcid = &(pcon->ci_desc[pcon->ci_desc_no ++]);
+   strcpy(pcid->label, label);
+   pcid->desc.rtn_name.address = pcid->label;
+   pcid->desc.rtn_name.length = (unsigned long) len;
+   pcid->desc.handle = NULL;
+
+   return &(pcid->desc);
+}
+
+
 /* v1.2.9 */
 int ydb_transaction_cb(void *pargs)
 {
 #if defined(_WIN32)
    return 0;
 #else
-   int rc, init, context, trestart;
-   struct timespec   ts;
-   struct timeval    tp;
+   int rc, context, trestart;
    DBXTHRT *pthrt;
    DBXMETH *pmeth;
 
@@ -5279,77 +5543,64 @@ int ydb_transaction_cb(void *pargs)
    printf("\r\n*** ydb_transaction_cb tid=%lu; tlevel=%d; ...", (unsigned long) mg_current_thread_id(), ydb_get_intsvar(pthrt->pmeth->pcon, "$tlevel"));
 */
 
-   init = 0;
-   pthread_mutex_lock(&(pthrt->req_cv_mutex));
+   /* v1.6.24 the transaction is open: release the requester */
+   pthrt->started = 1;
+   mg_mbox_post(&(pthrt->res));
+
    while (1) {
-      if (init == 0) {
-         init ++;
-         pthrt->done = 1;
-         pthread_cond_broadcast(&(pthrt->res_cv));
-      }
-      gettimeofday(&tp, NULL);
-      ts.tv_sec  = tp.tv_sec;
-      ts.tv_nsec = tp.tv_usec * 1000;
-      ts.tv_sec += 3;
-      rc = pthread_cond_timedwait(&(pthrt->req_cv), &(pthrt->req_cv_mutex), &ts);
+      pthrt->req_seen = mg_mbox_wait(&(pthrt->req), pthrt->req_seen);
 
       pmeth = pthrt->pmeth;
+      context = pthrt->context;
 
-      if (pthrt->context) {
-         context = pthrt->context;
-         pthrt->context = 0;
-         if (context == YDB_TPCTX_DB) {
-            rc = pmeth->p_dbxfun(pmeth);
+      if (context == YDB_TPCTX_COMMIT) {
+         rc = YDB_OK;
+         break;
+      }
+      else if (context == YDB_TPCTX_ROLLBACK) {
+         rc = YDB_TP_ROLLBACK;
+         break;
+      }
+      else if (context == YDB_TPCTX_DB) {
+         rc = pmeth->p_dbxfun(pmeth);
+      }
+      else if (context == YDB_TPCTX_FUN) {
+         rc = ydb_function_ex(pmeth, pmeth->pfun);
+      }
+      else if (context == YDB_TPCTX_QUERY) {
+         if (pmeth->pfun->dir == 1) {
+            pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_node_next_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_nkeys, pmeth->pfun->out_keys);
          }
-         else if (context == YDB_TPCTX_FUN) {
-            rc = ydb_function_ex(pmeth, pmeth->pfun);
+         else {
+            pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_node_previous_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_nkeys, pmeth->pfun->out_keys);
          }
-         else if (context == YDB_TPCTX_QUERY) {
-            if (pmeth->pfun->dir == 1) {
-               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_node_next_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_nkeys, pmeth->pfun->out_keys);
-            }
-            else {
-               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_node_previous_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_nkeys, pmeth->pfun->out_keys);
-            }
-            if (pmeth->pfun->getdata && pmeth->pfun->rc == YDB_OK && *(pmeth->pfun->out_nkeys) != YDB_NODE_END) {
-               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_get_s(pmeth->pfun->global, *(pmeth->pfun->out_nkeys), pmeth->pfun->out_keys, pmeth->pfun->data);
-            }
+         if (pmeth->pfun->getdata && pmeth->pfun->rc == YDB_OK && *(pmeth->pfun->out_nkeys) != YDB_NODE_END) {
+            pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_get_s(pmeth->pfun->global, *(pmeth->pfun->out_nkeys), pmeth->pfun->out_keys, pmeth->pfun->data);
          }
-         else if (context == YDB_TPCTX_ORDER) {
-            if (pmeth->pfun->dir == 1) {
-               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_subscript_next_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_keys);
-            }
-            else {
-               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_subscript_previous_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_keys);
-            }
-            if (pmeth->pfun->rc == CACHE_SUCCESS && pmeth->pfun->out_keys->len_used > 0) {
-               strcpy((pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->buf_addr, pmeth->pfun->out_keys->buf_addr);
-               (pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->len_used = pmeth->pfun->out_keys->len_used;
-               if (pmeth->pfun->getdata) {
-                  pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_get_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->data);
-               }
-            }
-            else {
-               (pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->len_used = 0;
-            }
+      }
+      else if (context == YDB_TPCTX_ORDER) {
+         if (pmeth->pfun->dir == 1) {
+            pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_subscript_next_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_keys);
          }
-         else if (context == YDB_TPCTX_TLEVEL) {
-            pmeth->output_val.num.int32 = ydb_get_intsvar(pmeth->pcon, (char *) "$tlevel");
+         else {
+            pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_subscript_previous_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->out_keys);
          }
-         pthrt->done = 1;
-         pthread_cond_broadcast(&(pthrt->res_cv));
-
-         if (context == YDB_TPCTX_COMMIT) {
-            rc = YDB_OK;
-            break;
+         if (pmeth->pfun->rc == CACHE_SUCCESS && pmeth->pfun->out_keys->len_used > 0) {
+            strcpy((pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->buf_addr, pmeth->pfun->out_keys->buf_addr);
+            (pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->len_used = pmeth->pfun->out_keys->len_used;
+            if (pmeth->pfun->getdata) {
+               pmeth->pfun->rc = pmeth->pcon->p_ydb_so->p_ydb_get_s(pmeth->pfun->global, pmeth->pfun->in_nkeys, pmeth->pfun->in_keys, pmeth->pfun->data);
+            }
          }
-         else if (context == YDB_TPCTX_ROLLBACK) {
-            rc = YDB_TP_ROLLBACK;
-            break;
+         else {
+            (pmeth->pfun->in_keys + (pmeth->pfun->in_nkeys - 1))->len_used = 0;
          }
       }
+      else if (context == YDB_TPCTX_TLEVEL) {
+         pmeth->output_val.num.int32 = ydb_get_intsvar(pmeth->pcon, (char *) "$tlevel");
+      }
+      mg_mbox_post(&(pthrt->res));
    }
-   pthread_mutex_unlock(&(pthrt->req_cv_mutex));
 /*
    printf("\r\n*** ydb_transaction_cb EXIT tid=%lu ...", (unsigned long) mg_current_thread_id());
 */
@@ -5358,27 +5609,69 @@ int ydb_transaction_cb(void *pargs)
 }
 
 
+/* v1.6.24 transaction callback for the threaded API: commands run in this thread use its token */
+int ydb_transaction_cb_st(ydb_uint64_t tptoken, ydb_buffer_t *errstr, void *pargs)
+{
+   int rc;
+   ydb_uint64_t tptoken_prev;
+
+   tptoken_prev = ydb_tptoken;
+   ydb_tptoken = tptoken;
+   rc = ydb_transaction_cb(pargs);
+   ydb_tptoken = tptoken_prev;
+
+   return rc;
+}
+
+
+/* v1.6.24 long-lived transaction worker: runs one transaction per START request (the requester returns it to the pool) until asked to STOP */
 #if defined(_WIN32)
 LPTHREAD_START_ROUTINE ydb_transaction_thread(LPVOID pargs)
 #else
 void * ydb_transaction_thread(void *pargs)
 #endif
 {
+#if !defined(_WIN32)
+   int rc;
    ydb_buffer_t vnames[DBX_MAXARGS];
    DBXTHRT *pthrt;
 
    pthrt = (DBXTHRT *) pargs;
+
+   while (1) {
+      pthrt->req_seen = mg_mbox_wait(&(pthrt->req), pthrt->req_seen);
+      if (pthrt->context == YDB_TPCTX_STOP) {
+         break; /* the requester frees this worker once the thread has ended */
+      }
+      if (pthrt->context != YDB_TPCTX_START) {
+         /* no transaction is open in this worker: fail the request rather than leave the requester waiting */
+         pthrt->rc = CACHE_FAILURE;
+         mg_mbox_post(&(pthrt->res));
+         continue;
+      }
 /*
-   printf("\r\n*** ydb_transaction_thread tid=%lu; tlevel=%d; ...", (unsigned long) dbx_current_thread_id(), ydb_get_intsvar(pthrt->pmeth->pcon, "$tlevel"));
+      printf("\r\n*** ydb_transaction_thread tid=%lu; tlevel=%d; ...", (unsigned long) dbx_current_thread_id(), ydb_get_intsvar(pthrt->pmeth->pcon, "$tlevel"));
 */
-   vnames[0].buf_addr = NULL;
-   vnames[0].len_alloc = 0;
-   vnames[0].len_used = 0;
+      vnames[0].buf_addr = NULL;
+      vnames[0].len_alloc = 0;
+      vnames[0].len_used = 0;
 
-   pthrt->pmeth->pcon->p_ydb_so->p_ydb_tp_s((ydb_tpfnptr_t) ydb_transaction_cb, (void *) pthrt, (const char *) "mg-dbx", 0, &vnames[0]);
+      if (pthrt->pmeth->pcon->p_ydb_so->threaded) { /* v1.6.24 */
+         rc = pthrt->pmeth->pcon->p_ydb_so->p_ydb_tp_st(YDB_NOTTP, NULL, (ydb_tp2fnptr_t) ydb_transaction_cb_st, (void *) pthrt, (const char *) "mg-dbx", 0, &vnames[0]);
+      }
+      else {
+         rc = pthrt->pmeth->pcon->p_ydb_so->p_ydb_tp_s((ydb_tpfnptr_t) ydb_transaction_cb, (void *) pthrt, (const char *) "mg-dbx", 0, &vnames[0]);
+      }
 /*
-   printf("\r\n*** ydb_transaction_thread EXIT tid=%lu ...", (unsigned long) dbx_current_thread_id());
+      printf("\r\n*** ydb_transaction_thread EXIT tid=%lu ...", (unsigned long) dbx_current_thread_id());
 */
+      pthrt->rc = rc;
+      pthrt->pmeth = NULL;
+
+      /* the transaction is complete (or did not start) */
+      mg_mbox_post(&(pthrt->res));
+   }
+#endif
 
 #if defined(_WIN32)
    return 0;
@@ -5394,53 +5687,64 @@ int ydb_transaction(DBXMETH *pmeth)
 #if defined(_WIN32)
    return 0;
 #else
-   int rc;
+   int rc, seen;
    DBXTHRT *pthrt;
    pthread_attr_t attr;
-   size_t stacksize, newstacksize;
-   struct timespec   ts;
-   struct timeval    tp;
 
-   pthrt = (DBXTHRT *) mg_malloc(sizeof(DBXTHRT), 0);
-   pthrt->pmeth = pmeth;
-   pthrt->context = 0;
-   pthrt->done = 0;
+   /* v1.6.24 reuse an idle worker thread */
+   pthrt = NULL;
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   if (ydb_tp_pool_size > 0) {
+      pthrt = ydb_tp_pool[-- ydb_tp_pool_size];
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
 
-   pthread_mutex_init(&(pthrt->req_cv_mutex), NULL);
-   pthread_cond_init(&(pthrt->req_cv), NULL);
-   pthread_mutex_init(&(pthrt->res_cv_mutex), NULL);
-   pthread_cond_init(&(pthrt->res_cv), NULL);
+   if (!pthrt) {
+      pthrt = (DBXTHRT *) mg_malloc(sizeof(DBXTHRT), 0);
+      if (!pthrt) {
+         return CACHE_NOCON;
+      }
+      memset((void *) pthrt, 0, sizeof(DBXTHRT));
+      mg_mbox_init(&(pthrt->req));
+      mg_mbox_init(&(pthrt->res));
+
+      /* joinable: a worker retired by ydb_transaction_release() is freed only once its thread has ended */
+      pthread_attr_init(&attr);
+      pthread_attr_setstacksize(&attr, DBX_THREAD_STACK_SIZE);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+      rc = pthread_create(&(pthrt->tp_tid), &attr, ydb_transaction_thread, (void *) pthrt);
+      pthread_attr_destroy(&attr);
+      if (rc) {
+         mg_free((void *) pthrt, 0);
+         return CACHE_NOCON;
+      }
+   }
+
+   pthrt->pmeth = pmeth;
+   pthrt->context = YDB_TPCTX_START;
+   pthrt->started = 0;
+   pthrt->rc = YDB_OK;
 
    mg_enter_critical_section((void *) &dbx_global_mutex);
    pmeth->pcon->tlevel ++;
    pmeth->pcon->pthrt[pmeth->pcon->tlevel] = (void *) pthrt;
    mg_leave_critical_section((void *) &dbx_global_mutex);
 
-   pthread_attr_init(&attr);
-
-   stacksize = 0;
-   pthread_attr_getstacksize(&attr, &stacksize);
-
-   newstacksize = DBX_THREAD_STACK_SIZE;
-
-   pthread_attr_setstacksize(&attr, newstacksize);
-/*
-   printf("Thread: default stack=%lu; new stack=%lu;\n", (unsigned long) stacksize, (unsigned long) newstacksize);
-*/
-   rc = pthread_create(&(pthrt->tp_tid), &attr, ydb_transaction_thread, (void *) pthrt);
-   if (rc) {
-      printf("failed to create thread, errno = %d\n",errno);
-   }
+   seen = pthrt->res.seq;
+   mg_mbox_post(&(pthrt->req));
+   mg_mbox_wait(&(pthrt->res), seen);
 
-   pthread_mutex_lock(&(pthrt->res_cv_mutex));
-   while (!pthrt->done) {
-      gettimeofday(&tp, NULL);
-      ts.tv_sec  = tp.tv_sec;
-      ts.tv_nsec = tp.tv_usec * 1000;
-      ts.tv_sec += 3;
-      pthread_cond_timedwait(&(pthrt->res_cv), &(pthrt->res_cv_mutex), &ts);
+   if (!pthrt->started) {
+      /* ydb_tp_s() failed (or returned without running the callback): take the worker off the connection before it can be reused */
+      rc = pthrt->rc;
+      mg_enter_critical_section((void *) &dbx_global_mutex);
+      pmeth->pcon->pthrt[pmeth->pcon->tlevel] = (void *) NULL;
+      pmeth->pcon->tlevel --;
+      mg_leave_critical_section((void *) &dbx_global_mutex);
+      ydb_transaction_release(pthrt);
+      return (rc == YDB_OK) ? CACHE_FAILURE : rc;
    }
-   pthread_mutex_unlock(&(pthrt->res_cv_mutex));
 
    return YDB_OK;
 
@@ -5453,45 +5757,170 @@ int ydb_transaction_task(DBXMETH *pmeth, int context)
 #if defined(_WIN32)
    return 0;
 #else
-   int rc;
+   int rc, seen;
    DBXTHRT *pthrt;
-   struct timespec   ts;
-   struct timeval    tp;
 
    rc = YDB_OK;
    pthrt = (DBXTHRT *) pmeth->pcon->pthrt[pmeth->pcon->tlevel];
    pthrt->context = context;
    pthrt->pmeth = pmeth;
 
-   pthread_mutex_lock(&(pthrt->req_cv_mutex));
-   pthread_cond_signal(&(pthrt->req_cv));
-   pthread_mutex_unlock(&(pthrt->req_cv_mutex));
-
-   pthrt->done = 0;
-
-   pthread_mutex_lock(&(pthrt->res_cv_mutex));
-   while (!pthrt->done) {
-      gettimeofday(&tp, NULL);
-      ts.tv_sec  = tp.tv_sec;
-      ts.tv_nsec = tp.tv_usec * 1000;
-      ts.tv_sec += 3;
-      pthread_cond_timedwait(&(pthrt->res_cv), &(pthrt->res_cv_mutex), &ts);
-   }
-   pthread_mutex_unlock(&(pthrt->res_cv_mutex));
+   seen = pthrt->res.seq;
+   mg_mbox_post(&(pthrt->req));
+   mg_mbox_wait(&(pthrt->res), seen);
 
    if (context == YDB_TPCTX_COMMIT || context == YDB_TPCTX_ROLLBACK) {
+      /* the result of ydb_tp_s(): a rollback reports YDB_TP_ROLLBACK when it succeeds */
+      rc = pthrt->rc;
+      if (context == YDB_TPCTX_ROLLBACK && rc == YDB_TP_ROLLBACK) {
+         rc = YDB_OK;
+      }
       mg_enter_critical_section((void *) &dbx_global_mutex);
       pmeth->pcon->pthrt[pmeth->pcon->tlevel] = (void *) NULL;
       pmeth->pcon->tlevel --;
       mg_leave_critical_section((void *) &dbx_global_mutex);
-      rc = pthread_join(pthrt->tp_tid, NULL);
+      ydb_transaction_release(pthrt);
+   }
+   return rc;
+#endif
+}
+
+
+/* v1.6.24 return an idle worker (already taken off its connection) to the pool: if the pool is full the worker is stopped and freed */
+
+int ydb_transaction_release(DBXTHRT *pthrt)
+{
+#if defined(_WIN32)
+   return 0;
+#else
+   int rc;
+
+   rc = 0;
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   if (ydb_tp_pool_size < YDB_MAX_TP) {
+      ydb_tp_pool[ydb_tp_pool_size ++] = pthrt;
+      rc = 1;
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   if (!rc) {
+      pthrt->context = YDB_TPCTX_STOP;
+      mg_mbox_post(&(pthrt->req));
+      pthread_join(pthrt->tp_tid, NULL);
       mg_free((void *) pthrt, 0);
    }
+
    return rc;
 #endif
 }
 
 
+/* v1.6.24 stop and join the idle workers (before the YottaDB run-time is closed down) */
+
+int ydb_transaction_drain(void)
+{
+#if defined(_WIN32)
+   return 0;
+#else
+   int n, pool_size;
+   DBXTHRT *pool[YDB_MAX_TP];
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   pool_size = ydb_tp_pool_size;
+   for (n = 0; n < pool_size; n ++) {
+      pool[n] = ydb_tp_pool[n];
+   }
+   ydb_tp_pool_size = 0;
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   for (n = 0; n < pool_size; n ++) {
+      pool[n]->context = YDB_TPCTX_STOP;
+      mg_mbox_post(&(pool[n]->req));
+      pthread_join(pool[n]->tp_tid, NULL);
+      mg_free((void *) pool[n], 0);
+   }
+
+   return pool_size;
+#endif
+}
+
+
+/* v1.6.24 Mailbox: the poster bumps the sequence number; the waiter spins briefly, then sleeps until it changes */
+
+int mg_mbox_init(DBXMBOX *p_mbox)
+{
+   p_mbox->seq = 0;
+   p_mbox->waiters = 0;
+#if !defined(_WIN32) && !defined(DBX_FUTEX)
+   pthread_mutex_init(&(p_mbox->mutex), NULL);
+   pthread_cond_init(&(p_mbox->cv), NULL);
+#endif
+   return 0;
+}
+
+
+int mg_mbox_post(DBXMBOX *p_mbox)
+{
+#if defined(_WIN32)
+   p_mbox->seq ++;
+#elif defined(DBX_FUTEX)
+   __sync_add_and_fetch(&(p_mbox->seq), 1);
+   if (p_mbox->waiters) {
+      syscall(SYS_futex, (int *) &(p_mbox->seq), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+   }
+#else
+   pthread_mutex_lock(&(p_mbox->mutex));
+   __sync_add_and_fetch(&(p_mbox->seq), 1);
+   if (p_mbox->waiters) {
+      pthread_cond_broadcast(&(p_mbox->cv));
+   }
+   pthread_mutex_unlock(&(p_mbox->mutex));
+#endif
+   return 0;
+}
+
+
+int mg_mbox_wait(DBXMBOX *p_mbox, int seen)
+{
+   int n;
+
+   for (n = 0; n < DBX_MBOX_SPIN; n ++) {
+      if (p_mbox->seq != seen) {
+#if !defined(_WIN32)
+         __sync_synchronize();
+#endif
+         return p_mbox->seq;
+      }
+      DBX_CPU_RELAX();
+   }
+
+#if defined(_WIN32)
+   while (p_mbox->seq == seen) {
+      Sleep(0);
+   }
+#elif defined(DBX_FUTEX)
+   __sync_add_and_fetch(&(p_mbox->waiters), 1);
+   while (p_mbox->seq == seen) {
+      syscall(SYS_futex, (int *) &(p_mbox->seq), FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+   }
+   __sync_sub_and_fetch(&(p_mbox->waiters), 1);
+#else
+   pthread_mutex_lock(&(p_mbox->mutex));
+   p_mbox->waiters ++;
+   while (p_mbox->seq == seen) {
+      pthread_cond_wait(&(p_mbox->cv), &(p_mbox->mutex));
+   }
+   p_mbox->waiters --;
+   pthread_mutex_unlock(&(p_mbox->mutex));
+#endif
+
+#if !defined(_WIN32)
+   __sync_synchronize();
+#endif
+   return p_mbox->seq;
+}
+
+
 int gtm_load_library(DBXCON *pcon)
 {
    int n, len, result;
@@ -5772,8 +6201,7 @@ int gtm_error_message(DBXMETH *pmeth, int error_code)
 
 DBXMETH * mg_unpack_header(unsigned char *input, unsigned char *output)
 {
-   int n, len, output_bsize, offset, index;
-   char *p;
+   int len, output_bsize, offset, index;
    DBXCON *pcon;
    DBXMETH *pmeth;
 
@@ -5822,6 +6250,18 @@ DBXMETH * mg_unpack_header(unsigned char *input, unsigned char *output)
 
    pmeth->offset = offset;
 
+   mg_meth_buffers(pmeth); /* v1.6.24 */
+
+   return pmeth;
+}
+
+
+int mg_meth_buffers(DBXMETH *pmeth)
+{
+   int n;
+   char *p;
+   DBXCON *pcon = pmeth->pcon;
+
    if (!pmeth->data_val.svalue.buf_addr) { /* v1.4.18 */
       pmeth->data_val.svalue.buf_addr = (char *) mg_malloc(CACHE_MAXLOSTSZ + 7, 0);
       pmeth->data_val.svalue.len_alloc = CACHE_MAXLOSTSZ;
@@ -5854,7 +6294,19 @@ DBXMETH * mg_unpack_header(unsigned char *input, unsigned char *output)
       pmeth->output_val.svalue16.len_used = 0;
    }
 
-   return pmeth;
+   return 1;
+}
+
+
+/* v1.6.24 the key buffers used by dbx_merge_ex() are allocated once per connection */
+
+int mg_merge_buffers(DBXCON *pcon)
+{
+   if (!pcon->merge_keys) {
+      pcon->merge_keys = (char *) mg_malloc(sizeof(char) * ((DBX_MERGEKEYSIZE * 3) + 8), 0);
+   }
+
+   return (pcon->merge_keys ? 1 : 0);
 }
 
 
@@ -6065,9 +6517,8 @@ int mg_global_reference(DBXMETH *pmeth)
                      rc = CACHE_FAILURE;
                      break;
                   }
-                  for (ne = 0; ne < pmeth->args[n].svalue16.len_used; ne ++) {
-                     pmeth->args[n].cvalue.zstr.str.wch[ne] = (unsigned short) pmeth->args[n].svalue16.buf_addr[ne];
-                  }
+                  ne = pmeth->args[n].svalue16.len_used; /* v1.6.24 bulk copy */
+                  memcpy((void *) pmeth->args[n].cvalue.zstr.str.wch, (void *) pmeth->args[n].svalue16.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.wch[0]));
                   pmeth->args[n].cvalue.zstr.str.wch[ne] = (char) 0;
                   pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue16.len_used;
 
@@ -6079,9 +6530,8 @@ int mg_global_reference(DBXMETH *pmeth)
                      rc = CACHE_FAILURE;
                      break;
                   }
-                  for (ne = 0; ne < pmeth->args[n].svalue.len_used; ne ++) {
-                     pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) pmeth->args[n].svalue.buf_addr[ne];
-                  }
+                  ne = pmeth->args[n].svalue.len_used; /* v1.6.24 bulk copy */
+                  memcpy((void *) pmeth->args[n].cvalue.zstr.str.ch, (void *) pmeth->args[n].svalue.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.ch[0]));
                   pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue.len_used;
 
                   rc = pcon->p_isc_so->p_CachePushExStr((CACHE_EXSTRP) &(pmeth->args[n].cvalue.zstr));
@@ -6207,9 +6657,8 @@ int mg_class_reference(DBXMETH *pmeth, short context)
          }
          else {
             pmeth->args[n].cvalue.pstr = (void *) pcon->p_isc_so->p_CacheExStrNew((CACHE_EXSTRP) &(pmeth->args[n].cvalue.zstr), pmeth->args[n].svalue.len_used + 1);
-            for (ne = 0; ne < pmeth->args[n].svalue.len_used; ne ++) {
-               pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) pmeth->args[n].svalue.buf_addr[ne];
-            }
+            ne = pmeth->args[n].svalue.len_used; /* v1.6.24 bulk copy */
+            memcpy((void *) pmeth->args[n].cvalue.zstr.str.ch, (void *) pmeth->args[n].svalue.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.ch[0]));
             pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) 0;
             pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue.len_used;
 
@@ -6315,9 +6764,8 @@ int mg_function_reference(DBXMETH *pmeth, DBXFUN *pfun)
                if (pcon->utf16) {
                   pmeth->args[n].cvalue.pstr = (void *) pcon->p_isc_so->p_CacheExStrNewW((CACHE_EXSTRP) &(pmeth->args[n].cvalue.zstr), pmeth->args[n].svalue16.len_used + 1);
                   if (pmeth->args[n].cvalue.pstr) {
-                     for (ne = 0; ne < pmeth->args[n].svalue16.len_used; ne ++) {
-                        pmeth->args[n].cvalue.zstr.str.wch[ne] = (unsigned short) pmeth->args[n].svalue16.buf_addr[ne];
-                     }
+                     ne = pmeth->args[n].svalue16.len_used; /* v1.6.24 bulk copy */
+                     memcpy((void *) pmeth->args[n].cvalue.zstr.str.wch, (void *) pmeth->args[n].svalue16.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.wch[0]));
                      pmeth->args[n].cvalue.zstr.str.wch[ne] = (char) 0;
                      pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue16.len_used;
 
@@ -6330,9 +6778,8 @@ int mg_function_reference(DBXMETH *pmeth, DBXFUN *pfun)
                else {
                   pmeth->args[n].cvalue.pstr = (void *) pcon->p_isc_so->p_CacheExStrNew((CACHE_EXSTRP) &(pmeth->args[n].cvalue.zstr), pmeth->args[n].svalue.len_used + 1);
                   if (pmeth->args[n].cvalue.pstr) {
-                     for (ne = 0; ne < pmeth->args[n].svalue.len_used; ne ++) {
-                        pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) pmeth->args[n].svalue.buf_addr[ne];
-                     }
+                     ne = pmeth->args[n].svalue.len_used; /* v1.6.24 bulk copy */
+                     memcpy((void *) pmeth->args[n].cvalue.zstr.str.ch, (void *) pmeth->args[n].svalue.buf_addr, (size_t) ne * sizeof(pmeth->args[n].cvalue.zstr.str.ch[0]));
                      pmeth->args[n].cvalue.zstr.str.ch[ne] = (char) 0;
                      pmeth->args[n].cvalue.zstr.len = pmeth->args[n].svalue.len_used;
 
@@ -6787,13 +7234,24 @@ int mg_buf_init(MGBUF *p_buf, int size, int increment_size)
 
 int mg_buf_resize(MGBUF *p_buf, unsigned long size)
 {
+   unsigned char *p_temp;
+
    if (size < MG_BUFSIZE)
       return 1;
 
    if (size < p_buf->size)
       return 1;
 
-   p_buf->p_buffer = (unsigned char *) mg_realloc((void *) p_buf->p_buffer, 0, sizeof(char) * size, 0);
+   /* v1.6.24 preserve the data already received */
+   p_temp = (unsigned char *) mg_malloc(sizeof(char) * (size + 1), 0);
+   if (!p_temp)
+      return 0;
+   if (p_buf->p_buffer) {
+      memcpy((void *) p_temp, (void *) p_buf->p_buffer, (size_t) p_buf->data_size);
+      mg_free((void *) p_buf->p_buffer, 0);
+   }
+   p_temp[p_buf->data_size] = '\0';
+   p_buf->p_buffer = p_temp;
    p_buf->size = size;
 
    return 1;
@@ -7040,17 +7498,13 @@ int mg_log_init(DBXLOG *p_log)
 
 int mg_log_event(DBXLOG *p_log, char *message, char *title, int level)
 {
+#if defined(_WIN32)
    int len, n;
    char timestr[64], heading[256], buffer[2048];
    char *p_buffer;
    time_t now = 0;
-#if defined(_WIN32)
    HANDLE hLogfile = 0;
    DWORD dwPos = 0, dwBytesWritten = 0;
-#else
-   FILE *fp = NULL;
-   struct flock lock;
-#endif
 
    now = time(NULL);
    sprintf(timestr, "%s", ctime(&now));
@@ -7081,8 +7535,6 @@ int mg_log_event(DBXLOG *p_log, char *message, char *title, int level)
    strcat(p_buffer, message);
    len = (int) strlen(p_buffer) * sizeof(char);
 
-#if defined(_WIN32)
-
    strcat(p_buffer, "\r\n");
    len = len + (2 * sizeof(char));
    hLogfile = CreateFileA(p_log->log_file, GENERIC_WRITE, FILE_SHARE_WRITE,
@@ -7094,33 +7546,368 @@ int mg_log_event(DBXLOG *p_log, char *message, char *title, int level)
    UnlockFile(hLogfile, dwPos, 0, dwPos + len, 0);
    CloseHandle(hLogfile);
 
+   if (p_buffer != buffer)
+      free((void *) p_buffer);
+
+   return 1;
+
 #else /* UNIX or VMS */
 
-   strcat(p_buffer, "\n");
-   fp = fopen(p_log->log_file, "a");
-   if (fp) {
+   int n;
+   unsigned long len, pos, pid;
+   char timestr[64], heading[256];
+   char *ts;
+   time_t now = 0;
+   struct iovec iov[6];
+   DBXLOGRING *p_ring;
+
+   /* v1.6.24 the time is formatted at most once a second for each thread */
+   now = time(NULL);
+   p_ring = mg_log_ring();
+   if (p_ring && p_ring->ts_time == now) {
+      ts = p_ring->ts_str;
+   }
+   else {
+      ts = p_ring ? p_ring->ts_str : timestr;
+      ctime_r(&now, ts);
+      for (n = 0; ts[n] != '\0'; n ++) {
+         if ((unsigned int) ts[n] < 32) {
+            ts[n] = '\0';
+            break;
+         }
+      }
+      if (p_ring) {
+         p_ring->ts_time = now;
+      }
+   }
+
+   pid = (unsigned long) mg_current_process_id();
+   sprintf(heading, ">>> Time: %s; Build: %s pid=%lu;tid=%lu;req_no=%lu;fun_no=%lu", ts, DBX_VERSION, pid, (unsigned long) mg_current_thread_id(), p_log->req_no, p_log->fun_no);
 
-      lock.l_type = F_WRLCK;
-      lock.l_start = 0;
-      lock.l_whence = SEEK_SET;
-      lock.l_len = 0;
-      n = fcntl(fileno(fp), F_SETLKW, &lock);
+   iov[0].iov_base = (void *) heading;
+   iov[0].iov_len = strlen(heading);
+   iov[1].iov_base = (void *) "\r\n    ";
+   iov[1].iov_len = 6;
+   iov[2].iov_base = (void *) title;
+   iov[2].iov_len = strlen(title);
+   iov[3].iov_base = (void *) "\r\n    ";
+   iov[3].iov_len = 6;
+   iov[4].iov_base = (void *) message;
+   iov[4].iov_len = strlen(message);
+   iov[5].iov_base = (void *) "\n";
+   iov[5].iov_len = 1;
+   for (n = 0, len = 0; n < 6; n ++) {
+      len += (unsigned long) iov[n].iov_len;
+   }
 
-      fputs(p_buffer, fp);
-      fclose(fp);
+   if (!dbx_logq.open || dbx_logq.pid != pid || strcmp(dbx_logq.log_file, p_log->log_file)) {
+      if (!mg_log_open(p_log)) {
+         return 0;
+      }
+   }
+
+   /* v1.6.24 queue the event for the log writer thread: if there is no room it is dropped (and counted) rather than waited for */
+   if (dbx_logq.started && p_ring && len <= (DBX_LOG_RING_SIZE / 4)) {
+      if (len > (DBX_LOG_RING_SIZE - (p_ring->head - p_ring->tail))) {
+         p_ring->dropped ++;
+         return 0;
+      }
+      pos = p_ring->head;
+      for (n = 0; n < 6; n ++) {
+         pos = mg_log_ring_put(p_ring, pos, (char *) iov[n].iov_base, (unsigned long) iov[n].iov_len);
+      }
+      /* publish the event only once it is complete */
+      __sync_synchronize();
+      p_ring->head = pos;
+      return 1;
+   }
 
-      lock.l_type = F_UNLCK;
-      lock.l_start = 0;
-      lock.l_whence = SEEK_SET;
-      lock.l_len = 0;
-      n = fcntl(fileno(fp), F_SETLK, &lock);
+   /* large events (and the fallback if the writer thread could not be started) are written directly: O_APPEND keeps each write whole */
+   if (dbx_logq.started && p_ring && p_ring->head != p_ring->tail) {
+      mg_log_flush(); /* this thread's queued events come first */
    }
+   n = (int) writev(dbx_logq.fd, iov, 6);
+
+   return (n > 0);
 
 #endif
+}
 
-   if (p_buffer != buffer)
-      free((void *) p_buffer);
 
+#if !defined(_WIN32)
+
+/* v1.6.24 asynchronous log writer */
+
+int mg_log_open(DBXLOG *p_log)
+{
+   int rc, fd, flags;
+   unsigned long pid;
+   DBXLOGRING *p_ring;
+   pthread_attr_t attr;
+
+   rc = 1;
+   pid = (unsigned long) mg_current_process_id();
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+
+   if (dbx_logq.pid && dbx_logq.pid != pid) {
+      /* a forked child: the writer thread was not inherited, and the events queued before the fork belong to the parent */
+      pthread_mutex_init(&dbx_log_flush_mutex, NULL);
+      for (p_ring = dbx_logq.rings; p_ring; p_ring = p_ring->next) {
+         p_ring->tail = p_ring->head;
+         p_ring->dropped_reported = p_ring->dropped;
+      }
+      dbx_logq.started = 0;
+   }
+   dbx_logq.pid = pid;
+
+   if (dbx_logq.open && strcmp(dbx_logq.log_file, p_log->log_file)) {
+      mg_log_flush();
+      close(dbx_logq.fd);
+      dbx_logq.open = 0;
+   }
+
+   if (!dbx_logq.open) {
+      flags = O_WRONLY | O_CREAT | O_APPEND;
+#if defined(O_CLOEXEC)
+      flags |= O_CLOEXEC;
+#endif
+      fd = open(p_log->log_file, flags, 0644);
+      if (fd < 0) {
+         rc = 0;
+         goto mg_log_open_exit;
+      }
+      dbx_logq.fd = fd;
+      dbx_logq.open = 1;
+      strncpy(dbx_logq.log_file, p_log->log_file, sizeof(dbx_logq.log_file) - 1);
+      dbx_logq.log_file[sizeof(dbx_logq.log_file) - 1] = '\0';
+   }
+
+   if (!dbx_logq.started && !dbx_logq.failed) {
+      dbx_logq.stop = 0;
+      pthread_attr_init(&attr);
+      pthread_attr_setstacksize(&attr, DBX_THREAD_STACK_SIZE);
+      if (pthread_create(&(dbx_logq.tid), &attr, mg_log_writer, NULL) == 0) {
+         dbx_logq.started = 1;
+      }
+      else {
+         dbx_logq.failed = 1;
+      }
+      pthread_attr_destroy(&attr);
+   }
+
+mg_log_open_exit:
+
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   return rc;
+}
+
+
+/* This thread's ring: on first use, a ring released by a thread that has ended is reused, otherwise one is allocated (and made visible to the writer thread) */
+
+DBXLOGRING * mg_log_ring(void)
+{
+   DBXLOGRING *p_ring;
+
+   if (dbx_log_ring) {
+      return dbx_log_ring;
+   }
+
+   pthread_once(&dbx_log_ring_once, mg_log_ring_key);
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   for (p_ring = dbx_logq.rings; p_ring; p_ring = p_ring->next) {
+      if (p_ring->free) {
+         p_ring->free = 0;
+         break;
+      }
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   if (!p_ring) {
+      p_ring = (DBXLOGRING *) mg_malloc(sizeof(DBXLOGRING), 0);
+      if (!p_ring) {
+         return NULL;
+      }
+      memset((void *) p_ring, 0, sizeof(DBXLOGRING));
+
+      mg_enter_critical_section((void *) &dbx_global_mutex);
+      p_ring->next = dbx_logq.rings;
+      __sync_synchronize();
+      dbx_logq.rings = p_ring;
+      mg_leave_critical_section((void *) &dbx_global_mutex);
+   }
+
+   dbx_log_ring = p_ring;
+   pthread_setspecific(dbx_log_ring_key, (void *) p_ring);
+
+   return p_ring;
+}
+
+
+void mg_log_ring_key(void)
+{
+   pthread_key_create(&dbx_log_ring_key, mg_log_ring_release);
+   return;
+}
+
+
+/* Called as a thread ends: the events still queued in its ring are written out as usual, and the ring is then free for another thread */
+
+void mg_log_ring_release(void *pargs)
+{
+   DBXLOGRING *p_ring;
+
+   p_ring = (DBXLOGRING *) pargs;
+   if (!p_ring) {
+      return;
+   }
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   p_ring->free = 1;
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   return;
+}
+
+
+/* Copy data into the ring at (unpublished) position pos: returns the position following it */
+
+unsigned long mg_log_ring_put(DBXLOGRING *p_ring, unsigned long pos, char *data, unsigned long len)
+{
+   unsigned long offset, size;
+
+   offset = pos & (DBX_LOG_RING_SIZE - 1);
+   size = DBX_LOG_RING_SIZE - offset;
+   if (len <= size) {
+      memcpy((void *) (p_ring->buffer + offset), (void *) data, (size_t) len);
+   }
+   else {
+      memcpy((void *) (p_ring->buffer + offset), (void *) data, (size_t) size);
+      memcpy((void *) p_ring->buffer, (void *) (data + size), (size_t) (len - size));
+   }
+
+   return pos + len;
+}
+
+
+void * mg_log_writer(void *pargs)
+{
+   while (!dbx_logq.stop) {
+      mg_log_flush();
+      mg_pause(DBX_LOG_FLUSH_MSECS);
+   }
+   mg_log_flush();
+
+   return NULL;
+}
+
+
+/* Write out everything queued, gathering the rings of several threads into each writev() */
+
+int mg_log_flush(void)
+{
+   int iovn, ringn;
+   unsigned long head, tail, pos, len, dropped;
+   char note[DBX_LOG_RINGS_PER_WRITE][128];
+   unsigned long heads[DBX_LOG_RINGS_PER_WRITE];
+   DBXLOGRING *rings[DBX_LOG_RINGS_PER_WRITE];
+   struct iovec iov[DBX_LOG_RINGS_PER_WRITE * 3];
+   DBXLOGRING *p_ring;
+
+   if (!dbx_logq.open) {
+      return 0;
+   }
+
+   pthread_mutex_lock(&dbx_log_flush_mutex);
+
+   iovn = 0;
+   ringn = 0;
+   for (p_ring = dbx_logq.rings; p_ring; p_ring = p_ring->next) {
+      head = p_ring->head;
+      __sync_synchronize();
+      tail = p_ring->tail;
+      dropped = p_ring->dropped;
+      if (head == tail && dropped == p_ring->dropped_reported) {
+         continue;
+      }
+      if (dropped != p_ring->dropped_reported) {
+         sprintf(note[ringn], ">>> Log: %lu event(s) dropped because the log buffer was full\n", dropped - p_ring->dropped_reported);
+         iov[iovn].iov_base = (void *) note[ringn];
+         iov[iovn].iov_len = strlen(note[ringn]);
+         iovn ++;
+         p_ring->dropped_reported = dropped;
+      }
+      pos = tail & (DBX_LOG_RING_SIZE - 1);
+      len = head - tail;
+      if (len && (pos + len) > DBX_LOG_RING_SIZE) {
+         iov[iovn].iov_base = (void *) (p_ring->buffer + pos);
+         iov[iovn].iov_len = (size_t) (DBX_LOG_RING_SIZE - pos);
+         iovn ++;
+         iov[iovn].iov_base = (void *) p_ring->buffer;
+         iov[iovn].iov_len = (size_t) (len - (DBX_LOG_RING_SIZE - pos));
+         iovn ++;
+      }
+      else if (len) {
+         iov[iovn].iov_base = (void *) (p_ring->buffer + pos);
+         iov[iovn].iov_len = (size_t) len;
+         iovn ++;
+      }
+      rings[ringn] = p_ring;
+      heads[ringn] = head;
+      ringn ++;
+
+      if (ringn == DBX_LOG_RINGS_PER_WRITE) {
+         mg_log_write(iov, iovn, rings, heads, ringn);
+         iovn = 0;
+         ringn = 0;
+      }
+   }
+   if (ringn) {
+      mg_log_write(iov, iovn, rings, heads, ringn);
+   }
+
+   pthread_mutex_unlock(&dbx_log_flush_mutex);
+
+   return 1;
+}
+
+int mg_log_write(struct iovec *iov, int iovn, DBXLOGRING **rings, unsigned long *heads, int ringn)
+{
+   int n;
+
+   if (iovn) {
+      n = (int) writev(dbx_logq.fd, iov, iovn);
+   }
+
+   /* the space is handed back to the producers once it has been written out */
+   __sync_synchronize();
+   for (n = 0; n < ringn; n ++) {
+      rings[n]->tail = heads[n];
+   }
+
+   return 1;
+}
+
+#endif /* #if !defined(_WIN32) */
+
+
+/* Stop the log writer thread (after it has written out everything queued) and close the log file */
+
+int mg_log_shutdown(void)
+{
+#if !defined(_WIN32)
+   if (dbx_logq.started && dbx_logq.pid == (unsigned long) mg_current_process_id()) {
+      dbx_logq.stop = 1;
+      pthread_join(dbx_logq.tid, NULL);
+      dbx_logq.started = 0;
+   }
+   if (dbx_logq.open) {
+      close(dbx_logq.fd);
+      dbx_logq.open = 0;
+   }
+#endif
    return 1;
 }
 
@@ -9141,6 +9928,7 @@ int mg_db_command(DBXMETH *pmeth, int context)
 int mg_db_connect(MGSRV *p_srv, int *p_chndle, short context)
 {
    int rc, n, free;
+   unsigned long long t0, elapsed;
    DBXCON *pcon;
    DBXMETH *pmeth;
 
@@ -9149,6 +9937,8 @@ int mg_db_connect(MGSRV *p_srv, int *p_chndle, short context)
    }
    p_srv->mode = 1; /* v1.5.23 network based connection */
 
+   t0 = p_srv->stat.active ? mg_time_ns() : 0; /* v1.6.24 */
+
    free = -1;
    *p_chndle = -1;
    mg_enter_critical_section((void *) &dbx_global_mutex); /* v1.5.23 */
@@ -9158,6 +9948,7 @@ int mg_db_connect(MGSRV *p_srv, int *p_chndle, short context)
             *p_chndle = n;
             connection[*p_chndle]->in_use = 1;
             connection[*p_chndle]->eod = 0;
+            MG_POOL_ADD(in_use, 1); /* v1.6.24 */
             break;
          }
       }
@@ -9171,6 +9962,8 @@ int mg_db_connect(MGSRV *p_srv, int *p_chndle, short context)
    if (*p_chndle != -1) {
       mg_leave_critical_section((void *) &dbx_global_mutex); /* v1.5.23 */
       p_srv->pcon[*p_chndle] = connection[*p_chndle];
+      elapsed = mg_stat_phase(p_srv, MG_STAT_CONNECT, t0);
+      MG_PROBE4(connect, *p_chndle, 0, 1, elapsed); /* v1.6.24 */
       return 1;
    }
 
@@ -9229,13 +10022,21 @@ int mg_db_connect(MGSRV *p_srv, int *p_chndle, short context)
 
    rc = netx_tcp_connect(pcon, 0);
 
+   elapsed = mg_stat_phase(p_srv, MG_STAT_CONNECT, t0);
+   MG_PROBE4(connect, *p_chndle, 1, (rc == CACHE_SUCCESS), elapsed); /* v1.6.24 */
+
    if (rc != CACHE_SUCCESS) {
+      MG_POOL_ADD(connect_errors, 1); /* v1.6.24 */
       pcon->connected = 0;
       rc = CACHE_NOCON;
       mg_error_message(pmeth, rc);
       return 0;
    }
 
+   MG_POOL_ADD(connects, 1); /* v1.6.24 */
+   MG_POOL_ADD(open, 1);
+   MG_POOL_ADD(in_use, 1);
+
    return 1;
 
 }
@@ -9253,17 +10054,30 @@ int mg_db_disconnect(MGSRV *p_srv, int chndle, short context)
       return 0;
 
    if (p_srv->mode == 1) {
+      if (p_srv->pcon[chndle]->in_use && p_srv->pcon[chndle]->connected) {
+         MG_POOL_ADD(in_use, -1); /* v1.6.24 */
+      }
       p_srv->pcon[chndle]->in_use = 0;
       return 1;
    }
 
    if (context == 1 && p_srv->pcon[chndle]->keep_alive) {
+      if (p_srv->pcon[chndle]->in_use && p_srv->pcon[chndle]->connected) {
+         MG_POOL_ADD(in_use, -1); /* v1.6.24 */
+      }
       p_srv->pcon[chndle]->in_use = 0;
       return 1;
    }
 
    pcon = p_srv->pcon[chndle];
 
+   if (pcon->connected) { /* v1.6.24 */
+      MG_POOL_ADD(open, -1);
+      if (pcon->in_use) {
+         MG_POOL_ADD(in_use, -1);
+      }
+   }
+
 #if defined(_WIN32)
    NETX_CLOSESOCKET(pcon->cli_socket);
    NETX_WSACLEANUP();
@@ -9283,11 +10097,15 @@ int mg_db_disconnect(MGSRV *p_srv, int chndle, short context)
 int mg_db_send(MGSRV *p_srv, int chndle, MGBUF *p_buf, int mode)
 {
    int result, n, n1, len, total;
+   unsigned long long t0, elapsed;
    char *request;
    unsigned char esize[8];
    DBXCON *pcon;
 
    result = 1;
+   p_srv->stat.bytes_sent += p_buf->data_size; /* v1.6.24 */
+   p_srv->stat.chndle = chndle;
+   p_srv->stat.command = (mode && p_srv->header_len >= 8) ? (int) p_buf->p_buffer[p_srv->header_len - 8] : 0;
 
    if (p_srv->p_log && p_srv->p_log->log_transmissions) {
       char buffer[64];
@@ -9301,7 +10119,12 @@ int mg_db_send(MGSRV *p_srv, int chndle, MGBUF *p_buf, int mode)
       strncpy((char *) (p_buf->p_buffer + (p_srv->header_len - 6) + (5 - len)), (char *) esize, len);
    }
 
+   if (dbx_capture.file[0]) { /* v1.6.24 the frame exactly as sent */
+      mg_capture_frame(p_srv, chndle, MG_CAPTURE_SEND, p_buf->p_buffer, p_buf->data_size);
+   }
+
    if (p_srv->mode == 2) {
+      MG_PROBE4(send, p_srv->stat.command, chndle, p_buf->data_size, 0); /* v1.6.24 */
       return 1;
    }
 
@@ -9309,6 +10132,8 @@ int mg_db_send(MGSRV *p_srv, int chndle, MGBUF *p_buf, int mode)
 
    pcon->eod = 0;
 
+   t0 = p_srv->stat.active ? mg_time_ns() : 0; /* v1.6.24 */
+
    request = (char *) p_buf->p_buffer;
    len = p_buf->data_size;
 
@@ -9333,6 +10158,9 @@ int mg_db_send(MGSRV *p_srv, int chndle, MGBUF *p_buf, int mode)
 
    }
 
+   elapsed = mg_stat_phase(p_srv, MG_STAT_SEND, t0);
+   MG_PROBE4(send, p_srv->stat.command, chndle, p_buf->data_size, elapsed); /* v1.6.24 */
+
    return result;
 }
 
@@ -9341,13 +10169,23 @@ int mg_db_receive(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
 {
    int result, n;
    unsigned long len, total, ssize;
+   unsigned long long t0, elapsed;
    fd_set rset, eset;
    struct timeval tval;
    DBXCON *pcon;
    unsigned long spin_count;
 
+   t0 = p_srv->stat.active ? mg_time_ns() : 0; /* v1.6.24 */
+
    if (p_srv->mode == 2) {
-      return mg_invoke_server_api(p_srv, chndle, p_buf, size, mode);
+      result = mg_invoke_server_api(p_srv, chndle, p_buf, size, mode);
+      p_srv->stat.bytes_recv += p_buf->data_size;
+      elapsed = mg_stat_phase(p_srv, MG_STAT_WAIT, t0);
+      MG_PROBE3(api, p_srv->stat.command, p_buf->data_size, elapsed); /* v1.6.24 */
+      if (dbx_capture.file[0]) {
+         mg_capture_frame(p_srv, chndle, MG_CAPTURE_RECEIVE, p_buf->p_buffer, p_buf->data_size);
+      }
+      return result;
    }
 
    pcon = p_srv->pcon[chndle];
@@ -9391,6 +10229,7 @@ int mg_db_receive(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
             sprintf(pcon->error, "TCP Read Error: Server did not respond within the timeout period (%d seconds)", pcon->timeout);
             result = NETX_READ_TIMEOUT;
             pcon->eod = 1;
+            MG_POOL_ADD(timeouts, 1); /* v1.6.24 */
             break;
          }
 
@@ -9398,6 +10237,7 @@ int mg_db_receive(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
             strcpy(pcon->error, "TCP Read Error: Server closed the connection without having returned any data");
             result = NETX_READ_ERROR;
             pcon->eod = 1;
+            MG_POOL_ADD(read_errors, 1); /* v1.6.24 */
             break;
          }
       }
@@ -9425,7 +10265,7 @@ int mg_db_receive(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
          ssize = mg_decode_size(p_buf->p_buffer, 5, MG_CHUNK_SIZE_BASE);
          total = ssize + MG_RECV_HEAD;
 
-         if (ssize && (ssize + MG_RECV_HEAD) > total) {
+         if (ssize && (ssize + MG_RECV_HEAD) >= p_buf->size) { /* v1.6.24 */
             if (!mg_buf_resize(p_buf, ssize + MG_RECV_HEAD + 32)) {
                p_srv->mem_error = 1;
                break;
@@ -9443,6 +10283,14 @@ int mg_db_receive(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
 
    }
 
+   p_srv->stat.bytes_recv += p_buf->data_size; /* v1.6.24 */
+   elapsed = mg_stat_phase(p_srv, MG_STAT_WAIT, t0);
+   MG_PROBE4(receive, p_srv->stat.command, chndle, p_buf->data_size, elapsed);
+
+   if (dbx_capture.file[0]) { /* v1.6.24 */
+      mg_capture_frame(p_srv, chndle, MG_CAPTURE_RECEIVE, p_buf->p_buffer, p_buf->data_size);
+   }
+
    if (p_srv->p_log && p_srv->p_log->log_transmissions) {
       char buffer[64];
       sprintf(buffer, "Transmission: Received from Host (size=%lu)", p_buf->data_size);
@@ -9945,6 +10793,34 @@ int mg_bind_server_api(MGSRV *p_srv, short context)
    chndle = 0;
    result = 0;
 
+   /* v1.6.24 reuse the binding made by an earlier request in this process (or thread) */
+   if (context & DBX_API_PERSISTENT) {
+      result = -1;
+      mg_enter_critical_section((void *) &dbx_global_mutex);
+      if (context & DBX_API_THREADED)
+         pcon = api_connection_thread;
+      else
+         pcon = api_connection;
+      if (pcon && pcon->connected) {
+         if (strcmp(pcon->shdir, p_srv->shdir) || strcmp(pcon->nspace, p_srv->uci)) {
+            strcpy(p_srv->error_mess, "A persistent binding to a different database is already in place");
+            result = 0;
+         }
+         else {
+            p_srv->pcon[chndle] = pcon;
+            p_srv->mode = 2;
+            p_srv->no_command = 0; /* v1.6.24 the batched commands are native in API mode */
+            pcon->p_srv = (void *) p_srv;
+            result = 1;
+         }
+      }
+      mg_leave_critical_section((void *) &dbx_global_mutex);
+      if (result != -1) {
+         return result;
+      }
+      result = 0;
+   }
+
    if (!p_srv->pcon[chndle]) {
       p_srv->pcon[chndle] = (DBXCON *) mg_malloc(sizeof(DBXCON), 0);
       if (!p_srv->pcon[chndle]) { /* 1.3.10 */
@@ -9985,8 +10861,12 @@ int mg_bind_server_api(MGSRV *p_srv, short context)
    pcon->p_isc_so = NULL;
    pcon->p_ydb_so = NULL;
    pcon->p_gtm_so = NULL;
+   pcon->threaded = (context & DBX_API_THREADED) ? 1 : 0; /* v1.6.24 */
+   pcon->tid = mg_current_thread_id();
+   pcon->ci_desc_no = 0;
 
    p_srv->mode = 2;
+   p_srv->no_command = 0; /* v1.6.24 */
    pcon->p_srv = (void *) p_srv;
    pcon->p_log = &pcon->log;
    pcon->p_db_mutex = &pcon->db_mutex;
@@ -10027,7 +10907,8 @@ int mg_bind_server_api(MGSRV *p_srv, short context)
    pcon->input_device[0] = '\0';
    pcon->output_device[0] = '\0';
 
-   p = (char *) p_srv->p_env->p_buffer;
+   /* v1.6.24 the environment is optional */
+   p = (p_srv->p_env && p_srv->p_env->p_buffer) ? (char *) p_srv->p_env->p_buffer : (char *) "";
    p2 = p;
    while ((p2 = strstr(p, "\n"))) {
       *p2 = '\0';
@@ -10071,6 +10952,24 @@ mg_bind_server_api_exit:
    if (rc == CACHE_SUCCESS) {
       pcon->connected = 1;
       result = 1;
+      /* v1.6.24 YottaDB and GT.M without the threaded API cannot be called from several threads at once */
+      if (pcon->threaded && pcon->dbtype != DBX_DBTYPE_CACHE && pcon->dbtype != DBX_DBTYPE_IRIS && !(pcon->p_ydb_so && pcon->p_ydb_so->threaded)) {
+         mg_enter_critical_section((void *) &dbx_global_mutex);
+         mg_mutex_create(&api_mutex);
+         mg_leave_critical_section((void *) &dbx_global_mutex);
+         pcon->p_db_mutex = &api_mutex;
+         pcon->use_db_mutex = 1;
+      }
+      if (context & DBX_API_PERSISTENT) { /* v1.6.24 */
+         pcon->persistent = 1;
+         mg_enter_critical_section((void *) &dbx_global_mutex);
+         pcon->api_next = api_connection;
+         api_connection = pcon;
+         if (context & DBX_API_THREADED) {
+            api_connection_thread = pcon;
+         }
+         mg_leave_critical_section((void *) &dbx_global_mutex);
+      }
    }
    else {
       pcon->connected = 0;
@@ -10085,19 +10984,60 @@ mg_bind_server_api_exit:
 
 int mg_release_server_api(MGSRV *p_srv, short context)
 {
-   int result, chndle, rc;
+   int result, chndle, rc, shared;
    char buffer[256];
    DBXMETH *pmeth;
-   DBXCON *pcon;
+   DBXCON *pcon, **pnext;
 
    result = 1;
    chndle = 0;
 
    pcon = p_srv->pcon[chndle];
+   if (!pcon) {
+      return result;
+   }
+
+   /* v1.6.24 a persistent binding outlives the request unless its release is forced */
+   if (pcon->persistent) {
+      if (!(context & DBX_API_FORCE)) {
+         return result;
+      }
+      mg_enter_critical_section((void *) &dbx_global_mutex);
+      for (pnext = &api_connection; *pnext; pnext = &((*pnext)->api_next)) {
+         if (*pnext == pcon) {
+            *pnext = pcon->api_next;
+            break;
+         }
+      }
+      pcon->api_next = NULL;
+      if (api_connection_thread == pcon) {
+         api_connection_thread = NULL;
+      }
+      mg_leave_critical_section((void *) &dbx_global_mutex);
+      pcon->persistent = 0;
+   }
+   pcon->connected = 0;
+
+   /* v1.6.24 the YottaDB run-time is shared by all threads: only the last binding to go closes it down */
+   shared = 0;
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   for (pnext = &api_connection; *pnext; pnext = &((*pnext)->api_next)) {
+      if ((*pnext)->connected && (*pnext)->dbtype == pcon->dbtype) {
+         shared = 1;
+         break;
+      }
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
    pmeth = (DBXMETH *) pcon->pmeth_base;
 
    if (pcon->dbtype == DBX_DBTYPE_YOTTADB) {
-      if (pcon->p_ydb_so->loaded) {
+      /* v1.6.24 roll back any transactions left open: their workers return to the pool */
+      while (pmeth && pcon->tlevel > 0 && pcon->tlevel < YDB_MAX_TP && pcon->pthrt[pcon->tlevel]) {
+         ydb_transaction_task(pmeth, YDB_TPCTX_ROLLBACK);
+      }
+      if (pcon->p_ydb_so->loaded && !shared) {
+         ydb_transaction_drain(); /* v1.6.24 no worker thread may still be in YottaDB when it is closed down */
          rc = pcon->p_ydb_so->p_ydb_exit();
          /* printf("\r\np_ydb_exit=%d\r\n", rc); */
       }
@@ -10113,7 +11053,7 @@ int mg_release_server_api(MGSRV *p_srv, short context)
 
    }
    else if (pcon->dbtype == DBX_DBTYPE_GTM) {
-      if (pcon->p_gtm_so->loaded) {
+      if (pcon->p_gtm_so->loaded && !shared) {
          rc = (int) pcon->p_gtm_so->p_gtm_exit();
          /* printf("\r\np_gtm_exit=%d\r\n", rc); */
          if (rc != 0) {
@@ -10133,7 +11073,8 @@ int mg_release_server_api(MGSRV *p_srv, short context)
       strcpy(pcon->p_gtm_so->libnam, "");
    }
    else {
-      if (pcon->p_isc_so->loaded) {
+      /* v1.6.24 a call-in session can only be ended by the thread that started it */
+      if (pcon->p_isc_so->loaded && pcon->tid == mg_current_thread_id()) {
 
          DBX_LOCK(rc, 0);
 
@@ -10158,17 +11099,75 @@ int mg_release_server_api(MGSRV *p_srv, short context)
       if (pmeth->output_val.svalue.buf_addr) {
          mg_free((void *) pmeth->output_val.svalue.buf_addr, 0);
       }
+      if (pmeth->api_str.buf_addr) { /* v1.6.24 */
+         mg_free((void *) pmeth->api_str.buf_addr, 0);
+      }
       mg_free((void *) pmeth, 0);
       pcon->pmeth_base = NULL;
    }
+   if (pcon->merge_keys) { /* v1.6.24 */
+      mg_free((void *) pcon->merge_keys, 0);
+      pcon->merge_keys = NULL;
+   }
 
    return result;
 }
 
 
-int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
+/* v1.6.24 the end of a request: a persistent binding must not keep a reference to the request's server record */
+
+int mg_detach_server_api(MGSRV *p_srv)
+{
+   int chndle;
+   DBXCON *pcon;
+
+   chndle = 0;
+
+   pcon = p_srv->pcon[chndle];
+   if (p_srv->mode != 2 || !pcon || !pcon->persistent) {
+      return 0;
+   }
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   if (pcon->p_srv == (void *) p_srv) {
+      pcon->p_srv = NULL;
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+   p_srv->pcon[chndle] = NULL;
+
+   return 1;
+}
+
+
+/* v1.6.24 release the persistent bindings (at process shutdown) */
+
+int mg_release_server_api_persistent(void)
+{
+   int n;
+   MGSRV srv;
+
+   for (n = 0; ; n ++) {
+      mg_enter_critical_section((void *) &dbx_global_mutex);
+      if (!api_connection) {
+         mg_leave_critical_section((void *) &dbx_global_mutex);
+         break;
+      }
+      memset((void *) &srv, 0, sizeof(MGSRV));
+      srv.pcon[0] = api_connection;
+      srv.mode = 2;
+      api_connection->p_srv = (void *) &srv;
+      mg_leave_critical_section((void *) &dbx_global_mutex);
+
+      mg_release_server_api(&srv, DBX_API_FORCE);
+   }
+
+   return n;
+}
+
+
+int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode)
 {
-   int result, rc, rc1, ne, ex;
+   int result, rc, rc1, ex;
    unsigned int n, max, len;
    char *outstr8, *p;
    char buffer[256], buf1[32], buf3[32];
@@ -10184,6 +11183,8 @@ int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int m
    pmeth = (DBXMETH *) pcon->pmeth_base;
    pfun = &fun;
 
+   DBX_LOCK(rc, 0); /* v1.6.24 */
+
    p = strstr((char *) p_buf->p_buffer, "\n");
    if (p) {
       p -= 7;
@@ -10227,6 +11228,34 @@ int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int m
       p_buf->data_size = (int) strlen((char *) p_buf->p_buffer);
       goto mg_invoke_server_api_exit;
    }
+   else if (pmeth->command[0] == 'N') { /* v1.6.24 */
+      result = mg_api_order(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'Q') { /* v1.6.24 */
+      result = mg_api_query(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'E') { /* v1.6.24 */
+      result = mg_api_globals(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'L') { /* v1.6.24 */
+      result = mg_api_lock(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'U') { /* v1.6.24 */
+      result = mg_api_unlock(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'R') { /* v1.6.24 */
+      result = mg_api_merge(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
+   else if (pmeth->command[0] == 'C') { /* v1.6.24 */
+      result = mg_api_count(p_srv, pmeth, p_buf);
+      goto mg_invoke_server_api_exit;
+   }
 
    if (pcon->dbtype == DBX_DBTYPE_YOTTADB) {
       if (!pcon->p_ydb_so->loaded || !pcon->p_ydb_so || !pcon->p_ydb_so->p_ydb_ci) {
@@ -10329,10 +11358,14 @@ int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int m
       }
       else {
          pmeth->args[0].cvalue.pstr = (void *) pcon->p_isc_so->p_CacheExStrNew((CACHE_EXSTRP) &(pmeth->args[0].cvalue.zstr), p_buf->data_size + 1);
-         for (ne = 0; ne < (int) p_buf->data_size; ne ++) {
-            pmeth->args[0].cvalue.zstr.str.ch[ne] = (char) p_buf->p_buffer[ne];
+         if (!pmeth->args[0].cvalue.pstr) {
+            result = 0;
+            strcpy(p_srv->error_mess, "InterSystems server error - unable to allocate a long string");
+            goto mg_invoke_server_api_exit;
          }
-         pmeth->args[0].cvalue.zstr.str.ch[ne] = (char) 0;
+         /* v1.6.24 bulk copy */
+         memcpy((void *) pmeth->args[0].cvalue.zstr.str.ch, (void *) p_buf->p_buffer, (size_t) p_buf->data_size);
+         pmeth->args[0].cvalue.zstr.str.ch[p_buf->data_size] = (char) 0;
          pmeth->args[0].cvalue.zstr.len = p_buf->data_size;
          rc = pcon->p_isc_so->p_CachePushExStr((CACHE_EXSTRP) &(pmeth->args[0].cvalue.zstr));
       }
@@ -10349,14 +11382,18 @@ int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int m
          else {
             rc = pcon->p_isc_so->p_CachePopStr((int *) &len, (Callin_char_t **) &outstr8);
          }
+         /* v1.6.24 size the buffer from the returned length (the request need not be preserved), then copy in bulk */
+         p_buf->data_size = 0;
+         if (len >= p_buf->size) {
+            mg_buf_resize(p_buf, len + 1);
+         }
          max = p_buf->size - 1;
-         for (n = 0; n < len; n ++) {
-            if (n > max)
-               break;
-            p_buf->p_buffer[n] = (char) outstr8[n];
+         n = (len > max) ? max : len;
+         if (n > 0) {
+            memcpy((void *) p_buf->p_buffer, (void *) outstr8, (size_t) n);
          }
          p_buf->p_buffer[n] = '\0';
-         p_buf->data_size = len;
+         p_buf->data_size = n;
 
          if (ex) {
             rc1 = pcon->p_isc_so->p_CacheExStrKill(&zstr);
@@ -10372,6 +11409,8 @@ int mg_invoke_server_api(MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int m
 
 mg_invoke_server_api_exit:
 
+   DBX_UNLOCK(rc);
+
    if (!result) {
       sprintf((char *) p_buf->p_buffer, "00000ce\n%s", buffer);
       p_buf->data_size = (int) strlen((char *) p_buf->p_buffer);
@@ -10381,154 +11420,2138 @@ mg_invoke_server_api_exit:
 }
 
 
-/* v1.5.20 */
+/* v1.6.24 Native (in-process) implementation of the bulk commands for API based connectivity */
 
-/* conversions without error checking
-   only works for valid UTF-8, i.e. no 5- or 6-byte sequences
-   srcsz = source size in bytes
-   sz = dest size in # of wide characters
-   returns # characters converted
-   if sz == srcsz+1 (i.e. 4*srcsz+4 bytes), there will always be enough space.
+/*
+   The request is in standard wire format (as built by the PHP extension):
+      <header>\n<item><item>...
+   The response is synthesized in the same format as that returned by the DB Superserver:
+      <size:5><type:2>\n<item><item>...
 */
 
-size_t mg_utf8_to_utf16(unsigned short *dest, size_t sz, const char *src, size_t srcsz)
+int mg_api_request_items(MGBUF *p_buf, MGSTR *items, int max)
 {
-   unsigned short ch;
-   const char *src_end;
-   size_t i, nb;
-
-   i = 0;
-   src_end = src + srcsz;
+   int n, size, hlen;
+   short byref, type;
+   unsigned long offset;
+   char *p;
 
-   if (sz == 0 || srcsz == 0)
+   p = strstr((char *) p_buf->p_buffer, "\n");
+   if (!p) {
       return 0;
+   }
+   offset = (unsigned long) ((p + 1) - (char *) p_buf->p_buffer);
 
-   while (i < sz) {
-      if (!dbx_isutf(*src)) { /* invalid sequence */
-         dest[i++] = 0xFFFD;
-         src ++;
-         if (src >= src_end)
-            break;
-         continue;
-      }
-      nb = dbx_trailing_bytes_for_utf8[(unsigned char) *src];
-      if (src + nb >= src_end)
+   for (n = 0; n < max && offset < p_buf->data_size; n ++) {
+      hlen = mg_decode_item_header(p_buf->p_buffer + offset, &size, &byref, &type);
+      offset += hlen;
+      if (size < 0 || (offset + size) > p_buf->data_size) {
          break;
-      ch = 0;
-/*
-      switch (nb) {
-         case 5: ch += (unsigned char) *src ++; ch <<= 6;
-         case 4: ch += (unsigned char) *src ++; ch <<= 6;
-         case 3: ch += (unsigned char) *src ++; ch <<= 6;
-         case 2: ch += (unsigned char) *src ++; ch <<= 6;
-         case 1: ch += (unsigned char) *src ++; ch <<= 6;
-         case 0: ch += (unsigned char) *src ++;
       }
-*/
+      items[n].ps = (unsigned char *) (p_buf->p_buffer + offset);
+      items[n].size = (unsigned int) size;
+      offset += size;
+   }
 
-      if (nb == 5) {
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-      }
-      else if (nb == 4) {
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-      }
-      else if (nb == 3) {
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-      }
-      else if (nb == 2) {
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
-      }
-      else if (nb == 1) {
-         ch += (unsigned char) *src ++;
-         ch <<= 6;
-         ch += (unsigned char) *src ++;
+   return n;
+}
+
+
+int mg_api_response_init(MGBUF *p_buf)
+{
+   return mg_buf_cpy(p_buf, "00000cv\n", MG_RECV_HEAD);
+}
+
+
+int mg_api_response_item(MGBUF *p_buf, unsigned char *data, int size)
+{
+   return mg_request_add(NULL, 0, p_buf, data, size, 0, MG_TX_DATA);
+}
+
+
+int mg_api_response_end(MGBUF *p_buf, int error)
+{
+   int len;
+   unsigned char esize[16];
+
+   len = mg_encode_size(esize, (int) (p_buf->data_size - MG_RECV_HEAD), MG_CHUNK_SIZE_BASE);
+   if (len > 5) {
+      len = 5;
+   }
+   memset((void *) p_buf->p_buffer, '0', 5);
+   memcpy((void *) (p_buf->p_buffer + (5 - len)), (void *) esize, (size_t) len);
+   if (error) {
+      p_buf->p_buffer[6] = 'e';
+   }
+
+   return 1;
+}
+
+
+int mg_api_response_error(MGBUF *p_buf, char *error)
+{
+   mg_api_response_init(p_buf);
+   mg_buf_cat(p_buf, error, (unsigned long) strlen(error));
+   mg_api_response_end(p_buf, 1);
+
+   return 1;
+}
+
+
+int mg_api_item_int(MGSTR *item)
+{
+   char buffer[32];
+
+   if (item->size == 0 || item->size > 30) {
+      return 0;
+   }
+   strncpy(buffer, (char *) item->ps, item->size);
+   buffer[item->size] = '\0';
+
+   return (int) strtol(buffer, NULL, 10);
+}
+
+
+int mg_api_check(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   DBXCON *pcon = pmeth->pcon;
+
+   if (pcon->dbtype == DBX_DBTYPE_YOTTADB) {
+      if (!pcon->p_ydb_so || !pcon->p_ydb_so->loaded) {
+         strcpy(p_srv->error_mess, "YottaDB server API not bound");
+         mg_api_response_error(p_buf, p_srv->error_mess);
+         return 0;
       }
-      else if (nb == 0) {
-         ch += (unsigned char) *src ++;
+   }
+   else if (pcon->dbtype == DBX_DBTYPE_GTM) {
+      strcpy(p_srv->error_mess, "This operation is not supported by the GT.M server API");
+      mg_api_response_error(p_buf, p_srv->error_mess);
+      return 0;
+   }
+   else {
+      if (!pcon->p_isc_so || !pcon->p_isc_so->loaded) {
+         strcpy(p_srv->error_mess, "InterSystems server API not bound");
+         mg_api_response_error(p_buf, p_srv->error_mess);
+         return 0;
       }
+   }
 
-      ch -= dbx_offsets_from_utf8[nb];
-      dest[i ++] = ch;
+   if (mg_meth_buffers(pmeth) == 0) {
+      strcpy(p_srv->error_mess, "Unable to allocate memory for the API buffers");
+      mg_api_response_error(p_buf, p_srv->error_mess);
+      return 0;
    }
-   return i;
+
+   return 1;
 }
 
 
-/* srcsz = number of source characters
-   sz = size of dest buffer in bytes
-   returns # bytes stored in dest
-   the destination string will never be bigger than the source string.
-*/
+int mg_api_reference(DBXMETH *pmeth, MGSTR *keys, int keyn, short global)
+{
+   return mg_api_reference_ex(pmeth, keys, keyn, global, 0);
+}
 
-size_t mg_utf16_to_utf8(char *dest, size_t sz, const unsigned short *src, size_t srcsz)
+
+/* global2 (if non-zero) marks the key that starts a second global reference (as used by merge) */
+
+int mg_api_reference_ex(DBXMETH *pmeth, MGSTR *keys, int keyn, short global, int global2)
 {
-   unsigned short ch;
-   size_t i;
-   char *dest0, *dest_end;
+   int n;
+   unsigned int size;
+   char *p;
 
-   i = 0;
-   dest0 = dest;
-   dest_end = dest + sz;
+   if (keyn < 1 || keyn > (DBX_MAXARGS - 2)) {
+      return CACHE_FAILURE;
+   }
 
-   while (i < srcsz) {
-      ch = src[i];
-      if (ch < 0x80) {
-         if (dest >= dest_end)
-            break;
-         *dest ++ = (char) ch;
+   size = 32;
+   for (n = 0; n < keyn; n ++) {
+      size += (keys[n].size + 5);
+   }
+   if (size > pmeth->api_str.len_alloc) {
+      p = (char *) mg_malloc(sizeof(char) * (size + DBX_MAXKEYSIZE), 0);
+      if (!p) {
+         return CACHE_FAILURE;
       }
-      else if (ch < 0x800) {
-         if (dest >= dest_end - 1)
-            break;
-          *dest ++ = (ch >> 6) | 0xC0;
-          *dest ++ = (ch & 0x3F) | 0x80;
-       }
-       else if (ch < 0x10000) {
-          if (dest >= dest_end - 2)
-            break;
-          *dest ++ = (ch >> 12) | 0xE0;
-          *dest ++ = ((ch >> 6) & 0x3F) | 0x80;
-          *dest ++ = (ch & 0x3F) | 0x80;
-       }
-/*
-       else if (ch < 0x110000) {
-         if (dest >= dest_end - 3)
-            break;
-         *dest ++ = (ch >> 18) | 0xF0;
-         *dest ++ = ((ch >> 12) & 0x3F) | 0x80;
-         *dest ++ = ((ch >> 6) & 0x3F) | 0x80;
-         *dest ++ = (ch & 0x3F) | 0x80;
+      if (pmeth->api_str.buf_addr) {
+         mg_free((void *) pmeth->api_str.buf_addr, 0);
       }
-*/
-      i ++;
+      pmeth->api_str.buf_addr = p;
+      pmeth->api_str.len_alloc = size + DBX_MAXKEYSIZE;
    }
-   return (dest - dest0);
+
+   pmeth->input_str.buf_addr = pmeth->api_str.buf_addr;
+   pmeth->input_str.len_alloc = pmeth->api_str.len_alloc;
+   pmeth->input_str.len_used = 0;
+
+   mg_add_block_head(&(pmeth->input_str), (unsigned long) pmeth->output_val.svalue.len_alloc, 0);
+   for (n = 0; n < keyn; n ++) {
+      mg_add_block_size(&(pmeth->input_str), pmeth->input_str.len_used, (unsigned long) keys[n].size, (global && (n == 0 || n == global2)) ? DBX_DSORT_GLOBAL : DBX_DSORT_SUBSCRIPT, DBX_DTYPE_STR);
+      pmeth->input_str.len_used += 5;
+      if (keys[n].size) {
+         memcpy((void *) (pmeth->input_str.buf_addr + pmeth->input_str.len_used), (void *) keys[n].ps, (size_t) keys[n].size);
+         pmeth->input_str.len_used += keys[n].size;
+      }
+   }
+   mg_add_block_size(&(pmeth->input_str), pmeth->input_str.len_used, (unsigned long) 0, DBX_DSORT_EOD, DBX_DTYPE_STR);
+   pmeth->input_str.len_used += 5;
+   mg_add_block_head_size(&(pmeth->input_str), (unsigned long) pmeth->input_str.len_used, 0);
+
+   pmeth->offset = 15;
+   pmeth->argc = 0;
+   pmeth->lock = 0;
+   pmeth->increment = 0;
+   pmeth->merge = 0;
+   pmeth->getdata = 0;
+   pmeth->input_str16.len_used = 0;
+   pmeth->output_val.offset = 5;
+   pmeth->output_val.svalue.len_used = 5;
+   pmeth->pcon->error[0] = '\0';
+
+   return CACHE_SUCCESS;
+}
+
+
+int mg_api_invoke(DBXMETH *pmeth, MGSTR *keys, int keyn, int (* p_dbxfun) (struct tagDBXMETH * pmeth))
+{
+   return mg_api_invoke_ex(pmeth, keys, keyn, 0, p_dbxfun);
+}
+
+
+int mg_api_invoke_ex(DBXMETH *pmeth, MGSTR *keys, int keyn, short lock, int (* p_dbxfun) (struct tagDBXMETH * pmeth))
+{
+   int rc;
+   DBXCON *pcon = pmeth->pcon;
+
+   /* lock names keep their '^' */
+   rc = mg_api_reference(pmeth, keys, keyn, (short) (lock ? 0 : 1));
+   if (rc != CACHE_SUCCESS) {
+      strcpy(pcon->error, "Invalid global reference");
+      return rc;
+   }
+
+   DBX_LOCK(rc, 0);
+
+   pmeth->lock = lock;
+   rc = mg_global_reference(pmeth);
+
+   if (rc == CACHE_SUCCESS) {
+      if (pcon->dbtype == DBX_DBTYPE_YOTTADB && pcon->tlevel > 0) {
+         pmeth->p_dbxfun = p_dbxfun;
+         rc = ydb_transaction_task(pmeth, YDB_TPCTX_DB);
+      }
+      else {
+         rc = p_dbxfun(pmeth);
+      }
+   }
+
+   if (rc != CACHE_SUCCESS) {
+      mg_error_message(pmeth, rc);
+   }
+
+   DBX_UNLOCK(rc);
+
+   mg_cleanup(pmeth);
+
+   return rc;
+}
+
+
+/*
+   Batched $Order (command 'N')
+   Request items:  max, direction, flags, stop, global, subscripts ..., seed
+   Flags:          'd' return $Data; 'v' return the value; 'i' include the seed key (if defined)
+   Response items: key [, $Data] [, value] for each node found
+*/
+
+int mg_api_order(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, keyn, max, rows, getdata, getvalue, inclusive, cmp;
+   unsigned int len;
+   unsigned char seed[DBX_MAXKEYSIZE + 8];
+   MGSTR items[DBX_MAXARGS];
+   MGSTR keys[DBX_MAXARGS];
+   MGSTR stop;
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS);
+   if (itemn < 6) {
+      mg_api_response_error(p_buf, "Invalid batched order request");
+      return 1;
+   }
+
+   max = mg_api_item_int(&items[0]);
+   if (max < 1) {
+      max = 1;
+   }
+   pmeth->direction = (mg_api_item_int(&items[1]) < 0) ? -1 : 1;
+   getdata = 0;
+   getvalue = 0;
+   inclusive = 0;
+   for (n = 0; n < (int) items[2].size; n ++) {
+      if (items[2].ps[n] == 'd')
+         getdata = 1;
+      else if (items[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (items[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+   stop = items[3];
+
+   keyn = itemn - 4;
+   for (n = 0; n < keyn; n ++) {
+      keys[n] = items[n + 4];
+   }
+   if (keys[keyn - 1].size > DBX_MAXKEYSIZE) {
+      mg_api_response_error(p_buf, "Subscript too long");
+      return 1;
+   }
+   memcpy((void *) seed, (void *) keys[keyn - 1].ps, (size_t) keys[keyn - 1].size);
+   keys[keyn - 1].ps = seed;
+
+   mg_buf_init(&response, MG_BUFSIZE, MG_BUFSIZE);
+   mg_api_response_init(&response);
+
+   rc = CACHE_SUCCESS;
+   rows = 0;
+   if (inclusive && keys[keyn - 1].size > 0) {
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_defined_ex);
+      if (rc == CACHE_SUCCESS && pmeth->output_val.num.int32) {
+         rc = mg_api_order_row(pmeth, keys, keyn, getdata, getvalue, &response);
+         rows ++;
+      }
+   }
+
+   while (rc == CACHE_SUCCESS && rows < max) {
+      pmeth->direction = (mg_api_item_int(&items[1]) < 0) ? -1 : 1;
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_next_ex);
+      if (rc != CACHE_SUCCESS) {
+         break;
+      }
+      len = (unsigned int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+      if (len == 0) {
+         break;
+      }
+      if (len > DBX_MAXKEYSIZE) {
+         strcpy(pmeth->pcon->error, "Subscript too long");
+         rc = CACHE_FAILURE;
+         break;
+      }
+      memcpy((void *) seed, (void *) (pmeth->output_val.svalue.buf_addr + 5), (size_t) len);
+      keys[keyn - 1].size = len;
+
+      if (stop.size) {
+         cmp = mg_collate_compare(seed, (int) len, stop.ps, (int) stop.size);
+         if ((pmeth->direction == 1 && cmp > 0) || (pmeth->direction == -1 && cmp < 0)) {
+            break;
+         }
+      }
+
+      rc = mg_api_order_row(pmeth, keys, keyn, getdata, getvalue, &response);
+      rows ++;
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+   mg_buf_free(&response);
+
+   return 1;
+}
+
+
+int mg_api_order_row(DBXMETH *pmeth, MGSTR *keys, int keyn, int getdata, int getvalue, MGBUF *p_res)
+{
+   int rc, data, len;
+   char buffer[32];
+
+   rc = CACHE_SUCCESS;
+   mg_api_response_item(p_res, keys[keyn - 1].ps, (int) keys[keyn - 1].size);
+
+   if (!getdata && !getvalue) {
+      return rc;
+   }
+
+   rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_defined_ex);
+   if (rc != CACHE_SUCCESS) {
+      return rc;
+   }
+   data = pmeth->output_val.num.int32;
+
+   if (getdata) {
+      sprintf(buffer, "%d", data);
+      mg_api_response_item(p_res, (unsigned char *) buffer, (int) strlen(buffer));
+   }
+   if (getvalue) {
+      len = 0;
+      if (data % 2) {
+         rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_get_ex);
+         if (rc != CACHE_SUCCESS) {
+            return rc;
+         }
+         len = (int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+      }
+      mg_api_response_item(p_res, (unsigned char *) pmeth->output_val.svalue.buf_addr + 5, len);
+   }
+
+   return rc;
+}
+
+
+/*
+   Batched $Query over the data nodes under a global reference (command 'Q')
+   Request items:  max, direction, flags, base, global, subscripts ...
+   Flags:          'v' return the value; 's' start of the walk (the reference is the base reference itself)
+                   'i' include the node at the reference itself (if it holds data)
+   Base:           the number of leading subscripts that identify the subtree
+   Response items: number of subscripts, subscripts ... [, value] for each node found
+*/
+
+int mg_api_query(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, keyn, basen, max, rows, direction, getvalue, start, inclusive;
+   unsigned int len;
+   unsigned char *kdata;
+   MGSTR items[DBX_MAXARGS];
+   MGSTR keys[DBX_MAXARGS];
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS - 2);
+   if (itemn < 5) {
+      mg_api_response_error(p_buf, "Invalid batched query request");
+      return 1;
+   }
+
+   max = mg_api_item_int(&items[0]);
+   if (max < 1) {
+      max = 1;
+   }
+   direction = (mg_api_item_int(&items[1]) < 0) ? -1 : 1;
+   getvalue = 0;
+   start = 0;
+   inclusive = 0;
+   for (n = 0; n < (int) items[2].size; n ++) {
+      if (items[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (items[2].ps[n] == 's')
+         start = 1;
+      else if (items[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+   keyn = itemn - 4;
+   basen = mg_api_item_int(&items[3]);
+   if (basen < 0 || basen > (keyn - 1)) {
+      basen = keyn - 1;
+   }
+
+   kdata = (unsigned char *) mg_malloc(sizeof(char) * DBX_MAXARGS * (DBX_MAXKEYSIZE + 1), 0);
+   if (!kdata) {
+      mg_api_response_error(p_buf, "Unable to allocate memory for the query keys");
+      return 1;
+   }
+   for (n = 0; n < keyn; n ++) {
+      if (items[n + 4].size > DBX_MAXKEYSIZE) {
+         mg_free((void *) kdata, 0);
+         mg_api_response_error(p_buf, "Subscript too long");
+         return 1;
+      }
+      keys[n].ps = kdata + (n * (DBX_MAXKEYSIZE + 1));
+      keys[n].size = items[n + 4].size;
+      memcpy((void *) keys[n].ps, (void *) items[n + 4].ps, (size_t) items[n + 4].size);
+   }
+
+   mg_buf_init(&response, MG_BUFSIZE, MG_BUFSIZE);
+   mg_api_response_init(&response);
+
+   rc = CACHE_SUCCESS;
+   rows = 0;
+
+   if (inclusive && direction == 1) {
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_defined_ex);
+      if (rc == CACHE_SUCCESS && (pmeth->output_val.num.int32 % 2)) {
+         rc = mg_api_query_row(pmeth, keys, keyn, getvalue, &response);
+         rows ++;
+      }
+   }
+
+   if (start && direction == -1) {
+      /* descend to the last node in the subtree */
+      while (keyn < (DBX_MAXARGS - 2)) {
+         keys[keyn].ps = kdata + (keyn * (DBX_MAXKEYSIZE + 1));
+         keys[keyn].size = 0;
+         pmeth->direction = -1;
+         rc = mg_api_invoke(pmeth, keys, keyn + 1, (int (*) (struct tagDBXMETH * pmeth)) dbx_next_ex);
+         if (rc != CACHE_SUCCESS) {
+            break;
+         }
+         len = (unsigned int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+         if (len == 0) {
+            break;
+         }
+         if (len > DBX_MAXKEYSIZE) {
+            strcpy(pmeth->pcon->error, "Subscript too long");
+            rc = CACHE_FAILURE;
+            break;
+         }
+         memcpy((void *) keys[keyn].ps, (void *) (pmeth->output_val.svalue.buf_addr + 5), (size_t) len);
+         keys[keyn].size = len;
+         keyn ++;
+      }
+      if (rc == CACHE_SUCCESS && keyn > (basen + 1)) {
+         rc = mg_api_query_row(pmeth, keys, keyn, getvalue, &response);
+         rows ++;
+      }
+      else {
+         max = 0;
+      }
+   }
+
+   while (rc == CACHE_SUCCESS && rows < max) {
+      pmeth->direction = direction;
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_next_node_ex);
+      if (rc != CACHE_SUCCESS) {
+         break;
+      }
+      n = mg_api_query_keys(pmeth, keys, kdata);
+      if (n < 0) {
+         strcpy(pmeth->pcon->error, "Subscript too long");
+         rc = CACHE_FAILURE;
+         break;
+      }
+      if (n == 0 || n <= (basen + 1)) {
+         break;
+      }
+      keyn = n;
+      for (n = 1; n <= basen; n ++) {
+         if (keys[n].size != items[n + 4].size || memcmp((void *) keys[n].ps, (void *) items[n + 4].ps, (size_t) keys[n].size)) {
+            break;
+         }
+      }
+      if (n <= basen) {
+         break;
+      }
+      rc = mg_api_query_row(pmeth, keys, keyn, getvalue, &response);
+      rows ++;
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+   mg_buf_free(&response);
+   mg_free((void *) kdata, 0);
+
+   return 1;
+}
+
+
+/* Copy the subscripts returned by dbx_next_node_ex into the key slots: returns the number of keys (including the global) or zero at the end */
+
+int mg_api_query_keys(DBXMETH *pmeth, MGSTR *keys, unsigned char *kdata)
+{
+   int n, dsort, dtype;
+   unsigned long len, offset;
+
+   offset = 5;
+   len = mg_get_block_size(&(pmeth->output_val.svalue), offset, &dsort, &dtype);
+   if (dsort == DBX_DSORT_EOD) {
+      return 0;
+   }
+   offset += (5 + len);
+
+   for (n = 1; n < (DBX_MAXARGS - 2); n ++) {
+      len = mg_get_block_size(&(pmeth->output_val.svalue), offset, &dsort, &dtype);
+      if (dsort == DBX_DSORT_EOD || offset >= pmeth->output_val.svalue.len_used) {
+         break;
+      }
+      offset += 5;
+      if (len > DBX_MAXKEYSIZE) {
+         return -1;
+      }
+      keys[n].ps = kdata + (n * (DBX_MAXKEYSIZE + 1));
+      keys[n].size = (unsigned int) len;
+      memcpy((void *) keys[n].ps, (void *) (pmeth->output_val.svalue.buf_addr + offset), (size_t) len);
+      offset += len;
+   }
+
+   return n;
+}
+
+
+int mg_api_query_row(DBXMETH *pmeth, MGSTR *keys, int keyn, int getvalue, MGBUF *p_res)
+{
+   int rc, n, len;
+   char buffer[32];
+
+   rc = CACHE_SUCCESS;
+   sprintf(buffer, "%d", keyn - 1);
+   mg_api_response_item(p_res, (unsigned char *) buffer, (int) strlen(buffer));
+   for (n = 1; n < keyn; n ++) {
+      mg_api_response_item(p_res, keys[n].ps, (int) keys[n].size);
+   }
+
+   if (getvalue) {
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_get_ex);
+      if (rc != CACHE_SUCCESS) {
+         return rc;
+      }
+      len = (int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+      mg_api_response_item(p_res, (unsigned char *) pmeth->output_val.svalue.buf_addr + 5, len);
+   }
+
+   return rc;
+}
+
+
+/*
+   Batched global directory listing (command 'E')
+   Request items:  max (0 for no limit), flags, prefix, seed
+   Flags:          'c' continue a listing (InterSystems: reuse the directory snapshot taken by the first call)
+   Response items: global names (with the leading '^') following the seed
+*/
+
+int mg_api_globals(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, max, rows, init, plen;
+   unsigned int len;
+   char prefix[DBX_MAXGNAMESIZE + 8], name[DBX_MAXGNAMESIZE + 8];
+   MGSTR items[8];
+   MGSTR seed;
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, 8);
+   if (itemn < 4) {
+      mg_api_response_error(p_buf, "Invalid global directory request");
+      return 1;
+   }
+   if (items[2].size > DBX_MAXGNAMESIZE || items[3].size > DBX_MAXGNAMESIZE) {
+      mg_api_response_error(p_buf, "Invalid global name");
+      return 1;
+   }
+
+   max = mg_api_item_int(&items[0]);
+   init = 1;
+   for (n = 0; n < (int) items[1].size; n ++) {
+      if (items[1].ps[n] == 'c')
+         init = 0;
+   }
+
+   plen = mg_api_gname_normalize(prefix, items[2].ps, (int) items[2].size);
+
+   mg_buf_init(&response, MG_BUFSIZE, MG_BUFSIZE);
+   mg_api_response_init(&response);
+
+   rc = CACHE_SUCCESS;
+   rows = 0;
+   if (items[3].size) {
+      memcpy((void *) name, (void *) items[3].ps, (size_t) items[3].size);
+      len = items[3].size;
+   }
+   else if (plen > 1) {
+      /* start from the prefix itself, which $Order would skip */
+      strcpy(name, prefix);
+      len = plen;
+      seed.ps = (unsigned char *) name;
+      seed.size = len;
+      rc = mg_api_invoke(pmeth, &seed, 1, (int (*) (struct tagDBXMETH * pmeth)) dbx_defined_ex);
+      if (rc == CACHE_SUCCESS && pmeth->output_val.num.int32) {
+         mg_api_response_item(&response, (unsigned char *) name, (int) len);
+         rows ++;
+      }
+   }
+   else {
+      len = 0;
+   }
+
+   while (rc == CACHE_SUCCESS && (max < 1 || rows < max)) {
+      seed.ps = (unsigned char *) name;
+      seed.size = len;
+      rc = mg_api_gname(pmeth, &seed, init);
+      init = 0;
+      if (rc != CACHE_SUCCESS) {
+         break;
+      }
+      len = (unsigned int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+      if (len == 0 || len > DBX_MAXGNAMESIZE) {
+         break;
+      }
+      memcpy((void *) name, (void *) (pmeth->output_val.svalue.buf_addr + 5), (size_t) len);
+      name[len] = '\0';
+      if (plen > 1 && strncmp(name, prefix, plen)) {
+         break;
+      }
+      mg_api_response_item(&response, (unsigned char *) name, (int) len);
+      rows ++;
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+   mg_buf_free(&response);
+
+   return 1;
+}
+
+
+int mg_api_gname(DBXMETH *pmeth, MGSTR *seed, int init)
+{
+   int rc;
+   DBXCON *pcon = pmeth->pcon;
+
+   rc = mg_api_reference(pmeth, seed, 1, 0);
+   if (rc != CACHE_SUCCESS) {
+      strcpy(pcon->error, "Invalid global name");
+      return rc;
+   }
+
+   DBX_LOCK(rc, 0);
+
+   mg_unpack_arguments(pmeth);
+   pmeth->direction = 1;
+   pmeth->args[1].num.int32 = init ? 0 : 1;
+
+   /* the YottaDB path leaves the output untouched at the end of the directory */
+   mg_add_block_size(&(pmeth->output_val.svalue), 0, (unsigned long) 0, DBX_DSORT_DATA, DBX_DTYPE_DBXSTR);
+
+   if (pcon->dbtype == DBX_DBTYPE_YOTTADB && pcon->tlevel > 0) {
+      pmeth->p_dbxfun = (int (*) (struct tagDBXMETH * pmeth)) dbx_next_gname_ex;
+      rc = ydb_transaction_task(pmeth, YDB_TPCTX_DB);
+   }
+   else {
+      rc = dbx_next_gname_ex(pmeth);
+   }
+
+   if (rc != CACHE_SUCCESS) {
+      mg_error_message(pmeth, rc);
+   }
+
+   DBX_UNLOCK(rc);
+
+   mg_cleanup(pmeth);
+
+   return rc;
+}
+
+
+int mg_api_gname_normalize(char *name, unsigned char *data, int len)
+{
+   int n;
+
+   n = 0;
+   if (len && data[0] != '^') {
+      name[n ++] = '^';
+   }
+   if (len) {
+      memcpy((void *) (name + n), (void *) data, (size_t) len);
+      n += len;
+   }
+   name[n] = '\0';
+
+   return n;
+}
+
+
+/*
+   Incremental lock of one or more nodes (command 'L')
+   Request items:  timeout (milliseconds; -1 to wait indefinitely), then for each node: number of keys, global, subscripts ...
+   Response items: 1 if all the nodes were locked; 0 if the timeout expired (in which case none of them are held)
+*/
+
+int mg_api_lock(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, keyn, locked, timeout, remaining;
+   unsigned long start;
+   MGSTR items[DBX_MAXARGS * 8];
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS * 8);
+   if (itemn < 3) {
+      mg_api_response_error(p_buf, "Invalid lock request");
+      return 1;
+   }
+   timeout = mg_api_item_int(&items[0]);
+   start = mg_api_time_ms();
+
+   rc = CACHE_SUCCESS;
+   locked = 1;
+   for (n = 1; n < itemn; n += (keyn + 1)) {
+      keyn = mg_api_item_int(&items[n]);
+      if (keyn < 1 || keyn > (DBX_MAXARGS - 4) || (n + keyn) >= itemn) {
+         strcpy(pmeth->pcon->error, "Invalid lock reference");
+         rc = CACHE_FAILURE;
+         break;
+      }
+      remaining = timeout;
+      if (timeout > 0) {
+         remaining = timeout - (int) (mg_api_time_ms() - start);
+         if (remaining < 0) {
+            remaining = 0;
+         }
+      }
+      rc = mg_api_lock_node(pmeth, &items[n + 1], keyn, remaining, 1);
+      if (rc != CACHE_SUCCESS) {
+         break;
+      }
+      if (!pmeth->output_val.num.int32) {
+         locked = 0;
+         break;
+      }
+   }
+
+   /* all or nothing: release the nodes already locked */
+   if (rc != CACHE_SUCCESS || !locked) {
+      itemn = n;
+      for (n = 1; n < itemn; n += (keyn + 1)) {
+         keyn = mg_api_item_int(&items[n]);
+         mg_api_lock_node(pmeth, &items[n + 1], keyn, 0, 0);
+      }
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_buf_init(&response, 64, 64);
+      mg_api_response_init(&response);
+      mg_api_response_item(&response, (unsigned char *) (locked ? "1" : "0"), 1);
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+      mg_buf_free(&response);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+
+   return 1;
+}
+
+
+/*
+   Incremental unlock of one or more nodes (command 'U')
+   Request items:  for each node: number of keys, global, subscripts ...
+   Response items: 1
+*/
+
+int mg_api_unlock(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, keyn;
+   MGSTR items[DBX_MAXARGS * 8];
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS * 8);
+
+   rc = CACHE_SUCCESS;
+   for (n = 0; n < itemn; n += (keyn + 1)) {
+      keyn = mg_api_item_int(&items[n]);
+      if (keyn < 1 || keyn > (DBX_MAXARGS - 4) || (n + keyn) >= itemn) {
+         strcpy(pmeth->pcon->error, "Invalid lock reference");
+         rc = CACHE_FAILURE;
+         break;
+      }
+      rc = mg_api_lock_node(pmeth, &items[n + 1], keyn, 0, 0);
+      if (rc != CACHE_SUCCESS) {
+         break;
+      }
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_buf_init(&response, 64, 64);
+      mg_api_response_init(&response);
+      mg_api_response_item(&response, (unsigned char *) "1", 1);
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+      mg_buf_free(&response);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+
+   return 1;
+}
+
+
+int mg_api_lock_node(DBXMETH *pmeth, MGSTR *keys, int keyn, int timeout, int lock)
+{
+   int rc, n;
+   char buffer[32];
+   MGSTR lkeys[DBX_MAXARGS];
+
+   if (!lock) {
+      rc = mg_api_invoke_ex(pmeth, keys, keyn, 1, (int (*) (struct tagDBXMETH * pmeth)) dbx_unlock_ex);
+      return rc;
+   }
+
+   /* dbx_lock_ex() expects the timeout (in whole seconds) to follow the reference */
+   for (n = 0; n < keyn; n ++) {
+      lkeys[n] = keys[n];
+   }
+   sprintf(buffer, "%d", (timeout < 0) ? -1 : ((timeout + 999) / 1000));
+   lkeys[keyn].ps = (unsigned char *) buffer;
+   lkeys[keyn].size = (unsigned int) strlen(buffer);
+
+   rc = mg_api_invoke_ex(pmeth, lkeys, keyn + 1, 1, (int (*) (struct tagDBXMETH * pmeth)) dbx_lock_ex);
+   pmeth->output_val.num.int32 = 0;
+   if (rc == CACHE_SUCCESS) {
+      pmeth->output_val.num.int32 = (int) strtol(pmeth->output_val.svalue.buf_addr + 5, NULL, 10);
+   }
+   return rc;
+}
+
+
+/*
+   Global to global merge (command 'R'): MERGE ^to(...)=^from(...)
+   Request items:  to keyn, global, subscripts ..., from keyn, global, subscripts ...
+   Response items: 1
+*/
+
+int mg_api_merge(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, to_keyn, from_keyn;
+   MGSTR items[DBX_MAXARGS];
+   MGBUF response;
+   DBXCON *pcon = pmeth->pcon;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS);
+   to_keyn = (itemn > 0) ? mg_api_item_int(&items[0]) : 0;
+   from_keyn = (to_keyn > 0 && (to_keyn + 1) < itemn) ? mg_api_item_int(&items[to_keyn + 1]) : 0;
+   if (to_keyn < 1 || from_keyn < 1 || (to_keyn + from_keyn + 2) != itemn) {
+      mg_api_response_error(p_buf, "Invalid merge request");
+      return 1;
+   }
+
+   /* dbx_merge_ex() takes both references as one list: the source global name marks the split */
+   for (n = 0; n < from_keyn; n ++) {
+      items[to_keyn + 1 + n] = items[to_keyn + 2 + n];
+   }
+   rc = mg_api_reference_ex(pmeth, &items[1], to_keyn + from_keyn, 1, to_keyn);
+   if (rc != CACHE_SUCCESS) {
+      strcpy(pcon->error, "Invalid global reference");
+   }
+   else {
+      DBX_LOCK(rc, 0);
+
+      pmeth->merge = 1;
+      rc = mg_global_reference(pmeth);
+
+      if (rc == CACHE_SUCCESS) {
+         if (pcon->dbtype == DBX_DBTYPE_YOTTADB && pcon->tlevel > 0) {
+            pmeth->p_dbxfun = (int (*) (struct tagDBXMETH * pmeth)) dbx_merge_ex;
+            rc = ydb_transaction_task(pmeth, YDB_TPCTX_DB);
+         }
+         else {
+            rc = dbx_merge_ex(pmeth);
+         }
+      }
+
+      if (rc != CACHE_SUCCESS) {
+         mg_error_message(pmeth, rc);
+      }
+
+      DBX_UNLOCK(rc);
+
+      pmeth->merge = 0;
+      mg_cleanup(pmeth);
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      mg_buf_init(&response, 64, 64);
+      mg_api_response_init(&response);
+      mg_api_response_item(&response, (unsigned char *) "1", 1);
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+      mg_buf_free(&response);
+   }
+   else {
+      strcpy(p_srv->error_mess, pcon->error);
+      mg_api_response_error(p_buf, pcon->error);
+   }
+
+   return 1;
+}
+
+
+/*
+   Subtree aggregation (command 'C')
+   Request items:  flags, limit, global, subscripts ...
+   Flags:          'd' count the data nodes at every level below the reference (rather than the immediate children)
+                   's' total the size (in bytes) of the data values in the subtree, including the node itself
+   Limit:          stop once the total reaches this value (0 for no limit)
+   Response items: total
+*/
+
+int mg_api_count(MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf)
+{
+   int rc, n, itemn, keyn, basen, descend, size;
+   unsigned int len;
+   unsigned long total, limit;
+   char buffer[32];
+   unsigned char *kdata;
+   MGSTR items[DBX_MAXARGS];
+   MGSTR keys[DBX_MAXARGS];
+   MGBUF response;
+
+   if (!mg_api_check(p_srv, pmeth, p_buf)) {
+      return 1;
+   }
+
+   itemn = mg_api_request_items(p_buf, items, DBX_MAXARGS - 2);
+   if (itemn < 3) {
+      mg_api_response_error(p_buf, "Invalid count request");
+      return 1;
+   }
+
+   descend = 0;
+   size = 0;
+   for (n = 0; n < (int) items[0].size; n ++) {
+      if (items[0].ps[n] == 'd')
+         descend = 1;
+      else if (items[0].ps[n] == 's')
+         size = 1;
+   }
+   limit = 0;
+   if (items[1].size > 0 && items[1].size < 30 && items[1].ps[0] != '-') {
+      memcpy((void *) buffer, (void *) items[1].ps, (size_t) items[1].size);
+      buffer[items[1].size] = '\0';
+      limit = strtoul(buffer, NULL, 10);
+   }
+
+   keyn = itemn - 2;
+   basen = keyn - 1;
+
+   kdata = (unsigned char *) mg_malloc(sizeof(char) * DBX_MAXARGS * (DBX_MAXKEYSIZE + 1), 0);
+   if (!kdata) {
+      mg_api_response_error(p_buf, "Unable to allocate memory for the count keys");
+      return 1;
+   }
+   for (n = 0; n < keyn; n ++) {
+      if (items[n + 2].size > DBX_MAXKEYSIZE) {
+         mg_free((void *) kdata, 0);
+         mg_api_response_error(p_buf, "Subscript too long");
+         return 1;
+      }
+      keys[n].ps = kdata + (n * (DBX_MAXKEYSIZE + 1));
+      keys[n].size = items[n + 2].size;
+      memcpy((void *) keys[n].ps, (void *) items[n + 2].ps, (size_t) items[n + 2].size);
+   }
+
+   rc = CACHE_SUCCESS;
+   total = 0;
+
+   if (size) {
+      /* the value at the node itself (if any) */
+      rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_defined_ex);
+      if (rc == CACHE_SUCCESS && (pmeth->output_val.num.int32 % 2)) {
+         rc = mg_api_count_value(pmeth, keys, keyn, &total);
+      }
+   }
+
+   if (descend || size) {
+      /* walk the data nodes under the reference in $Query order */
+      while (rc == CACHE_SUCCESS && (!limit || total < limit)) {
+         pmeth->direction = 1;
+         rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_next_node_ex);
+         if (rc != CACHE_SUCCESS) {
+            break;
+         }
+         n = mg_api_query_keys(pmeth, keys, kdata);
+         if (n < 0) {
+            strcpy(pmeth->pcon->error, "Subscript too long");
+            rc = CACHE_FAILURE;
+            break;
+         }
+         if (n == 0 || n <= (basen + 1)) {
+            break;
+         }
+         keyn = n;
+         for (n = 1; n <= basen; n ++) {
+            if (keys[n].size != items[n + 2].size || memcmp((void *) keys[n].ps, (void *) items[n + 2].ps, (size_t) keys[n].size)) {
+               break;
+            }
+         }
+         if (n <= basen) {
+            break;
+         }
+         if (size) {
+            rc = mg_api_count_value(pmeth, keys, keyn, &total);
+         }
+         else {
+            total ++;
+         }
+      }
+   }
+   else {
+      /* step through the subscripts at the next level */
+      keys[keyn].ps = kdata + (keyn * (DBX_MAXKEYSIZE + 1));
+      keys[keyn].size = 0;
+      keyn ++;
+      while (rc == CACHE_SUCCESS && (!limit || total < limit)) {
+         pmeth->direction = 1;
+         rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_next_ex);
+         if (rc != CACHE_SUCCESS) {
+            break;
+         }
+         len = (unsigned int) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+         if (len == 0) {
+            break;
+         }
+         if (len > DBX_MAXKEYSIZE) {
+            strcpy(pmeth->pcon->error, "Subscript too long");
+            rc = CACHE_FAILURE;
+            break;
+         }
+         memcpy((void *) keys[keyn - 1].ps, (void *) (pmeth->output_val.svalue.buf_addr + 5), (size_t) len);
+         keys[keyn - 1].size = len;
+         total ++;
+      }
+   }
+
+   if (rc == CACHE_SUCCESS) {
+      sprintf(buffer, "%lu", total);
+      mg_buf_init(&response, 64, 64);
+      mg_api_response_init(&response);
+      mg_api_response_item(&response, (unsigned char *) buffer, (int) strlen(buffer));
+      mg_api_response_end(&response, 0);
+      mg_buf_cpy(p_buf, (char *) response.p_buffer, response.data_size);
+      mg_buf_free(&response);
+   }
+   else {
+      strcpy(p_srv->error_mess, pmeth->pcon->error);
+      mg_api_response_error(p_buf, pmeth->pcon->error);
+   }
+   mg_free((void *) kdata, 0);
+
+   return 1;
+}
+
+
+/* Add the size of the value held at a data node to the running total: the value does not leave the process */
+
+int mg_api_count_value(DBXMETH *pmeth, MGSTR *keys, int keyn, unsigned long *total)
+{
+   int rc;
+
+   rc = mg_api_invoke(pmeth, keys, keyn, (int (*) (struct tagDBXMETH * pmeth)) dbx_get_ex);
+   if (rc == CACHE_SUCCESS) {
+      *total += (unsigned long) mg_get_size((unsigned char *) pmeth->output_val.svalue.buf_addr);
+   }
+
+   return rc;
+}
+
+
+unsigned long mg_api_time_ms(void)
+{
+#if defined(_WIN32)
+   return (unsigned long) GetTickCount();
+#else
+   struct timeval tp;
+
+   gettimeofday(&tp, NULL);
+   return (unsigned long) ((tp.tv_sec * 1000) + (tp.tv_usec / 1000));
+#endif
+}
+
+
+/* v1.6.24 monotonic clock (nanoseconds) for timing requests */
+
+unsigned long long mg_time_ns(void)
+{
+#if defined(_WIN32)
+   static LARGE_INTEGER frequency = {0};
+   LARGE_INTEGER counter;
+
+   if (!frequency.QuadPart) {
+      QueryPerformanceFrequency(&frequency);
+   }
+   QueryPerformanceCounter(&counter);
+   return (unsigned long long) ((counter.QuadPart / frequency.QuadPart) * 1000000000ULL) + (unsigned long long) (((counter.QuadPart % frequency.QuadPart) * 1000000000ULL) / frequency.QuadPart);
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((unsigned long long) ts.tv_sec * 1000000000ULL) + (unsigned long long) ts.tv_nsec;
+#endif
+}
+
+
+/* v1.6.24 add the time elapsed since t0 to a phase of the function currently being timed (t0 is zero if timing is not active) and return it */
+
+unsigned long long mg_stat_phase(MGSRV *p_srv, int phase, unsigned long long t0)
+{
+   unsigned long long t1;
+
+   if (!t0) {
+      return 0;
+   }
+
+   t1 = mg_time_ns();
+   p_srv->stat.phase[phase] += (t1 - t0);
+   if (phase == MG_STAT_WAIT) {
+      p_srv->stat.received = t1;
+   }
+   return (t1 - t0);
+}
+
+
+/* v1.6.24 micro-benchmarks: the time (nanoseconds) taken for 'iterations' operations of the benchmark named (zero operations if it is not known)
+   encode_size, decode_size:                 the base 62 size in the header of each request and response
+   encode_item_header, decode_item_header:   the header of each item (argument, key or data)
+   buf_cat:                                  appending 32 bytes to a buffer
+   buf_grow:                                 appending 32 bytes to a new buffer, growing it from 256 bytes to 32KB
+   array_encode, array_decode:               a record of an array (3 keys and data) in MG_TX_AREC format
+   utf8_to_utf16, utf16_to_utf8:             348 bytes (224 characters) of mixed Cyrillic, CJK and ASCII text
+   ydb_ci, ydb_cip:                          a call to ifc_zmgsis (a 'G' request) by name or through a call-in descriptor (zero operations if YottaDB is not available)
+*/
+
+unsigned long long mg_benchmark(char *name, unsigned long iterations, unsigned long *p_ops)
+{
+   int n, hlen, size, records;
+   short byref, type;
+   size_t len, len16;
+   unsigned long i, sink;
+   unsigned long long t0, t1;
+   unsigned char head[16], esize[16], *p;
+   char *keys[3] = {"^Customer", "123456", "address"};
+   char data[32] = "1 Main Street, Springfield, IL";
+   MGBUF buf;
+   char utf8[512];
+   unsigned short utf16[512];
+   char *text = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80! \xe4\xbd\xa0\xe5\xa5\xbd\xef\xbc\x8c\xe4\xb8\x96\xe7\x95\x8c\xe3\x80\x82 Hello, world 2026; \xd0\x9c\xd0\xbe\xd1\x81\xd0\xba\xd0\xb2\xd0\xb0, \xe6\x9d\xb1\xe4\xba\xac, Paris";
+   MGSRV srv;
+   DBXCON *pcon;
+   ci_name_descriptor desc;
+   ydb_string_t out, in[4];
+
+   *p_ops = 0;
+   sink = 0;
+   if (!iterations) {
+      return 0;
+   }
+
+   if (!strcmp(name, "encode_size")) {
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         sink += mg_encode_size(esize, (int) (i & 0xfffff), MG_CHUNK_SIZE_BASE);
+      }
+      t1 = mg_time_ns();
+   }
+   else if (!strcmp(name, "decode_size")) {
+      mg_encode_size(esize, 123456, MG_CHUNK_SIZE_BASE);
+      n = (int) strlen((char *) esize);
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         esize[n - 1] = (unsigned char) ('0' + (i % 10));
+         sink += mg_decode_size(esize, n, MG_CHUNK_SIZE_BASE);
+      }
+      t1 = mg_time_ns();
+   }
+   else if (!strcmp(name, "encode_item_header")) {
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         sink += mg_encode_item_header(head, (int) (i & 0xffff), 0, MG_TX_DATA);
+      }
+      t1 = mg_time_ns();
+   }
+   else if (!strcmp(name, "decode_item_header")) {
+      mg_encode_item_header(head, 12345, 0, MG_TX_DATA);
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         head[5] = (unsigned char) ('0' + (i % 10));
+         sink += mg_decode_item_header(head, &size, &byref, &type) + size;
+      }
+      t1 = mg_time_ns();
+   }
+   else if (!strcmp(name, "buf_cat")) {
+      if (!mg_buf_init(&buf, MG_BUFSIZE, MG_BUFSIZE)) {
+         return 0;
+      }
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         if (buf.data_size >= (MG_BUFSIZE - 32)) {
+            buf.data_size = 0;
+         }
+         mg_buf_cat(&buf, data, 32);
+      }
+      t1 = mg_time_ns();
+      sink += buf.data_size;
+      mg_buf_free(&buf);
+   }
+   else if (!strcmp(name, "buf_grow")) {
+      buf.p_buffer = NULL;
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         if (!buf.p_buffer || buf.data_size >= (MG_BUFSIZE - 32)) {
+            if (buf.p_buffer) {
+               sink += buf.size;
+               mg_buf_free(&buf);
+            }
+            if (!mg_buf_init(&buf, 256, 256)) {
+               return 0;
+            }
+         }
+         mg_buf_cat(&buf, data, 32);
+      }
+      t1 = mg_time_ns();
+      mg_buf_free(&buf);
+   }
+   else if (!strcmp(name, "array_encode")) {
+      if (!mg_buf_init(&buf, MG_BUFSIZE, MG_BUFSIZE)) {
+         return 0;
+      }
+      mg_request_add(NULL, 0, &buf, NULL, 0, 0, MG_TX_AREC);
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         if (buf.data_size >= (MG_BUFSIZE - 128)) {
+            buf.data_size = 0;
+            mg_request_add(NULL, 0, &buf, NULL, 0, 0, MG_TX_AREC);
+         }
+         for (n = 0; n < 3; n ++) {
+            mg_request_add(NULL, 0, &buf, (unsigned char *) keys[n], (int) strlen(keys[n]), 0, MG_TX_AKEY);
+         }
+         mg_request_add(NULL, 0, &buf, (unsigned char *) data, 30, 0, MG_TX_DATA);
+      }
+      t1 = mg_time_ns();
+      sink += buf.data_size;
+      mg_buf_free(&buf);
+   }
+   else if (!strcmp(name, "array_decode")) {
+      /* as the records of an array are read from a response: the keys and data are located in place */
+      if (!mg_buf_init(&buf, MG_BUFSIZE, MG_BUFSIZE)) {
+         return 0;
+      }
+      mg_request_add(NULL, 0, &buf, NULL, 0, 0, MG_TX_AREC);
+      for (records = 0; buf.data_size < (MG_BUFSIZE - 128); records ++) {
+         for (n = 0; n < 3; n ++) {
+            mg_request_add(NULL, 0, &buf, (unsigned char *) keys[n], (int) strlen(keys[n]), 0, MG_TX_AKEY);
+         }
+         mg_request_add(NULL, 0, &buf, (unsigned char *) data, 30, 0, MG_TX_DATA);
+      }
+      mg_request_add(NULL, 0, &buf, NULL, 0, 0, MG_TX_EOD);
+
+      t0 = mg_time_ns();
+      p = buf.p_buffer;
+      p += mg_decode_item_header(p, &size, &byref, &type);
+      for (i = 0; i < iterations; ) {
+         hlen = mg_decode_item_header(p, &size, &byref, &type);
+         if (type == MG_TX_EOD) {
+            p = buf.p_buffer;
+            p += mg_decode_item_header(p, &size, &byref, &type);
+            continue;
+         }
+         p += hlen;
+         sink += (unsigned long) (p[0] + size);
+         p += size;
+         if (type == MG_TX_DATA) {
+            i ++;
+         }
+      }
+      t1 = mg_time_ns();
+      mg_buf_free(&buf);
+   }
+   else if (!strcmp(name, "utf8_to_utf16") || !strcmp(name, "utf16_to_utf8")) {
+      len = 0;
+      for (n = 0; n < 4; n ++) {
+         memcpy((void *) (utf8 + len), (void *) text, strlen(text));
+         len += strlen(text);
+      }
+      len16 = mg_utf8_to_utf16(utf16, 512, utf8, len);
+      t0 = mg_time_ns();
+      if (name[3] == '8') {
+         for (i = 0; i < iterations; i ++) {
+            utf8[0] = (char) ('A' + (i % 26));
+            sink += (unsigned long) mg_utf8_to_utf16(utf16, 512, utf8, len);
+         }
+      }
+      else {
+         for (i = 0; i < iterations; i ++) {
+            utf16[0] = (unsigned short) ('A' + (i % 26));
+            sink += (unsigned long) mg_utf16_to_utf8(utf8, 512, utf16, len16);
+         }
+      }
+      t1 = mg_time_ns();
+   }
+   else if (!strcmp(name, "ydb_ci") || !strcmp(name, "ydb_cip")) {
+      pcon = mg_benchmark_ydb();
+      if (!pcon || !mg_buf_init(&buf, MG_BUFSIZE, MG_BUFSIZE)) {
+         return 0;
+      }
+      p = (unsigned char *) mg_malloc(MG_BUFSIZE, 0);
+      if (!p) {
+         mg_buf_free(&buf);
+         return 0;
+      }
+      memset((void *) &srv, 0, sizeof(MGSRV));
+      mg_request_header(&srv, &buf, "G", "z");
+      mg_request_add(&srv, 0, &buf, (unsigned char *) "^MGBench", 8, 0, MG_TX_DATA);
+      mg_request_add(&srv, 0, &buf, (unsigned char *) "1", 1, 0, MG_TX_DATA);
+      n = mg_encode_size(esize, buf.data_size - srv.header_len, MG_CHUNK_SIZE_BASE);
+      memcpy((void *) (buf.p_buffer + (srv.header_len - 6) + (5 - n)), (void *) esize, (size_t) n);
+
+      in[1].address = "0";
+      in[1].length = 1;
+      in[2].address = (char *) buf.p_buffer;
+      in[2].length = (unsigned long) buf.data_size;
+      in[3].address = "";
+      in[3].length = 0;
+      desc.rtn_name.address = "ifc_zmgsis";
+      desc.rtn_name.length = 10;
+      desc.handle = NULL;
+
+      t0 = mg_time_ns();
+      for (i = 0; i < iterations; i ++) {
+         out.address = (char *) p;
+         out.length = MG_BUFSIZE;
+         if (name[6] == 'p') {
+            n = pcon->p_ydb_so->p_ydb_cip(&desc, &out, &in[1], &in[2], &in[3]);
+         }
+         else {
+            n = pcon->p_ydb_so->p_ydb_ci("ifc_zmgsis", &out, &in[1], &in[2], &in[3]);
+         }
+         if (n != YDB_OK) {
+            break;
+         }
+         sink += out.length;
+      }
+      t1 = mg_time_ns();
+      mg_free((void *) p, 0);
+      mg_buf_free(&buf);
+      iterations = i;
+      if (!iterations) {
+         return 0;
+      }
+   }
+   else {
+      return 0;
+   }
+
+   mg_benchmark_sink = sink; /* the results are used, so the work is not optimised away */
+   *p_ops = iterations;
+
+   return (t1 - t0);
+}
+
+
+/* v1.6.24 the YottaDB connection used by the call-in benchmarks: the library is loaded from $ydb_dist once per process (NULL if it cannot be) */
+
+DBXCON * mg_benchmark_ydb(void)
+{
+   char *dist;
+   DBXCON *pcon;
+
+   if (mg_benchmark_ydb_tried) {
+      return mg_benchmark_pcon;
+   }
+   mg_benchmark_ydb_tried = 1;
+
+   dist = getenv("ydb_dist");
+   if (!dist || !dist[0] || strlen(dist) >= 200) {
+      return NULL;
+   }
+
+   pcon = (DBXCON *) mg_malloc(sizeof(DBXCON), 0);
+   if (!pcon) {
+      return NULL;
+   }
+   memset((void *) pcon, 0, sizeof(DBXCON));
+   pcon->p_ydb_so = (DBXYDBSO *) mg_malloc(sizeof(DBXYDBSO), 0);
+   if (!pcon->p_ydb_so) {
+      mg_free((void *) pcon, 0);
+      return NULL;
+   }
+   memset((void *) pcon->p_ydb_so, 0, sizeof(DBXYDBSO));
+   pcon->dbtype = DBX_DBTYPE_YOTTADB;
+   strcpy(pcon->shdir, dist);
+
+   if (ydb_load_library(pcon) != CACHE_SUCCESS || pcon->p_ydb_so->p_ydb_init() != YDB_OK) {
+      mg_free((void *) pcon->p_ydb_so, 0);
+      mg_free((void *) pcon, 0);
+      return NULL;
+   }
+
+   mg_benchmark_pcon = pcon;
+   return pcon;
+}
+
+
+/* v1.6.24 wire capture: the file for each process is opened when it first sends or receives a frame */
+
+int mg_capture_open(char *file)
+{
+   if (!file || !file[0] || strlen(file) > 200) {
+      return 0;
+   }
+
+   mg_mutex_create(&(dbx_capture.mutex));
+   mg_mutex_lock(&(dbx_capture.mutex), 0);
+
+   if (dbx_capture.fp && dbx_capture.pid == mg_current_process_id()) {
+      fclose(dbx_capture.fp);
+   }
+   dbx_capture.fp = NULL;
+   dbx_capture.pid = 0;
+   strcpy(dbx_capture.file, file);
+
+   mg_mutex_unlock(&(dbx_capture.mutex));
+
+   return 1;
+}
+
+
+/* called with the capture mutex held: a stream inherited from a parent process belongs to the parent, and is left alone */
+
+int mg_capture_start(void)
+{
+   char path[280];
+   FILE *fp;
+   MGCAPHEAD head;
+#if !defined(_WIN32)
+   struct timespec ts;
+#endif
+
+   dbx_capture.fp = NULL;
+   dbx_capture.pid = mg_current_process_id();
+   dbx_capture.records = 0;
+   dbx_capture.bytes = 0;
+
+   sprintf(path, "%s.%lu", dbx_capture.file, dbx_capture.pid);
+   fp = fopen(path, "wb");
+   if (!fp) {
+      return 0;
+   }
+   setvbuf(fp, NULL, _IOFBF, MG_CAPTURE_BUFFER);
+
+   memset((void *) &head, 0, sizeof(MGCAPHEAD));
+   memcpy((void *) head.magic, (void *) MG_CAPTURE_MAGIC, 8);
+   head.version = MG_CAPTURE_VERSION;
+   head.pid = (unsigned int) dbx_capture.pid;
+#if defined(_WIN32)
+   head.time_real = (unsigned long long) time(NULL) * 1000000000ULL;
+#else
+   clock_gettime(CLOCK_REALTIME, &ts);
+   head.time_real = ((unsigned long long) ts.tv_sec * 1000000000ULL) + (unsigned long long) ts.tv_nsec;
+#endif
+   head.time_mono = mg_time_ns();
+
+   if (fwrite((void *) &head, sizeof(MGCAPHEAD), 1, fp) != 1) {
+      fclose(fp);
+      return 0;
+   }
+   dbx_capture.fp = fp;
+
+   return 1;
+}
+
+
+int mg_capture_frame(MGSRV *p_srv, int chndle, int type, unsigned char *frame, unsigned long size)
+{
+   MGCAPREC rec;
+
+   if (!size) {
+      return 0;
+   }
+
+   rec.size = (unsigned int) size;
+   rec.type = (unsigned char) type;
+   rec.command = (unsigned char) p_srv->stat.command;
+   rec.chndle = (unsigned short) chndle;
+   rec.time = mg_time_ns();
+
+   if (mg_mutex_lock(&(dbx_capture.mutex), 0) != 0) {
+      return 0;
+   }
+   if (dbx_capture.pid != mg_current_process_id()) {
+      mg_capture_start();
+   }
+   if (dbx_capture.fp) {
+      fwrite((void *) &rec, sizeof(MGCAPREC), 1, dbx_capture.fp);
+      fwrite((void *) frame, 1, size, dbx_capture.fp);
+      dbx_capture.records ++;
+      dbx_capture.bytes += (sizeof(MGCAPREC) + size);
+   }
+   mg_mutex_unlock(&(dbx_capture.mutex));
+
+   return 1;
+}
+
+
+/* the host calls this at the end of each request, so that the file holds whole requests */
+
+int mg_capture_flush(void)
+{
+   if (!dbx_capture.file[0]) {
+      return 0;
+   }
+
+   mg_mutex_lock(&(dbx_capture.mutex), 0);
+   if (dbx_capture.fp && dbx_capture.pid == mg_current_process_id()) {
+      fflush(dbx_capture.fp);
+   }
+   mg_mutex_unlock(&(dbx_capture.mutex));
+
+   return 1;
+}
+
+
+int mg_capture_close(void)
+{
+   if (!dbx_capture.file[0]) {
+      return 0;
+   }
+
+   mg_mutex_lock(&(dbx_capture.mutex), 0);
+   if (dbx_capture.fp && dbx_capture.pid == mg_current_process_id()) {
+      fclose(dbx_capture.fp);
+   }
+   dbx_capture.fp = NULL;
+   dbx_capture.pid = 0;
+   dbx_capture.file[0] = '\0';
+   mg_mutex_unlock(&(dbx_capture.mutex));
+
+   return 1;
+}
+
+
+/* Canonical numbers collate before strings; numbers collate numerically; strings collate by byte value */
+
+int mg_canonical_number(unsigned char *str, int len)
+{
+   int n, dp, digits;
+
+   if (len < 1 || len > 18) {
+      return 0;
+   }
+   n = 0;
+   if (str[0] == '-') {
+      n ++;
+   }
+   if ((len - n) == 1 && str[n] == '0') {
+      return (n == 0);
+   }
+   if (n == len || str[n] == '0') {
+      return 0;
+   }
+
+   dp = 0;
+   digits = 0;
+   for (; n < len; n ++) {
+      if (str[n] == '.') {
+         if (dp) {
+            return 0;
+         }
+         dp = 1;
+         continue;
+      }
+      if (str[n] < '0' || str[n] > '9') {
+         return 0;
+      }
+      digits ++;
+   }
+   if (!digits) {
+      return 0;
+   }
+   if (dp && (str[len - 1] == '0' || str[len - 1] == '.')) {
+      return 0;
+   }
+
+   return 1;
+}
+
+
+int mg_collate_compare(unsigned char *str1, int len1, unsigned char *str2, int len2)
+{
+   int num1, num2, cmp;
+   double d1, d2;
+   char buffer[32];
+
+   num1 = mg_canonical_number(str1, len1);
+   num2 = mg_canonical_number(str2, len2);
+
+   if (num1 && num2) {
+      memcpy((void *) buffer, (void *) str1, (size_t) len1);
+      buffer[len1] = '\0';
+      d1 = strtod(buffer, NULL);
+      memcpy((void *) buffer, (void *) str2, (size_t) len2);
+      buffer[len2] = '\0';
+      d2 = strtod(buffer, NULL);
+      return (d1 < d2) ? -1 : ((d1 > d2) ? 1 : 0);
+   }
+   if (num1) {
+      return len2 ? -1 : 1;
+   }
+   if (num2) {
+      return len1 ? 1 : -1;
+   }
+
+   cmp = memcmp((void *) str1, (void *) str2, (size_t) (len1 < len2 ? len1 : len2));
+   if (cmp == 0) {
+      return (len1 < len2) ? -1 : ((len1 > len2) ? 1 : 0);
+   }
+
+   return (cmp < 0) ? -1 : 1;
+}
+
+
+/* v1.5.20 */
+
+/* conversions without error checking
+   only works for valid UTF-8, i.e. no 5- or 6-byte sequences
+   srcsz = source size in bytes
+   sz = dest size in # of wide characters
+   returns # characters converted
+   if sz == srcsz+1 (i.e. 4*srcsz+4 bytes), there will always be enough space.
+*/
+
+size_t mg_utf8_to_utf16(unsigned short *dest, size_t sz, const char *src, size_t srcsz)
+{
+   unsigned short ch;
+   const char *src_end;
+   size_t i, n, nb, used;
+
+   i = 0;
+   src_end = src + srcsz;
+
+   if (sz == 0 || srcsz == 0)
+      return 0;
+
+   while (i < sz && src < src_end) {
+      /* v1.6.24 runs of ASCII are widened a block at a time */
+      if (!(*src & 0x80)) {
+         n = mg_ascii_to_utf16(dest + i, sz - i, src, (size_t) (src_end - src));
+         i += n;
+         src += n;
+         if (i >= sz || src >= src_end)
+            break;
+      }
+
+      /* v1.6.24 runs of two and three byte sequences are validated and decoded a block at a time */
+      n = mg_utf8_block_to_utf16(dest + i, sz - i, src, (size_t) (src_end - src), &used);
+      if (used) {
+         i += n;
+         src += used;
+         continue;
+      }
+
+      if (!dbx_isutf(*src)) { /* invalid sequence */
+         dest[i++] = 0xFFFD;
+         src ++;
+         continue;
+      }
+      nb = dbx_trailing_bytes_for_utf8[(unsigned char) *src];
+      if (src + nb >= src_end)
+         break;
+      /* v1.6.24 validate the trailing bytes */
+      for (n = 1; n <= nb; n ++) {
+         if (dbx_isutf(src[n]))
+            break;
+      }
+      if (n <= nb) {
+         dest[i++] = 0xFFFD;
+         src ++;
+         continue;
+      }
+      ch = 0;
+/*
+      switch (nb) {
+         case 5: ch += (unsigned char) *src ++; ch <<= 6;
+         case 4: ch += (unsigned char) *src ++; ch <<= 6;
+         case 3: ch += (unsigned char) *src ++; ch <<= 6;
+         case 2: ch += (unsigned char) *src ++; ch <<= 6;
+         case 1: ch += (unsigned char) *src ++; ch <<= 6;
+         case 0: ch += (unsigned char) *src ++;
+      }
+*/
+
+      if (nb == 5) {
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+      }
+      else if (nb == 4) {
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+      }
+      else if (nb == 3) {
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+      }
+      else if (nb == 2) {
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+      }
+      else if (nb == 1) {
+         ch += (unsigned char) *src ++;
+         ch <<= 6;
+         ch += (unsigned char) *src ++;
+      }
+      else if (nb == 0) {
+         ch += (unsigned char) *src ++;
+      }
+
+      ch -= dbx_offsets_from_utf8[nb];
+      dest[i ++] = ch;
+   }
+   return i;
+}
+
+
+/* srcsz = number of source characters
+   sz = size of dest buffer in bytes
+   returns # bytes stored in dest
+   the destination string will never be bigger than the source string.
+*/
+
+size_t mg_utf16_to_utf8(char *dest, size_t sz, const unsigned short *src, size_t srcsz)
+{
+   unsigned short ch;
+   size_t i, n;
+   char *dest0, *dest_end;
+
+   i = 0;
+   dest0 = dest;
+   dest_end = dest + sz;
+
+   while (i < srcsz) {
+      /* v1.6.24 runs of ASCII are narrowed a block at a time */
+      if (src[i] < 0x80 && (i + 1) < srcsz && src[i + 1] < 0x80) {
+         n = mg_ascii_from_utf16(dest, (size_t) (dest_end - dest), src + i, srcsz - i);
+         i += n;
+         dest += n;
+         if (i >= srcsz)
+            break;
+      }
+
+      ch = src[i];
+      if (ch < 0x80) {
+         if (dest >= dest_end)
+            break;
+         *dest ++ = (char) ch;
+      }
+      else if (ch < 0x800) {
+         if (dest >= dest_end - 1)
+            break;
+          *dest ++ = (ch >> 6) | 0xC0;
+          *dest ++ = (ch & 0x3F) | 0x80;
+       }
+       else if (ch < 0x10000) {
+          if (dest >= dest_end - 2)
+            break;
+          *dest ++ = (ch >> 12) | 0xE0;
+          *dest ++ = ((ch >> 6) & 0x3F) | 0x80;
+          *dest ++ = (ch & 0x3F) | 0x80;
+       }
+/*
+       else if (ch < 0x110000) {
+         if (dest >= dest_end - 3)
+            break;
+         *dest ++ = (ch >> 18) | 0xF0;
+         *dest ++ = ((ch >> 12) & 0x3F) | 0x80;
+         *dest ++ = ((ch >> 6) & 0x3F) | 0x80;
+         *dest ++ = (ch & 0x3F) | 0x80;
+      }
+*/
+      i ++;
+   }
+   return (dest - dest0);
+}
+
+
+/* v1.6.24 SIMD support: 0 = scalar; 1 = SSE2; 2 = AVX2 */
+
+static int dbx_simd = -1;
+
+int mg_simd_level(void)
+{
+   if (dbx_simd < 0) {
+#if defined(DBX_SIMD_X86)
+      __builtin_cpu_init();
+      dbx_simd = __builtin_cpu_supports("avx2") ? 2 : 1;
+#else
+      dbx_simd = 0;
+#endif
+   }
+   return dbx_simd;
+}
+
+
+#if defined(DBX_SIMD_X86)
+
+/* Each kernel converts the leading run of ASCII characters and stops at the first block containing anything else */
+
+static size_t mg_ascii_to_utf16_sse2(unsigned short *dest, size_t sz, const char *src, size_t srcsz)
+{
+   int mask;
+   size_t i, max;
+   __m128i zero, v;
+
+   max = (sz < srcsz) ? sz : srcsz;
+   zero = _mm_setzero_si128();
+
+   for (i = 0; i + 16 <= max; i += 16) {
+      v = _mm_loadu_si128((const __m128i *) (src + i));
+      mask = _mm_movemask_epi8(v);
+      if (mask) {
+         break; /* the scalar loop finishes the run */
+      }
+      _mm_storeu_si128((__m128i *) (dest + i), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128((__m128i *) (dest + i + 8), _mm_unpackhi_epi8(v, zero));
+   }
+   return i;
+}
+
+
+__attribute__((target("avx2")))
+static size_t mg_ascii_to_utf16_avx2(unsigned short *dest, size_t sz, const char *src, size_t srcsz)
+{
+   int mask;
+   size_t i, max;
+   __m256i v;
+
+   max = (sz < srcsz) ? sz : srcsz;
+
+   for (i = 0; i + 32 <= max; i += 32) {
+      v = _mm256_loadu_si256((const __m256i *) (src + i));
+      mask = _mm256_movemask_epi8(v);
+      if (mask) {
+         break; /* the scalar loop finishes the run */
+      }
+      _mm256_storeu_si256((__m256i *) (dest + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+      _mm256_storeu_si256((__m256i *) (dest + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+   }
+   return i;
+}
+
+
+static size_t mg_ascii_from_utf16_sse2(char *dest, size_t sz, const unsigned short *src, size_t srcsz)
+{
+   int mask;
+   size_t i, max;
+   __m128i high, zero, v;
+
+   max = (sz < srcsz) ? sz : srcsz;
+   high = _mm_set1_epi16((short) 0xFF80);
+   zero = _mm_setzero_si128();
+
+   for (i = 0; i + 8 <= max; i += 8) {
+      v = _mm_loadu_si128((const __m128i *) (src + i));
+      mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero)) ^ 0xFFFF;
+      if (mask) {
+         break;
+      }
+      _mm_storel_epi64((__m128i *) (dest + i), _mm_packus_epi16(v, v));
+   }
+   return i;
+}
+
+
+__attribute__((target("avx2")))
+static size_t mg_ascii_from_utf16_avx2(char *dest, size_t sz, const unsigned short *src, size_t srcsz)
+{
+   unsigned int mask;
+   size_t i, max;
+   __m256i high, zero, v;
+
+   max = (sz < srcsz) ? sz : srcsz;
+   high = _mm256_set1_epi16((short) 0xFF80);
+   zero = _mm256_setzero_si256();
+
+   for (i = 0; i + 16 <= max; i += 16) {
+      v = _mm256_loadu_si256((const __m256i *) (src + i));
+      mask = ((unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(v, high), zero))) ^ 0xFFFFFFFFU;
+      if (mask) {
+         break;
+      }
+      _mm_storeu_si128((__m128i *) (dest + i), _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+   }
+   return i;
+}
+
+
+/* Decode blocks of 16 bytes holding ASCII and two and three byte sequences; stops at the first block that is all ASCII or not valid */
+
+static size_t mg_utf8_block_to_utf16_sse2(unsigned short *dest, size_t sz, const char *src, size_t srcsz, size_t *p_used)
+{
+   int high, cont, lead2, lead3, lead4, n, k;
+   unsigned int kmask, expect;
+   size_t i, j;
+   const unsigned char *s;
+   __m128i v, m_c0, m_e0, m_f0, m_80;
+
+   m_c0 = _mm_set1_epi8((char) 0xC0);
+   m_e0 = _mm_set1_epi8((char) 0xE0);
+   m_f0 = _mm_set1_epi8((char) 0xF0);
+   m_80 = _mm_set1_epi8((char) 0x80);
+
+   i = 0;
+   j = 0;
+   while ((j + 16) <= srcsz && (i + 16) <= sz) {
+      v = _mm_loadu_si128((const __m128i *) (src + j));
+      high = _mm_movemask_epi8(v);
+      if (!high) {
+         break; /* left to the ASCII kernel */
+      }
+      cont = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, m_c0), m_80));
+      lead2 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, m_e0), m_c0));
+      lead3 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, m_f0), m_e0));
+      lead4 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, m_f0), m_f0));
+      if (lead4) {
+         break;
+      }
+
+      /* a sequence starting in the last two bytes that runs past the block is left to the next block */
+      k = 16;
+      if (lead3 & 0x4000)
+         k = 14;
+      else if ((lead2 | lead3) & 0x8000)
+         k = 15;
+      kmask = (1U << k) - 1;
+
+      /* each lead byte must be followed by exactly its continuation bytes, all within the k bytes decoded */
+      expect = (((unsigned int) (lead2 | lead3) & kmask) << 1) | (((unsigned int) lead3 & kmask) << 2);
+      if (expect != ((unsigned int) cont & kmask)) {
+         break;
+      }
+
+      s = (const unsigned char *) (src + j);
+      for (n = 0; n < k; ) {
+         if (s[n] < 0x80) {
+            dest[i ++] = (unsigned short) s[n];
+            n ++;
+         }
+         else if (s[n] < 0xE0) {
+            dest[i ++] = (unsigned short) (((s[n] & 0x1F) << 6) | (s[n + 1] & 0x3F));
+            n += 2;
+         }
+         else {
+            dest[i ++] = (unsigned short) (((s[n] & 0x0F) << 12) | ((s[n + 1] & 0x3F) << 6) | (s[n + 2] & 0x3F));
+            n += 3;
+         }
+      }
+      j += k;
+   }
+
+   *p_used = j;
+   return i;
+}
+
+#endif
+
+
+/* Widen the leading run of ASCII bytes in src; returns the number of characters converted */
+
+size_t mg_ascii_to_utf16(unsigned short *dest, size_t sz, const char *src, size_t srcsz)
+{
+   size_t i, max;
+
+   i = 0;
+#if defined(DBX_SIMD_X86)
+   if (mg_simd_level() == 2)
+      i = mg_ascii_to_utf16_avx2(dest, sz, src, srcsz);
+   else
+      i = mg_ascii_to_utf16_sse2(dest, sz, src, srcsz);
+#endif
+
+   max = (sz < srcsz) ? sz : srcsz;
+   for (; i < max; i ++) {
+      if (src[i] & 0x80)
+         break;
+      dest[i] = (unsigned short) src[i];
+   }
+   return i;
+}
+
+
+/* Narrow the leading run of ASCII characters in src; returns the number of characters converted */
+
+size_t mg_ascii_from_utf16(char *dest, size_t sz, const unsigned short *src, size_t srcsz)
+{
+   size_t i, max;
+
+   i = 0;
+#if defined(DBX_SIMD_X86)
+   if (mg_simd_level() == 2)
+      i = mg_ascii_from_utf16_avx2(dest, sz, src, srcsz);
+   else
+      i = mg_ascii_from_utf16_sse2(dest, sz, src, srcsz);
+#endif
+
+   max = (sz < srcsz) ? sz : srcsz;
+   for (; i < max; i ++) {
+      if (src[i] >= 0x80)
+         break;
+      dest[i] = (char) src[i];
+   }
+   return i;
+}
+
+
+/* Decode the leading valid run of multibyte UTF-8 in src a block at a time; returns the number of characters converted and, in *p_used, the number of bytes (zero if the scalar loop is to take the next sequence) */
+
+size_t mg_utf8_block_to_utf16(unsigned short *dest, size_t sz, const char *src, size_t srcsz, size_t *p_used)
+{
+#if defined(DBX_SIMD_X86)
+   return mg_utf8_block_to_utf16_sse2(dest, sz, src, srcsz, p_used);
+#else
+   *p_used = 0;
+   return 0;
+#endif
 }
@@ -104,10 +104,24 @@
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <pthread.h>
 #include <dlfcn.h>
 #include <math.h>
+#if defined(__linux__)
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#define DBX_FUTEX                1
+#endif
+
+#endif
 
+/* v1.6.24 SSE2 (baseline) and AVX2 (selected at run time) kernels for UTF-8/UTF-16 transcoding */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define DBX_SIMD_X86             1
 #endif
 
 
@@ -246,6 +260,8 @@ typedef int                (*ydb_tpfnptr_t) (void *tpfnparm);
 #define YDB_TPCTX_FUN      10
 #define YDB_TPCTX_QUERY    11
 #define YDB_TPCTX_ORDER    12
+#define YDB_TPCTX_START    20 /* v1.6.24 */
+#define YDB_TPCTX_STOP     21 /* v1.6.24 */
 
 typedef struct {
    unsigned int   len_alloc;
@@ -268,6 +284,12 @@ typedef char         ydb_char_t;
 typedef long         ydb_long_t;
 typedef int          (*ydb_tpfnptr_t) (void *tpfnparm);  
 
+/* v1.6.24 YottaDB threaded API */
+#define YDB_NOTTP    0
+
+typedef unsigned long long ydb_uint64_t;
+typedef int          (*ydb_tp2fnptr_t) (ydb_uint64_t tptoken, ydb_buffer_t *errstr, void *tpfnparm);
+
 
 /* End of YottaDB */
 
@@ -289,6 +311,15 @@ typedef int    xc_status_t;
 #define DBX_MAXCONS              32
 #define DBX_MAXARGS              64
 #define DBX_MAXKEYSIZE           1024
+#define DBX_MAXGNAMESIZE         32
+#define DBX_MAXCIDESC            32 /* v1.6.24 */
+#define DBX_MAXCILABEL           64
+#define DBX_MERGEKEYSIZE         (DBX_MAXARGS * DBX_MAXKEYSIZE) /* v1.6.24 */
+
+/* v1.6.24 contexts for mg_bind_server_api() and mg_release_server_api() */
+#define DBX_API_PERSISTENT       1
+#define DBX_API_FORCE            2
+#define DBX_API_THREADED         4
 
 #define DBX_ERROR_SIZE           512
 
@@ -417,6 +448,13 @@ typedef int    xc_status_t;
       RC = mg_mutex_unlock(pcon->p_db_mutex); \
    } \
 
+/* v1.6.24 thread local storage */
+#if defined(_WIN32)
+#define DBX_TLS                  __declspec(thread)
+#else
+#define DBX_TLS                  __thread
+#endif
+
 
 #define NETX_TIMEOUT             30
 #define NETX_IPV6                1
@@ -813,6 +851,38 @@ typedef struct tagDBXLOG {
 } DBXLOG, *PDBXLOG;
 
 
+/* v1.6.24 asynchronous log writer: each thread queues its events in its own ring, which a background thread writes out */
+#define DBX_LOG_RING_SIZE        262144
+#define DBX_LOG_FLUSH_MSECS      20
+#define DBX_LOG_RINGS_PER_WRITE  8
+
+typedef struct tagDBXLOGRING {
+   volatile unsigned long  head;
+   volatile unsigned long  tail;
+   volatile unsigned long  dropped;
+   unsigned long           dropped_reported;
+   int                     free;
+   time_t                  ts_time;
+   char                    ts_str[64];
+   struct tagDBXLOGRING    *next;
+   char                    buffer[DBX_LOG_RING_SIZE];
+} DBXLOGRING, *PDBXLOGRING;
+
+typedef struct tagDBXLOGQ {
+   int                     fd;
+   short                   open;
+   short                   started;
+   short                   failed;
+   volatile short          stop;
+   unsigned long           pid;
+   char                    log_file[128];
+   DBXLOGRING * volatile   rings;
+#if !defined(_WIN32)
+   pthread_t               tid;
+#endif
+} DBXLOGQ, *PDBXLOGQ;
+
+
 typedef struct tagDBXZV {
    unsigned char  product;
    double         mg_version;
@@ -1021,6 +1091,22 @@ typedef struct tagDBXYDBSO {
    void              (* p_ydb_zstatus)                   (ydb_char_t* msg_buffer, ydb_long_t buf_len);
    int               (* p_ydb_tp_s)                      (ydb_tpfnptr_t tpfn, void *tpfnparm, const char *transid, int namecount, ydb_buffer_t *varnames);
 
+   /* v1.6.24 threaded API */
+   short             threaded;
+   int               (* p_ydb_data_st)                   (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, unsigned int *ret_value);
+   int               (* p_ydb_delete_st)                 (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int deltype);
+   int               (* p_ydb_set_st)                    (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *value);
+   int               (* p_ydb_get_st)                    (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+   int               (* p_ydb_subscript_next_st)         (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+   int               (* p_ydb_subscript_previous_st)     (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+   int               (* p_ydb_node_next_st)              (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray);
+   int               (* p_ydb_node_previous_st)          (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray);
+   int               (* p_ydb_incr_st)                   (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *increment, ydb_buffer_t *ret_value);
+   int               (* p_ydb_cip_t)                     (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ci_name_descriptor *ci_info, ...);
+   int               (* p_ydb_lock_incr_st)              (ydb_uint64_t tptoken, ydb_buffer_t *errstr, unsigned long long timeout_nsec, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray);
+   int               (* p_ydb_lock_decr_st)              (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray);
+   int               (* p_ydb_tp_st)                     (ydb_uint64_t tptoken, ydb_buffer_t *errstr, ydb_tp2fnptr_t tpfn, void *tpfnparm, const char *transid, int namecount, ydb_buffer_t *varnames);
+
 } DBXYDBSO, *PDBXYDBSO;
 
 
@@ -1038,6 +1124,13 @@ typedef struct tagDBXGTMSO {
 } DBXGTMSO, *PDBXGTMSO;
 
 
+/* v1.6.24 cached YottaDB call-in descriptor */
+typedef struct tagDBXCIDESC {
+   char                 label[DBX_MAXCILABEL];
+   ci_name_descriptor   desc;
+} DBXCIDESC, *PDBXCIDESC;
+
+
 typedef struct tagDBXCON {
    short          dbtype;
    unsigned long  pid;
@@ -1091,6 +1184,13 @@ typedef struct tagDBXCON {
    char           server_software[64];
    char           zmgsi_version[8];
    void *         p_srv;
+   short          persistent; /* v1.6.24 */
+   short          threaded;
+   DBXTHID        tid;
+   struct tagDBXCON *api_next;
+   int            ci_desc_no;
+   DBXCIDESC      ci_desc[DBX_MAXCIDESC];
+   char           *merge_keys;
 
 } DBXCON, *PDBXCON;
 
@@ -1110,6 +1210,7 @@ typedef struct tagDBXMETH {
    int            keyn_next; /* v1.4.18 */
    DBXSTR         input_str;
    DBXSTR16       input_str16; /* v1.5.20 */
+   DBXSTR         api_str; /* v1.6.24 */
    DBXVAL         output_val;
    DBXVAL         data_val;
    int            offset;
@@ -1123,17 +1224,38 @@ typedef struct tagDBXMETH {
 } DBXMETH, *PDBXMETH;
 
 
+/* v1.6.24 single producer/single consumer mailbox: spin briefly, then sleep (futex where available) */
+#define DBX_MBOX_SPIN            200
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DBX_CPU_RELAX()          __asm__ __volatile__("pause")
+#elif defined(__aarch64__)
+#define DBX_CPU_RELAX()          __asm__ __volatile__("yield")
+#else
+#define DBX_CPU_RELAX()
+#endif
+
+typedef struct tagDBXMBOX {
+   volatile int      seq;
+   volatile int      waiters;
+#if !defined(_WIN32) && !defined(DBX_FUTEX)
+   pthread_mutex_t   mutex;
+   pthread_cond_t    cv;
+#endif
+} DBXMBOX, *PDBXMBOX;
+
+
 /* v1.2.9 */
 typedef struct tagDBXTHRT {
    int               context;
-   int               done;
+   int               rc; /* v1.6.24 */
+   int               started; /* v1.6.24 */
+   int               req_seen;
+   DBXMBOX           req;
+   DBXMBOX           res;
 #if !defined(_WIN32)
    pthread_t         parent_tid;
    pthread_t         tp_tid;
-   pthread_mutex_t   req_cv_mutex;
-   pthread_cond_t    req_cv;
-   pthread_mutex_t   res_cv_mutex;
-   pthread_cond_t    res_cv;
 #endif
    int               task_id;
    DBXMETH           *pmeth;
@@ -1172,6 +1294,14 @@ typedef struct tagDBXTHRT {
 
 #define MG_CHUNK_SIZE_BASE       62
 
+/* v1.6.24 commands rejected by the DB Superserver (MGSRV no_command) */
+#define MG_NOCMD_ORDER           0x01
+#define MG_NOCMD_MERGE           0x02
+#define MG_NOCMD_COUNT           0x04
+#define MG_NOCMD_LOCK            0x08
+#define MG_NOCMD_QUERY           0x10
+#define MG_NOCMD_GLOBALS         0x20
+
 #define MG_BUFSIZE               32768
 #define MG_BUFMAX                32767
 
@@ -1190,6 +1320,89 @@ typedef struct tagMGSTR {
    unsigned char *   ps;
 } MGSTR, *LPMGSTR;
 
+/* v1.6.24 timings for the function currently being processed (see m_stats()) */
+#define MG_STAT_CONNECT          0
+#define MG_STAT_SEND             1
+#define MG_STAT_WAIT             2
+#define MG_STAT_DECODE           3
+#define MG_STAT_TOTAL            4
+#define MG_STAT_PHASES           5
+
+typedef struct tagMGSTATCALL {
+   short                active;
+   short                error;
+   int                  fun;
+   int                  chndle;
+   int                  command;
+   unsigned long long   start;
+   unsigned long long   received;
+   unsigned long long   phase[MG_STAT_PHASES];
+   unsigned long long   bytes_sent;
+   unsigned long long   bytes_recv;
+} MGSTATCALL, *LPMGSTATCALL;
+
+/* v1.6.24 connection pool counters for network based connectivity (see m_metrics_export()) */
+typedef struct tagMGPOOLSTAT {
+   long long            open;
+   long long            in_use;
+   unsigned long long   connects;
+   unsigned long long   connect_errors;
+   unsigned long long   timeouts;
+   unsigned long long   read_errors;
+} MGPOOLSTAT, *LPMGPOOLSTAT;
+
+/* v1.6.24 wire capture: each process writes the request and response frames exchanged with the DB Server to <file>.<pid> */
+#define MG_CAPTURE_MAGIC         "MGCAPT01"
+#define MG_CAPTURE_VERSION       1
+#define MG_CAPTURE_SEND          'S'
+#define MG_CAPTURE_RECEIVE       'R'
+#define MG_CAPTURE_BUFFER        262144
+
+/* file header: times in nanoseconds; time_mono is mg_time_ns() at the instant time_real was taken */
+typedef struct tagMGCAPHEAD {
+   char                 magic[8];
+   unsigned int         version;
+   unsigned int         pid;
+   unsigned long long   time_real;
+   unsigned long long   time_mono;
+} MGCAPHEAD, *LPMGCAPHEAD;
+
+/* record header (host byte order) followed by 'size' bytes of frame: time is mg_time_ns() */
+typedef struct tagMGCAPREC {
+   unsigned int         size;
+   unsigned char        type;
+   unsigned char        command;
+   unsigned short       chndle;
+   unsigned long long   time;
+} MGCAPREC, *LPMGCAPREC;
+
+typedef struct tagMGCAPTURE {
+   FILE *               fp;
+   unsigned long        pid;
+   unsigned long long   records;
+   unsigned long long   bytes;
+   char                 file[256];
+   DBXMUTEX             mutex;
+} MGCAPTURE, *LPMGCAPTURE;
+
+/* v1.6.24 static tracepoints (USDT) for DTrace, SystemTap, bpftrace and perf: compiled in when MG_USDT is defined (config.m4 defines it if sys/sdt.h is found) */
+#if defined(MG_USDT) && !defined(_WIN32)
+#include <sys/sdt.h>
+#define MG_PROBE1(name, a1)               DTRACE_PROBE1(mg_php, name, a1)
+#define MG_PROBE3(name, a1, a2, a3)       DTRACE_PROBE3(mg_php, name, a1, a2, a3)
+#define MG_PROBE4(name, a1, a2, a3, a4)   DTRACE_PROBE4(mg_php, name, a1, a2, a3, a4)
+#else
+#define MG_PROBE1(name, a1)               ((void) (a1))
+#define MG_PROBE3(name, a1, a2, a3)       ((void) (a1), (void) (a2), (void) (a3))
+#define MG_PROBE4(name, a1, a2, a3, a4)   ((void) (a1), (void) (a2), (void) (a3), (void) (a4))
+#endif
+
+#if defined(_WIN32)
+#define MG_POOL_ADD(f, v)        InterlockedExchangeAdd64((volatile LONG64 *) &(dbx_pool_stat->f), (LONG64) (v))
+#else
+#define MG_POOL_ADD(f, v)        __sync_fetch_and_add(&(dbx_pool_stat->f), (v))
+#endif
+
 typedef struct tagMGSRV {
    short       mem_error;
    short       storage_mode;
@@ -1215,6 +1428,8 @@ typedef struct tagMGSRV {
    MGBUF *     p_env;
    MGBUF *     p_params;
    DBXLOG *    p_log;
+   MGSTATCALL  stat; /* v1.6.24 */
+   unsigned int no_command; /* v1.6.24 */
    PDBXCON     pcon[MG_MAXCON];
 } MGSRV, *LPMGSRV;
 
@@ -1228,6 +1443,7 @@ extern pthread_mutex_t   dbx_global_mutex;
 extern MG_MALLOC     dbx_ext_malloc;
 extern MG_REALLOC    dbx_ext_realloc;
 extern MG_FREE       dbx_ext_free;
+extern MGPOOLSTAT *  dbx_pool_stat;
 
 DBX_EXTFUN(int)         dbx_init                      ();
 DBX_EXTFUN(int)         dbx_version                   (int index, char *output, int output_len);
@@ -1323,7 +1539,21 @@ int                     ydb_get_intsvar               (DBXCON *pcon, char *svarn
 int                     ydb_error_message             (DBXMETH *pmeth, int error_code);
 int                     ydb_function                  (DBXMETH *pmeth, DBXFUN *pfun);
 int                     ydb_function_ex               (DBXMETH *pmeth, DBXFUN *pfun);
+ci_name_descriptor *    ydb_ci_descriptor             (DBXCON *pcon, char *label);
 int                     ydb_transaction_cb            (void *pargs);
+int                     ydb_transaction_cb_st         (ydb_uint64_t tptoken, ydb_buffer_t *errstr, void *pargs);
+int                     ydb_load_threaded             (DBXCON *pcon);
+int                     ydb_thread_data               (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, unsigned int *ret_value);
+int                     ydb_thread_delete             (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int deltype);
+int                     ydb_thread_set                (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *value);
+int                     ydb_thread_get                (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+int                     ydb_thread_subscript_next     (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+int                     ydb_thread_subscript_previous (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *ret_value);
+int                     ydb_thread_node_next          (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray);
+int                     ydb_thread_node_previous      (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, int *ret_subs_used, ydb_buffer_t *ret_subsarray);
+int                     ydb_thread_incr               (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray, ydb_buffer_t *increment, ydb_buffer_t *ret_value);
+int                     ydb_thread_lock_incr          (unsigned long long timeout_nsec, ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray);
+int                     ydb_thread_lock_decr          (ydb_buffer_t *varname, int subs_used, ydb_buffer_t *subsarray);
 #if defined(_WIN32)
 LPTHREAD_START_ROUTINE  ydb_transaction_thread        (LPVOID pargs);
 #else
@@ -1331,6 +1561,11 @@ void *                  ydb_transaction_thread        (void *pargs);
 #endif
 int                     ydb_transaction               (DBXMETH *pmeth);
 int                     ydb_transaction_task          (DBXMETH *pmeth, int context);
+int                     ydb_transaction_release       (DBXTHRT *pthrt);
+int                     ydb_transaction_drain         (void);
+int                     mg_mbox_init                  (DBXMBOX *p_mbox);
+int                     mg_mbox_post                  (DBXMBOX *p_mbox);
+int                     mg_mbox_wait                  (DBXMBOX *p_mbox, int seen);
 
 int                     gtm_load_library              (DBXCON *pcon);
 int                     gtm_open                      (DBXMETH *pmeth);
@@ -1338,6 +1573,8 @@ int                     gtm_parse_zv                  (char *zv, DBXZV * p_gtm_s
 int                     gtm_error_message             (DBXMETH *pmeth, int error_code);
 
 DBXMETH *               mg_unpack_header              (unsigned char *input, unsigned char *output);
+int                     mg_meth_buffers               (DBXMETH *pmeth);
+int                     mg_merge_buffers              (DBXCON *pcon);
 int                     mg_unpack_arguments           (DBXMETH *pmeth);
 int                     mg_global_reference           (DBXMETH *pmeth);
 int                     mg_class_reference            (DBXMETH *pmeth, short context);
@@ -1369,6 +1606,17 @@ int                     mg_create_string              (DBXMETH *pmeth, void *dat
 int                     mg_log_init                   (DBXLOG *p_log);
 int                     mg_log_event                  (DBXLOG *p_log, char *message, char *title, int level);
 int                     mg_log_buffer                 (DBXLOG *p_log, char *buffer, int buffer_len, char *title, int level);
+int                     mg_log_shutdown               (void);
+#if !defined(_WIN32)
+int                     mg_log_open                   (DBXLOG *p_log);
+DBXLOGRING *            mg_log_ring                   (void);
+void                    mg_log_ring_key               (void);
+void                    mg_log_ring_release           (void *pargs);
+unsigned long           mg_log_ring_put               (DBXLOGRING *p_ring, unsigned long pos, char *data, unsigned long len);
+void *                  mg_log_writer                 (void *pargs);
+int                     mg_log_flush                  (void);
+int                     mg_log_write                  (struct iovec *iov, int iovn, DBXLOGRING **rings, unsigned long *heads, int ringn);
+#endif
 int                     mg_pause                      (int msecs);
 DBXPLIB                 mg_dso_load                   (char *library);
 DBXPROC                 mg_dso_sym                    (DBXPLIB p_library, char *symbol);
@@ -1430,10 +1678,53 @@ int                     mg_replace_substrings         (char * tbuffer, char *fbu
 
 int                     mg_bind_server_api            (MGSRV *p_srv, short context);
 int                     mg_release_server_api         (MGSRV *p_srv, short context);
+int                     mg_detach_server_api          (MGSRV *p_srv);
+int                     mg_release_server_api_persistent (void);
 int                     mg_invoke_server_api          (MGSRV *p_srv, int chndle, MGBUF *p_buf, int size, int mode);
+int                     mg_api_request_items          (MGBUF *p_buf, MGSTR *items, int max);
+int                     mg_api_response_init          (MGBUF *p_buf);
+int                     mg_api_response_item          (MGBUF *p_buf, unsigned char *data, int size);
+int                     mg_api_response_end           (MGBUF *p_buf, int error);
+int                     mg_api_response_error         (MGBUF *p_buf, char *error);
+int                     mg_api_item_int               (MGSTR *item);
+int                     mg_api_check                  (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_reference              (DBXMETH *pmeth, MGSTR *keys, int keyn, short global);
+int                     mg_api_reference_ex           (DBXMETH *pmeth, MGSTR *keys, int keyn, short global, int global2);
+int                     mg_api_invoke                 (DBXMETH *pmeth, MGSTR *keys, int keyn, int (* p_dbxfun) (struct tagDBXMETH * pmeth));
+int                     mg_api_invoke_ex              (DBXMETH *pmeth, MGSTR *keys, int keyn, short lock, int (* p_dbxfun) (struct tagDBXMETH * pmeth));
+int                     mg_api_order                  (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_order_row              (DBXMETH *pmeth, MGSTR *keys, int keyn, int getdata, int getvalue, MGBUF *p_res);
+int                     mg_api_query                  (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_query_keys             (DBXMETH *pmeth, MGSTR *keys, unsigned char *kdata);
+int                     mg_api_query_row              (DBXMETH *pmeth, MGSTR *keys, int keyn, int getvalue, MGBUF *p_res);
+int                     mg_api_globals                (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_gname                  (DBXMETH *pmeth, MGSTR *seed, int init);
+int                     mg_api_gname_normalize        (char *name, unsigned char *data, int len);
+int                     mg_api_lock                   (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_unlock                 (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_lock_node              (DBXMETH *pmeth, MGSTR *keys, int keyn, int timeout, int lock);
+int                     mg_api_merge                  (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_count                  (MGSRV *p_srv, DBXMETH *pmeth, MGBUF *p_buf);
+int                     mg_api_count_value            (DBXMETH *pmeth, MGSTR *keys, int keyn, unsigned long *total);
+unsigned long           mg_api_time_ms                (void);
+unsigned long long      mg_time_ns                    (void);
+unsigned long long      mg_stat_phase                 (MGSRV *p_srv, int phase, unsigned long long t0);
+unsigned long long      mg_benchmark                  (char *name, unsigned long iterations, unsigned long *p_ops);
+DBXCON *                mg_benchmark_ydb              (void);
+int                     mg_capture_open               (char *file);
+int                     mg_capture_start              (void);
+int                     mg_capture_frame              (MGSRV *p_srv, int chndle, int type, unsigned char *frame, unsigned long size);
+int                     mg_capture_flush              (void);
+int                     mg_capture_close              (void);
+int                     mg_canonical_number           (unsigned char *str, int len);
+int                     mg_collate_compare            (unsigned char *str1, int len1, unsigned char *str2, int len2);
 
 size_t                  mg_utf8_to_utf16              (unsigned short *dest, size_t sz, const char *src, size_t srcsz);
 size_t                  mg_utf16_to_utf8              (char *dest, size_t sz, const unsigned short *src, size_t srcsz);
+int                     mg_simd_level                 (void);
+size_t                  mg_ascii_to_utf16             (unsigned short *dest, size_t sz, const char *src, size_t srcsz);
+size_t                  mg_ascii_from_utf16           (char *dest, size_t sz, const unsigned short *src, size_t srcsz);
+size_t                  mg_utf8_block_to_utf16        (unsigned short *dest, size_t sz, const char *src, size_t srcsz, size_t *p_used);
 
 #ifdef __cplusplus
 }
@@ -30,13 +30,13 @@
 #define MG_DBASYS_H
 
 #define MAJORVERSION             1
-#define MINORVERSION             5
-#define MAINTVERSION             23
+#define MINORVERSION             6
+#define MAINTVERSION             24
 #define BUILDNUMBER              23
 
 #define DBX_VERSION_MAJOR        "1"
-#define DBX_VERSION_MINOR        "5"
-#define DBX_VERSION_BUILD        "23"
+#define DBX_VERSION_MINOR        "6"
+#define DBX_VERSION_BUILD        "24"
 
 #define DBX_VERSION              DBX_VERSION_MAJOR "." DBX_VERSION_MINOR "." DBX_VERSION_BUILD
 #define DBX_COMPANYNAME          "MGateway Ltd\0"
@@ -161,6 +161,38 @@ Version 3.3.61 22 March 2024:
 Version 3.3.62 16 April 2024:
    Correct a fault in the management of DB Server connections in multi-process Apache configurations.
       This fault led web requests failing with 'empty page' errors.
+
+Version 3.4.63 19 October 2026:
+   Introduce the Mg\Cursor class: a PHP Iterator over the subscripts at one level of an M global.
+      Subscripts (and, optionally, data values) are fetched from the DB Server in batches.
+   Introduce m_query() and the Mg\Query class for $Query style traversal of all data nodes under a global node.
+   Introduce an opt-in readahead mode for m_order() and m_previous(): m_set_readahead().
+      Sibling subscripts are fetched in batches and cached for the duration of the request.
+   Introduce m_globals() and the Mg\Globals class for listing the global directory in batches.
+   Introduce m_lock(), m_lock_many(), m_unlock(), m_unlock_many() and m_unlock_all() for incremental locking with millisecond timeouts.
+      Locks still held at the end of the request are released automatically.
+   Introduce a persistent API binding: m_bind_server_api(..., "persistent") binds once per process and later requests reuse it.
+      m_release_server_api() leaves a persistent binding in place unless called as m_release_server_api(1).
+   Introduce per-thread database contexts for API based connectivity in thread-safe (ZTS) builds.
+   YottaDB transactions (API based connectivity) are run by a pool of reusable worker threads.
+   Introduce m_merge() for merging one global node into another within the database (MERGE ^to(...)=^from(...)).
+   Introduce m_count() and m_subtree_size() for counting the nodes, or totalling the data size, of a subtree in a single call.
+   Introduce m_export() for exporting a subtree to a stream (NDJSON or binary records) or callback, with partitions of the first-level subscripts scanned concurrently.
+   Introduce m_import() for bulk loading records from an array, Traversable or NDJSON stream: each batch is sorted into M collation order and divided between connections by first subscript.
+   Log events are queued and written by a background thread rather than opening, locking and closing the log file for each event.
+   Introduce m_stats() for per-function call, error and byte counts together with latency histograms (connect, send, wait, decode and total).
+      The same figures are summarised in the phpinfo() table.
+   Introduce m_metrics_export() for rendering call and connection pool metrics in OpenMetrics (Prometheus) text format.
+      With mg_php.metrics_workers set (php.ini) each worker process publishes its metrics to memory shared with the others, created at module startup.
+   Introduce a slow call log: calls taking longer than a threshold (mg_php.slowlog_threshold or m_set_slowlog()) are recorded in memory, and optionally the log file.
+      m_slowlog() returns the calls recorded with their arguments, data sizes, connection, DB Server process id and the PHP file and line.
+   Static tracepoints (USDT) at the entry to, and return from, each function (when built with sys/sdt.h).
+   Introduce an access pattern report (mg_php.access_report or m_set_access_report()) for finding loops of similar single-node calls ('N+1' access).
+      Calls are grouped by PHP file and line, function and global; groups of many calls are reported at the end of the request (log file) or by m_access_report().
+   Introduce hot key tracking (mg_php.hotkeys_sample): a sample of the global nodes referenced is counted in a count-min sketch with a list of the most frequent, for each worker.
+      m_hot_keys() returns the nodes most often referenced by all workers (with mg_php.metrics_workers set) or this worker.
+   Introduce a binary wire capture (mg_php.capture_file): the request and response frames exchanged with the DB Server are written, with timings, to a file for each worker process.
+      The capture can be replayed against a DB Server with the replayer in tools/mg_replay.c.
 */
 
 #ifdef HAVE_CONFIG_H
@@ -199,12 +231,14 @@ Version 3.3.62 16 April 2024:
 #define MG_WRONG_PARAM_COUNT_AND_FREE_BUF \
    { \
       mg_buf_free(p_buf); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 2); \
       WRONG_PARAM_COUNT; \
    } \
 
 #define MG_RETURN_TRUE \
    { \
       RETVAL_TRUE; \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
@@ -212,12 +246,14 @@ Version 3.3.62 16 April 2024:
    { \
       RETVAL_TRUE; \
       mg_buf_free(p_buf); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
 #define MG_RETURN_FALSE \
    { \
       RETVAL_FALSE; \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
@@ -225,18 +261,21 @@ Version 3.3.62 16 April 2024:
    { \
       RETVAL_FALSE; \
       mg_buf_free(p_buf); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
 #define MG_RETURN_STRING(s, duplicate) \
    { \
       RETVAL_STRING(s); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
 #define MG_RETURN_LONG(i) \
    { \
       RETVAL_LONG(i); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
@@ -244,10 +283,13 @@ Version 3.3.62 16 April 2024:
    { \
       RETVAL_STRING(s); \
       mg_buf_free(p_buf); \
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 0); \
       return; \
    } \
 
 #define MG_ERROR1(e) \
+   if (p_page) \
+      p_page->p_srv->stat.error = 1; \
    if (p_page && p_page->p_log->log_errors) \
       mg_log_event(p_page->p_log, e, "Error Condition", 0); \
    if (p_page && p_page->p_srv->error_mode == 1) \
@@ -261,6 +303,8 @@ Version 3.3.62 16 April 2024:
 
 
 #define MG_ERROR2(e) \
+   if (p_page) \
+      p_page->p_srv->stat.error = 1; \
    if (p_page && p_page->p_log->log_errors) \
       mg_log_event(p_page->p_log, e, "Error Condition", 0); \
    if (p_page && p_page->p_srv->error_mode == 1) \
@@ -273,6 +317,8 @@ Version 3.3.62 16 April 2024:
    return 1; \
 
 #define MG_ERROR3(e) \
+   if (p_page) \
+      p_page->p_srv->stat.error = 1; \
    if (p_page && p_page->p_log->log_errors) \
       mg_log_event(p_page->p_log, e, "Error Condition", 0); \
 
@@ -340,6 +386,18 @@ typedef struct tagMGAKEYX {
 } MGAKEYX;
 
 
+/* v3.4.63 readahead window for m_order() and m_previous() */
+typedef struct tagMGRAHEAD {
+   int            batch;
+   short          direction;
+   short          eod;
+   unsigned long  offset;
+   char           server[64];
+   MGBUF          ref;
+   MGBUF          last;
+   MGBUF          keys;
+} MGRAHEAD;
+
 typedef struct tagMGPAGE {
    MGSRV       srv;
    MGSRV       *p_srv;
@@ -347,9 +405,241 @@ typedef struct tagMGPAGE {
    DBXLOG      *p_log;
    char        eod[4];
    char        server_base[64];
+   MGRAHEAD    ra; /* v3.4.63 */
+   MGBUF       locks; /* v3.4.63 */
+   short       slow_log; /* v3.4.63 */
+   unsigned long long slow_ns;
+   int         access_min; /* v3.4.63 */
+   HashTable   *p_access;
 } MGPAGE;
 
 
+/* v3.4.63 */
+#define MG_CURSOR_BATCH       100
+#define MG_CURSOR_ORDER       0
+#define MG_CURSOR_QUERY       1
+#define MG_CURSOR_GLOBALS     2
+
+typedef struct tagMGCURSOR {
+   short          type;
+   short          direction;
+   short          getvalue;
+   short          eod;
+   int            batch;
+   int            row_no;
+   int            row_max;
+   int            keyn;
+   int            global_size;
+   char           server[64];
+   zend_string    *start;
+   zend_string    *stop;
+   MGBUF          ref;
+   zval           rows;
+   zend_object    std;
+} MGCURSOR;
+
+#define MG_EXPORT_PARTITIONS  4
+#define MG_EXPORT_MAXPART     16
+#define MG_EXPORT_BATCH       1000
+#define MG_EXPORT_SAMPLE      1024
+#define MG_EXPORT_FLUSH       65536
+#define MG_EXPORT_NDJSON      0
+#define MG_EXPORT_BINARY      1
+
+typedef struct tagMGEXPART {
+   short          eod;
+   short          first;
+   short          sent;
+   short          connected;
+   int            chndle;
+   zend_string    *hi;
+   MGBUF          seed;
+   MGBUF          io;
+} MGEXPART;
+
+typedef struct tagMGEXPORT {
+   short          format;
+   short          stop;
+   short          callback;
+   int            parts;
+   int            batch;
+   int            keyn;
+   int            global_size;
+   unsigned long  records;
+   php_stream     *stream;
+   zend_fcall_info         fci;
+   zend_fcall_info_cache   fcc;
+   MGBUF          ref;
+   MGBUF          out;
+} MGEXPORT;
+
+#define MG_IMPORT_PARTITIONS  4
+#define MG_IMPORT_MAXPART     16
+#define MG_IMPORT_BATCH       1000
+#define MG_IMPORT_MAXBATCH    1000000
+#define MG_IMPORT_MAXKEY      32
+
+typedef struct tagMGIMPKEY {
+   short          num;
+   double         value;
+   zend_string    *str;
+} MGIMPKEY;
+
+typedef struct tagMGIMPREC {
+   int            seq;
+   int            keyn;
+   int            key0;
+   MGIMPKEY       *key;
+   zend_string    *data;
+} MGIMPREC;
+
+typedef struct tagMGIMPART {
+   short          sent;
+   short          connected;
+   int            chndle;
+   int            rec0;
+   int            recn;
+   MGBUF          io;
+} MGIMPART;
+
+typedef struct tagMGIMPORT {
+   short          stop;
+   short          tp;
+   int            parts;
+   int            batch;
+   int            recn;
+   int            keyn;
+   int            keymax;
+   unsigned long  records;
+   php_stream     *stream;
+   MGIMPREC       *rec;
+   MGIMPKEY       *key;
+   MGBUF          ref;
+   MGBUF          line;
+} MGIMPORT;
+
+/* v3.4.63 function statistics: HDR-style histograms of nanosecond latencies (8 linear sub-buckets for each power of 2, up to 2^36ns) */
+#define MG_STAT_MAXFUN        128
+#define MG_STAT_SUBBITS       3
+#define MG_STAT_SUBBUCKETS    8
+#define MG_STAT_MAXEXP        36
+#define MG_STAT_BUCKETS       ((MG_STAT_MAXEXP - MG_STAT_SUBBITS + 2) * MG_STAT_SUBBUCKETS)
+
+#if defined(ZTS) && defined(_WIN32)
+#define MG_STAT_ADD(p, v)     InterlockedExchangeAdd64((volatile LONG64 *) (p), (LONG64) (v))
+#elif defined(ZTS)
+#define MG_STAT_ADD(p, v)     __sync_fetch_and_add((p), (unsigned long long) (v))
+#else
+#define MG_STAT_ADD(p, v)     (*(p) += (unsigned long long) (v))
+#endif
+
+typedef struct tagMGSTATFUN {
+   char                 name[32];
+   int                  metric;
+   unsigned long long   calls;
+   unsigned long long   errors;
+   unsigned long long   bytes_sent;
+   unsigned long long   bytes_recv;
+   unsigned long long   sum[MG_STAT_PHASES];
+   unsigned long long   hist[MG_STAT_PHASES][MG_STAT_BUCKETS];
+} MGSTATFUN;
+
+/* v3.4.63 metrics published by each worker process for m_metrics_export(): shared between processes if mg_php.metrics_workers is set */
+#define MG_METRICS_MAXWORKERS 4096
+#define MG_METRICS_MAXFUN     64
+#define MG_METRICS_BUCKETS    16
+
+/* v3.4.63 hot keys: a sample of the global nodes referenced, counted in a count-min sketch with a list of the most frequent (a min-heap) */
+#define MG_HOTKEYS_DEPTH      4
+#define MG_HOTKEYS_WIDTH      1024
+#define MG_HOTKEYS_TOPK       32
+#define MG_HOTKEYS_KEYSIZE    96
+
+/* v3.4.63 slow call log */
+#define MG_SLOWLOG_SIZE       128
+#define MG_SLOWLOG_MAXARG     48
+
+typedef struct tagMGSLOW {
+   time_t               time;
+   int                  chndle;
+   int                  line;
+   unsigned long long   duration;
+   unsigned long long   wait;
+   unsigned long long   bytes_sent;
+   unsigned long long   bytes_recv;
+   char                 function[32];
+   char                 name[64];
+   char                 mpid[32];
+   char                 args[256];
+   char                 file[256];
+} MGSLOW;
+
+/* v3.4.63 access pattern report: similar calls from one call site */
+#define MG_ACCESS_MAXARG      8
+#define MG_ACCESS_ARGSIZE     64
+
+typedef struct tagMGACCESS {
+   char                 function[32];
+   char                 file[256];
+   int                  line;
+   int                  argc;
+   unsigned int         varied;
+   unsigned long        count;
+   unsigned long long   duration;
+   unsigned long long   wait;
+   char                 args[MG_ACCESS_MAXARG][MG_ACCESS_ARGSIZE];
+} MGACCESS;
+
+typedef struct tagMGHOTKEY {
+   unsigned long long   hash;
+   unsigned long long   count;
+   char                 key[MG_HOTKEYS_KEYSIZE];
+} MGHOTKEY;
+
+typedef struct tagMGHOTSLOT {
+   unsigned long long   samples;
+   int                  topn;
+   int                  spare;
+   MGHOTKEY             top[MG_HOTKEYS_TOPK];
+   unsigned int         sketch[MG_HOTKEYS_DEPTH][MG_HOTKEYS_WIDTH];
+} MGHOTSLOT;
+
+typedef struct tagMGHOTKEYS {
+   int                  shared;
+   int                  workers;
+   int                  sample;
+   int                  subscripts;
+   size_t               size;
+   MGHOTSLOT            slot[1];
+} MGHOTKEYS;
+
+typedef struct tagMGMETFUN {
+   unsigned long long   calls;
+   unsigned long long   errors;
+   unsigned long long   bytes_sent;
+   unsigned long long   bytes_recv;
+   unsigned long long   sum;
+   unsigned long long   bucket[MG_METRICS_BUCKETS + 1];
+} MGMETFUN;
+
+typedef struct tagMGMETSLOT {
+   volatile int         pid;
+   int                  spare;
+   unsigned long long   requests;
+   MGPOOLSTAT           pool;
+   MGMETFUN             fun[MG_METRICS_MAXFUN];
+} MGMETSLOT;
+
+typedef struct tagMGMETRICS {
+   int                  shared;
+   int                  workers;
+   size_t               size;
+   volatile int         fun_state[MG_METRICS_MAXFUN];
+   char                 fun_name[MG_METRICS_MAXFUN][32];
+   MGMETSLOT            slot[1];
+} MGMETRICS;
+
+
 ZEND_BEGIN_MODULE_GLOBALS(mg_php)
    unsigned long     req_no;
    unsigned long     fun_no;
@@ -524,14 +814,22 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_set_storage_mode, m_onearg_ainfo)
     PHP_FE(m_set_timeout, m_onearg_ainfo)
     PHP_FE(m_set_no_retry, m_onearg_ainfo)
+    PHP_FE(m_set_readahead, m_onearg_ainfo)
+    PHP_FE(m_set_slowlog, m_set_error_mode_ainfo)
+    PHP_FE(m_set_access_report, m_onearg_ainfo)
     PHP_FE(m_set_host, m_set_host_ainfo)
     PHP_FE(m_set_server, m_onearg_ainfo)
     PHP_FE(m_set_uci, m_onearg_ainfo)
 #if !defined(MG_PHP_MGW)
     PHP_FE(m_bind_server_api, m_bind_server_api_ainfo)
-    PHP_FE(m_release_server_api, m_noargs_ainfo)
+    PHP_FE(m_release_server_api, m_onearg_ainfo)
 #endif
     PHP_FE(m_get_last_error, m_noargs_ainfo)
+    PHP_FE(m_stats, m_onearg_ainfo)
+    PHP_FE(m_metrics_export, m_noargs_ainfo)
+    PHP_FE(m_slowlog, m_onearg_ainfo)
+    PHP_FE(m_access_report, m_noargs_ainfo)
+    PHP_FE(m_hot_keys, m_onearg_ainfo)
     PHP_FE(m_set, m_global_ainfo)
     PHP_FE(m_get, m_global_ainfo)
     PHP_FE(m_delete, m_global_ainfo)
@@ -540,7 +838,14 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_data, m_global_ainfo)
     PHP_FE(m_order, m_global_ainfo)
     PHP_FE(m_previous, m_global_ainfo)
+    PHP_FE(m_query, m_global_ainfo)
+    PHP_FE(m_globals, m_global_ainfo)
     PHP_FE(m_increment, m_global_ainfo)
+    PHP_FE(m_lock, m_global_ainfo)
+    PHP_FE(m_lock_many, m_global_ainfo)
+    PHP_FE(m_unlock, m_global_ainfo)
+    PHP_FE(m_unlock_many, m_global_ainfo)
+    PHP_FE(m_unlock_all, m_noargs_ainfo)
     PHP_FE(m_tstart, m_onearg_ainfo)
     PHP_FE(m_tlevel, m_onearg_ainfo)
     PHP_FE(m_tcommit, m_onearg_ainfo)
@@ -558,6 +863,11 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_method_byref, m_method_byref_ainfo)
     PHP_FE(m_merge_to_db, m_varargs_ainfo)
     PHP_FE(m_merge_from_db, m_merge_from_db_byref_ainfo)
+    PHP_FE(m_merge, m_global_ainfo)
+    PHP_FE(m_count, m_global_ainfo)
+    PHP_FE(m_subtree_size, m_global_ainfo)
+    PHP_FE(m_export, m_global_ainfo)
+    PHP_FE(m_import, m_global_ainfo)
     PHP_FE(m_return_to_applet, m_varargs_ainfo)
     PHP_FE(m_return_to_client, m_varargs_ainfo)
     PHP_FE(m_array_test, m_array_test_ainfo)
@@ -652,6 +962,9 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_set_storage_mode, NULL)
     PHP_FE(m_set_timeout, NULL)
     PHP_FE(m_set_no_retry, NULL)
+    PHP_FE(m_set_readahead, NULL)
+    PHP_FE(m_set_slowlog, NULL)
+    PHP_FE(m_set_access_report, NULL)
     PHP_FE(m_set_host, NULL)
     PHP_FE(m_set_server, NULL)
     PHP_FE(m_set_uci, NULL)
@@ -660,6 +973,11 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_release_server_api, NULL)
 #endif
     PHP_FE(m_get_last_error, NULL)
+    PHP_FE(m_stats, NULL)
+    PHP_FE(m_metrics_export, NULL)
+    PHP_FE(m_slowlog, NULL)
+    PHP_FE(m_access_report, NULL)
+    PHP_FE(m_hot_keys, NULL)
     PHP_FE(m_set, NULL)
     PHP_FE(m_get, NULL)
     PHP_FE(m_delete, NULL)
@@ -668,7 +986,14 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_data, NULL)
     PHP_FE(m_order, NULL)
     PHP_FE(m_previous, NULL)
+    PHP_FE(m_query, NULL)
+    PHP_FE(m_globals, NULL)
     PHP_FE(m_increment, NULL)
+    PHP_FE(m_lock, NULL)
+    PHP_FE(m_lock_many, NULL)
+    PHP_FE(m_unlock, NULL)
+    PHP_FE(m_unlock_many, NULL)
+    PHP_FE(m_unlock_all, NULL)
     PHP_FE(m_tstart, NULL)
     PHP_FE(m_tlevel, NULL)
     PHP_FE(m_tcommit, NULL)
@@ -686,6 +1011,11 @@ static const zend_function_entry mg_functions[] =
     PHP_FE(m_method_byref, m_method_byref_ainfo)
     PHP_FE(m_merge_to_db, NULL)
     PHP_FE(m_merge_from_db, m_merge_from_db_byref_ainfo)
+    PHP_FE(m_merge, NULL)
+    PHP_FE(m_count, NULL)
+    PHP_FE(m_subtree_size, NULL)
+    PHP_FE(m_export, NULL)
+    PHP_FE(m_import, NULL)
     PHP_FE(m_return_to_applet, NULL)
     PHP_FE(m_return_to_client, NULL)
     PHP_FE(m_array_test, m_array_test_ainfo)
@@ -695,6 +1025,76 @@ static const zend_function_entry mg_functions[] =
 #endif /* #if PHP_MAJOR_VERSION >= 8 */
 
 
+/* v3.4.63 */
+ZEND_BEGIN_ARG_INFO_EX(mg_cursor_construct_ainfo, 0, 0, 1)
+   ZEND_ARG_INFO(0, reference)
+   ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(mg_globals_construct_ainfo, 0, 0, 0)
+   ZEND_ARG_INFO(0, prefix)
+   ZEND_ARG_INFO(0, options)
+ZEND_END_ARG_INFO()
+
+#if PHP_MAJOR_VERSION >= 8
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(mg_cursor_mixed_ainfo, 0, 0, IS_MIXED, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(mg_cursor_void_ainfo, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(mg_cursor_bool_ainfo, 0, 0, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+#else
+
+ZEND_BEGIN_ARG_INFO_EX(mg_cursor_mixed_ainfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(mg_cursor_void_ainfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(mg_cursor_bool_ainfo, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+#endif
+
+static const zend_function_entry mg_cursor_methods[] =
+{
+    PHP_ME(MgCursor, __construct, mg_cursor_construct_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, rewind, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, valid, mg_cursor_bool_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, current, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, key, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, next, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    PHP_ME(MgCursor, data, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    {NULL, NULL, NULL}
+};
+
+static const zend_function_entry mg_query_methods[] =
+{
+    PHP_ME(MgQuery, __construct, mg_cursor_construct_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, rewind, rewind, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, valid, valid, mg_cursor_bool_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, current, current, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, key, key, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, next, next, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    {NULL, NULL, NULL}
+};
+
+static const zend_function_entry mg_globals_methods[] =
+{
+    PHP_ME(MgGlobals, __construct, mg_globals_construct_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, rewind, rewind, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, valid, valid, mg_cursor_bool_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, current, current, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, key, key, mg_cursor_mixed_ainfo, ZEND_ACC_PUBLIC)
+    PHP_MALIAS(MgCursor, next, next, mg_cursor_void_ainfo, ZEND_ACC_PUBLIC)
+    {NULL, NULL, NULL}
+};
+
+
 /* compiled module information */
 zend_module_entry mg_php_module_entry =
 {
@@ -723,6 +1123,41 @@ static unsigned long request_no  = 0;
 static char minit[256]           = {'\0'};
 /* v3.3.62 */
 static DBXLOG dbxlog             = {MG_LOG_FILE, "", "", 0, 0, 0, 0, 0, "", ""};
+/* v3.4.63 */
+static zend_class_entry *        mg_cursor_ce = NULL;
+static zend_class_entry *        mg_query_ce = NULL;
+static zend_class_entry *        mg_globals_ce = NULL;
+static zend_object_handlers      mg_cursor_handlers;
+static MGSTATFUN *               mg_stat_fun[MG_STAT_MAXFUN];
+static time_t                    mg_stat_since = 0;
+static const char *              mg_stat_phase_name[MG_STAT_PHASES] = {"connect", "send", "wait", "decode", "total"};
+static MGMETRICS *               mg_metrics = NULL;
+static MGMETSLOT *               mg_metrics_slot = NULL;
+static unsigned long             mg_metrics_pid = 0;
+static MGPOOLSTAT *              mg_metrics_pool = NULL;
+static const unsigned long long  mg_metrics_le[MG_METRICS_BUCKETS] = {100000ULL, 250000ULL, 500000ULL, 1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL, 100000000ULL, 250000000ULL, 500000000ULL, 1000000000ULL, 2500000000ULL, 5000000000ULL, 10000000000ULL};
+static const char *              mg_metrics_le_name[MG_METRICS_BUCKETS] = {"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1.0", "2.5", "5.0", "10.0"};
+
+static MGHOTKEYS *               mg_hotkeys = NULL;
+static unsigned long             mg_hotkeys_tick = 0;
+static MGSLOW                    mg_slowlog[MG_SLOWLOG_SIZE];
+static unsigned long             mg_slowlog_next = 0;
+
+PHP_INI_BEGIN()
+   PHP_INI_ENTRY(MG_EXT_NAME ".metrics_workers", "0", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".slowlog_threshold", "0", PHP_INI_ALL, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".slowlog_log", "0", PHP_INI_ALL, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".access_report", "0", PHP_INI_ALL, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".hotkeys_sample", "0", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".hotkeys_subscripts", "1", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".capture_file", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_dbtype", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_path", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_username", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_password", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_namespace", "", PHP_INI_SYSTEM, NULL)
+   PHP_INI_ENTRY(MG_EXT_NAME ".api_envvars", "", PHP_INI_SYSTEM, NULL)
+PHP_INI_END()
 
 int                  mg_type                    (zval *item);
 int                  mg_get_integer             (zval *item);
@@ -738,11 +1173,104 @@ zval *               mg_array_subarray_zval     (MGAKEY *p_akey, MGAREC *p_arec)
 int                  mg_array_terminate_strings (MGAREC *p_arec);
 int                  mg_array_reset_strings     (MGAREC *p_arec);
 int                  mg_array_parse             (MGPAGE *p_page, int chndle, zval *ppa, MGBUF *p_buf, int mode, short byref);
+int                  mg_array_add_node          (MGPAGE *p_page, int chndle, MGBUF *p_buf, unsigned char **key, int *ksize, int keyn, unsigned char *data, int len, short byref);
 int                  mg_request_header_ex       (MGPAGE *p_page, MGBUF *p_buf, char *command, char *product, zval *parg0);
 void *               mg_ext_malloc              (unsigned long size);
 void *               mg_ext_realloc             (void *p_buffer, unsigned long size);
 int                  mg_ext_free                (void *p_buffer);
 int                  mg_log_request             (MGPAGE *p_page, char *function);
+int                  mg_bind_api                (MGPAGE *p_page, char *env, int env_len, char env_sep, short context);
+int                  mg_bind_ini                (MGPAGE *p_page);
+zend_object *        mg_cursor_create           (zend_class_entry *ce);
+void                 mg_cursor_free             (zend_object *object);
+MGCURSOR *           mg_cursor_fetch            (zend_object *object);
+zval *               mg_cursor_item             (MGCURSOR *p_cursor, int index);
+int                  mg_readahead               (MGPAGE *p_page, zval *parameter_array, int argument_count, short direction, zval *return_value);
+int                  mg_readahead_next          (MGRAHEAD *p_ra, zval *return_value);
+int                  mg_request_server          (MGPAGE *p_page, zval *parg0, char *server);
+int                  mg_readahead_invalidate    (MGPAGE *p_page, zval *parameter_array, int argument_count);
+void                 mg_lock_invoke             (MGPAGE *p_page, zval *return_value, zval *parameter_array, int argument_count, short lock, short many);
+int                  mg_lock_reference          (MGPAGE *p_page, MGBUF *p_buf, zval *ref, zval *args, int argn);
+unsigned long        mg_lock_size               (unsigned char *p, unsigned long total);
+int                  mg_lock_record             (MGPAGE *p_page, char *server, MGBUF *p_ref);
+int                  mg_lock_forget             (MGPAGE *p_page, char *server, MGBUF *p_ref);
+void                 mg_count_invoke            (MGPAGE *p_page, zval *return_value, zval *parameter_array, int argument_count, short size);
+int                  mg_request_reference       (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref);
+int                  mg_request_exchange        (MGPAGE *p_page, int chndle, MGBUF *p_buf);
+int                  mg_response_error          (MGPAGE *p_page, MGBUF *p_buf);
+int                  mg_node_value              (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, zval *parg0, MGBUF *p_value);
+int                  mg_merge_fetch             (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, zval *parg0);
+int                  mg_merge_records           (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval **ref, zval *parg0);
+int                  mg_count_records           (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, char *flags, unsigned long limit, unsigned long *p_total, zval *parg0);
+int                  mg_batch_exchange          (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0);
+int                  mg_path_request            (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, char *command, MGBUF *p_path);
+int                  mg_path_data               (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, int *p_data);
+int                  mg_path_next               (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long offset, int direction);
+int                  mg_order_records           (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGSTR *items, int itemn, MGBUF *p_res);
+int                  mg_order_row               (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long offset, int data, int getdata, int getvalue, MGBUF *p_res);
+int                  mg_query_records           (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGSTR *items, int itemn, MGBUF *p_res);
+int                  mg_query_next              (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int basen, int *p_data);
+int                  mg_query_previous          (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int basen, int *p_data);
+int                  mg_query_last              (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int *p_data);
+int                  mg_query_row               (MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int keyn, int getvalue, MGBUF *p_res);
+int                  mg_export_sample           (MGPAGE *p_page, MGEXPORT *p_exp, zval *parg0, zend_string **sample, int *samplen);
+int                  mg_export_send             (MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part, zval *parg0);
+int                  mg_export_receive          (MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part, zval *parg0);
+int                  mg_export_rows             (MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part);
+int                  mg_export_emit             (MGPAGE *p_page, MGEXPORT *p_exp, unsigned char **key, int *keylen, int keyn, unsigned char *data, int len);
+int                  mg_export_json             (MGBUF *p_buf, unsigned char *data, int len);
+int                  mg_export_flush            (MGEXPORT *p_exp);
+int                  mg_export_close            (MGEXPORT *p_exp, MGEXPART *part, zend_string **sample, int samplen);
+int                  mg_import_add              (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, zval *record);
+int                  mg_import_json             (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, char *line, size_t len);
+char *               mg_import_json_space       (char *p, char *end);
+zend_string *        mg_import_json_scalar      (char **pp, char *end, MGBUF *p_buf);
+zend_string *        mg_import_json_string      (char **pp, char *end, MGBUF *p_buf);
+unsigned long        mg_import_json_hex         (char *p, char *end);
+int                  mg_import_record           (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, zend_string **key, int keyn, zend_string *data);
+int                  mg_import_batch            (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0);
+int                  mg_import_encode           (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *p_part, zval *parg0);
+int                  mg_import_exchange         (MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, char *command);
+int                  mg_import_compare          (const void *p1, const void *p2);
+int                  mg_import_key_compare      (MGIMPKEY *p_key1, MGIMPKEY *p_key2);
+int                  mg_import_release          (MGIMPORT *p_imp);
+int                  mg_lock_release_all        (MGPAGE *p_page);
+int                  mg_cursor_init             (MGPAGE *p_page, MGCURSOR *p_cursor, zval *pref, zval *popt, short type);
+int                  mg_cursor_fill             (MGPAGE *p_page, MGCURSOR *p_cursor, zval *seed, int inclusive);
+int                  mg_cursor_error            (MGPAGE *p_page, char *error);
+int                  mg_stat_begin              (MGPAGE *p_page, char *function);
+int                  mg_stat_end                (MGPAGE *p_page, int context);
+int                  mg_stat_function           (char *function);
+int                  mg_stat_bucket             (unsigned long long value);
+unsigned long long   mg_stat_bucket_value       (int bucket);
+unsigned long long   mg_stat_count              (MGSTATFUN *p_fun, int phase);
+unsigned long long   mg_stat_percentile         (MGSTATFUN *p_fun, int phase, unsigned long long count, double percentile);
+int                  mg_stat_phase_array        (zval *phase, MGSTATFUN *p_fun, int n);
+int                  mg_stat_reset              (void);
+int                  mg_stat_release            (void);
+int                  mg_metrics_init            (int workers);
+int                  mg_metrics_attach          (void);
+int                  mg_metrics_function        (char *function);
+int                  mg_metrics_record          (MGSTATFUN *p_fun, MGSTATCALL *p_stat, int context);
+int                  mg_metrics_family          (MGBUF *p_buf, char *name, char *type, char *unit, char *help);
+int                  mg_metrics_release         (void);
+int                  mg_slowlog_record          (MGPAGE *p_page, MGSTATFUN *p_fun, MGSTATCALL *p_stat);
+int                  mg_slowlog_arg             (char *buffer, int size, zval *arg, char *name, int name_size, int depth);
+const char *         mg_access_advice           (char *function);
+int                  mg_access_record           (MGPAGE *p_page, MGSTATFUN *p_fun, MGSTATCALL *p_stat);
+int                  mg_access_signature        (MGACCESS *p_acc, char *buffer, int size);
+int                  mg_access_sites            (MGPAGE *p_page, MGACCESS ***p_sites);
+int                  mg_access_compare          (const void *p1, const void *p2);
+int                  mg_access_report           (MGPAGE *p_page);
+int                  mg_access_release          (MGPAGE *p_page);
+int                  mg_hotkeys_init            (int sample, int subscripts);
+int                  mg_hotkeys_record          (MGSTATFUN *p_fun);
+int                  mg_hotkeys_key             (zend_execute_data *ex, char *function, char *key, int size);
+int                  mg_hotkeys_key_item        (zval *item, char *key, int size, int len, int *p_keyn);
+int                  mg_hotkeys_swap            (MGHOTSLOT *p_slot, int n1, int n2);
+int                  mg_hotkeys_sift            (MGHOTSLOT *p_slot, int n);
+int                  mg_hotkeys_compare         (const void *p1, const void *p2);
+int                  mg_hotkeys_release         (void);
 
 
 #if defined(_WIN32) && defined(COMPILE_DL_MG_PHP)
@@ -791,6 +1319,7 @@ PHP_MINIT_FUNCTION(mg_php)
    int n;
    time_t now;
    char buffer[256];
+   zend_class_entry ce;
 
 #if 0
    mg_log_event(&dbxlog, "PHP_MINIT_FUNCTION(mg_php)", "trace", 0);
@@ -821,6 +1350,33 @@ PHP_MINIT_FUNCTION(mg_php)
 
    dbx_init();
 
+   mg_stat_since = now; /* v3.4.63 */
+
+   REGISTER_INI_ENTRIES(); /* v3.4.63 */
+   mg_metrics_init((int) INI_INT(MG_EXT_NAME ".metrics_workers"));
+   mg_hotkeys_init((int) INI_INT(MG_EXT_NAME ".hotkeys_sample"), (int) INI_INT(MG_EXT_NAME ".hotkeys_subscripts"));
+   mg_capture_open(INI_STR(MG_EXT_NAME ".capture_file"));
+
+   /* v3.4.63 */
+   INIT_NS_CLASS_ENTRY(ce, "Mg", "Cursor", mg_cursor_methods);
+   mg_cursor_ce = zend_register_internal_class(&ce);
+   mg_cursor_ce->create_object = mg_cursor_create;
+   zend_class_implements(mg_cursor_ce, 1, zend_ce_iterator);
+   memcpy(&mg_cursor_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+   mg_cursor_handlers.offset = XtOffsetOf(MGCURSOR, std);
+   mg_cursor_handlers.free_obj = mg_cursor_free;
+   mg_cursor_handlers.clone_obj = NULL;
+
+   INIT_NS_CLASS_ENTRY(ce, "Mg", "Query", mg_query_methods);
+   mg_query_ce = zend_register_internal_class(&ce);
+   mg_query_ce->create_object = mg_cursor_create;
+   zend_class_implements(mg_query_ce, 1, zend_ce_iterator);
+
+   INIT_NS_CLASS_ENTRY(ce, "Mg", "Globals", mg_globals_methods);
+   mg_globals_ce = zend_register_internal_class(&ce);
+   mg_globals_ce->create_object = mg_cursor_create;
+   zend_class_implements(mg_globals_ce, 1, zend_ce_iterator);
+
 	return SUCCESS;
 }
 
@@ -834,6 +1390,17 @@ PHP_MSHUTDOWN_FUNCTION(mg_php)
    mg_log_event(&dbxlog, "PHP_MSHUTDOWN_FUNCTION(mg_php)", "trace", 0);
 #endif
 
+#if !defined(MG_PHP_MGW)
+   mg_release_server_api_persistent(); /* v3.4.63 */
+#endif
+
+   mg_log_shutdown(); /* v3.4.63 write out any queued log events */
+   mg_stat_release(); /* v3.4.63 */
+   mg_hotkeys_release();
+   mg_metrics_release();
+   mg_capture_close();
+   UNREGISTER_INI_ENTRIES();
+
 #if defined(_WIN32) && !defined(COMPILE_DL_MG_PHP)
    DeleteCriticalSection(&dbx_global_mutex);
 #endif
@@ -877,6 +1444,8 @@ PHP_RINIT_FUNCTION(mg_php)
    MG_PHP_GLOBAL(p_page)->p_srv->timeout = 0;
    MG_PHP_GLOBAL(p_page)->p_srv->no_retry = 0;
    MG_PHP_GLOBAL(p_page)->p_srv->mode = 0; /* v3.3.62 */
+   MG_PHP_GLOBAL(p_page)->p_srv->no_command = 0; /* v3.4.63 */
+   MG_PHP_GLOBAL(p_page)->p_srv->p_env = NULL; /* v3.4.63 */
 
    strcpy(MG_PHP_GLOBAL(p_page)->p_srv->ip_address, MG_HOST);
    MG_PHP_GLOBAL(p_page)->p_srv->port = MG_DEFAULT_PORT;
@@ -893,6 +1462,24 @@ PHP_RINIT_FUNCTION(mg_php)
       MG_PHP_GLOBAL(p_page)->p_srv->pcon[n] = NULL;
    }
 
+   memset((void *) &(MG_PHP_GLOBAL(p_page)->ra), 0, sizeof(MGRAHEAD)); /* v3.4.63 */
+   memset((void *) &(MG_PHP_GLOBAL(p_page)->locks), 0, sizeof(MGBUF));
+   memset((void *) &(MG_PHP_GLOBAL(p_page)->p_srv->stat), 0, sizeof(MGSTATCALL));
+
+   mg_metrics_attach(); /* v3.4.63 */
+
+   MG_PHP_GLOBAL(p_page)->slow_ns = (unsigned long long) INI_INT(MG_EXT_NAME ".slowlog_threshold") * 1000000ULL;
+   MG_PHP_GLOBAL(p_page)->slow_log = (short) INI_INT(MG_EXT_NAME ".slowlog_log");
+   MG_PHP_GLOBAL(p_page)->access_min = (int) INI_INT(MG_EXT_NAME ".access_report");
+   MG_PHP_GLOBAL(p_page)->p_access = NULL;
+
+#if !defined(MG_PHP_MGW)
+   /* v3.4.63 a binding to the database API configured in php.ini: scripts need not call m_bind_server_api() */
+   if (*(INI_STR(MG_EXT_NAME ".api_dbtype"))) {
+      mg_bind_ini(MG_PHP_GLOBAL(p_page));
+   }
+#endif
+
 	return SUCCESS;
 }
 
@@ -910,6 +1497,27 @@ PHP_RSHUTDOWN_FUNCTION(mg_php)
 
    if (MG_PHP_GLOBAL(p_page) != NULL) {
 
+      /* v3.4.63 account for a function that did not return normally (e.g. a fatal error) */
+      mg_stat_end(MG_PHP_GLOBAL(p_page), 1);
+
+      /* v3.4.63 report loops of similar calls */
+      if (MG_PHP_GLOBAL(p_page)->p_access) {
+         if (MG_PHP_GLOBAL(p_page)->access_min) {
+            mg_access_report(MG_PHP_GLOBAL(p_page));
+         }
+         mg_access_release(MG_PHP_GLOBAL(p_page));
+      }
+
+      /* v3.4.63 release any locks still held */
+      if (MG_PHP_GLOBAL(p_page)->locks.data_size) {
+         mg_lock_release_all(MG_PHP_GLOBAL(p_page));
+      }
+
+#if !defined(MG_PHP_MGW)
+      /* v3.4.63 a persistent binding to the database API outlives this request's server record */
+      mg_detach_server_api(MG_PHP_GLOBAL(p_page)->p_srv);
+#endif
+
       for (n = 0; n < MG_MAXCON; n ++) {
          if (MG_PHP_GLOBAL(p_page)->p_srv->pcon[n] != NULL) {
 /*
@@ -922,9 +1530,15 @@ PHP_RSHUTDOWN_FUNCTION(mg_php)
             mg_db_disconnect(MG_PHP_GLOBAL(p_page)->p_srv, n, 0);
          }
       }
+      mg_buf_free(&(MG_PHP_GLOBAL(p_page)->ra.ref)); /* v3.4.63 */
+      mg_buf_free(&(MG_PHP_GLOBAL(p_page)->ra.last));
+      mg_buf_free(&(MG_PHP_GLOBAL(p_page)->ra.keys));
+      mg_buf_free(&(MG_PHP_GLOBAL(p_page)->locks));
       mg_free((void *) MG_PHP_GLOBAL(p_page), 0);
    }
 
+   mg_capture_flush(); /* v3.4.63 */
+
 	return SUCCESS;
 }
 
@@ -934,6 +1548,11 @@ PHP_RSHUTDOWN_FUNCTION(mg_php)
  */
 PHP_MINFO_FUNCTION(mg_php)
 {
+   int n;
+   unsigned long long count;
+   char calls[32], errors[32], sent[32], recv[32], mean[32], p50[32], p99[32];
+   MGSTATFUN *p_fun;
+
 #if 0
    mg_log_event(&dbxlog, "PHP_MINFO_FUNCTION(mg_php)", "trace", 0);
 #endif
@@ -946,6 +1565,28 @@ PHP_MINFO_FUNCTION(mg_php)
 
 	php_info_print_table_end();
 
+   DISPLAY_INI_ENTRIES(); /* v3.4.63 */
+
+   /* v3.4.63 function statistics for this worker (latencies in microseconds, from call to return) */
+   php_info_print_table_start();
+   php_info_print_table_header(8, "Function", "Calls", "Errors", "Bytes Sent", "Bytes Received", "Mean", "p50", "p99");
+   for (n = 0; n < MG_STAT_MAXFUN; n ++) {
+      p_fun = mg_stat_fun[n];
+      if (!p_fun || !p_fun->calls) {
+         continue;
+      }
+      count = mg_stat_count(p_fun, MG_STAT_TOTAL);
+      sprintf(calls, "%llu", p_fun->calls);
+      sprintf(errors, "%llu", p_fun->errors);
+      sprintf(sent, "%llu", p_fun->bytes_sent);
+      sprintf(recv, "%llu", p_fun->bytes_recv);
+      sprintf(mean, "%.1f", count ? ((double) p_fun->sum[MG_STAT_TOTAL] / (double) count) / 1000.0 : 0.0);
+      sprintf(p50, "%.1f", (double) mg_stat_percentile(p_fun, MG_STAT_TOTAL, count, 50.0) / 1000.0);
+      sprintf(p99, "%.1f", (double) mg_stat_percentile(p_fun, MG_STAT_TOTAL, count, 99.0) / 1000.0);
+      php_info_print_table_row(8, p_fun->name, calls, errors, sent, recv, mean, p50, p99);
+   }
+   php_info_print_table_end();
+
 }
 
 
@@ -1336,6 +1977,138 @@ ZEND_FUNCTION(m_set_no_retry)
 /* }}} */
 
 
+/* {{{ proto bool m_set_slowlog(int milliseconds[, bool log])
+   Record calls taking longer than a threshold (0 to disable) in the slow call log, and optionally in the log file, for the rest of this request */
+ZEND_FUNCTION(m_set_slowlog)
+{
+   int argument_count, threshold;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   if (!p_page) {
+      MG_RETURN_FALSE;
+   }
+
+   mg_log_request(p_page, "m_set_slowlog");
+
+   strcpy(p_page->p_srv->error_code, "");
+   strcpy(p_page->p_srv->error_mess, "");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   threshold = (int) zval_get_long(&(parameter_array[0]));
+   if (threshold < 0) {
+      MG_RETURN_FALSE;
+   }
+
+   p_page->slow_ns = (unsigned long long) threshold * 1000000ULL;
+   if (argument_count > 1) {
+      p_page->slow_log = (short) mg_get_integer(&(parameter_array[1]));
+   }
+
+   MG_RETURN_TRUE;
+}
+/* }}} */
+
+
+/* {{{ proto bool m_set_access_report(int calls)
+   Report call sites that make at least this number of similar single-node calls during this request (0 to disable) */
+ZEND_FUNCTION(m_set_access_report)
+{
+   int argument_count, calls;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   if (!p_page) {
+      MG_RETURN_FALSE;
+   }
+
+   mg_log_request(p_page, "m_set_access_report");
+
+   strcpy(p_page->p_srv->error_code, "");
+   strcpy(p_page->p_srv->error_mess, "");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   calls = (int) zval_get_long(&(parameter_array[0]));
+   if (calls < 0) {
+      MG_RETURN_FALSE;
+   }
+
+   p_page->access_min = calls;
+
+   MG_RETURN_TRUE;
+}
+/* }}} */
+
+
+/* {{{ proto bool m_set_readahead(int batch)
+   Set the number of subscripts fetched per round-trip by m_order() and m_previous() (0 to disable) */
+ZEND_FUNCTION(m_set_readahead)
+{
+   int argument_count, batch;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   if (!p_page) {
+      MG_RETURN_FALSE;
+   }
+
+   mg_log_request(p_page, "m_set_readahead");
+
+   strcpy(p_page->p_srv->error_code, "");
+   strcpy(p_page->p_srv->error_mess, "");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   batch = (int) zval_get_long(&(parameter_array[0]));
+   if (batch < 0) {
+      MG_RETURN_FALSE;
+   }
+
+   if (batch > 0 && !p_page->ra.keys.p_buffer) {
+      mg_buf_init(&(p_page->ra.ref), 256, 256);
+      mg_buf_init(&(p_page->ra.last), 256, 256);
+      mg_buf_init(&(p_page->ra.keys), MG_BUFSIZE, MG_BUFSIZE);
+   }
+   p_page->ra.batch = batch;
+   p_page->ra.ref.data_size = 0;
+
+   MG_RETURN_TRUE;
+}
+/* }}} */
+
+
 /* {{{ proto bool m_set_host(string ipaddress, int port, string username, string password)
    Set the host.  Either the M server or the 'Service Integration Gateway' (if used). */
 ZEND_FUNCTION(m_set_host)
@@ -1386,6 +2159,7 @@ ZEND_FUNCTION(m_set_host)
          p_page->p_srv->port = MG_DEFAULT_PORT;
       }
    }
+   p_page->p_srv->no_command = 0; /* v3.4.63 a different DB Superserver may implement the batched commands */
 
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[2]));
@@ -1509,6 +2283,7 @@ ZEND_FUNCTION(m_bind_server_api)
 {
    char buffer[128];
    int argument_count, n, result;
+   short context;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
    MGPAGE *p_page;
    MGBUF *p_buf;
@@ -1537,9 +2312,10 @@ ZEND_FUNCTION(m_bind_server_api)
 
    n = 0;
 
+   /* v3.4.63 the arguments are copied straight from the (terminated) PHP strings */
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[0]));
-   strncpy(buffer, estrndup(Z_STRVAL_P(&parameter_array[0]), Z_STRLEN_P(&parameter_array[0])), 30);
+   strncpy(buffer, Z_STRVAL_P(&parameter_array[0]), 30);
    buffer[30] = '\0';
    if (buffer[0]) {
       strcpy(p_page->p_srv->dbtype_name, buffer);
@@ -1547,7 +2323,7 @@ ZEND_FUNCTION(m_bind_server_api)
 
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[1]));
-   strncpy(buffer, estrndup(Z_STRVAL_P(&parameter_array[1]), Z_STRLEN_P(&parameter_array[1])), 120);
+   strncpy(buffer, Z_STRVAL_P(&parameter_array[1]), 120);
    buffer[120] = '\0';
    if (buffer[0]) {
       strcpy(p_page->p_srv->shdir, buffer);
@@ -1555,7 +2331,7 @@ ZEND_FUNCTION(m_bind_server_api)
 
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[2]));
-   strncpy(buffer, estrndup(Z_STRVAL_P(&parameter_array[2]), Z_STRLEN_P(&parameter_array[2])), 60);
+   strncpy(buffer, Z_STRVAL_P(&parameter_array[2]), 60);
    buffer[60] = '\0';
    if (buffer[0]) {
       strcpy(p_page->p_srv->username, buffer);
@@ -1563,24 +2339,24 @@ ZEND_FUNCTION(m_bind_server_api)
 
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[3]));
-   strncpy(buffer, estrndup(Z_STRVAL_P(&parameter_array[3]), Z_STRLEN_P(&parameter_array[3])), 60);
+   strncpy(buffer, Z_STRVAL_P(&parameter_array[3]), 60);
    buffer[60] = '\0';
    if (buffer[0]) {
       strcpy(p_page->p_srv->password, buffer);
    }
 
-   p_page->p_srv->p_env = (MGBUF *) mg_malloc(sizeof(MGBUF), 0);
-   mg_buf_init(p_page->p_srv->p_env, MG_BUFSIZE, MG_BUFSIZE);
-
    convert_to_string_ex(&(parameter_array[4]));
-   mg_buf_cpy(p_page->p_srv->p_env, estrndup(Z_STRVAL_P(&parameter_array[4]), Z_STRLEN_P(&parameter_array[4])), (unsigned long) Z_STRLEN_P(&parameter_array[4]));
 
    *buffer = '\0';
    convert_to_string_ex(&(parameter_array[5]));
-   strncpy(buffer, estrndup(Z_STRVAL_P(&parameter_array[5]), Z_STRLEN_P(&parameter_array[5])), 60);
+   strncpy(buffer, Z_STRVAL_P(&parameter_array[5]), 60);
    buffer[60] = '\0';
+   mg_lcase(buffer);
 
-   result = mg_bind_server_api(p_page->p_srv, 0);
+   /* v3.4.63 a persistent binding is made once per process (or thread) and reused by later requests */
+   context = strstr(buffer, "persistent") ? DBX_API_PERSISTENT : 0;
+
+   result = mg_bind_api(p_page, Z_STRVAL_P(&parameter_array[4]), (int) Z_STRLEN_P(&parameter_array[4]), '\n', context);
 
    if (!result) {
       if (!strlen(p_page->p_srv->error_mess)) {
@@ -1595,11 +2371,74 @@ ZEND_FUNCTION(m_bind_server_api)
 /* }}} */
 
 
-/* {{{ proto string m_release_server_api()
+/* v3.4.63 bind to the server's API: the database type, path and credentials are already in the server record */
+int mg_bind_api(MGPAGE *p_page, char *env, int env_len, char env_sep, short context)
+{
+   int n, result;
+   MGBUF env_buf;
+
+#ifdef ZTS
+   context |= DBX_API_THREADED; /* v3.4.63 per-thread database contexts */
+#endif
+
+   /* v3.4.63 the environment variables are only read while the API is opened: they are copied for that and freed on return */
+   mg_buf_init(&env_buf, env_len + 1, MG_BUFSIZE);
+   mg_buf_cpy(&env_buf, env, (unsigned long) env_len);
+   for (n = 0; n < (int) env_buf.data_size; n ++) {
+      if (env_buf.p_buffer[n] == (unsigned char) env_sep) {
+         env_buf.p_buffer[n] = '\n';
+      }
+   }
+   if (env_buf.data_size && env_buf.p_buffer[env_buf.data_size - 1] != '\n') {
+      mg_buf_cat(&env_buf, "\n", 1);
+   }
+   p_page->p_srv->p_env = &env_buf;
+
+   result = mg_bind_server_api(p_page->p_srv, context);
+
+   p_page->p_srv->p_env = NULL;
+   mg_buf_free(&env_buf);
+
+   return result;
+}
+
+
+/* v3.4.63 the persistent binding configured in php.ini (mg_php.api_*): made by a process's (or thread's) first request and reused by the rest */
+int mg_bind_ini(MGPAGE *p_page)
+{
+   int result;
+   char *env;
+
+   strncpy(p_page->p_srv->dbtype_name, INI_STR(MG_EXT_NAME ".api_dbtype"), 30);
+   p_page->p_srv->dbtype_name[30] = '\0';
+   strncpy(p_page->p_srv->shdir, INI_STR(MG_EXT_NAME ".api_path"), 120);
+   p_page->p_srv->shdir[120] = '\0';
+   strncpy(p_page->p_srv->username, INI_STR(MG_EXT_NAME ".api_username"), 60);
+   p_page->p_srv->username[60] = '\0';
+   strncpy(p_page->p_srv->password, INI_STR(MG_EXT_NAME ".api_password"), 60);
+   p_page->p_srv->password[60] = '\0';
+   if (*(INI_STR(MG_EXT_NAME ".api_namespace"))) {
+      strncpy(p_page->p_srv->uci, INI_STR(MG_EXT_NAME ".api_namespace"), 31);
+      p_page->p_srv->uci[31] = '\0';
+   }
+
+   /* environment variables are separated by ';' in php.ini */
+   env = INI_STR(MG_EXT_NAME ".api_envvars");
+
+   result = mg_bind_api(p_page, env, (int) strlen(env), ';', DBX_API_PERSISTENT);
+   if (!result) {
+      mg_log_event(p_page->p_log, p_page->p_srv->error_mess[0] ? p_page->p_srv->error_mess : "The server API is not available on this host", "Unable to bind to the database API (" MG_EXT_NAME ".api_dbtype)", 0);
+   }
+
+   return result;
+}
+
+
+/* {{{ proto string m_release_server_api([bool force])
    Release binding to the server's API */
 ZEND_FUNCTION(m_release_server_api)
 {
-   int argument_count, result;
+   int argument_count, n, result;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
    MGPAGE *p_page;
    MGBUF *p_buf;
@@ -1618,7 +2457,16 @@ ZEND_FUNCTION(m_release_server_api)
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
-   result = mg_release_server_api(p_page->p_srv, 0);
+   /* v3.4.63 a persistent binding is only released if forced */
+   n = 0;
+   if (argument_count > 0) {
+      if (zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+         MG_WRONG_PARAM_COUNT;
+      convert_to_long_ex(&(parameter_array[0]));
+      n = (int) Z_LVAL_P(&parameter_array[0]);
+   }
+
+   result = mg_release_server_api(p_page->p_srv, (short) (n ? DBX_API_FORCE : 0));
 
    MG_RETURN_STRING_AND_FREE_BUF("", 1);
 }
@@ -1662,65 +2510,425 @@ ZEND_FUNCTION(m_get_last_error)
 /* }}} */
 
 
-/* {{{ proto string m_set([string servername, ]string globalname, mixed keys ..., mixed data)
-   Set an M global node */
-ZEND_FUNCTION(m_set)
+/* {{{ proto array m_stats([bool reset])
+   Get the call, error and byte counts and latency distributions (microseconds) for each function called in this worker */
+ZEND_FUNCTION(m_stats)
 {
-   long parameter = 0;
-   MGBUF mgbuf, *p_buf;
-   int argument_count, offset, n, len;
-   char *key = NULL;
-   char *data;
+   int argument_count, n, m, reset;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
-   int chndle;
+   zval functions, function, phase;
+   MGSTATFUN *p_fun;
    MGPAGE *p_page;
 
    p_page = MG_PHP_GLOBAL(p_page);
 
-   p_buf = &mgbuf;
-   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
-
-   mg_log_request(p_page, "m_set");
+   /* this function is not itself counted, but it accounts for a previous function that did not return normally */
+   mg_stat_end(p_page, 1);
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
-   /* see if it satisfies our minimal request (1 argument) */
-   if (argument_count < 1)
-      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
-
    /* argument count is correct, now retrieve arguments */
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
-      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+      MG_WRONG_PARAM_COUNT;
 
-   n = mg_db_connect(p_page->p_srv, &chndle, 1);
-   if (!n) {
-      MG_ERROR1(p_page->p_srv->error_mess);
+   reset = 0;
+   if (argument_count > 0) {
+      reset = mg_get_integer(&(parameter_array[0]));
    }
 
-   offset = mg_request_header_ex(p_page, p_buf, "S", MG_PRODUCT, &(parameter_array[0]));
+   array_init(return_value);
+   add_assoc_long(return_value, "pid", (long) mg_current_process_id());
+   add_assoc_long(return_value, "since", (long) mg_stat_since);
 
-   for (n = offset; n < argument_count; n ++) {
-      data = mg_get_string(&(parameter_array[n]), NULL, &len);
-      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, 0, MG_TX_DATA);
+   array_init(&functions);
+   for (n = 0; n < MG_STAT_MAXFUN; n ++) {
+      p_fun = mg_stat_fun[n];
+      if (!p_fun || !p_fun->calls) {
+         continue;
+      }
+      array_init(&function);
+      add_assoc_long(&function, "calls", (long) p_fun->calls);
+      add_assoc_long(&function, "errors", (long) p_fun->errors);
+      add_assoc_long(&function, "bytes_sent", (long) p_fun->bytes_sent);
+      add_assoc_long(&function, "bytes_received", (long) p_fun->bytes_recv);
+      for (m = 0; m < MG_STAT_PHASES; m ++) {
+         mg_stat_phase_array(&phase, p_fun, m);
+         add_assoc_zval(&function, mg_stat_phase_name[m], &phase);
+      }
+      add_assoc_zval(&functions, p_fun->name, &function);
    }
+   add_assoc_zval(return_value, "functions", &functions);
 
-   MG_MEMCHECK("Insufficient memory to process request", 1);
-
-   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
-   if (!n) {
-      MG_ERROR1(p_page->p_srv->error_mess);
+   if (reset) {
+      mg_stat_reset();
    }
 
-   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
-   MG_MEMCHECK("Insufficient memory to process response", 0);
+   return;
+}
+/* }}} */
 
-   mg_db_disconnect(p_page->p_srv, chndle, 1);
 
-   parameter ++;
+/* {{{ proto string m_metrics_export()
+   Get the call and connection pool metrics for all worker processes (or this worker if mg_php.metrics_workers is not set) in OpenMetrics text format */
+ZEND_FUNCTION(m_metrics_export)
+{
+   int n, w, f, workers;
+   unsigned long long total;
+   char buffer[512];
+   MGBUF mgbuf, *p_buf;
+   MGMETSLOT *p_slot;
+   MGMETFUN *p_mfun;
 
-   if ((n = mg_php_error(p_page, p_buf->p_buffer))) {
-      if (n == 2) {
+   if (!mg_metrics) {
+      RETURN_EMPTY_STRING();
+   }
+
+   mg_stat_end(MG_PHP_GLOBAL(p_page), 1);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   workers = mg_metrics->shared ? mg_metrics->workers : 1;
+
+   mg_metrics_family(p_buf, "mg_php_worker", "info", NULL, "Worker process occupying each metrics slot.");
+   for (w = 0; w < workers; w ++) {
+      p_slot = &(mg_metrics->slot[w]);
+      if (p_slot->pid) {
+         sprintf(buffer, "mg_php_worker_info{worker=\"%d\",pid=\"%d\"} 1\n", w, p_slot->pid);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      }
+   }
+
+   mg_metrics_family(p_buf, "mg_php_requests", "counter", NULL, "PHP requests handled.");
+   for (w = 0; w < workers; w ++) {
+      p_slot = &(mg_metrics->slot[w]);
+      if (p_slot->pid) {
+         sprintf(buffer, "mg_php_requests_total{worker=\"%d\"} %llu\n", w, p_slot->requests);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      }
+   }
+
+   mg_metrics_family(p_buf, "mg_php_connections", "gauge", NULL, "Network connections to the DB Server held in the connection pool.");
+   for (w = 0; w < workers; w ++) {
+      p_slot = &(mg_metrics->slot[w]);
+      if (p_slot->pid) {
+         sprintf(buffer, "mg_php_connections{worker=\"%d\",state=\"in_use\"} %lld\nmg_php_connections{worker=\"%d\",state=\"idle\"} %lld\n", w, p_slot->pool.in_use, w, p_slot->pool.open - p_slot->pool.in_use);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      }
+   }
+
+   for (n = 0; n < 4; n ++) {
+      static const char *name[4] = {"mg_php_connects", "mg_php_connect_errors", "mg_php_timeouts", "mg_php_read_errors"};
+      static const char *help[4] = {"Network connections opened to the DB Server.", "Failed attempts to connect to the DB Server.", "DB Server responses not received within the timeout.", "DB Server connections closed before a response was received."};
+
+      mg_metrics_family(p_buf, (char *) name[n], "counter", NULL, (char *) help[n]);
+      for (w = 0; w < workers; w ++) {
+         p_slot = &(mg_metrics->slot[w]);
+         if (!p_slot->pid) {
+            continue;
+         }
+         total = (n == 0) ? p_slot->pool.connects : ((n == 1) ? p_slot->pool.connect_errors : ((n == 2) ? p_slot->pool.timeouts : p_slot->pool.read_errors));
+         sprintf(buffer, "%s_total{worker=\"%d\"} %llu\n", name[n], w, total);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      }
+   }
+
+   for (n = 0; n < 4; n ++) {
+      static const char *name[4] = {"mg_php_calls", "mg_php_call_errors", "mg_php_sent_bytes", "mg_php_received_bytes"};
+      static const char *help[4] = {"Calls to mg_php functions.", "Calls to mg_php functions that raised an error.", "Bytes sent to the DB Server.", "Bytes received from the DB Server."};
+
+      mg_metrics_family(p_buf, (char *) name[n], "counter", n > 1 ? "bytes" : NULL, (char *) help[n]);
+      for (w = 0; w < workers; w ++) {
+         p_slot = &(mg_metrics->slot[w]);
+         if (!p_slot->pid) {
+            continue;
+         }
+         for (f = 0; f < MG_METRICS_MAXFUN; f ++) {
+            p_mfun = &(p_slot->fun[f]);
+            if (mg_metrics->fun_state[f] != 2 || !p_mfun->calls) {
+               continue;
+            }
+            total = (n == 0) ? p_mfun->calls : ((n == 1) ? p_mfun->errors : ((n == 2) ? p_mfun->bytes_sent : p_mfun->bytes_recv));
+            sprintf(buffer, "%s_total{worker=\"%d\",function=\"%s\"} %llu\n", name[n], w, mg_metrics->fun_name[f], total);
+            mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+         }
+      }
+   }
+
+   mg_metrics_family(p_buf, "mg_php_call_duration_seconds", "histogram", "seconds", "Time from the call of an mg_php function to its return.");
+   for (w = 0; w < workers; w ++) {
+      p_slot = &(mg_metrics->slot[w]);
+      if (!p_slot->pid) {
+         continue;
+      }
+      for (f = 0; f < MG_METRICS_MAXFUN; f ++) {
+         p_mfun = &(p_slot->fun[f]);
+         if (mg_metrics->fun_state[f] != 2 || !p_mfun->calls) {
+            continue;
+         }
+         total = 0;
+         for (n = 0; n < MG_METRICS_BUCKETS; n ++) {
+            total += p_mfun->bucket[n];
+            sprintf(buffer, "mg_php_call_duration_seconds_bucket{worker=\"%d\",function=\"%s\",le=\"%s\"} %llu\n", w, mg_metrics->fun_name[f], mg_metrics_le_name[n], total);
+            mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+         }
+         /* calls that did not return normally are counted but not timed */
+         total += p_mfun->bucket[MG_METRICS_BUCKETS];
+         sprintf(buffer, "mg_php_call_duration_seconds_bucket{worker=\"%d\",function=\"%s\",le=\"+Inf\"} %llu\n", w, mg_metrics->fun_name[f], total);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+         sprintf(buffer, "mg_php_call_duration_seconds_count{worker=\"%d\",function=\"%s\"} %llu\n", w, mg_metrics->fun_name[f], total);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+         sprintf(buffer, "mg_php_call_duration_seconds_sum{worker=\"%d\",function=\"%s\"} %.9f\n", w, mg_metrics->fun_name[f], (double) p_mfun->sum / 1000000000.0);
+         mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      }
+   }
+
+   mg_buf_cat(p_buf, "# EOF\n", 6);
+
+   RETVAL_STRINGL((char *) p_buf->p_buffer, p_buf->data_size);
+   mg_buf_free(p_buf);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto array m_slowlog([bool clear])
+   Get the calls recorded in the slow call log of this worker (oldest first) */
+ZEND_FUNCTION(m_slowlog)
+{
+   int argument_count, clear;
+   unsigned long n, first;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   zval entry;
+   MGSLOW *p_slow;
+
+   mg_stat_end(MG_PHP_GLOBAL(p_page), 1);
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   clear = 0;
+   if (argument_count > 0) {
+      clear = mg_get_integer(&(parameter_array[0]));
+   }
+
+   array_init(return_value);
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+
+   first = (mg_slowlog_next > MG_SLOWLOG_SIZE) ? (mg_slowlog_next - MG_SLOWLOG_SIZE) : 0;
+   for (n = first; n < mg_slowlog_next; n ++) {
+      p_slow = &(mg_slowlog[n % MG_SLOWLOG_SIZE]);
+      array_init(&entry);
+      add_assoc_long(&entry, "time", (long) p_slow->time);
+      add_assoc_string(&entry, "function", p_slow->function);
+      add_assoc_string(&entry, "name", p_slow->name);
+      add_assoc_string(&entry, "args", p_slow->args);
+      add_assoc_double(&entry, "duration", (double) p_slow->duration / 1000000.0);
+      add_assoc_double(&entry, "wait", (double) p_slow->wait / 1000000.0);
+      add_assoc_long(&entry, "bytes_sent", (long) p_slow->bytes_sent);
+      add_assoc_long(&entry, "bytes_received", (long) p_slow->bytes_recv);
+      add_assoc_long(&entry, "chndle", (long) p_slow->chndle);
+      add_assoc_string(&entry, "server_pid", p_slow->mpid);
+      add_assoc_string(&entry, "file", p_slow->file);
+      add_assoc_long(&entry, "line", (long) p_slow->line);
+      add_next_index_zval(return_value, &entry);
+   }
+   if (clear) {
+      mg_slowlog_next = 0;
+   }
+
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto array m_access_report()
+   Get the call sites that have made similar single-node calls so far in this request (most time spent waiting first) */
+ZEND_FUNCTION(m_access_report)
+{
+   int n, sitesn;
+   char buffer[1024];
+   zval site;
+   MGACCESS **sites;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_stat_end(p_page, 1);
+
+   array_init(return_value);
+   if (!p_page || !p_page->p_access) {
+      return;
+   }
+
+   sitesn = mg_access_sites(p_page, &sites);
+   for (n = 0; n < sitesn; n ++) {
+      mg_access_signature(sites[n], buffer, sizeof(buffer));
+      array_init(&site);
+      add_assoc_string(&site, "file", sites[n]->file);
+      add_assoc_long(&site, "line", (long) sites[n]->line);
+      add_assoc_string(&site, "function", sites[n]->function);
+      add_assoc_string(&site, "call", buffer);
+      add_assoc_long(&site, "count", (long) sites[n]->count);
+      add_assoc_double(&site, "duration", (double) sites[n]->duration / 1000000.0);
+      add_assoc_double(&site, "wait", (double) sites[n]->wait / 1000000.0);
+      add_assoc_string(&site, "advice", (char *) mg_access_advice(sites[n]->function));
+      add_next_index_zval(return_value, &site);
+   }
+   if (sites) {
+      efree((void *) sites);
+   }
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto array m_hot_keys([int limit])
+   Get the global nodes most often referenced by all worker processes (or this worker if mg_php.metrics_workers is not set), most frequent first */
+ZEND_FUNCTION(m_hot_keys)
+{
+   int argument_count, limit, n, k, keysn, slot;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   zval entry, *p_index;
+   unsigned long long samples;
+   HashTable index;
+   MGHOTKEY *keys, *p_key;
+   MGHOTSLOT *p_slot;
+
+   mg_stat_end(MG_PHP_GLOBAL(p_page), 1);
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   limit = MG_HOTKEYS_TOPK;
+   if (argument_count > 0) {
+      limit = mg_get_integer(&(parameter_array[0]));
+   }
+
+   array_init(return_value);
+   if (!mg_hotkeys || limit <= 0) {
+      return;
+   }
+
+   /* merge the lists held by each worker: a node may be counted by several */
+   keys = (MGHOTKEY *) emalloc(sizeof(MGHOTKEY) * MG_HOTKEYS_TOPK * mg_hotkeys->workers);
+   zend_hash_init(&index, MG_HOTKEYS_TOPK, NULL, NULL, 0);
+   keysn = 0;
+   samples = 0;
+   for (slot = 0; slot < mg_hotkeys->workers; slot ++) {
+      p_slot = &(mg_hotkeys->slot[slot]);
+      samples += p_slot->samples;
+      for (n = 0; n < p_slot->topn && n < MG_HOTKEYS_TOPK; n ++) {
+         p_key = &(keys[keysn]);
+         memcpy((void *) p_key, (void *) &(p_slot->top[n]), sizeof(MGHOTKEY));
+         p_key->key[MG_HOTKEYS_KEYSIZE - 1] = '\0';
+         if (!p_key->count || !p_key->key[0]) {
+            continue;
+         }
+         p_index = zend_hash_str_find(&index, p_key->key, strlen(p_key->key));
+         if (p_index) {
+            keys[Z_LVAL_P(p_index)].count += p_key->count;
+            continue;
+         }
+         ZVAL_LONG(&entry, (zend_long) keysn);
+         zend_hash_str_add(&index, p_key->key, strlen(p_key->key), &entry);
+         keysn ++;
+      }
+   }
+   zend_hash_destroy(&index);
+
+   qsort((void *) keys, keysn, sizeof(MGHOTKEY), mg_hotkeys_compare);
+
+   for (k = 0; k < keysn && k < limit; k ++) {
+      array_init(&entry);
+      add_assoc_string(&entry, "key", keys[k].key);
+      add_assoc_long(&entry, "count", (long) (keys[k].count * mg_hotkeys->sample));
+      add_assoc_long(&entry, "samples", (long) keys[k].count);
+      add_assoc_double(&entry, "share", samples ? ((double) keys[k].count * 100.0) / (double) samples : 0.0);
+      add_next_index_zval(return_value, &entry);
+   }
+   efree((void *) keys);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_set([string servername, ]string globalname, mixed keys ..., mixed data)
+   Set an M global node */
+ZEND_FUNCTION(m_set)
+{
+   long parameter = 0;
+   MGBUF mgbuf, *p_buf;
+   int argument_count, offset, n, len;
+   char *key = NULL;
+   char *data;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   int chndle;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, "m_set");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   mg_readahead_invalidate(p_page, parameter_array, argument_count - 1); /* v3.4.63 */
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   offset = mg_request_header_ex(p_page, p_buf, "S", MG_PRODUCT, &(parameter_array[0]));
+
+   for (n = offset; n < argument_count; n ++) {
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, 0, MG_TX_DATA);
+   }
+
+   MG_MEMCHECK("Insufficient memory to process request", 1);
+
+   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+   MG_MEMCHECK("Insufficient memory to process response", 0);
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   parameter ++;
+
+   if ((n = mg_php_error(p_page, p_buf->p_buffer))) {
+      if (n == 2) {
          MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
       }
       MG_RETURN_FALSE_AND_FREE_BUF;
@@ -1837,6 +3045,8 @@ ZEND_FUNCTION(m_delete)
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
+   mg_readahead_invalidate(p_page, parameter_array, argument_count); /* v3.4.63 */
+
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
@@ -1904,6 +3114,8 @@ ZEND_FUNCTION(m_kill)
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
+   mg_readahead_invalidate(p_page, parameter_array, argument_count); /* v3.4.63 */
+
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
@@ -2105,6 +3317,12 @@ ZEND_FUNCTION(m_order)
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
+   if (p_page->ra.batch > 0 && mg_readahead(p_page, parameter_array, argument_count, 1, return_value)) { /* v3.4.63 */
+      mg_buf_free(p_buf);
+      mg_stat_end(p_page, 0);
+      return;
+   }
+
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
@@ -2142,14 +3360,17 @@ ZEND_FUNCTION(m_order)
 /* }}} */
 
 
-/* {{{ proto string m_previous([string servername, ]string globalname, mixed keys ...)
-   Get the previous trailing key value for an M global node */
-ZEND_FUNCTION(m_previous)
+/* {{{ proto array m_query([string servername, ]string globalname, mixed keys ...)
+   Get the full set of subscripts for the next data node in collating sequence ($Query) */
+ZEND_FUNCTION(m_query)
 {
    MGBUF mgbuf, *p_buf;
-   int argument_count, offset, n, len;
-   char *key = NULL;
+   short byref, type;
+   int argument_count, offset, n, len, hlen, size, keyn;
+   unsigned long total;
    char *data;
+   char buffer[32];
+   unsigned char *p;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
    int chndle;
    MGPAGE *p_page;
@@ -2159,7 +3380,7 @@ ZEND_FUNCTION(m_previous)
    p_buf = &mgbuf;
    mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
 
-   mg_log_request(p_page, "m_previous");
+   mg_log_request(p_page, "m_query");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
@@ -2177,7 +3398,13 @@ ZEND_FUNCTION(m_previous)
       MG_ERROR1(p_page->p_srv->error_mess);
    }
 
-   offset = mg_request_header_ex(p_page, p_buf, "P", MG_PRODUCT, &(parameter_array[0]));
+   offset = mg_request_header_ex(p_page, p_buf, "Q", MG_PRODUCT, &(parameter_array[0]));
+
+   /* batched $Query: one node, forward, subscripts only, whole global */
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "1", 1, 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "1", 1, 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "0", 1, 0, MG_TX_DATA);
 
    for (n = offset; n < argument_count; n ++) {
       data = mg_get_string(&(parameter_array[n]), NULL, &len);
@@ -2186,13 +3413,15 @@ ZEND_FUNCTION(m_previous)
 
    MG_MEMCHECK("Insufficient memory to process request", 1);
 
-   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+   /* a DB Superserver without the batched command: the node is found with $Order and $Data */
+   n = mg_batch_exchange(p_page, chndle, p_buf, &(parameter_array[0]));
+
+   MG_MEMCHECK("Insufficient memory to process response", 0);
+
    if (!n) {
+      mg_db_disconnect(p_page->p_srv, chndle, 1);
       MG_ERROR1(p_page->p_srv->error_mess);
    }
-   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
-
-   MG_MEMCHECK("Insufficient memory to process response", 0);
 
    mg_db_disconnect(p_page->p_srv, chndle, 1);
 
@@ -2202,16 +3431,40 @@ ZEND_FUNCTION(m_previous)
       }
       MG_RETURN_FALSE_AND_FREE_BUF;
    }
-   else {
-      MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer + MG_RECV_HEAD, 1);
+
+   array_init(return_value);
+
+   p = p_buf->p_buffer + MG_RECV_HEAD;
+   total = (p_buf->data_size > MG_RECV_HEAD) ? (p_buf->data_size - MG_RECV_HEAD) : 0;
+   if (total) {
+      hlen = mg_decode_item_header(p, &size, &byref, &type);
+      if (size >= 0 && size < 30 && (hlen + size) <= (int) total) {
+         strncpy(buffer, (char *) p + hlen, size);
+         buffer[size] = '\0';
+         keyn = (int) strtol(buffer, NULL, 10);
+         offset = hlen + size;
+         for (n = 0; n < keyn && offset < (int) total; n ++) {
+            hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+            offset += hlen;
+            if (size < 0 || (offset + size) > (int) total) {
+               break;
+            }
+            add_next_index_stringl(return_value, (char *) p + offset, size);
+            offset += size;
+         }
+      }
    }
+
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+   return;
 }
 /* }}} */
 
 
-/* {{{ proto string m_increment([string servername, ]string globalname, mixed keys ...)
-   Increment the value of an M global node and return the next value */
-ZEND_FUNCTION(m_increment)
+/* {{{ proto string m_previous([string servername, ]string globalname, mixed keys ...)
+   Get the previous trailing key value for an M global node */
+ZEND_FUNCTION(m_previous)
 {
    MGBUF mgbuf, *p_buf;
    int argument_count, offset, n, len;
@@ -2226,7 +3479,7 @@ ZEND_FUNCTION(m_increment)
    p_buf = &mgbuf;
    mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
 
-   mg_log_request(p_page, "m_increment");
+   mg_log_request(p_page, "m_previous");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
@@ -2239,12 +3492,18 @@ ZEND_FUNCTION(m_increment)
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
+   if (p_page->ra.batch > 0 && mg_readahead(p_page, parameter_array, argument_count, -1, return_value)) { /* v3.4.63 */
+      mg_buf_free(p_buf);
+      mg_stat_end(p_page, 0);
+      return;
+   }
+
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
    }
 
-   offset = mg_request_header_ex(p_page, p_buf, "I", MG_PRODUCT, &(parameter_array[0]));
+   offset = mg_request_header_ex(p_page, p_buf, "P", MG_PRODUCT, &(parameter_array[0]));
 
    for (n = offset; n < argument_count; n ++) {
       data = mg_get_string(&(parameter_array[n]), NULL, &len);
@@ -2276,14 +3535,17 @@ ZEND_FUNCTION(m_increment)
 /* }}} */
 
 
-/* {{{ proto string m_tstart([string servername])
-   Start a transaction */
-ZEND_FUNCTION(m_tstart)
+/* {{{ proto array m_globals([string servername, ][string prefix[, int limit]])
+   Get a list of the global names (optionally starting with prefix) in a single round-trip */
+ZEND_FUNCTION(m_globals)
 {
    MGBUF mgbuf, *p_buf;
-   int argument_count, offset, n, len;
-   char *key = NULL;
+   short byref, type;
+   int argument_count, offset, n, len, hlen, size;
+   unsigned long total;
    char *data;
+   char buffer[32];
+   unsigned char *p;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
    int chndle;
    MGPAGE *p_page;
@@ -2293,32 +3555,348 @@ ZEND_FUNCTION(m_tstart)
    p_buf = &mgbuf;
    mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
 
-   mg_log_request(p_page, "m_tstart");
+   mg_log_request(p_page, "m_globals");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
-   if (argument_count > 0) {
-      if (zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
-          MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
-   }
+   if (argument_count > 3)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
    }
 
-   offset = mg_request_header_ex(p_page, p_buf, "a", MG_PRODUCT, &(parameter_array[0]));
+   /* the prefix need not start with '^' (for example, "Per"), so the first argument is only taken as the server name if all three are given */
+   offset = 0;
+   if (argument_count > 2) {
+      offset = mg_request_header_ex(p_page, p_buf, "E", MG_PRODUCT, &(parameter_array[0]));
+   }
+   else {
+      mg_request_header(p_page->p_srv, p_buf, "E", MG_PRODUCT);
+   }
 
-   for (n = offset; n < argument_count; n ++) {
-      data = mg_get_string(&(parameter_array[n]), NULL, &len);
-      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, 0, MG_TX_DATA);
+   /* limit, flags, prefix, seed */
+   if (argument_count > (offset + 1)) {
+      sprintf(buffer, "%ld", (long) zval_get_long(&(parameter_array[offset + 1])));
+   }
+   else {
+      strcpy(buffer, "0");
+   }
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+   if (argument_count > offset) {
+      data = mg_get_string(&(parameter_array[offset]), NULL, &len);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) data, len, 0, MG_TX_DATA);
    }
+   else {
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+   }
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
 
    MG_MEMCHECK("Insufficient memory to process request", 1);
 
-   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
-   if (!n) {
+   /* a DB Superserver without the global directory command is reported as such (and is not asked again) */
+   n = mg_batch_exchange(p_page, chndle, p_buf, &(parameter_array[0]));
+
+   MG_MEMCHECK("Insufficient memory to process response", 0);
+
+   if (!n) {
+      mg_db_disconnect(p_page->p_srv, chndle, 1);
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   if ((n = mg_php_error(p_page, p_buf->p_buffer))) {
+      if (n == 2) {
+         MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
+      }
+      MG_RETURN_FALSE_AND_FREE_BUF;
+   }
+
+   array_init(return_value);
+
+   p = p_buf->p_buffer + MG_RECV_HEAD;
+   total = (p_buf->data_size > MG_RECV_HEAD) ? (p_buf->data_size - MG_RECV_HEAD) : 0;
+   for (offset = 0; (unsigned long) offset < total; ) {
+      hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+      offset += hlen;
+      if (size < 0 || (unsigned long) (offset + size) > total) {
+         break;
+      }
+      add_next_index_stringl(return_value, (char *) p + offset, size);
+      offset += size;
+   }
+
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_increment([string servername, ]string globalname, mixed keys ...)
+   Increment the value of an M global node and return the next value */
+ZEND_FUNCTION(m_increment)
+{
+   MGBUF mgbuf, *p_buf;
+   int argument_count, offset, n, len;
+   char *key = NULL;
+   char *data;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   int chndle;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, "m_increment");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   mg_readahead_invalidate(p_page, parameter_array, argument_count - 1); /* v3.4.63 */
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   offset = mg_request_header_ex(p_page, p_buf, "I", MG_PRODUCT, &(parameter_array[0]));
+
+   for (n = offset; n < argument_count; n ++) {
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, 0, MG_TX_DATA);
+   }
+
+   MG_MEMCHECK("Insufficient memory to process request", 1);
+
+   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+
+   MG_MEMCHECK("Insufficient memory to process response", 0);
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   if ((n = mg_php_error(p_page, p_buf->p_buffer))) {
+      if (n == 2) {
+         MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
+      }
+      MG_RETURN_FALSE_AND_FREE_BUF;
+   }
+   else {
+      MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer + MG_RECV_HEAD, 1);
+   }
+}
+/* }}} */
+
+
+/* {{{ proto string m_lock([string servername, ]string globalname, mixed keys ..., int timeout)
+   Incrementally lock an M global node: the timeout is in milliseconds (-1 to wait indefinitely) */
+ZEND_FUNCTION(m_lock)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_log_request(p_page, "m_lock");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (2 arguments) */
+   if (argument_count < 2)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_lock_invoke(p_page, return_value, parameter_array, argument_count, 1, 0);
+   mg_stat_end(p_page, 0);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_lock_many([string servername, ]array references, int timeout)
+   Incrementally lock a set of M global nodes: either all of them are locked or (on timeout) none of them */
+ZEND_FUNCTION(m_lock_many)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_log_request(p_page, "m_lock_many");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (2 arguments) */
+   if (argument_count < 2 || argument_count > 3)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_lock_invoke(p_page, return_value, parameter_array, argument_count, 1, 1);
+   mg_stat_end(p_page, 0);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_unlock([string servername, ]string globalname, mixed keys ...)
+   Incrementally unlock an M global node */
+ZEND_FUNCTION(m_unlock)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_log_request(p_page, "m_unlock");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_lock_invoke(p_page, return_value, parameter_array, argument_count, 0, 0);
+   mg_stat_end(p_page, 0);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_unlock_many([string servername, ]array references)
+   Incrementally unlock a set of M global nodes */
+ZEND_FUNCTION(m_unlock_many)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_log_request(p_page, "m_unlock_many");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1 || argument_count > 2)
+      MG_WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_lock_invoke(p_page, return_value, parameter_array, argument_count, 0, 1);
+   mg_stat_end(p_page, 0);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto bool m_unlock_all()
+   Release all the locks acquired (and not yet released) through m_lock() and m_lock_many() in this request */
+ZEND_FUNCTION(m_unlock_all)
+{
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   if (!p_page) {
+      MG_RETURN_FALSE;
+   }
+
+   mg_log_request(p_page, "m_unlock_all");
+
+   mg_lock_release_all(p_page);
+
+   MG_RETURN_TRUE;
+}
+/* }}} */
+
+
+/* {{{ proto string m_tstart([string servername])
+   Start a transaction */
+ZEND_FUNCTION(m_tstart)
+{
+   MGBUF mgbuf, *p_buf;
+   int argument_count, offset, n, len;
+   char *key = NULL;
+   char *data;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   int chndle;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, "m_tstart");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   if (argument_count > 0) {
+      if (zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+          MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+   }
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   offset = mg_request_header_ex(p_page, p_buf, "a", MG_PRODUCT, &(parameter_array[0]));
+
+   for (n = offset; n < argument_count; n ++) {
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, 0, MG_TX_DATA);
+   }
+
+   MG_MEMCHECK("Insufficient memory to process request", 1);
+
+   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+   if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
    }
    mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
@@ -2487,6 +4065,8 @@ ZEND_FUNCTION(m_trollback)
 
    mg_log_request(p_page, "m_trollback");
 
+   p_page->ra.ref.data_size = 0; /* v3.4.63 rolled back updates may be in the readahead window */
+
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
@@ -3548,6 +5128,7 @@ m_proc_ex_retry:
    add_index_string(return_value, 0, data);
 
    mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
 
    return;
 
@@ -4315,6 +5896,8 @@ ZEND_FUNCTION(m_merge_to_db)
       MG_ERROR1(p_page->p_srv->error_mess);
    }
 
+   mg_readahead_invalidate(p_page, parameter_array, argument_count - 2); /* v3.4.63 */
+
    n = mg_db_connect(p_page->p_srv, &chndle, 1);
    if (!n) {
       MG_ERROR1(p_page->p_srv->error_mess);
@@ -4546,16 +6129,16 @@ ZEND_FUNCTION(m_merge_from_db)
 /* }}} */
 
 
-/* {{{ proto string m_return_to_applet(string content)
-   Send content to the client (e.g. AJAX/XMLHTTP) */
-ZEND_FUNCTION(m_return_to_applet)
+/* {{{ proto string m_merge([string servername, ]array to_reference, array from_reference)
+   Merge an M global node (and its descendants) into another within the database: MERGE ^to(...)=^from(...) */
+ZEND_FUNCTION(m_merge)
 {
    MGBUF mgbuf, *p_buf;
-   int argument_count, n, len;
-   char *key = NULL;
-   char *data;
+   short byref, type, native;
+   int argument_count, offset, n, chndle, hlen, size;
+   char server[64];
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
-   int chndle = 0;
+   zval *ref[2];
    MGPAGE *p_page;
 
    p_page = MG_PHP_GLOBAL(p_page);
@@ -4563,799 +6146,5524 @@ ZEND_FUNCTION(m_return_to_applet)
    p_buf = &mgbuf;
    mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
 
-   mg_log_request(p_page, "m_return_to_applet");
+   mg_log_request(p_page, "m_merge");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
-   /* see if it satisfies our minimal request (1 argument) */
-   if (argument_count < 1)
+   /* see if it satisfies our minimal request (2 arguments) */
+   if (argument_count < 2 || argument_count > 3)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
    /* argument count is correct, now retrieve arguments */
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
       MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
-    mg_buf_cpy(p_buf, "\x07", 1);
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   if ((argument_count - offset) != 2)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
-   for (n = 0; n < argument_count; n ++) {
+   for (n = 0; n < 2; n ++) {
+      ref[n] = &(parameter_array[offset + n]);
+      ZVAL_DEREF(ref[n]);
+      if (Z_TYPE_P(ref[n]) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(ref[n])) < 1) {
+         strcpy(p_page->p_srv->error_mess, "The references passed to the 'm_merge()' function must be arrays holding a global name followed by any subscripts");
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+   }
 
-      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+   /* the merge may create nodes anywhere under the target: discard any readahead window */
+   p_page->ra.ref.data_size = 0;
 
-      mg_buf_cat(p_buf, data, len);
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   native = 0;
+   if (!(p_page->p_srv->no_command & MG_NOCMD_MERGE)) {
+      mg_request_header_ex(p_page, p_buf, "R", MG_PRODUCT, &(parameter_array[0]));
+      mg_lock_reference(p_page, p_buf, ref[0], NULL, 0);
+      mg_lock_reference(p_page, p_buf, ref[1], NULL, 0);
+
+      MG_MEMCHECK("Insufficient memory to process request", 1);
+
+      n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+      if (!n) {
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+      mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
 
+      MG_MEMCHECK("Insufficient memory to process response", 0);
+
+      native = 1;
+      /* a DB Superserver without the 'R' command: use the merge commands of m_merge_from_db() and m_merge_to_db() from now on */
+      if (p_page->p_srv->mode != 2 && p_buf->data_size >= MG_RECV_HEAD && !strncmp((char *) p_buf->p_buffer + 5, "ce", 2)) {
+         p_page->p_srv->no_command |= MG_NOCMD_MERGE;
+         native = 0;
+      }
+   }
+   if (!native) {
+      n = mg_merge_records(p_page, chndle, p_buf, ref, &(parameter_array[0]));
+      MG_MEMCHECK("Insufficient memory to process response", 0);
+      if (!n) {
+         mg_db_disconnect(p_page->p_srv, chndle, 1);
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
    }
 
-   p_buf->p_buffer[p_buf->data_size] = '\0';
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
 
-   zend_printf("%s", p_buf->p_buffer);
+   if ((n = mg_php_error(p_page, (char *) p_buf->p_buffer))) {
+      if (n == 2) {
+         MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
+      }
+      MG_RETURN_FALSE_AND_FREE_BUF;
+   }
 
-   MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer, 1);
+   if (!native) {
+      RETVAL_STRINGL("1", 1);
+      mg_buf_free(p_buf);
+      mg_stat_end(p_page, 0);
+      return;
+   }
+
+   size = 0;
+   hlen = 0;
+   if (p_buf->data_size > MG_RECV_HEAD) {
+      hlen = mg_decode_item_header(p_buf->p_buffer + MG_RECV_HEAD, &size, &byref, &type);
+      if (size < 0 || (unsigned long) (MG_RECV_HEAD + hlen + size) > p_buf->data_size) {
+         size = 0;
+      }
+   }
+
+   RETVAL_STRINGL((char *) p_buf->p_buffer + MG_RECV_HEAD + hlen, size);
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+
+   return;
 }
 /* }}} */
 
 
-/* {{{ proto string m_return_to_client(string content)
-   Send content to the client (e.g. AJAX/XMLHTTP) */
-ZEND_FUNCTION(m_return_to_client)
+/* {{{ proto string m_count([string servername, ]array reference[, bool descendants[, int limit]])
+   Count the immediate children of an M global node or (descendants) all the data nodes below it: counting stops at the limit */
+ZEND_FUNCTION(m_count)
 {
-   MGBUF mgbuf, *p_buf;
-   int argument_count, n, len;
-   char *key = NULL;
-   char *data;
+   int argument_count;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
-   int chndle = 0;
    MGPAGE *p_page;
 
    p_page = MG_PHP_GLOBAL(p_page);
 
-   p_buf = &mgbuf;
-   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
-
-   mg_log_request(p_page, "m_return_to_client");
+   mg_log_request(p_page, "m_count");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
    /* see if it satisfies our minimal request (1 argument) */
-   if (argument_count < 1)
-      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+   if (argument_count < 1 || argument_count > 4)
+      MG_WRONG_PARAM_COUNT;
 
    /* argument count is correct, now retrieve arguments */
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
-      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
-
-    mg_buf_cpy(p_buf, "\x07", 1);
-
-   for (n = 0; n < argument_count; n ++) {
-      data = mg_get_string(&(parameter_array[n]), NULL, &len);
-      mg_buf_cat(p_buf, data, len);
-   }
-
-   p_buf->p_buffer[p_buf->data_size] = '\0';
+      MG_WRONG_PARAM_COUNT;
 
-   zend_printf("%s", p_buf->p_buffer);
+   mg_count_invoke(p_page, return_value, parameter_array, argument_count, 0);
+   mg_stat_end(p_page, 0);
 
-   MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer, 1);
+   return;
 }
 /* }}} */
 
 
-/* {{{ proto mixed m_array_test(mixed data...)
-   Internal test function */
-ZEND_FUNCTION(m_array_test)
+/* {{{ proto string m_subtree_size([string servername, ]array reference[, int limit])
+   Total the size (in bytes) of the data values held at and below an M global node: the scan stops once the limit is reached */
+ZEND_FUNCTION(m_subtree_size)
 {
    int argument_count;
-   zval *array;
    zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   mg_log_request(p_page, "m_subtree_size");
 
    /* get the number of arguments */
    argument_count = ZEND_NUM_ARGS();
 
    /* see if it satisfies our minimal request (1 argument) */
-   if (argument_count < 1)
-      WRONG_PARAM_COUNT;
+   if (argument_count < 1 || argument_count > 3)
+      MG_WRONG_PARAM_COUNT;
 
    /* argument count is correct, now retrieve arguments */
    if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
-      WRONG_PARAM_COUNT;
-
-   array = &parameter_array_a[0];
-   ZVAL_DEREF(array);
-   SEPARATE_ARRAY(array);
+      MG_WRONG_PARAM_COUNT;
 
-   add_assoc_string(array, "1", "value 1");
-   add_assoc_string(array, "2", "value 2");
-   add_assoc_string(array, "3", "value 3");
+   mg_count_invoke(p_page, return_value, parameter_array, argument_count, 1);
+   mg_stat_end(p_page, 0);
 
-   RETVAL_NULL();
+   return;
 }
 /* }}} */
 
 
-int mg_type(zval * item)
+/* {{{ proto int m_export([string servername, ]array reference, mixed target[, array options])
+   Export the data nodes at and below an M global node to a stream (or pass them to a callback): the first-level subscripts are divided into partitions that are scanned concurrently */
+ZEND_FUNCTION(m_export)
 {
-   int result;
+   MGBUF *p_buf;
+   MGEXPORT exp;
+   MGEXPART part[MG_EXPORT_MAXPART];
+   int argument_count, offset, argn, n, active, samplen;
+   char server[64];
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   zval *ref, *target, *options, *item;
+   zend_string *str, *sample[MG_EXPORT_SAMPLE];
+   MGPAGE *p_page;
 
-   if (!item)
-      return -1;
+   p_page = MG_PHP_GLOBAL(p_page);
 
-   if (Z_TYPE_P(item) == IS_ARRAY) {
-      result = MG_T_LIST;
+   memset((void *) &exp, 0, sizeof(MGEXPORT));
+   memset((void *) part, 0, sizeof(part));
+   p_buf = &(exp.out);
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+   samplen = 0;
+
+   mg_log_request(p_page, "m_export");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (2 arguments) */
+   if (argument_count < 2 || argument_count > 4)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   argn = argument_count - offset;
+   if (argn < 2 || argn > 3) {
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
    }
-   else {
-      result = MG_T_STRING;
+
+   ref = &(parameter_array[offset]);
+   ZVAL_DEREF(ref);
+   if (Z_TYPE_P(ref) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(ref)) < 1) {
+      strcpy(p_page->p_srv->error_mess, "The reference must be an array holding a global name followed by any subscripts");
+      MG_ERROR1(p_page->p_srv->error_mess);
    }
 
-/*
-      result = MG_T_INTEGER;
-      result = MG_T_FLOAT;
-      result = MG_T_LIST;
-      result = MG_T_VAR;
-*/
-   return result;
-}
+   target = &(parameter_array[offset + 1]);
+   ZVAL_DEREF(target);
+   exp.stream = NULL;
+   if (Z_TYPE_P(target) == IS_RESOURCE) {
+      php_stream_from_zval_no_verify(exp.stream, target);
+   }
+   if (!exp.stream) {
+      if (zend_fcall_info_init(target, 0, &(exp.fci), &(exp.fcc), NULL, NULL) != SUCCESS) {
+         strcpy(p_page->p_srv->error_mess, "The export target must be a stream or a callable");
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+      exp.callback = 1;
+   }
+
+   exp.parts = MG_EXPORT_PARTITIONS;
+   exp.batch = MG_EXPORT_BATCH;
+   exp.format = MG_EXPORT_NDJSON;
+   if (argn > 2) {
+      options = &(parameter_array[offset + 2]);
+      ZVAL_DEREF(options);
+      if (Z_TYPE_P(options) == IS_ARRAY) {
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "partitions", 10))) {
+            exp.parts = (int) zval_get_long(item);
+         }
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "batch", 5))) {
+            exp.batch = (int) zval_get_long(item);
+         }
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "format", 6))) {
+            str = zval_get_string(item);
+            if (!strcmp(ZSTR_VAL(str), "binary")) {
+               exp.format = MG_EXPORT_BINARY;
+            }
+            else if (strcmp(ZSTR_VAL(str), "ndjson")) {
+               zend_string_release(str);
+               strcpy(p_page->p_srv->error_mess, "The export format must be 'ndjson' or 'binary'");
+               MG_ERROR1(p_page->p_srv->error_mess);
+            }
+            zend_string_release(str);
+         }
+      }
+   }
+   if (exp.parts < 1) {
+      exp.parts = 1;
+   }
+   if (exp.parts > MG_EXPORT_MAXPART) {
+      exp.parts = MG_EXPORT_MAXPART;
+   }
+   if (exp.batch < 1) {
+      exp.batch = MG_EXPORT_BATCH;
+   }
+   /* the API binding serves one request at a time */
+   if (p_page->p_srv->mode == 2) {
+      exp.parts = 1;
+   }
 
+   mg_buf_init(&(exp.ref), 256, 256);
+   n = 0;
+   ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(ref), item) {
+      str = zval_get_string(item);
+      mg_request_add(p_page->p_srv, 0, &(exp.ref), (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+      if (n == 0) {
+         exp.global_size = (int) exp.ref.data_size;
+      }
+      else {
+         exp.keyn ++;
+      }
+      zend_string_release(str);
+      n ++;
+   } ZEND_HASH_FOREACH_END();
 
-int mg_get_integer(zval * item)
-{
-   int result;
-   char *ps;
+   /* partition bounds are drawn from a sample of the first-level subscripts */
+   if (exp.parts > 1) {
+      if (!mg_export_sample(p_page, &exp, &(parameter_array[0]), sample, &samplen)) {
+         mg_export_close(&exp, NULL, sample, samplen);
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+      if (samplen < exp.parts) {
+         exp.parts = samplen ? samplen : 1;
+      }
+   }
 
-   convert_to_string_ex(item);
-   ps = Z_STRVAL_P(item);
-   result = (int) strtol(ps, NULL, 10);
+   for (n = 0; n < exp.parts; n ++) {
+      part[n].first = 1;
+      mg_buf_init(&(part[n].seed), 256, 256);
+      mg_buf_init(&(part[n].io), MG_BUFSIZE, MG_BUFSIZE);
+      mg_buf_cpy(&(part[n].seed), (char *) exp.ref.p_buffer, exp.ref.data_size);
+      if (n > 0) {
+         str = sample[(n * samplen) / exp.parts];
+         mg_request_add(p_page->p_srv, 0, &(part[n].seed), (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+      }
+      if (n < (exp.parts - 1)) {
+         part[n].hi = sample[((n + 1) * samplen) / exp.parts];
+      }
+   }
 
-   return result;
-}
+   for (n = 0; n < exp.parts && !exp.stop; n ++) {
+      if (mg_db_connect(p_page->p_srv, &(part[n].chndle), 1)) {
+         part[n].connected = 1;
+      }
+      else {
+         exp.stop = 2;
+      }
+   }
 
+   /* send the next request on every open partition before collecting the responses */
+   while (!exp.stop) {
+      active = 0;
+      for (n = 0; n < exp.parts; n ++) {
+         part[n].sent = 0;
+         if (part[n].eod) {
+            continue;
+         }
+         active ++;
+         part[n].sent = (short) mg_export_send(p_page, &exp, &(part[n]), &(parameter_array[0]));
+         if (!part[n].sent) {
+            exp.stop = 2;
+            break;
+         }
+      }
+      if (!active) {
+         break;
+      }
+      for (n = 0; n < exp.parts; n ++) {
+         if (!part[n].sent) {
+            continue;
+         }
+         /* a batch assembled with the stock commands (sent == 2) is already in the buffer */
+         if (part[n].sent == 1 && !mg_export_receive(p_page, &exp, &(part[n]), &(parameter_array[0]))) {
+            exp.stop = 2;
+         }
+         if (!exp.stop) {
+            mg_export_rows(p_page, &exp, &(part[n]));
+         }
+      }
+   }
 
-double mg_get_float(zval * item)
-{
-   double result;
-   char *ps;
+   if (exp.stop != 2 && !mg_export_flush(&exp)) {
+      strcpy(p_page->p_srv->error_mess, "Unable to write to the export stream");
+      exp.stop = 2;
+   }
 
-   convert_to_string_ex(item);
-   ps = Z_STRVAL_P(item);
-   result = (double) strtod(ps, NULL);
+   for (n = 0; n < exp.parts; n ++) {
+      if (part[n].connected) {
+         mg_db_disconnect(p_page->p_srv, part[n].chndle, (short) (exp.stop == 2 ? 0 : 1));
+      }
+   }
+   mg_export_close(&exp, part, sample, samplen);
 
-   return result;
+   if (exp.stop == 2) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   RETVAL_LONG((long) exp.records);
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+
+   return;
 }
+/* }}} */
 
 
-char * mg_get_string(zval * item, zval * item_tmp, int * size)
+/* {{{ proto int m_import([string servername, ]array reference, mixed source[, array options])
+   Load records from an array, Traversable or NDJSON stream into an M global node: each batch is sorted into M collation order and divided between connections by first subscript */
+ZEND_FUNCTION(m_import)
 {
-   char * result;
+   MGBUF *p_buf;
+   MGIMPORT imp;
+   MGIMPART part[MG_IMPORT_MAXPART];
+   int argument_count, offset, argn, n;
+   size_t len;
+   char server[64];
+   char *line;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   zval *ref, *source, *options, *item;
+   zend_string *str;
+   zend_object_iterator *iter;
+   MGPAGE *p_page;
 
-   result = NULL;
-   *size = 0;
+   p_page = MG_PHP_GLOBAL(p_page);
 
-   convert_to_string_ex(item);
-   result = Z_STRVAL_P(item);
-   *size = (int) strlen(result);
+   memset((void *) &imp, 0, sizeof(MGIMPORT));
+   memset((void *) part, 0, sizeof(part));
+   p_buf = &(imp.line);
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
 
-   return result;
-}
+   mg_log_request(p_page, "m_import");
 
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
 
+   /* see if it satisfies our minimal request (2 arguments) */
+   if (argument_count < 2 || argument_count > 4)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
-int mg_php_error(MGPAGE *p_page, char *buffer)
-{
-   int n;
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
 
-   if (!strncmp(buffer + 5, "ce", 2)) {
-      for (n = MG_RECV_HEAD; buffer[n]; n ++) {
-         if (buffer[n] == '%')
-            buffer[n] = '^';
-      }
-      strcpy(p_page->p_srv->error_mess, buffer + MG_RECV_HEAD);
-      MG_ERROR2(p_page->p_srv->error_mess);
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   argn = argument_count - offset;
+   if (argn < 2 || argn > 3) {
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
    }
-   else
-      return 0;
-}
 
+   ref = &(parameter_array[offset]);
+   ZVAL_DEREF(ref);
+   if (Z_TYPE_P(ref) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(ref)) < 1) {
+      strcpy(p_page->p_srv->error_mess, "The reference must be an array holding a global name followed by any subscripts");
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
 
+   source = &(parameter_array[offset + 1]);
+   ZVAL_DEREF(source);
+   imp.stream = NULL;
+   if (Z_TYPE_P(source) == IS_RESOURCE) {
+      php_stream_from_zval_no_verify(imp.stream, source);
+   }
+   if (!imp.stream && Z_TYPE_P(source) != IS_ARRAY && !(Z_TYPE_P(source) == IS_OBJECT && Z_OBJCE_P(source)->get_iterator)) {
+      strcpy(p_page->p_srv->error_mess, "The import source must be an array, a Traversable object or a stream");
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
 
-int mg_get_input_arguments(int argument_count, zval *parameter_array[])
-{
-   int n;
+   imp.parts = MG_IMPORT_PARTITIONS;
+   imp.batch = MG_IMPORT_BATCH;
+   imp.tp = 1;
+   if (argn > 2) {
+      options = &(parameter_array[offset + 2]);
+      ZVAL_DEREF(options);
+      if (Z_TYPE_P(options) == IS_ARRAY) {
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "partitions", 10))) {
+            imp.parts = (int) zval_get_long(item);
+         }
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "batch", 5))) {
+            imp.batch = (int) zval_get_long(item);
+         }
+         if ((item = zend_hash_str_find(Z_ARRVAL_P(options), "transactions", 12))) {
+            imp.tp = zend_is_true(item) ? 1 : 0;
+         }
+      }
+   }
+   if (imp.parts < 1) {
+      imp.parts = 1;
+   }
+   if (imp.parts > MG_IMPORT_MAXPART) {
+      imp.parts = MG_IMPORT_MAXPART;
+   }
+   if (imp.batch < 1) {
+      imp.batch = MG_IMPORT_BATCH;
+   }
+   if (imp.batch > MG_IMPORT_MAXBATCH) {
+      imp.batch = MG_IMPORT_MAXBATCH;
+   }
+   /* the API binding serves one request at a time */
+   if (p_page->p_srv->mode == 2) {
+      imp.parts = 1;
+   }
 
-   switch (argument_count) {
+   mg_buf_init(&(imp.ref), 256, 256);
+   ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(ref), item) {
+      str = zval_get_string(item);
+      mg_request_add(p_page->p_srv, 0, &(imp.ref), (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+      zend_string_release(str);
+   } ZEND_HASH_FOREACH_END();
+
+   imp.rec = (MGIMPREC *) emalloc(sizeof(MGIMPREC) * imp.batch);
+   imp.keymax = imp.batch * 4;
+   imp.key = (MGIMPKEY *) emalloc(sizeof(MGIMPKEY) * imp.keymax);
+
+   for (n = 0; n < imp.parts; n ++) {
+      mg_buf_init(&(part[n].io), MG_BUFSIZE, MG_BUFSIZE);
+   }
+   for (n = 0; n < imp.parts && !imp.stop; n ++) {
+      if (mg_db_connect(p_page->p_srv, &(part[n].chndle), 1)) {
+         part[n].connected = 1;
+      }
+      else {
+         imp.stop = 2;
+      }
+   }
+
+   if (imp.stop) {
+      ;
+   }
+   else if (imp.stream) {
+      while (!imp.stop && (line = php_stream_get_line(imp.stream, NULL, 0, &len))) {
+         mg_import_json(p_page, &imp, part, &(parameter_array[0]), line, len);
+         efree((void *) line);
+      }
+   }
+   else if (Z_TYPE_P(source) == IS_ARRAY) {
+      ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(source), item) {
+         if (!mg_import_add(p_page, &imp, part, &(parameter_array[0]), item)) {
+            break;
+         }
+      } ZEND_HASH_FOREACH_END();
+   }
+   else {
+      iter = Z_OBJCE_P(source)->get_iterator(Z_OBJCE_P(source), source, 0);
+      if (iter) {
+         if (iter->funcs->rewind) {
+            iter->funcs->rewind(iter);
+         }
+         while (!EG(exception) && iter->funcs->valid(iter) == SUCCESS) {
+            item = iter->funcs->get_current_data(iter);
+            if (EG(exception) || !item || !mg_import_add(p_page, &imp, part, &(parameter_array[0]), item)) {
+               break;
+            }
+            iter->funcs->move_forward(iter);
+         }
+         zend_iterator_dtor(iter);
+      }
+      if (EG(exception) && !imp.stop) {
+         imp.stop = 1;
+      }
+   }
+
+   /* the final (part) batch */
+   if (!imp.stop && imp.recn) {
+      mg_import_batch(p_page, &imp, part, &(parameter_array[0]));
+   }
+
+   p_page->ra.ref.data_size = 0;
+
+   for (n = 0; n < imp.parts; n ++) {
+      if (part[n].connected) {
+         mg_db_disconnect(p_page->p_srv, part[n].chndle, (short) (imp.stop == 2 ? 0 : 1));
+      }
+      mg_buf_free(&(part[n].io));
+   }
+   mg_import_release(&imp);
+   efree((void *) imp.rec);
+   efree((void *) imp.key);
+   mg_buf_free(&(imp.ref));
+
+   if (imp.stop == 2) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   RETVAL_LONG((long) imp.records);
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto string m_return_to_applet(string content)
+   Send content to the client (e.g. AJAX/XMLHTTP) */
+ZEND_FUNCTION(m_return_to_applet)
+{
+   MGBUF mgbuf, *p_buf;
+   int argument_count, n, len;
+   char *key = NULL;
+   char *data;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   int chndle = 0;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, "m_return_to_applet");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+    mg_buf_cpy(p_buf, "\x07", 1);
+
+   for (n = 0; n < argument_count; n ++) {
+
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+
+      mg_buf_cat(p_buf, data, len);
+
+   }
+
+   p_buf->p_buffer[p_buf->data_size] = '\0';
+
+   zend_printf("%s", p_buf->p_buffer);
+
+   MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer, 1);
+}
+/* }}} */
+
+
+/* {{{ proto string m_return_to_client(string content)
+   Send content to the client (e.g. AJAX/XMLHTTP) */
+ZEND_FUNCTION(m_return_to_client)
+{
+   MGBUF mgbuf, *p_buf;
+   int argument_count, n, len;
+   char *key = NULL;
+   char *data;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   int chndle = 0;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, "m_return_to_client");
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+
+    mg_buf_cpy(p_buf, "\x07", 1);
+
+   for (n = 0; n < argument_count; n ++) {
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_buf_cat(p_buf, data, len);
+   }
+
+   p_buf->p_buffer[p_buf->data_size] = '\0';
+
+   zend_printf("%s", p_buf->p_buffer);
+
+   MG_RETURN_STRING_AND_FREE_BUF(p_buf->p_buffer, 1);
+}
+/* }}} */
+
+
+/* {{{ proto mixed m_array_test(mixed data...)
+   Internal test function */
+ZEND_FUNCTION(m_array_test)
+{
+   int argument_count;
+   zval *array;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+
+   /* get the number of arguments */
+   argument_count = ZEND_NUM_ARGS();
+
+   /* see if it satisfies our minimal request (1 argument) */
+   if (argument_count < 1)
+      WRONG_PARAM_COUNT;
+
+   /* argument count is correct, now retrieve arguments */
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      WRONG_PARAM_COUNT;
+
+   array = &parameter_array_a[0];
+   ZVAL_DEREF(array);
+   SEPARATE_ARRAY(array);
+
+   add_assoc_string(array, "1", "value 1");
+   add_assoc_string(array, "2", "value 2");
+   add_assoc_string(array, "3", "value 3");
+
+   RETVAL_NULL();
+}
+/* }}} */
+
+
+/* {{{ proto object Mg\Cursor::__construct(array reference[, array options])
+   Create a cursor over the subscripts at the level immediately below an M global node */
+ZEND_METHOD(MgCursor, __construct)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   argument_count = ZEND_NUM_ARGS();
+
+   if (argument_count < 1 || argument_count > 2)
+      MG_WRONG_PARAM_COUNT;
+
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_cursor_init(p_page, mg_cursor_fetch(Z_OBJ_P(getThis())), &(parameter_array[0]), argument_count > 1 ? &(parameter_array[1]) : NULL, MG_CURSOR_ORDER);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto void Mg\Cursor::rewind()
+   Position the cursor at the first subscript (fetching the first batch) */
+ZEND_METHOD(MgCursor, rewind)
+{
+   int n;
+   zval seed;
+   MGPAGE *p_page;
+   MGCURSOR *p_cursor;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   p_cursor->eod = 0;
+   if (p_cursor->type == MG_CURSOR_ORDER && p_cursor->start && ZSTR_LEN(p_cursor->start)) {
+      ZVAL_STRINGL(&seed, ZSTR_VAL(p_cursor->start), ZSTR_LEN(p_cursor->start));
+      n = mg_cursor_fill(p_page, p_cursor, &seed, 1);
+      zval_ptr_dtor(&seed);
+   }
+   else {
+      n = mg_cursor_fill(p_page, p_cursor, NULL, 0);
+   }
+   if (!n) {
+      mg_cursor_error(p_page, p_page->p_srv->error_mess);
+   }
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto bool Mg\Cursor::valid()
+   Determine whether the cursor is positioned on a subscript */
+ZEND_METHOD(MgCursor, valid)
+{
+   MGCURSOR *p_cursor;
+
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   if (p_cursor->row_no < p_cursor->row_max) {
+      MG_RETURN_TRUE;
+   }
+   MG_RETURN_FALSE;
+}
+/* }}} */
+
+
+/* {{{ proto mixed Mg\Cursor::current()
+   Return the data value (or, in keys-only mode, the $Data value) at the current subscript */
+ZEND_METHOD(MgCursor, current)
+{
+   zval *item;
+   MGCURSOR *p_cursor;
+
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   if (p_cursor->type == MG_CURSOR_GLOBALS)
+      item = mg_cursor_item(p_cursor, 0);
+   else if (p_cursor->type == MG_CURSOR_QUERY)
+      item = mg_cursor_item(p_cursor, 1);
+   else
+      item = mg_cursor_item(p_cursor, p_cursor->getvalue ? 2 : 1);
+   if (item) {
+      RETURN_ZVAL(item, 1, 0);
+   }
+   RETURN_NULL();
+}
+/* }}} */
+
+
+/* {{{ proto mixed Mg\Cursor::key()
+   Return the current subscript (or, for Mg\Query, the array of subscripts) */
+ZEND_METHOD(MgCursor, key)
+{
+   zval *item;
+   MGCURSOR *p_cursor;
+
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   item = mg_cursor_item(p_cursor, 0);
+   if (item) {
+      RETURN_ZVAL(item, 1, 0);
+   }
+   RETURN_NULL();
+}
+/* }}} */
+
+
+/* {{{ proto void Mg\Cursor::next()
+   Advance the cursor, fetching the next batch from the DB Server when the current batch is exhausted */
+ZEND_METHOD(MgCursor, next)
+{
+   int n;
+   zval *item;
+   zval seed;
+   MGPAGE *p_page;
+   MGCURSOR *p_cursor;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   if (p_cursor->row_no >= p_cursor->row_max) {
+      return;
+   }
+   p_cursor->row_no ++;
+   if (p_cursor->row_no < p_cursor->row_max || p_cursor->eod) {
+      return;
+   }
+
+   p_cursor->row_no = p_cursor->row_max - 1;
+   item = mg_cursor_item(p_cursor, 0);
+   p_cursor->row_no = p_cursor->row_max;
+   if (!item) {
+      return;
+   }
+   ZVAL_COPY(&seed, item);
+   n = mg_cursor_fill(p_page, p_cursor, &seed, 0);
+   zval_ptr_dtor(&seed);
+   if (!n) {
+      mg_cursor_error(p_page, p_page->p_srv->error_mess);
+   }
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto int Mg\Cursor::data()
+   Return the $Data value at the current subscript */
+ZEND_METHOD(MgCursor, data)
+{
+   zval *item;
+   MGCURSOR *p_cursor;
+
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+
+   item = mg_cursor_item(p_cursor, 1);
+   if (item) {
+      RETURN_ZVAL(item, 1, 0);
+   }
+   RETURN_NULL();
+}
+/* }}} */
+
+
+/* {{{ proto object Mg\Query::__construct(array reference[, array options])
+   Create an iterator over every data node under an M global node: keys are arrays of subscripts */
+ZEND_METHOD(MgQuery, __construct)
+{
+   int argument_count;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   MGPAGE *p_page;
+
+   p_page = MG_PHP_GLOBAL(p_page);
+
+   argument_count = ZEND_NUM_ARGS();
+
+   if (argument_count < 1 || argument_count > 2)
+      MG_WRONG_PARAM_COUNT;
+
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   mg_cursor_init(p_page, mg_cursor_fetch(Z_OBJ_P(getThis())), &(parameter_array[0]), argument_count > 1 ? &(parameter_array[1]) : NULL, MG_CURSOR_QUERY);
+
+   return;
+}
+/* }}} */
+
+
+/* {{{ proto object Mg\Globals::__construct([string prefix[, array options]])
+   Create an iterator over the global directory: keys and values are global names */
+ZEND_METHOD(MgGlobals, __construct)
+{
+   int argument_count, n;
+   zval	parameter_array_a[MG_MAXARG] = {0}, *parameter_array = parameter_array_a;
+   zval *item;
+   zend_string *str;
+   MGCURSOR *p_cursor;
+
+   argument_count = ZEND_NUM_ARGS();
+
+   if (argument_count > 2)
+      MG_WRONG_PARAM_COUNT;
+
+   if(zend_get_parameters_array_ex(argument_count, parameter_array) != SUCCESS)
+      MG_WRONG_PARAM_COUNT;
+
+   p_cursor = mg_cursor_fetch(Z_OBJ_P(getThis()));
+   p_cursor->type = MG_CURSOR_GLOBALS;
+
+   if (argument_count > 0 && Z_TYPE(parameter_array[0]) != IS_NULL) {
+      p_cursor->start = zval_get_string(&(parameter_array[0]));
+   }
+   if (argument_count > 1 && Z_TYPE(parameter_array[1]) == IS_ARRAY) {
+      if ((item = zend_hash_str_find(Z_ARRVAL(parameter_array[1]), "batch", 5))) {
+         n = (int) zval_get_long(item);
+         p_cursor->batch = (n > 0) ? n : MG_CURSOR_BATCH;
+      }
+      if ((item = zend_hash_str_find(Z_ARRVAL(parameter_array[1]), "server", 6))) {
+         str = zval_get_string(item);
+         if (ZSTR_LEN(str) < sizeof(p_cursor->server)) {
+            strcpy(p_cursor->server, ZSTR_VAL(str));
+         }
+         zend_string_release(str);
+      }
+   }
+
+   return;
+}
+/* }}} */
+
+
+int mg_type(zval * item)
+{
+   int result;
+
+   if (!item)
+      return -1;
+
+   if (Z_TYPE_P(item) == IS_ARRAY) {
+      result = MG_T_LIST;
+   }
+   else {
+      result = MG_T_STRING;
+   }
+
+/*
+      result = MG_T_INTEGER;
+      result = MG_T_FLOAT;
+      result = MG_T_LIST;
+      result = MG_T_VAR;
+*/
+   return result;
+}
+
+
+int mg_get_integer(zval * item)
+{
+   int result;
+   char *ps;
+
+   convert_to_string_ex(item);
+   ps = Z_STRVAL_P(item);
+   result = (int) strtol(ps, NULL, 10);
+
+   return result;
+}
+
+
+double mg_get_float(zval * item)
+{
+   double result;
+   char *ps;
+
+   convert_to_string_ex(item);
+   ps = Z_STRVAL_P(item);
+   result = (double) strtod(ps, NULL);
+
+   return result;
+}
+
+
+char * mg_get_string(zval * item, zval * item_tmp, int * size)
+{
+   char * result;
+
+   result = NULL;
+   *size = 0;
+
+   convert_to_string_ex(item);
+   result = Z_STRVAL_P(item);
+   *size = (int) strlen(result);
+
+   return result;
+}
+
+
+
+int mg_php_error(MGPAGE *p_page, char *buffer)
+{
+   int n;
+
+   if (!strncmp(buffer + 5, "ce", 2)) {
+      for (n = MG_RECV_HEAD; buffer[n]; n ++) {
+         if (buffer[n] == '%')
+            buffer[n] = '^';
+      }
+      strcpy(p_page->p_srv->error_mess, buffer + MG_RECV_HEAD);
+      MG_ERROR2(p_page->p_srv->error_mess);
+   }
+   else
+      return 0;
+}
+
+
+
+int mg_get_input_arguments(int argument_count, zval *parameter_array[])
+{
+   int n;
+
+   switch (argument_count) {
       case 1:
          n = zend_parse_parameters(argument_count, "z/", &parameter_array[0]);
          break;
-      case 2:
-         n = zend_parse_parameters(argument_count, "z/z/", &parameter_array[0], &parameter_array[1]);
+      case 2:
+         n = zend_parse_parameters(argument_count, "z/z/", &parameter_array[0], &parameter_array[1]);
+         break;
+      case 3:
+         n = zend_parse_parameters(argument_count, "z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2]);
+         break;
+      case 4:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3]);
+         break;
+      case 5:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4]);
+         break;
+      case 6:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5]);
+         break;
+      case 7:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6]);
+         break;
+      case 8:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7]);
+         break;
+      case 9:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8]);
+         break;
+      case 10:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9]);
+         break;
+      case 11:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10]);
+         break;
+      case 12:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11]);
+         break;
+      case 13:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12]);
+         break;
+      case 14:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13]);
+         break;
+      case 15:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13], &parameter_array[14]);
+         break;
+      case 16:
+         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13], &parameter_array[14], &parameter_array[15]);
+         break;
+      default:
+         n = FAILURE;
+         break;
+   }
+   return n;
+}
+
+
+static const char *mg_array_lookup_string(HashTable *ht, const char *idx)
+{
+   zval *pvalue;
+   zend_string *key;
+
+   key = zend_string_init(idx, strlen(idx), 0);
+   if (ht && (pvalue = zend_hash_find(ht, key))) {
+      SEPARATE_ZVAL(pvalue);
+      convert_to_string_ex(pvalue);
+      zend_string_release(key);
+      return Z_STRVAL_P(pvalue);
+   }
+
+   return 0;
+}
+
+
+int mg_array_add_record(zval *ppa, MGAREC * p_arec, int mode)
+{
+   int kn;
+   unsigned long index;
+	zval *pk[MG_MAXKEY];
+   zval *zv = NULL;
+   zval *ppk[MG_MAXKEY];
+   HashTable *ht[MG_MAXKEY];
+
+/* v3.3.59 */
+#if PHP_MAJOR_VERSION >= 8
+#else
+   TSRMLS_FETCH();
+#endif
+
+   if (p_arec->kn < 1) {
+      return 0;
+   }
+
+   mg_array_terminate_strings(p_arec);
+
+   for (kn = 0; p_arec->krec[kn]; kn ++) {
+      p_arec->krec_ex[kn] = zend_string_init(p_arec->krec[kn], strlen(p_arec->krec[kn]), 0);
+   }
+
+   ppk[0] = ppa;
+   for (kn = 0; p_arec->krec[kn]; kn ++) {
+      if (!p_arec->krec[kn + 1]) {
+         add_assoc_string(ppk[kn], p_arec->krec[kn], p_arec->vrec);
+         break;
+      }
+
+	   ht[kn] = HASH_OF(ppk[kn]);
+
+      zv = NULL;
+      if (!strcmp(p_arec->krec[kn], "0")) {
+         index = 0;
+         zv = zend_hash_index_find(ht[kn], index);
+         if (zv == NULL) {
+            zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
+         }
+      }
+      else {
+         index = (int) strtol(p_arec->krec[kn], NULL, 10);
+         if (index != 0) {
+            zv = zend_hash_index_find(ht[kn], index);
+            if (zv == NULL) {
+               zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
+            }
+         }
+         else {
+            zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
+         }
+      }
+/*
+      zend_printf("\r\n*** NEW zend_hash_find: kn=%d; ht[kn]=%p; p_arec->krec[kn]=%s; ppk[kn]=%p; zv=%p", kn, ht[kn], p_arec->krec[kn], ppk[kn], zv);
+*/
+      if (ht[kn] && zv != NULL) {
+         ppk[kn] = zv;
+         if (Z_TYPE_P(ppk[kn]) == IS_ARRAY) {
+            ppk[kn + 1] = ppk[kn];
+         }
+         else {
+/*
+	         MAKE_STD_ZVAL(pk[kn + 1]);
+            ZVAL_NEW_EMPTY_REF(pk[kn + 1]);
+*/
+            pk[kn + 1] = emalloc(sizeof(zval));
+            ppk[kn + 1] = pk[kn + 1];
+	         array_init(ppk[kn + 1]);
+            add_assoc_zval(ppk[kn], p_arec->krec[kn], ppk[kn + 1]);
+         }
+	   }
+      else {
+         pk[kn + 1] = emalloc(sizeof(zval));
+         ppk[kn + 1] = pk[kn + 1];
+	      array_init(ppk[kn + 1]);
+         add_assoc_zval(ppk[kn], p_arec->krec[kn], ppk[kn + 1]);
+      }
+
+   }
+
+   for (kn = 0; p_arec->krec[kn]; kn ++) {
+      zend_string_release(p_arec->krec_ex[kn]);
+   }
+
+   mg_array_reset_strings(p_arec);
+
+   return 1;
+
+}
+
+
+int mg_akey_init(MGAKEY *p_akey)
+{
+   int n;
+
+   for (n = 0; n < MG_MAXKEY; n ++) {
+      p_akey->krec[n] = NULL;
+      p_akey->ksize[n] = 0;
+      p_akey->kmemsize[n] = 0;
+      p_akey->zval_subarray[n] = NULL;
+   }
+   p_akey->kn = 0;
+   p_akey->zval_array = NULL;
+   return 0;
+}
+
+
+int mg_akey_free(MGAKEY *p_akey)
+{
+   int n;
+
+   for (n = 0; n < MG_MAXKEY; n ++) {
+      if (p_akey->krec[n]) {
+         mg_free((void *) p_akey->krec[n], 0);
+      }
+      p_akey->krec[n] = NULL;
+      p_akey->ksize[n] = 0;
+      p_akey->kmemsize[n] = 0;
+   }
+
+   return 0;
+}
+
+
+zval * mg_array_subarray_zval(MGAKEY *p_akey, MGAREC * p_arec)
+{
+   int n, kn, newsub;
+
+   if (p_arec->kn < 2) {
+      return p_akey->zval_array;
+   }
+
+   for (kn = 0; kn < (p_arec->kn - 1); kn ++) {
+      newsub = 0;
+      if (p_akey->zval_subarray[kn] == NULL) {
+         newsub = 1;
+      }
+      else if (p_akey->ksize[kn] == 0) {
+         newsub = 1;
+      }
+      else if (p_akey->ksize[kn] != p_arec->ksize[kn] || strcmp(p_akey->krec[kn], p_arec->krec[kn])) {
+         /*
+         zend_printf("\r\n   ===> Difference at kn=%d; p_akey->ksize[kn]=%d; p_arec->ksize[kn]=%d; p_akey->krec[kn]=%s; p_arec->krec[kn]=%s;", kn, p_akey->ksize[kn], p_arec->ksize[kn], p_akey->krec[kn], p_arec->krec[kn]);
+         */
+         newsub = 1;
+      }
+
+      if (newsub) {
+
+         p_akey->zval_subarray[kn + 1] = (zval *) emalloc(sizeof(zval));
+         array_init(p_akey->zval_subarray[kn + 1]);
+
+         add_assoc_zval(p_akey->zval_subarray[kn], p_arec->krec[kn], p_akey->zval_subarray[kn + 1]);
+         /*
+         zend_printf("\r\n      ===> New PHP array at kn=%d; zval=%p; name=%s; new_array=%p;", kn, p_akey->zval_subarray[kn], p_arec->krec[kn], p_akey->zval_subarray[kn + 1]);
+         */
+         /*
+         zend_printf("\r\n      ===> New PHP array at kn=%d; p_akey->ksize[kn]=%d; p_arec->ksize[kn]=%d; p_akey->krec[kn]=%s; p_arec->krec[kn]=%s;", kn, p_akey->ksize[kn], p_arec->ksize[kn], p_akey->krec[kn], p_arec->krec[kn]);
+         */
+         for (n = kn + 1; n < MG_MAXKEY; n ++) {
+            p_akey->ksize[n] = 0;
+         }
+
+         if (p_akey->kmemsize[kn] < (p_arec->ksize[kn] + 32)) {
+            p_akey->kmemsize[kn] = p_arec->ksize[kn] + 126;
+            p_akey->krec[kn] = (unsigned char *) mg_malloc(p_akey->kmemsize[kn] * sizeof(char), 0);
+            if (!p_akey->krec[kn]) {
+               return NULL;
+            }
+         }
+
+         memcpy(p_akey->krec[kn], p_arec->krec[kn], p_arec->ksize[kn]);
+         p_akey->krec[kn][p_arec->ksize[kn]] = '\0';
+         p_akey->ksize[kn] = p_arec->ksize[kn];
+      }
+   }
+
+   /*
+   zend_printf("\r\n =========> sub array p_arec->kn=%d; p_arec->krec[kn-1]=%s; subarray=%p", p_arec->kn, p_arec->krec[kn-1], p_akey->zval_subarray[p_arec->kn - 1]); 
+   */
+
+   return p_akey->zval_subarray[p_arec->kn - 1];
+}
+
+
+int mg_array_terminate_strings(MGAREC * p_arec)
+{
+   int kn;
+
+   p_arec->krec[p_arec->kn] = NULL;
+   for (kn = 0; kn < p_arec->kn; kn ++) {
+      p_arec->kz[kn] = *(p_arec->krec[kn] + p_arec->ksize[kn]);
+      *(p_arec->krec[kn] + p_arec->ksize[kn]) = '\0';
+   }
+   p_arec->vz = *(p_arec->vrec + p_arec->vsize);
+   *(p_arec->vrec + p_arec->vsize) = '\0';
+
+   return 0;
+}
+
+
+int mg_array_reset_strings(MGAREC * p_arec)
+{
+   int kn;
+
+   for (kn = 0; kn < p_arec->kn; kn ++) {
+      *(p_arec->krec[kn] + p_arec->ksize[kn]) = p_arec->kz[kn];
+   }
+   *(p_arec->vrec + p_arec->vsize) = p_arec->vz;
+
+   return 0;
+}
+
+
+int mg_array_parse(MGPAGE *p_page, int chndle, zval *ppa, MGBUF *p_buf, int mode, short byref)
+{
+   short phase;
+   unsigned long num_key;		
+   int rc, type, string_key_len;
+   zval *current;
+   char *string_key = NULL;
+   char *string_data = NULL;
+   zend_string *string_key_ex = NULL;
+   char num[32];
+   MGAKEYX *p_keyx;
+
+   phase = 0;
+
+#ifdef _WIN32
+__try {
+#endif
+
+   rc = 1;
+   p_keyx = (MGAKEYX *) mg_malloc(sizeof(MGAKEYX) + MG_MAXKEYLEN + 32, 0);
+   if (!p_keyx) {
+      return 0;
+   }
+   memset((void *) p_keyx, 0, (sizeof(MGAKEYX) + MG_MAXKEYLEN + 32));
+   p_keyx->krec[0] = ((unsigned char *) p_keyx) + sizeof(MGAKEYX);
+   p_keyx->kmemoffs[0] = 0;
+
+/* v3.3.59 */
+#if PHP_MAJOR_VERSION >= 8
+#else
+   TSRMLS_FETCH();
+#endif
+
+   phase = 1;
+   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, byref, MG_TX_AREC);
+
+   p_keyx->kn = 0;
+   p_keyx->ht[p_keyx->kn] = HASH_OF(ppa);
+   phase = 2;
+   zend_hash_internal_pointer_reset_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+
+   phase = 3;
+   for (;;) {
+      phase = 4;
+      current = zend_hash_get_current_data_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+      if (current == NULL) {
+         if (p_keyx->kn) {
+            p_keyx->kn --;
+            phase = 5;
+            zend_hash_move_forward_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+            continue;
+         }
+         else {
+            break;
+         }
+      }
+
+      if (Z_TYPE_P(current) == IS_ARRAY) {
+         string_key_ex = NULL;
+         string_key = NULL;
+
+         phase = 6;
+	      type = zend_hash_get_current_key_ex(p_keyx->ht[p_keyx->kn], &string_key_ex, (zend_ulong *) &num_key, &(p_keyx->hp[p_keyx->kn]));
+         if (string_key_ex) {
+            string_key = ZSTR_VAL(string_key_ex);
+            string_key_len = (int) strlen(string_key);
+         }
+         else {
+            sprintf(num, "%lu", num_key);
+            string_key = num;
+            string_key_len = (int) strlen(string_key);
+         }
+         /* zend_printf("\r\np_keyx->kn=%d; string_key=%s;", p_keyx->kn, string_key); */
+         if (p_keyx->kn > 0) {
+            p_keyx->krec[p_keyx->kn] = p_keyx->krec[0] + p_keyx->kmemoffs[p_keyx->kn];
+         }
+         p_keyx->kmemoffs[p_keyx->kn + 1] = p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 1;
+         if ((p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 32) > MG_MAXKEYLEN) {
+            sprintf(p_page->p_srv->error_mess, "Total length of keys may not exceed %d Bytes", MG_MAXKEYLEN - 32);
+            rc = 0;
+            break;
+         }
+         if ((p_keyx->kn + 2) > MG_MAXKEY) {
+            sprintf(p_page->p_srv->error_mess, "Total number of keys (nested arrays) may not exceed %d", MG_MAXKEY - 2);
+            rc = 0;
+            break;
+         }
+         strcpy(p_keyx->krec[p_keyx->kn], string_key);
+         p_keyx->ksize[p_keyx->kn] = string_key_len;
+         p_keyx->kn ++;
+	      p_keyx->ht[p_keyx->kn] = HASH_OF(current);
+
+         phase = 7;
+         zend_hash_internal_pointer_reset_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+         continue;
+      }
+      else {
+		   SEPARATE_ZVAL(current);
+         convert_to_string_ex(current);
+         string_key_ex = NULL;
+         string_key = NULL;
+         phase = 8;
+	      type = zend_hash_get_current_key_ex(p_keyx->ht[p_keyx->kn], &string_key_ex, (zend_ulong *) &num_key, &(p_keyx->hp[p_keyx->kn]));
+         string_data = Z_STRVAL_P(current);
+         if (string_key_ex) {
+            string_key = ZSTR_VAL(string_key_ex);
+            if (string_data) {
+               string_key_len = (int) strlen(string_key);
+            }
+            else {
+               strcpy(num, "");
+               string_key = num;
+               string_key_len = (int) strlen(string_key);
+            }
+         }
+         else {
+            sprintf(num, "%lu", num_key);
+            string_key = num;
+            string_key_len = (int) strlen(string_key);
+         }
+
+         if (p_keyx->kn > 0) {
+            p_keyx->krec[p_keyx->kn] = p_keyx->krec[0] + p_keyx->kmemoffs[p_keyx->kn];
+         }
+         p_keyx->kmemoffs[p_keyx->kn + 1] = p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 1;
+         if ((p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 32) > MG_MAXKEYLEN) {
+            sprintf(p_page->p_srv->error_mess, "Total length of keys may not exceed %d Bytes", MG_MAXKEYLEN - 32);
+            rc = 0;
+            break;
+         }
+         strcpy(p_keyx->krec[p_keyx->kn], string_key);
+         p_keyx->ksize[p_keyx->kn] = string_key_len;
+
+         mg_array_add_node(p_page, chndle, p_buf, p_keyx->krec, p_keyx->ksize, p_keyx->kn + 1, (unsigned char *) string_data, string_data ? (int) strlen(string_data) : 0, byref);
+         phase = 9;
+         zend_hash_move_forward_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+      }
+
+   }
+
+   phase = 99;
+   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, byref, MG_TX_EOD);
+
+   if (p_keyx) {
+      mg_free((void *) p_keyx, 0);
+   }
+
+   return rc;
+
+#ifdef _WIN32
+}
+__except (EXCEPTION_EXECUTE_HANDLER ) {
+
+   DWORD code;
+
+   __try {
+      code = GetExceptionCode();
+      if (p_page) {
+         sprintf(p_page->p_srv->error_mess, "Exception caught in f:mg_array_parse: %x|%d", code, phase);
+      }
+   }
+   __except (EXCEPTION_EXECUTE_HANDLER ) {
+      ;
+   }
+
+   return 0;
+}
+#endif
+
+}
+
+
+/* Add one node of an array record (its keys followed by any data) to the request */
+
+int mg_array_add_node(MGPAGE *p_page, int chndle, MGBUF *p_buf, unsigned char **key, int *ksize, int keyn, unsigned char *data, int len, short byref)
+{
+   int n;
+
+   for (n = 0; n < keyn; n ++) {
+      mg_request_add(p_page->p_srv, chndle, p_buf, key[n], ksize[n], byref, MG_TX_AKEY);
+   }
+   if (data) {
+      mg_request_add(p_page->p_srv, chndle, p_buf, data, len, byref, MG_TX_DATA);
+   }
+
+   return 1;
+}
+
+
+int mg_request_header_ex(MGPAGE *p_page, MGBUF *p_buf, char *command, char *product, zval *parg0)
+{
+   int offset;
+#if !defined(MG_PHP_MGW)
+   int len;
+   char *data;
+#endif
+
+   offset = 0;
+
+   /* for mg_php */
+#if !defined(MG_PHP_MGW)
+   if (Z_TYPE_P(parg0) == IS_STRING) {
+      data = mg_get_string(parg0, NULL, &len);
+      if (data && len) {
+         if (!strstr(data, "^") && !strstr(data, "$") && !strstr(data,".")) {
+            offset = 1;
+            strcpy(p_page->p_srv->server, data);
+         }
+      }
+   }
+#endif
+
+   mg_request_header(p_page->p_srv, p_buf, command, MG_PRODUCT);
+   strcpy(p_page->p_srv->server, p_page->server_base);
+
+   return offset;
+}
+
+
+void * mg_ext_malloc(unsigned long size)
+{
+   void *p;
+
+   p = NULL;
+
+#ifdef MG_EMALLOC
+   p = emalloc(size);
+#else
+#ifdef _WIN32
+   p = (void *) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size + 32);
+#else
+   p =  malloc(size);
+#endif
+#endif
+
+   return p;
+}
+
+
+void * mg_ext_realloc(void *p_buffer, unsigned long size)
+{
+   void *p;
+
+   p = NULL;
+
+#ifdef MG_EMALLOC
+   p = erealloc((void *) p_buffer, size);
+#else
+#ifdef _WIN32
+   p = (void *) HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (LPVOID) p_buffer, size + 32);
+#else
+   p = realloc(p_buffer, size);
+#endif
+#endif
+   return p;
+}
+
+
+int mg_ext_free(void *p_buffer)
+{
+#ifdef MG_EMALLOC
+   efree((void *) p_buffer);
+#else
+#ifdef _WIN32
+   HeapFree(GetProcessHeap(), 0, p_buffer);
+#else
+   free((void *) p_buffer);
+#endif
+#endif
+   return 1;
+}
+
+
+int mg_log_request(MGPAGE *p_page, char *function)
+{
+   char *p;
+   char buffer[32];
+
+   MG_PROBE1(function__entry, function); /* v3.4.63 */
+   mg_stat_begin(p_page, function);
+
+   MG_PHP_GLOBAL(fun_no) ++;
+   p_page->p_log->req_no = MG_PHP_GLOBAL(req_no);
+   p_page->p_log->fun_no = MG_PHP_GLOBAL(fun_no);
+   p_page->p_log->log_errors = 0;
+   p_page->p_log->log_functions = 0;
+   p_page->p_log->log_transmissions = 0;
+   if (!p_page->p_log->log_level[0]) {
+      return 0;
+   }
+
+   if (p_page->p_log->log_filter[0] && !strstr(p_page->p_log->log_filter, "*")) {
+      sprintf(buffer, ",%s,", function);
+      if (!strstr(p_page->p_log->log_filter, buffer)) {
+         return 0;
+      }
+   }
+   p = p_page->p_log->log_level;
+   while (*p) {
+      if (*p == 'e')
+         p_page->p_log->log_errors = 1;
+      else if (*p == 'f')
+         p_page->p_log->log_functions = 1;
+      else if (*p == 't')
+         p_page->p_log->log_transmissions = 1;
+      p ++;
+   }
+
+   p_page->p_srv->p_log = p_page->p_log;
+
+   if (p_page->p_log->log_functions) {  
+      mg_log_event(p_page->p_log, function, "function called", 0);
+   }
+   return 1;
+}
+
+
+/* v3.4.63 readahead for m_order() and m_previous() */
+
+int mg_readahead(MGPAGE *p_page, zval *parameter_array, int argument_count, short direction, zval *return_value)
+{
+   MGBUF mgbuf, *p_buf;
+   MGBUF reqbuf, *p_req;
+   MGRAHEAD *p_ra;
+   short byref, type;
+   int n, offset, len, hlen, size, keyn, chndle;
+   unsigned long total;
+   char server[64];
+   char buffer[32];
+   char *seed;
+   unsigned char *p;
+
+   p_ra = &(p_page->ra);
+
+   /* the DB Superserver has already rejected the batched order command */
+   if (p_page->p_srv->no_command & MG_NOCMD_ORDER) {
+      return 0;
+   }
+
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   if ((argument_count - offset) < 2) {
+      return 0;
+   }
+
+   /* the parent reference: global name and leading subscripts */
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, 256, 256);
+   for (n = offset; n < (argument_count - 1); n ++) {
+      seed = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) seed, len, 0, MG_TX_DATA);
+   }
+   seed = mg_get_string(&(parameter_array[argument_count - 1]), NULL, &len);
+
+   /* serve the next subscript from the window if this call continues the walk */
+   if (p_ra->ref.data_size && p_ra->direction == direction && !strcmp(p_ra->server, server)
+         && p_ra->ref.data_size == p_buf->data_size && !memcmp(p_ra->ref.p_buffer, p_buf->p_buffer, p_buf->data_size)
+         && p_ra->last.data_size == (unsigned long) len && !memcmp(p_ra->last.p_buffer, seed, len)) {
+      if (mg_readahead_next(p_ra, return_value)) {
+         mg_buf_free(p_buf);
+         return 1;
+      }
+   }
+
+   /* otherwise fetch the next window using the batched order command */
+   p_ra->ref.data_size = 0;
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      mg_buf_free(p_buf);
+      return 0;
+   }
+
+   p_req = &reqbuf;
+   mg_buf_init(p_req, MG_BUFSIZE, MG_BUFSIZE);
+   mg_request_header_ex(p_page, p_req, "N", MG_PRODUCT, &(parameter_array[0]));
+   sprintf(buffer, "%d", p_ra->batch);
+   mg_request_add(p_page->p_srv, chndle, p_req, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   sprintf(buffer, "%d", direction);
+   mg_request_add(p_page->p_srv, chndle, p_req, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_req, (unsigned char *) "", 0, 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, chndle, p_req, (unsigned char *) "", 0, 0, MG_TX_DATA);
+   mg_buf_cat(p_req, (char *) p_buf->p_buffer, p_buf->data_size);
+   mg_request_add(p_page->p_srv, chndle, p_req, (unsigned char *) seed, len, 0, MG_TX_DATA);
+
+   n = 0;
+   if (p_page->p_srv->mem_error != 1) {
+      n = mg_db_send(p_page->p_srv, chndle, p_req, 1);
+      if (n) {
+         mg_db_receive(p_page->p_srv, chndle, p_req, MG_BUFSIZE, 0);
+      }
+   }
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   /* on any failure revert to a plain $Order: a DB Server without the 'N' command is not asked again */
+   if (!n || p_page->p_srv->mem_error == 1 || p_req->data_size < MG_RECV_HEAD || !strncmp((char *) p_req->p_buffer + 5, "ce", 2)) {
+      if (n && p_page->p_srv->mode != 2 && p_req->data_size >= MG_RECV_HEAD && !strncmp((char *) p_req->p_buffer + 5, "ce", 2)) {
+         p_page->p_srv->no_command |= MG_NOCMD_ORDER;
+      }
+      mg_buf_free(p_req);
+      mg_buf_free(p_buf);
+      return 0;
+   }
+
+   p = p_req->p_buffer + MG_RECV_HEAD;
+   total = p_req->data_size - MG_RECV_HEAD;
+   p_ra->keys.data_size = 0;
+   if (total) {
+      mg_buf_cat(&(p_ra->keys), (char *) p, total);
+   }
+
+   keyn = 0;
+   for (offset = 0; (unsigned long) offset < total; keyn ++) {
+      hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+      offset += (hlen + size);
+   }
+
+   strcpy(p_ra->server, server);
+   p_ra->direction = direction;
+   p_ra->eod = (keyn < p_ra->batch) ? 1 : 0;
+   p_ra->offset = 0;
+   mg_buf_cpy(&(p_ra->ref), (char *) p_buf->p_buffer, p_buf->data_size);
+
+   mg_buf_free(p_req);
+   mg_buf_free(p_buf);
+
+   n = mg_readahead_next(p_ra, return_value);
+   if (!n) {
+      p_ra->ref.data_size = 0;
+   }
+   return n;
+}
+
+
+int mg_readahead_next(MGRAHEAD *p_ra, zval *return_value)
+{
+   short byref, type;
+   int hlen, size;
+   unsigned char *p;
+
+   if (p_ra->offset < p_ra->keys.data_size) {
+      p = p_ra->keys.p_buffer + p_ra->offset;
+      hlen = mg_decode_item_header(p, &size, &byref, &type);
+      if (size < 0 || (p_ra->offset + hlen + size) > p_ra->keys.data_size) {
+         return 0;
+      }
+      p_ra->offset += (hlen + size);
+      p_ra->last.data_size = 0;
+      if (size) {
+         mg_buf_cat(&(p_ra->last), (char *) p + hlen, size);
+      }
+      RETVAL_STRINGL((char *) p + hlen, size);
+      return 1;
+   }
+
+   if (p_ra->eod) {
+      /* end of the walk: the next call (from "") starts a new one */
+      p_ra->ref.data_size = 0;
+      RETVAL_EMPTY_STRING();
+      return 1;
+   }
+
+   return 0;
+}
+
+
+int mg_request_server(MGPAGE *p_page, zval *parg0, char *server)
+{
+   int offset;
+#if !defined(MG_PHP_MGW)
+   int len;
+   char *data;
+#endif
+
+   offset = 0;
+   strcpy(server, p_page->server_base);
+
+#if !defined(MG_PHP_MGW)
+   if (Z_TYPE_P(parg0) == IS_STRING) {
+      data = Z_STRVAL_P(parg0);
+      len = (int) Z_STRLEN_P(parg0);
+      if (len && len < 64 && !strstr(data, "^") && !strstr(data, "$") && !strstr(data,".")) {
+         offset = 1;
+         strcpy(server, data);
+      }
+   }
+#endif
+
+   return offset;
+}
+
+
+/*
+   Discard the readahead window if the node modified is under (or above) its parent reference
+*/
+
+int mg_readahead_invalidate(MGPAGE *p_page, zval *parameter_array, int argument_count)
+{
+   MGBUF mgbuf, *p_buf;
+   int n, offset, len;
+   unsigned long size;
+   char server[64];
+   char *data;
+   MGRAHEAD *p_ra;
+
+   p_ra = &(p_page->ra);
+   if (!p_ra->ref.data_size || argument_count < 1) {
+      return 0;
+   }
+
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   if (strcmp(p_ra->server, server)) {
+      return 0;
+   }
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, 256, 256);
+   for (n = offset; n < argument_count; n ++) {
+      data = mg_get_string(&(parameter_array[n]), NULL, &len);
+      mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) data, len, 0, MG_TX_DATA);
+   }
+
+   size = (p_buf->data_size < p_ra->ref.data_size) ? p_buf->data_size : p_ra->ref.data_size;
+   if (!memcmp(p_buf->p_buffer, p_ra->ref.p_buffer, size)) {
+      p_ra->ref.data_size = 0;
+   }
+
+   mg_buf_free(p_buf);
+
+   return 1;
+}
+
+
+/* v3.4.63 locks */
+
+void mg_lock_invoke(MGPAGE *p_page, zval *return_value, zval *parameter_array, int argument_count, short lock, short many)
+{
+   MGBUF mgbuf, *p_buf;
+   MGBUF refbuf, *p_ref;
+   short byref, type;
+   int n, offset, chndle, hlen, size;
+   char server[64], timeout[32];
+   zval *ref, *refs;
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+   p_ref = &refbuf;
+   mg_buf_init(p_ref, 256, 256);
+
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+
+   /* the number of arguments making up the reference(s) */
+   n = argument_count - offset - (lock ? 1 : 0);
+   if (n < 1 || (many && n != 1)) {
+      mg_buf_free(p_ref);
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+   }
+
+   if (many) {
+      refs = &(parameter_array[offset]);
+      ZVAL_DEREF(refs);
+      if (Z_TYPE_P(refs) != IS_ARRAY) {
+         mg_buf_free(p_ref);
+         strcpy(p_page->p_srv->error_mess, "The set of references must be an array of global references");
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+      ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(refs), ref) {
+         ZVAL_DEREF(ref);
+         if (Z_TYPE_P(ref) == IS_ARRAY && zend_hash_num_elements(Z_ARRVAL_P(ref)) > 0) {
+            mg_lock_reference(p_page, p_ref, ref, NULL, 0);
+         }
+      } ZEND_HASH_FOREACH_END();
+      if (!p_ref->data_size) {
+         mg_buf_free(p_ref);
+         MG_RETURN_FALSE_AND_FREE_BUF;
+      }
+   }
+   else {
+      mg_lock_reference(p_page, p_ref, NULL, &(parameter_array[offset]), n);
+   }
+
+   /* the DB Superserver has already rejected the lock commands */
+   if (p_page->p_srv->no_command & MG_NOCMD_LOCK) {
+      mg_buf_free(p_ref);
+      strcpy(p_page->p_srv->error_mess, "The lock commands ('L' and 'U') are not supported by this DB Superserver");
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      mg_buf_free(p_ref);
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   mg_request_header_ex(p_page, p_buf, lock ? "L" : "U", MG_PRODUCT, &(parameter_array[0]));
+   if (lock) {
+      sprintf(timeout, "%ld", (long) zval_get_long(&(parameter_array[argument_count - 1])));
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) timeout, (int) strlen(timeout), 0, MG_TX_DATA);
+   }
+   mg_buf_cat(p_buf, (char *) p_ref->p_buffer, p_ref->data_size);
+
+   if (p_page->p_srv->mem_error == 1) {
+      mg_buf_free(p_ref);
+   }
+   MG_MEMCHECK("Insufficient memory to process request", 1);
+
+   n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+   if (!n) {
+      mg_buf_free(p_ref);
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+
+   if (p_page->p_srv->mem_error == 1) {
+      mg_buf_free(p_ref);
+   }
+   MG_MEMCHECK("Insufficient memory to process response", 0);
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   /* a DB Superserver without the lock commands (%zmgsi): report it, and do not ask again */
+   if (p_page->p_srv->mode != 2 && p_buf->data_size >= MG_RECV_HEAD && !strncmp((char *) p_buf->p_buffer + 5, "ce", 2)) {
+      p_page->p_srv->no_command |= MG_NOCMD_LOCK;
+      mg_buf_free(p_ref);
+      strcpy(p_page->p_srv->error_mess, "The lock commands ('L' and 'U') are not supported by this DB Superserver");
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   if ((n = mg_php_error(p_page, (char *) p_buf->p_buffer))) {
+      mg_buf_free(p_ref);
+      if (n == 2) {
+         MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
+      }
+      MG_RETURN_FALSE_AND_FREE_BUF;
+   }
+
+   size = 0;
+   hlen = 0;
+   if (p_buf->data_size > MG_RECV_HEAD) {
+      hlen = mg_decode_item_header(p_buf->p_buffer + MG_RECV_HEAD, &size, &byref, &type);
+      if (size < 0 || (unsigned long) (MG_RECV_HEAD + hlen + size) > p_buf->data_size) {
+         size = 0;
+      }
+   }
+
+   /* keep track of the locks held so that they can be released at the end of the request */
+   if (lock && size == 1 && p_buf->p_buffer[MG_RECV_HEAD + hlen] == '1') {
+      mg_lock_record(p_page, server, p_ref);
+   }
+   else if (!lock) {
+      mg_lock_forget(p_page, server, p_ref);
+   }
+   mg_buf_free(p_ref);
+
+   RETVAL_STRINGL((char *) p_buf->p_buffer + MG_RECV_HEAD + hlen, size);
+   mg_buf_free(p_buf);
+
+   return;
+}
+
+
+/*
+   Encode a lock reference: the number of keys followed by the global name and subscripts
+   The keys are taken from either a PHP array or a list of arguments
+*/
+
+int mg_lock_reference(MGPAGE *p_page, MGBUF *p_buf, zval *ref, zval *args, int argn)
+{
+   int n;
+   char buffer[32];
+   zval *item;
+   zend_string *str;
+
+   if (ref) {
+      argn = (int) zend_hash_num_elements(Z_ARRVAL_P(ref));
+   }
+   sprintf(buffer, "%d", argn);
+   mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+
+   if (ref) {
+      ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(ref), item) {
+         str = zval_get_string(item);
+         mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+         zend_string_release(str);
+      } ZEND_HASH_FOREACH_END();
+   }
+   else {
+      for (n = 0; n < argn; n ++) {
+         str = zval_get_string(&(args[n]));
+         mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+         zend_string_release(str);
+      }
+   }
+
+   return argn;
+}
+
+
+/* Size (in bytes) of the encoded lock reference at p */
+
+unsigned long mg_lock_size(unsigned char *p, unsigned long total)
+{
+   short byref, type;
+   int n, keyn, hlen, size;
+   unsigned long offset;
+   char buffer[32];
+
+   hlen = mg_decode_item_header(p, &size, &byref, &type);
+   if (size < 1 || size > 30 || (unsigned long) (hlen + size) > total) {
+      return 0;
+   }
+   strncpy(buffer, (char *) p + hlen, size);
+   buffer[size] = '\0';
+   keyn = (int) strtol(buffer, NULL, 10);
+
+   offset = hlen + size;
+   for (n = 0; n < keyn; n ++) {
+      if (offset >= total) {
+         return 0;
+      }
+      hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+      if (size < 0 || (offset + hlen + size) > total) {
+         return 0;
+      }
+      offset += (hlen + size);
+   }
+
+   return offset;
+}
+
+
+/* Record each of the references in p_ref as a lock held: server name followed by the reference */
+
+int mg_lock_record(MGPAGE *p_page, char *server, MGBUF *p_ref)
+{
+   unsigned long offset, rlen;
+
+   if (!p_page->locks.p_buffer) {
+      mg_buf_init(&(p_page->locks), 1024, 1024);
+   }
+
+   for (offset = 0; offset < p_ref->data_size; offset += rlen) {
+      rlen = mg_lock_size(p_ref->p_buffer + offset, p_ref->data_size - offset);
+      if (!rlen) {
+         break;
+      }
+      mg_request_add(p_page->p_srv, 0, &(p_page->locks), (unsigned char *) server, (int) strlen(server), 0, MG_TX_DATA);
+      mg_buf_cat(&(p_page->locks), (char *) p_ref->p_buffer + offset, rlen);
+   }
+
+   return 1;
+}
+
+
+/* Remove the most recent record for each of the references in p_ref */
+
+int mg_lock_forget(MGPAGE *p_page, char *server, MGBUF *p_ref)
+{
+   short byref, type;
+   int hlen, size, slen;
+   unsigned long offset, roffset, rlen, found, found_len, len;
+   unsigned char *p;
+
+   if (!p_page->locks.data_size) {
+      return 0;
+   }
+
+   slen = (int) strlen(server);
+   for (roffset = 0; roffset < p_ref->data_size; roffset += rlen) {
+      rlen = mg_lock_size(p_ref->p_buffer + roffset, p_ref->data_size - roffset);
+      if (!rlen) {
          break;
-      case 3:
-         n = zend_parse_parameters(argument_count, "z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2]);
+      }
+      found = 0;
+      found_len = 0;
+      p = p_page->locks.p_buffer;
+      for (offset = 0; offset < p_page->locks.data_size; offset += (hlen + size + len)) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         len = mg_lock_size(p + offset + hlen + size, p_page->locks.data_size - (offset + hlen + size));
+         if (!len) {
+            p_page->locks.data_size = offset;
+            break;
+         }
+         if (size == slen && !memcmp(p + offset + hlen, server, slen) && len == rlen && !memcmp(p + offset + hlen + size, p_ref->p_buffer + roffset, rlen)) {
+            found = offset + 1;
+            found_len = hlen + size + len;
+         }
+      }
+      if (found) {
+         found --;
+         memmove((void *) (p + found), (void *) (p + found + found_len), (size_t) (p_page->locks.data_size - (found + found_len)));
+         p_page->locks.data_size -= found_len;
+      }
+   }
+
+   return 1;
+}
+
+
+/* Release all the locks recorded: one unlock request per DB Server */
+
+int mg_lock_release_all(MGPAGE *p_page)
+{
+   MGBUF mgbuf, *p_buf;
+   MGBUF refbuf, *p_ref;
+   short byref, type;
+   int n, chndle, hlen, size;
+   unsigned long offset, len;
+   char server[64];
+   unsigned char *p;
+   zval zserver;
+
+   /* no lock can have been granted by a DB Superserver without the lock commands */
+   if (p_page->p_srv->no_command & MG_NOCMD_LOCK) {
+      if (p_page->locks.p_buffer) {
+         p_page->locks.data_size = 0;
+      }
+      return 1;
+   }
+
+   while (p_page->locks.p_buffer && p_page->locks.data_size) {
+      p = p_page->locks.p_buffer;
+      hlen = mg_decode_item_header(p, &size, &byref, &type);
+      if (size < 0 || size >= (int) sizeof(server)) {
+         p_page->locks.data_size = 0;
          break;
-      case 4:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3]);
+      }
+      memcpy((void *) server, (void *) (p + hlen), (size_t) size);
+      server[size] = '\0';
+
+      /* gather (and remove) the records for this DB Server */
+      p_ref = &refbuf;
+      mg_buf_init(p_ref, 1024, 1024);
+      offset = 0;
+      while (offset < p_page->locks.data_size) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         len = mg_lock_size(p + offset + hlen + size, p_page->locks.data_size - (offset + hlen + size));
+         if (!len) {
+            p_page->locks.data_size = offset;
+            break;
+         }
+         if (size == (int) strlen(server) && !memcmp(p + offset + hlen, server, size)) {
+            mg_buf_cat(p_ref, (char *) p + offset + hlen + size, len);
+            memmove((void *) (p + offset), (void *) (p + offset + hlen + size + len), (size_t) (p_page->locks.data_size - (offset + hlen + size + len)));
+            p_page->locks.data_size -= (hlen + size + len);
+         }
+         else {
+            offset += (hlen + size + len);
+         }
+      }
+
+      if (p_ref->data_size) {
+         p_buf = &mgbuf;
+         mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+         n = mg_db_connect(p_page->p_srv, &chndle, 1);
+         if (n) {
+            ZVAL_STRING(&zserver, server);
+            mg_request_header_ex(p_page, p_buf, "U", MG_PRODUCT, &zserver);
+            zval_ptr_dtor(&zserver);
+            mg_buf_cat(p_buf, (char *) p_ref->p_buffer, p_ref->data_size);
+            n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+            if (n) {
+               mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+            }
+            mg_db_disconnect(p_page->p_srv, chndle, 1);
+         }
+         if (!n && p_page->p_log->log_errors) {
+            mg_log_event(p_page->p_log, p_page->p_srv->error_mess, "Error Condition: unable to release locks", 0);
+         }
+         mg_buf_free(p_buf);
+      }
+      mg_buf_free(p_ref);
+   }
+
+   return 1;
+}
+
+
+/*
+   Subtree aggregation: the nodes are visited (and the total formed) by the DB Server
+   so that neither the keys nor the data cross the wire
+*/
+
+void mg_count_invoke(MGPAGE *p_page, zval *return_value, zval *parameter_array, int argument_count, short size)
+{
+   MGBUF mgbuf, *p_buf;
+   short byref, type, native;
+   int n, offset, argn, chndle, hlen, len;
+   unsigned long total;
+   char server[64], flags[8], limit[32];
+   zval *ref;
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   offset = mg_request_server(p_page, &(parameter_array[0]), server);
+   argn = argument_count - offset;
+   if (argn < 1 || argn > (size ? 2 : 3)) {
+      MG_WRONG_PARAM_COUNT_AND_FREE_BUF;
+   }
+
+   ref = &(parameter_array[offset]);
+   ZVAL_DEREF(ref);
+   if (Z_TYPE_P(ref) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(ref)) < 1) {
+      strcpy(p_page->p_srv->error_mess, "The reference must be an array holding a global name followed by any subscripts");
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   strcpy(flags, size ? "s" : "");
+   if (!size && argn > 1 && zend_is_true(&(parameter_array[offset + 1]))) {
+      strcat(flags, "d");
+   }
+   strcpy(limit, "0");
+   n = offset + (size ? 1 : 2);
+   if (n < argument_count) {
+      sprintf(limit, "%ld", (long) zval_get_long(&(parameter_array[n])));
+   }
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      MG_ERROR1(p_page->p_srv->error_mess);
+   }
+
+   native = 0;
+   if (!(p_page->p_srv->no_command & MG_NOCMD_COUNT)) {
+      mg_request_header_ex(p_page, p_buf, "C", MG_PRODUCT, &(parameter_array[0]));
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) flags, (int) strlen(flags), 0, MG_TX_DATA);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) limit, (int) strlen(limit), 0, MG_TX_DATA);
+      mg_request_reference(p_page, chndle, p_buf, ref);
+
+      MG_MEMCHECK("Insufficient memory to process request", 1);
+
+      n = mg_db_send(p_page->p_srv, chndle, p_buf, 1);
+      if (!n) {
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+      mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+
+      MG_MEMCHECK("Insufficient memory to process response", 0);
+
+      native = 1;
+      /* a DB Superserver without the 'C' command: count on the client from now on */
+      if (p_page->p_srv->mode != 2 && p_buf->data_size >= MG_RECV_HEAD && !strncmp((char *) p_buf->p_buffer + 5, "ce", 2)) {
+         p_page->p_srv->no_command |= MG_NOCMD_COUNT;
+         native = 0;
+      }
+   }
+   total = 0;
+   if (!native) {
+      n = mg_count_records(p_page, chndle, p_buf, ref, flags, (limit[0] == '-') ? 0 : strtoul(limit, NULL, 10), &total, &(parameter_array[0]));
+      MG_MEMCHECK("Insufficient memory to process response", 0);
+      if (!n) {
+         mg_db_disconnect(p_page->p_srv, chndle, 1);
+         MG_ERROR1(p_page->p_srv->error_mess);
+      }
+   }
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   if ((n = mg_php_error(p_page, (char *) p_buf->p_buffer))) {
+      if (n == 2) {
+         MG_RETURN_STRING_AND_FREE_BUF(p_page->p_srv->error_code, 1);
+      }
+      MG_RETURN_FALSE_AND_FREE_BUF;
+   }
+
+   if (!native) {
+      sprintf(limit, "%lu", total);
+      RETVAL_STRINGL(limit, (int) strlen(limit));
+      mg_buf_free(p_buf);
+      return;
+   }
+
+   len = 0;
+   hlen = 0;
+   if (p_buf->data_size > MG_RECV_HEAD) {
+      hlen = mg_decode_item_header(p_buf->p_buffer + MG_RECV_HEAD, &len, &byref, &type);
+      if (len < 0 || (unsigned long) (MG_RECV_HEAD + hlen + len) > p_buf->data_size) {
+         len = 0;
+      }
+   }
+
+   RETVAL_STRINGL((char *) p_buf->p_buffer + MG_RECV_HEAD + hlen, len);
+   mg_buf_free(p_buf);
+
+   return;
+}
+
+
+/*
+   Fallbacks for a DB Superserver without the merge ('R') and count ('C') commands: the work is done
+   with the commands it does implement, and the data passes through the extension (but not through PHP)
+*/
+
+/* Add the global name and subscripts held in a reference array to a request */
+
+int mg_request_reference(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref)
+{
+   int n;
+   zval *item;
+   zend_string *str;
+
+   n = 0;
+   ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(ref), item) {
+      str = zval_get_string(item);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+      zend_string_release(str);
+      n ++;
+   } ZEND_HASH_FOREACH_END();
+
+   return n;
+}
+
+
+/* Send the request and receive the response: 0 if the exchange failed, -1 if the response is an error (left in p_buf for mg_php_error) */
+
+int mg_request_exchange(MGPAGE *p_page, int chndle, MGBUF *p_buf)
+{
+   if (p_page->p_srv->mem_error == 1) {
+      strcpy(p_page->p_srv->error_mess, "Insufficient memory to process request");
+      return 0;
+   }
+   if (!mg_db_send(p_page->p_srv, chndle, p_buf, 1)) {
+      return 0;
+   }
+   mg_db_receive(p_page->p_srv, chndle, p_buf, MG_BUFSIZE, 0);
+   if (p_page->p_srv->mem_error == 1) {
+      return 0;
+   }
+   if (p_buf->data_size < MG_RECV_HEAD) {
+      strcpy(p_page->p_srv->error_mess, "No response from the DB Server");
+      return 0;
+   }
+   if (!strncmp((char *) p_buf->p_buffer + 5, "ce", 2)) {
+      return -1;
+   }
+
+   return 1;
+}
+
+
+/* Translate an error (or missing) response into the error message: returns zero if the request failed */
+
+int mg_response_error(MGPAGE *p_page, MGBUF *p_buf)
+{
+   int n;
+   char *buffer;
+
+   buffer = (char *) p_buf->p_buffer;
+   if (p_buf->data_size < MG_RECV_HEAD) {
+      strcpy(p_page->p_srv->error_mess, "No response from the DB Server");
+      return 0;
+   }
+   if (strncmp(buffer + 5, "ce", 2)) {
+      return 1;
+   }
+   for (n = MG_RECV_HEAD; buffer[n]; n ++) {
+      if (buffer[n] == '%')
+         buffer[n] = '^';
+   }
+   strncpy(p_page->p_srv->error_mess, buffer + MG_RECV_HEAD, sizeof(p_page->p_srv->error_mess) - 1);
+   p_page->p_srv->error_mess[sizeof(p_page->p_srv->error_mess) - 1] = '\0';
+
+   return 0;
+}
+
+
+/* The value at a global node ($Data then Get): 1 with the value in p_value, 2 if the node has no value, otherwise as mg_request_exchange */
+
+int mg_node_value(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, zval *parg0, MGBUF *p_value)
+{
+   int rc;
+
+   p_value->data_size = 0;
+
+   mg_request_header_ex(p_page, p_buf, "D", MG_PRODUCT, parg0);
+   mg_request_reference(p_page, chndle, p_buf, ref);
+   rc = mg_request_exchange(p_page, chndle, p_buf);
+   if (rc <= 0) {
+      return rc;
+   }
+   if (p_buf->data_size == MG_RECV_HEAD || !(strtol((char *) p_buf->p_buffer + MG_RECV_HEAD, NULL, 10) % 2)) {
+      return 2;
+   }
+
+   mg_request_header_ex(p_page, p_buf, "G", MG_PRODUCT, parg0);
+   mg_request_reference(p_page, chndle, p_buf, ref);
+   rc = mg_request_exchange(p_page, chndle, p_buf);
+   if (rc <= 0) {
+      return rc;
+   }
+   if (p_buf->data_size > MG_RECV_HEAD) {
+      mg_buf_cpy(p_value, (char *) p_buf->p_buffer + MG_RECV_HEAD, p_buf->data_size - MG_RECV_HEAD);
+   }
+
+   return 1;
+}
+
+
+/* The nodes below a global node as an array record, as returned to m_merge_from_db() ('m') */
+
+int mg_merge_fetch(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, zval *parg0)
+{
+   mg_request_header_ex(p_page, p_buf, "m", MG_PRODUCT, parg0);
+   mg_request_reference(p_page, chndle, p_buf, ref);
+   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, 1, MG_TX_AREC);
+   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, 1, MG_TX_EOD);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+
+   return mg_request_exchange(p_page, chndle, p_buf);
+}
+
+
+/* MERGE ^to=^from: the value at the source node is copied with Set, and the nodes below it are passed back unchanged to m_merge_to_db() ('M') */
+
+int mg_merge_records(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval **ref, zval *parg0)
+{
+   int rc;
+   MGBUF recbuf, *p_rec;
+
+   p_rec = &recbuf;
+   mg_buf_init(p_rec, 256, 256);
+
+   rc = mg_node_value(p_page, chndle, p_buf, ref[1], parg0, p_rec);
+   if (rc == 1) {
+      mg_request_header_ex(p_page, p_buf, "S", MG_PRODUCT, parg0);
+      mg_request_reference(p_page, chndle, p_buf, ref[0]);
+      mg_request_add(p_page->p_srv, chndle, p_buf, p_rec->p_buffer, (int) p_rec->data_size, 0, MG_TX_DATA);
+      rc = mg_request_exchange(p_page, chndle, p_buf);
+   }
+   if (rc > 0) {
+      rc = mg_merge_fetch(p_page, chndle, p_buf, ref[1], parg0);
+   }
+   if (rc > 0 && p_buf->data_size > MG_RECV_HEAD) {
+      mg_buf_cpy(p_rec, (char *) p_buf->p_buffer + MG_RECV_HEAD, p_buf->data_size - MG_RECV_HEAD);
+      mg_request_header_ex(p_page, p_buf, "M", MG_PRODUCT, parg0);
+      mg_request_reference(p_page, chndle, p_buf, ref[0]);
+      mg_buf_cat(p_buf, (char *) p_rec->p_buffer, p_rec->data_size);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      rc = mg_request_exchange(p_page, chndle, p_buf);
+   }
+
+   mg_buf_free(p_rec);
+
+   return (rc == 0) ? 0 : 1;
+}
+
+
+/* m_count() and m_subtree_size(): the immediate children are counted with $Order, and the data nodes below the node in the records fetched as for m_merge_from_db() */
+
+int mg_count_records(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *ref, char *flags, unsigned long limit, unsigned long *p_total, zval *parg0)
+{
+   short byref, type;
+   int rc, hlen, size;
+   unsigned long offset, total;
+   unsigned char *p;
+   MGBUF seedbuf, *p_seed;
+
+   *p_total = 0;
+   p_seed = &seedbuf;
+   mg_buf_init(p_seed, 256, 256);
+
+   if (!strchr(flags, 'd') && !strchr(flags, 's')) {
+      for (rc = 1; !limit || *p_total < limit; ) {
+         mg_request_header_ex(p_page, p_buf, "O", MG_PRODUCT, parg0);
+         mg_request_reference(p_page, chndle, p_buf, ref);
+         mg_request_add(p_page->p_srv, chndle, p_buf, p_seed->p_buffer, (int) p_seed->data_size, 0, MG_TX_DATA);
+         rc = mg_request_exchange(p_page, chndle, p_buf);
+         if (rc <= 0 || p_buf->data_size == MG_RECV_HEAD) {
+            break;
+         }
+         (*p_total) ++;
+         mg_buf_cpy(p_seed, (char *) p_buf->p_buffer + MG_RECV_HEAD, p_buf->data_size - MG_RECV_HEAD);
+      }
+      mg_buf_free(p_seed);
+      return (rc == 0) ? 0 : 1;
+   }
+
+   rc = 1;
+   if (strchr(flags, 's')) {
+      rc = mg_node_value(p_page, chndle, p_buf, ref, parg0, p_seed);
+      if (rc == 1) {
+         *p_total = p_seed->data_size;
+      }
+   }
+   mg_buf_free(p_seed);
+   if (rc > 0) {
+      rc = mg_merge_fetch(p_page, chndle, p_buf, ref, parg0);
+   }
+   if (rc <= 0) {
+      return (rc == 0) ? 0 : 1;
+   }
+
+   p = p_buf->p_buffer + MG_RECV_HEAD;
+   total = p_buf->data_size - MG_RECV_HEAD;
+   for (offset = 0; offset < total && (!limit || *p_total < limit); ) {
+      hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+      if (size < 0 || (offset + hlen + size) > total || type == MG_TX_EOD) {
+         break;
+      }
+      if (type == MG_TX_DATA) {
+         *p_total += strchr(flags, 's') ? (unsigned long) size : 1;
+      }
+      offset += (hlen + size);
+   }
+
+   return 1;
+}
+
+
+/*
+   Fallbacks for a DB Superserver without the batched order ('N') and query ('Q') commands: the batch is
+   assembled with $Order, $Data and Get, and returned to the caller in the format of the batched command
+*/
+
+/*
+   Send a batched command, falling back to the stock commands if the DB Superserver rejects it (and from then on without asking it again): as mg_request_exchange
+   The global directory ('E') cannot be listed with the stock commands, so a DB Superserver without it is reported as such
+*/
+
+int mg_batch_exchange(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0)
+{
+   int rc, itemn, nocmd;
+   char command;
+   MGSTR items[DBX_MAXARGS];
+   MGBUF reqbuf, resbuf, *p_req, *p_res;
+
+   if (p_page->p_srv->mode == 2) {
+      return mg_request_exchange(p_page, chndle, p_buf);
+   }
+
+   command = (char) p_buf->p_buffer[p_page->p_srv->header_len - 8];
+
+   if (command == 'E') {
+      if (!(p_page->p_srv->no_command & MG_NOCMD_GLOBALS)) {
+         rc = mg_request_exchange(p_page, chndle, p_buf);
+         if (rc != -1) {
+            return rc;
+         }
+         p_page->p_srv->no_command |= MG_NOCMD_GLOBALS;
+      }
+      strcpy(p_page->p_srv->error_mess, "The global directory command ('E') is not supported by this DB Superserver");
+      return 0;
+   }
+
+   nocmd = (command == 'Q') ? MG_NOCMD_QUERY : MG_NOCMD_ORDER;
+
+   p_req = &reqbuf;
+   mg_buf_init(p_req, MG_BUFSIZE, MG_BUFSIZE);
+   mg_buf_cpy(p_req, (char *) p_buf->p_buffer, p_buf->data_size);
+
+   if (!(p_page->p_srv->no_command & nocmd)) {
+      rc = mg_request_exchange(p_page, chndle, p_buf);
+      if (rc != -1) {
+         mg_buf_free(p_req);
+         return rc;
+      }
+      p_page->p_srv->no_command |= nocmd;
+   }
+
+   itemn = mg_api_request_items(p_req, items, DBX_MAXARGS);
+
+   p_res = &resbuf;
+   mg_buf_init(p_res, MG_BUFSIZE, MG_BUFSIZE);
+   mg_api_response_init(p_res);
+
+   if (command == 'Q')
+      rc = mg_query_records(p_page, chndle, p_buf, parg0, items, itemn, p_res);
+   else
+      rc = mg_order_records(p_page, chndle, p_buf, parg0, items, itemn, p_res);
+   if (rc > 0) {
+      mg_api_response_end(p_res, 0);
+      mg_buf_cpy(p_buf, (char *) p_res->p_buffer, p_res->data_size);
+   }
+
+   mg_buf_free(p_res);
+   mg_buf_free(p_req);
+
+   return rc;
+}
+
+
+/* Send a stock command for the global node held (as encoded request items) in p_path: as mg_request_exchange */
+
+int mg_path_request(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, char *command, MGBUF *p_path)
+{
+   mg_request_header_ex(p_page, p_buf, command, MG_PRODUCT, parg0);
+   mg_buf_cat(p_buf, (char *) p_path->p_buffer, p_path->data_size);
+
+   return mg_request_exchange(p_page, chndle, p_buf);
+}
+
+
+/* $Data at the global node held in p_path: as mg_request_exchange, with the value in *p_data */
+
+int mg_path_data(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, int *p_data)
+{
+   int rc;
+
+   *p_data = 0;
+   rc = mg_path_request(p_page, chndle, p_buf, parg0, "D", p_path);
+   if (rc > 0 && p_buf->data_size > MG_RECV_HEAD) {
+      *p_data = (int) strtol((char *) p_buf->p_buffer + MG_RECV_HEAD, NULL, 10);
+   }
+
+   return rc;
+}
+
+
+/* Replace the last subscript in p_path (at 'offset') with the next one in the given direction: 1 with the new subscript also left in p_buf, 2 at the end of the level, otherwise as mg_request_exchange */
+
+int mg_path_next(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long offset, int direction)
+{
+   int rc;
+
+   rc = mg_path_request(p_page, chndle, p_buf, parg0, (direction == -1) ? "P" : "O", p_path);
+   if (rc <= 0) {
+      return rc;
+   }
+   if (p_buf->data_size == MG_RECV_HEAD) {
+      return 2;
+   }
+   p_path->data_size = offset;
+   mg_request_add(p_page->p_srv, chndle, p_path, p_buf->p_buffer + MG_RECV_HEAD, (int) (p_buf->data_size - MG_RECV_HEAD), 0, MG_TX_DATA);
+
+   return 1;
+}
+
+
+/* Batched $Order ('N'): request items max, direction, flags, stop, global, subscripts ..., seed; response items key [, $Data] [, value] */
+
+int mg_order_records(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGSTR *items, int itemn, MGBUF *p_res)
+{
+   int rc, n, max, direction, getdata, getvalue, inclusive, rows, data, cmp;
+   unsigned long offset;
+   MGBUF pathbuf, *p_path;
+
+   if (itemn < 6) {
+      strcpy(p_page->p_srv->error_mess, "Invalid batched order request");
+      return 0;
+   }
+
+   max = mg_api_item_int(&items[0]);
+   if (max < 1) {
+      max = 1;
+   }
+   direction = (mg_api_item_int(&items[1]) < 0) ? -1 : 1;
+   getdata = 0;
+   getvalue = 0;
+   inclusive = 0;
+   for (n = 0; n < (int) items[2].size; n ++) {
+      if (items[2].ps[n] == 'd')
+         getdata = 1;
+      else if (items[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (items[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+
+   p_path = &pathbuf;
+   mg_buf_init(p_path, 256, 256);
+   offset = 0;
+   for (n = 4; n < itemn; n ++) {
+      offset = p_path->data_size;
+      mg_request_add(p_page->p_srv, chndle, p_path, items[n].ps, (int) items[n].size, 0, MG_TX_DATA);
+   }
+
+   rc = 1;
+   rows = 0;
+   data = -1;
+   if (inclusive && items[itemn - 1].size > 0) {
+      rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, &data);
+      if (rc > 0 && data) {
+         rc = mg_order_row(p_page, chndle, p_buf, parg0, p_path, offset, data, getdata, getvalue, p_res);
+         rows ++;
+      }
+   }
+
+   while (rc > 0 && rows < max) {
+      rc = mg_path_next(p_page, chndle, p_buf, parg0, p_path, offset, direction);
+      if (rc != 1) {
          break;
-      case 5:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4]);
+      }
+      if (items[3].size) {
+         cmp = mg_collate_compare(p_buf->p_buffer + MG_RECV_HEAD, (int) (p_buf->data_size - MG_RECV_HEAD), items[3].ps, (int) items[3].size);
+         if ((direction == 1 && cmp > 0) || (direction == -1 && cmp < 0)) {
+            break;
+         }
+      }
+      rc = mg_order_row(p_page, chndle, p_buf, parg0, p_path, offset, -1, getdata, getvalue, p_res);
+      rows ++;
+   }
+
+   mg_buf_free(p_path);
+
+   return (rc > 0) ? 1 : rc;
+}
+
+
+/* One row of the batched $Order for the node held in p_path: the last subscript (at 'offset') [, $Data] [, value] */
+
+int mg_order_row(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long offset, int data, int getdata, int getvalue, MGBUF *p_res)
+{
+   short byref, type;
+   int rc, hlen, size;
+   char buffer[32];
+
+   hlen = mg_decode_item_header(p_path->p_buffer + offset, &size, &byref, &type);
+   mg_api_response_item(p_res, p_path->p_buffer + offset + hlen, size);
+
+   if (!getdata && !getvalue) {
+      return 1;
+   }
+   if (data < 0) {
+      rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, &data);
+      if (rc <= 0) {
+         return rc;
+      }
+   }
+
+   if (getdata) {
+      sprintf(buffer, "%d", data);
+      mg_api_response_item(p_res, (unsigned char *) buffer, (int) strlen(buffer));
+   }
+   if (getvalue) {
+      if (data % 2) {
+         rc = mg_path_request(p_page, chndle, p_buf, parg0, "G", p_path);
+         if (rc <= 0) {
+            return rc;
+         }
+         mg_api_response_item(p_res, p_buf->p_buffer + MG_RECV_HEAD, (int) (p_buf->data_size - MG_RECV_HEAD));
+      }
+      else {
+         mg_api_response_item(p_res, (unsigned char *) "", 0);
+      }
+   }
+
+   return 1;
+}
+
+
+/* Batched $Query ('Q'): request items max, direction, flags, base, global, subscripts ...; response items number of subscripts, subscripts ... [, value] */
+
+int mg_query_records(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGSTR *items, int itemn, MGBUF *p_res)
+{
+   int rc, n, keyn, basen, max, direction, getvalue, start, inclusive, rows, data;
+   unsigned long off[DBX_MAXARGS];
+   MGBUF pathbuf, *p_path;
+
+   if (itemn < 5) {
+      strcpy(p_page->p_srv->error_mess, "Invalid batched query request");
+      return 0;
+   }
+
+   max = mg_api_item_int(&items[0]);
+   if (max < 1) {
+      max = 1;
+   }
+   direction = (mg_api_item_int(&items[1]) < 0) ? -1 : 1;
+   getvalue = 0;
+   start = 0;
+   inclusive = 0;
+   for (n = 0; n < (int) items[2].size; n ++) {
+      if (items[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (items[2].ps[n] == 's')
+         start = 1;
+      else if (items[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+   keyn = itemn - 5;
+   basen = mg_api_item_int(&items[3]);
+   if (basen < 0 || basen > keyn) {
+      basen = keyn;
+   }
+
+   /* the node is held as its encoded request items, with off[n] the offset of subscript n */
+   p_path = &pathbuf;
+   mg_buf_init(p_path, 256, 256);
+   for (n = 0; n <= keyn; n ++) {
+      off[n] = p_path->data_size;
+      mg_request_add(p_page->p_srv, chndle, p_path, items[n + 4].ps, (int) items[n + 4].size, 0, MG_TX_DATA);
+   }
+
+   rc = 1;
+   rows = 0;
+   data = 0;
+
+   if (direction == 1) {
+      rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, &data);
+      if (rc > 0 && inclusive && (data % 2)) {
+         rc = mg_query_row(p_page, chndle, p_buf, parg0, p_path, off, keyn, getvalue, p_res);
+         rows ++;
+      }
+   }
+   else if (start) {
+      /* the last node in the subtree */
+      if (basen < keyn) {
+         p_path->data_size = off[basen + 1];
+         keyn = basen;
+      }
+      rc = mg_query_last(p_page, chndle, p_buf, parg0, p_path, off, &keyn, &data);
+      if (rc > 0 && keyn > basen && (data % 2)) {
+         rc = mg_query_row(p_page, chndle, p_buf, parg0, p_path, off, keyn, getvalue, p_res);
+         rows ++;
+      }
+      else {
+         max = 0;
+      }
+   }
+
+   while (rc > 0 && rows < max) {
+      if (direction == 1) {
+         rc = mg_query_next(p_page, chndle, p_buf, parg0, p_path, off, &keyn, basen, &data);
+      }
+      else {
+         rc = mg_query_previous(p_page, chndle, p_buf, parg0, p_path, off, &keyn, basen, &data);
+      }
+      if (rc != 1) {
          break;
-      case 6:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5]);
+      }
+      rc = mg_query_row(p_page, chndle, p_buf, parg0, p_path, off, keyn, getvalue, p_res);
+      rows ++;
+   }
+
+   mg_buf_free(p_path);
+
+   return (rc > 0) ? 1 : rc;
+}
+
+
+/* Move to the next data node after the node held in p_path (with $Data 'data') that lies below the base: 1 with its $Data in *p_data, 2 at the end of the subtree */
+
+int mg_query_next(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int basen, int *p_data)
+{
+   int rc;
+
+   for (;;) {
+      /* the first child, or else the next sibling of the node or of its nearest ancestor below the base */
+      if (*p_data >= 10 && *p_keyn < (DBX_MAXARGS - 6)) {
+         (*p_keyn) ++;
+         off[*p_keyn] = p_path->data_size;
+         mg_request_add(p_page->p_srv, chndle, p_path, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+      else if (*p_keyn <= basen) {
+         return 2;
+      }
+      *p_data = 0;
+
+      rc = mg_path_next(p_page, chndle, p_buf, parg0, p_path, off[*p_keyn], 1);
+      if (rc <= 0) {
+         return rc;
+      }
+      if (rc == 2) {
+         p_path->data_size = off[*p_keyn];
+         (*p_keyn) --;
+         continue;
+      }
+
+      rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, p_data);
+      if (rc <= 0 || (*p_data % 2)) {
+         return rc;
+      }
+   }
+}
+
+
+/* Move to the data node before the node held in p_path that lies below the base: 1 with its $Data in *p_data, 2 at the start of the subtree */
+
+int mg_query_previous(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int basen, int *p_data)
+{
+   int rc;
+
+   for (;;) {
+      if (*p_keyn <= basen) {
+         return 2;
+      }
+
+      /* the last node under the previous sibling, or else the parent */
+      rc = mg_path_next(p_page, chndle, p_buf, parg0, p_path, off[*p_keyn], -1);
+      if (rc == 1) {
+         rc = mg_query_last(p_page, chndle, p_buf, parg0, p_path, off, p_keyn, p_data);
+      }
+      else if (rc == 2) {
+         p_path->data_size = off[*p_keyn];
+         (*p_keyn) --;
+         if (*p_keyn <= basen) {
+            return 2;
+         }
+         rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, p_data);
+      }
+      if (rc <= 0 || (*p_data % 2)) {
+         return rc;
+      }
+   }
+}
+
+
+/* Descend from the node held in p_path to the last node below it: 1 with its $Data in *p_data */
+
+int mg_query_last(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int *p_keyn, int *p_data)
+{
+   int rc;
+
+   for (;;) {
+      rc = mg_path_data(p_page, chndle, p_buf, parg0, p_path, p_data);
+      if (rc <= 0 || *p_data < 10 || *p_keyn >= (DBX_MAXARGS - 6)) {
+         return rc;
+      }
+      (*p_keyn) ++;
+      off[*p_keyn] = p_path->data_size;
+      mg_request_add(p_page->p_srv, chndle, p_path, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      rc = mg_path_next(p_page, chndle, p_buf, parg0, p_path, off[*p_keyn], -1);
+      if (rc <= 0) {
+         return rc;
+      }
+      if (rc == 2) {
+         p_path->data_size = off[*p_keyn];
+         (*p_keyn) --;
+         return 1;
+      }
+   }
+}
+
+
+/* One row of the batched $Query for the node held in p_path: the number of subscripts, the subscripts [, value] */
+
+int mg_query_row(MGPAGE *p_page, int chndle, MGBUF *p_buf, zval *parg0, MGBUF *p_path, unsigned long *off, int keyn, int getvalue, MGBUF *p_res)
+{
+   int rc;
+   char buffer[32];
+
+   sprintf(buffer, "%d", keyn);
+   mg_api_response_item(p_res, (unsigned char *) buffer, (int) strlen(buffer));
+   if (keyn > 0) {
+      mg_buf_cat(p_res, (char *) p_path->p_buffer + off[1], p_path->data_size - off[1]);
+   }
+
+   if (getvalue) {
+      rc = mg_path_request(p_page, chndle, p_buf, parg0, "G", p_path);
+      if (rc <= 0) {
+         return rc;
+      }
+      mg_api_response_item(p_res, p_buf->p_buffer + MG_RECV_HEAD, (int) (p_buf->data_size - MG_RECV_HEAD));
+   }
+
+   return 1;
+}
+
+
+/*
+   Subtree export: each partition walks its own range of first-level subscripts
+   over its own connection, with the batches for all partitions in flight together
+*/
+
+int mg_export_sample(MGPAGE *p_page, MGEXPORT *p_exp, zval *parg0, zend_string **sample, int *samplen)
+{
+   MGBUF mgbuf, *p_buf;
+   short byref, type;
+   int n, rc, chndle, hlen, size, rown, stride, lastlen;
+   unsigned long offset, total, count;
+   char buffer[32];
+   unsigned char *p, *last;
+   zend_string *seed;
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   *samplen = 0;
+   chndle = 0;
+   if (!mg_db_connect(p_page->p_srv, &chndle, 1)) {
+      mg_buf_free(p_buf);
+      return 0;
+   }
+
+   rc = 1;
+   seed = NULL;
+   stride = 1;
+   count = 0;
+
+   for (;;) {
+      mg_request_header_ex(p_page, p_buf, "N", MG_PRODUCT, parg0);
+      sprintf(buffer, "%d", p_exp->batch);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "1", 1, 0, MG_TX_DATA);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      mg_buf_cat(p_buf, (char *) p_exp->ref.p_buffer, p_exp->ref.data_size);
+      if (seed) {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(seed), (int) ZSTR_LEN(seed), 0, MG_TX_DATA);
+      }
+      else {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+
+      rc = mg_batch_exchange(p_page, chndle, p_buf, parg0);
+      if (rc == -1) {
+         mg_response_error(p_page, p_buf);
+      }
+      if (rc <= 0) {
+         rc = 0;
          break;
-      case 7:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6]);
+      }
+
+      p = p_buf->p_buffer + MG_RECV_HEAD;
+      total = (p_buf->data_size > MG_RECV_HEAD) ? (p_buf->data_size - MG_RECV_HEAD) : 0;
+      offset = 0;
+      rown = 0;
+      last = NULL;
+      lastlen = 0;
+      while (offset < total) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         offset += hlen;
+         if (size < 0 || (offset + size) > total) {
+            break;
+         }
+         /* keep at most MG_EXPORT_SAMPLE evenly spaced keys: thin them out as the scan proceeds */
+         if ((count % stride) == 0) {
+            sample[(*samplen) ++] = zend_string_init((char *) p + offset, size, 0);
+            if (*samplen == MG_EXPORT_SAMPLE) {
+               for (n = 0; n < MG_EXPORT_SAMPLE; n ++) {
+                  if (n % 2) {
+                     zend_string_release(sample[n]);
+                  }
+                  else {
+                     sample[n / 2] = sample[n];
+                  }
+               }
+               *samplen = MG_EXPORT_SAMPLE / 2;
+               stride *= 2;
+            }
+         }
+         last = p + offset;
+         lastlen = size;
+         offset += size;
+         count ++;
+         rown ++;
+      }
+      if (rown < p_exp->batch || !last) {
          break;
-      case 8:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7]);
+      }
+      if (seed) {
+         zend_string_release(seed);
+      }
+      seed = zend_string_init((char *) last, lastlen, 0);
+   }
+
+   if (seed) {
+      zend_string_release(seed);
+   }
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+   mg_buf_free(p_buf);
+
+   return rc;
+}
+
+
+int mg_export_send(MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part, zval *parg0)
+{
+   MGBUF *p_buf;
+   char buffer[32];
+
+   p_buf = &(p_part->io);
+
+   mg_request_header_ex(p_page, p_buf, "Q", MG_PRODUCT, parg0);
+   sprintf(buffer, "%d", p_exp->batch);
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, (unsigned char *) "1", 1, 0, MG_TX_DATA);
+   strcpy(buffer, p_part->first ? "vi" : "v");
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   sprintf(buffer, "%d", p_exp->keyn);
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   mg_buf_cat(p_buf, (char *) p_part->seed.p_buffer, p_part->seed.data_size);
+
+   if (p_page->p_srv->mem_error == 1) {
+      strcpy(p_page->p_srv->error_mess, "Insufficient memory to process request");
+      return 0;
+   }
+
+   /* a DB Superserver without the batched query command: the batch is assembled now, and there is no response to wait for */
+   if (p_page->p_srv->no_command & MG_NOCMD_QUERY) {
+      return mg_batch_exchange(p_page, p_part->chndle, p_buf, parg0) ? 2 : 0;
+   }
+
+   return mg_db_send(p_page->p_srv, p_part->chndle, p_buf, 1) ? 1 : 0;
+}
+
+
+/* Collect the response to the batch sent on a partition: a DB Superserver that rejects the batched query command is asked again with the stock commands */
+
+int mg_export_receive(MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part, zval *parg0)
+{
+   int n;
+   MGBUF *p_buf;
+
+   p_buf = &(p_part->io);
+
+   n = mg_db_receive(p_page->p_srv, p_part->chndle, p_buf, MG_BUFSIZE, 0);
+   if (p_page->p_srv->mem_error == 1) {
+      strcpy(p_page->p_srv->error_mess, "Insufficient memory to process response");
+      return 0;
+   }
+   if (n <= 0 || p_buf->data_size < MG_RECV_HEAD) {
+      if (n < 0 && p_page->p_srv->mode != 2) {
+         strncpy(p_page->p_srv->error_mess, p_page->p_srv->pcon[p_part->chndle]->error, sizeof(p_page->p_srv->error_mess) - 1);
+         p_page->p_srv->error_mess[sizeof(p_page->p_srv->error_mess) - 1] = '\0';
+      }
+      else {
+         strcpy(p_page->p_srv->error_mess, "No response from the DB Server");
+      }
+      return 0;
+   }
+
+   if (p_page->p_srv->mode != 2 && !strncmp((char *) p_buf->p_buffer + 5, "ce", 2)) {
+      p_page->p_srv->no_command |= MG_NOCMD_QUERY;
+      if (p_exp->stop) {
+         return 1;
+      }
+      return mg_export_send(p_page, p_exp, p_part, parg0) ? 1 : 0;
+   }
+
+   return 1;
+}
+
+
+int mg_export_rows(MGPAGE *p_page, MGEXPORT *p_exp, MGEXPART *p_part)
+{
+   short byref, type;
+   int n, hlen, size, subn, itemn, rown;
+   unsigned long offset, total;
+   char buffer[32];
+   unsigned char *p;
+   unsigned char *key[DBX_MAXARGS + 1];
+   int keylen[DBX_MAXARGS + 1];
+   MGBUF *p_buf;
+
+   p_buf = &(p_part->io);
+
+   if (!mg_response_error(p_page, p_buf)) {
+      p_exp->stop = 2;
+      return 0;
+   }
+   p_part->first = 0;
+
+   p = p_buf->p_buffer + MG_RECV_HEAD;
+   total = (p_buf->data_size > MG_RECV_HEAD) ? (p_buf->data_size - MG_RECV_HEAD) : 0;
+   offset = 0;
+   rown = 0;
+   subn = 0;
+
+   /* each row: number of subscripts, subscripts ..., value */
+   while (offset < total) {
+      hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+      offset += hlen;
+      if (size < 0 || size > 30 || (offset + size) > total) {
          break;
-      case 9:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8]);
+      }
+      strncpy(buffer, (char *) p + offset, size);
+      buffer[size] = '\0';
+      offset += size;
+      n = (int) strtol(buffer, NULL, 10);
+      if (n < p_exp->keyn || n >= DBX_MAXARGS) {
          break;
-      case 10:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9]);
+      }
+      for (itemn = 0; itemn <= n; itemn ++) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         offset += hlen;
+         if (size < 0 || (offset + size) > total) {
+            break;
+         }
+         key[itemn] = p + offset;
+         keylen[itemn] = size;
+         offset += size;
+      }
+      if (itemn <= n) {
          break;
-      case 11:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10]);
+      }
+      subn = n;
+      rown ++;
+
+      /* the walk has reached the next partition */
+      if (p_part->hi && subn > p_exp->keyn && mg_collate_compare(key[p_exp->keyn], keylen[p_exp->keyn], (unsigned char *) ZSTR_VAL(p_part->hi), (int) ZSTR_LEN(p_part->hi)) >= 0) {
+         p_part->eod = 1;
+         return 1;
+      }
+
+      if (!mg_export_emit(p_page, p_exp, key + p_exp->keyn, keylen + p_exp->keyn, subn - p_exp->keyn, key[subn], keylen[subn])) {
+         p_exp->stop = 1;
+         return 1;
+      }
+   }
+
+   if (rown < p_exp->batch) {
+      p_part->eod = 1;
+      return 1;
+   }
+
+   /* the next batch follows on from the last node returned */
+   p_part->seed.data_size = 0;
+   mg_buf_cat(&(p_part->seed), (char *) p_exp->ref.p_buffer, p_exp->global_size);
+   for (n = 0; n < subn; n ++) {
+      mg_request_add(p_page->p_srv, 0, &(p_part->seed), key[n], keylen[n], 0, MG_TX_DATA);
+   }
+
+   return 1;
+}
+
+
+int mg_export_emit(MGPAGE *p_page, MGEXPORT *p_exp, unsigned char **key, int *keylen, int keyn, unsigned char *data, int len)
+{
+   int n, rc;
+   char buffer[32];
+   zval args[2], retval;
+   MGBUF *p_buf;
+
+   p_exp->records ++;
+
+   if (p_exp->callback) {
+      array_init(&args[0]);
+      for (n = 0; n < keyn; n ++) {
+         add_next_index_stringl(&args[0], (char *) key[n], keylen[n]);
+      }
+      ZVAL_STRINGL(&args[1], (char *) data, len);
+      ZVAL_UNDEF(&retval);
+      p_exp->fci.retval = &retval;
+      p_exp->fci.params = args;
+      p_exp->fci.param_count = 2;
+      rc = zend_call_function(&(p_exp->fci), &(p_exp->fcc));
+      zval_ptr_dtor(&args[0]);
+      zval_ptr_dtor(&args[1]);
+      n = (rc == SUCCESS && !EG(exception) && Z_TYPE(retval) != IS_FALSE) ? 1 : 0;
+      zval_ptr_dtor(&retval);
+      return n;
+   }
+
+   p_buf = &(p_exp->out);
+   if (p_exp->format == MG_EXPORT_BINARY) {
+      sprintf(buffer, "%d", keyn);
+      mg_request_add(p_page->p_srv, 0, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+      for (n = 0; n < keyn; n ++) {
+         mg_request_add(p_page->p_srv, 0, p_buf, key[n], keylen[n], 0, MG_TX_DATA);
+      }
+      mg_request_add(p_page->p_srv, 0, p_buf, data, len, 0, MG_TX_DATA);
+   }
+   else {
+      mg_buf_cat(p_buf, "{\"k\":[", 6);
+      for (n = 0; n < keyn; n ++) {
+         if (n) {
+            mg_buf_cat(p_buf, ",", 1);
+         }
+         mg_export_json(p_buf, key[n], keylen[n]);
+      }
+      mg_buf_cat(p_buf, "],\"v\":", 6);
+      mg_export_json(p_buf, data, len);
+      mg_buf_cat(p_buf, "}\n", 2);
+   }
+
+   if (p_buf->data_size >= MG_EXPORT_FLUSH) {
+      return mg_export_flush(p_exp);
+   }
+
+   return 1;
+}
+
+
+/* Append a JSON string: the data is assumed to be UTF-8 */
+
+int mg_export_json(MGBUF *p_buf, unsigned char *data, int len)
+{
+   int n, start;
+   char buffer[8];
+
+   mg_buf_cat(p_buf, "\"", 1);
+   start = 0;
+   for (n = 0; n < len; n ++) {
+      if (data[n] >= 0x20 && data[n] != '"' && data[n] != '\\') {
+         continue;
+      }
+      if (n > start) {
+         mg_buf_cat(p_buf, (char *) data + start, n - start);
+      }
+      switch (data[n]) {
+         case '"':
+            strcpy(buffer, "\\\"");
+            break;
+         case '\\':
+            strcpy(buffer, "\\\\");
+            break;
+         case '\n':
+            strcpy(buffer, "\\n");
+            break;
+         case '\r':
+            strcpy(buffer, "\\r");
+            break;
+         case '\t':
+            strcpy(buffer, "\\t");
+            break;
+         default:
+            sprintf(buffer, "\\u%04x", (unsigned int) data[n]);
+            break;
+      }
+      mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+      start = n + 1;
+   }
+   if (n > start) {
+      mg_buf_cat(p_buf, (char *) data + start, n - start);
+   }
+   mg_buf_cat(p_buf, "\"", 1);
+
+   return 1;
+}
+
+
+int mg_export_flush(MGEXPORT *p_exp)
+{
+   size_t len;
+
+   if (!p_exp->stream || !p_exp->out.data_size) {
+      return 1;
+   }
+   len = php_stream_write(p_exp->stream, (char *) p_exp->out.p_buffer, (size_t) p_exp->out.data_size);
+   if (len != (size_t) p_exp->out.data_size) {
+      return 0;
+   }
+   p_exp->out.data_size = 0;
+
+   return 1;
+}
+
+
+int mg_export_close(MGEXPORT *p_exp, MGEXPART *part, zend_string **sample, int samplen)
+{
+   int n;
+
+   if (part) {
+      for (n = 0; n < p_exp->parts; n ++) {
+         mg_buf_free(&(part[n].seed));
+         mg_buf_free(&(part[n].io));
+      }
+   }
+   for (n = 0; n < samplen; n ++) {
+      zend_string_release(sample[n]);
+   }
+   mg_buf_free(&(p_exp->ref));
+
+   return 1;
+}
+
+
+/*
+   Bulk load: each batch is sorted into M collation order here so that the
+   DB Server's B-tree is written near-sequentially, then split into contiguous
+   ranges of first-level subscripts (one per connection)
+*/
+
+int mg_import_add(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, zval *record)
+{
+   int keyn;
+   zval *keys, *value, *item;
+   zend_string *key[MG_IMPORT_MAXKEY];
+
+   ZVAL_DEREF(record);
+   keys = NULL;
+   value = NULL;
+   if (Z_TYPE_P(record) == IS_ARRAY) {
+      if ((keys = zend_hash_str_find(Z_ARRVAL_P(record), "k", 1))) {
+         value = zend_hash_str_find(Z_ARRVAL_P(record), "v", 1);
+      }
+      else {
+         keys = zend_hash_index_find(Z_ARRVAL_P(record), 0);
+         value = zend_hash_index_find(Z_ARRVAL_P(record), 1);
+      }
+   }
+   if (!keys || !value) {
+      strcpy(p_page->p_srv->error_mess, "Each record must be an array holding the subscripts and the value");
+      p_imp->stop = 2;
+      return 0;
+   }
+
+   ZVAL_DEREF(keys);
+   keyn = 0;
+   if (Z_TYPE_P(keys) == IS_ARRAY) {
+      if (zend_hash_num_elements(Z_ARRVAL_P(keys)) > MG_IMPORT_MAXKEY) {
+         sprintf(p_page->p_srv->error_mess, "Each record must have between 1 and %d subscripts", MG_IMPORT_MAXKEY);
+         p_imp->stop = 2;
+         return 0;
+      }
+      ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(keys), item) {
+         key[keyn ++] = zval_get_string(item);
+      } ZEND_HASH_FOREACH_END();
+   }
+   else {
+      key[keyn ++] = zval_get_string(keys);
+   }
+
+   return mg_import_record(p_page, p_imp, part, parg0, key, keyn, zval_get_string(value));
+}
+
+
+/* Parse an NDJSON record of the form written by m_export(): {"k":[subscripts ...],"v":value} */
+
+int mg_import_json(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, char *line, size_t len)
+{
+   int keyn;
+   char *p, *end;
+   zend_string *key[MG_IMPORT_MAXKEY], *data, *name, *str;
+
+   p = line;
+   end = line + len;
+   keyn = 0;
+   data = NULL;
+   name = NULL;
+
+   p = mg_import_json_space(p, end);
+   if (p == end) {
+      return 1;
+   }
+   if (*p != '{') {
+      goto mg_import_json_error;
+   }
+   p = mg_import_json_space(p + 1, end);
+   if (p < end && *p == '}') {
+      goto mg_import_json_error;
+   }
+
+   for (;;) {
+      if (!(name = mg_import_json_string(&p, end, &(p_imp->line)))) {
+         goto mg_import_json_error;
+      }
+      p = mg_import_json_space(p, end);
+      if (p == end || *p != ':') {
+         goto mg_import_json_error;
+      }
+      p = mg_import_json_space(p + 1, end);
+
+      if (ZSTR_LEN(name) == 1 && ZSTR_VAL(name)[0] == 'k') {
+         if (p == end || *p != '[' || keyn) {
+            goto mg_import_json_error;
+         }
+         p = mg_import_json_space(p + 1, end);
+         if (p < end && *p == ']') {
+            p ++;
+         }
+         else {
+            for (;;) {
+               if (keyn == MG_IMPORT_MAXKEY || !(key[keyn] = mg_import_json_scalar(&p, end, &(p_imp->line)))) {
+                  goto mg_import_json_error;
+               }
+               keyn ++;
+               p = mg_import_json_space(p, end);
+               if (p < end && *p == ',') {
+                  p = mg_import_json_space(p + 1, end);
+                  continue;
+               }
+               if (p < end && *p == ']') {
+                  p ++;
+                  break;
+               }
+               goto mg_import_json_error;
+            }
+         }
+      }
+      else {
+         if (!(str = mg_import_json_scalar(&p, end, &(p_imp->line)))) {
+            goto mg_import_json_error;
+         }
+         if (ZSTR_LEN(name) == 1 && ZSTR_VAL(name)[0] == 'v' && !data) {
+            data = str;
+         }
+         else {
+            zend_string_release(str);
+         }
+      }
+      zend_string_release(name);
+      name = NULL;
+
+      p = mg_import_json_space(p, end);
+      if (p < end && *p == ',') {
+         p = mg_import_json_space(p + 1, end);
+         continue;
+      }
+      if (p < end && *p == '}') {
          break;
-      case 12:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11]);
+      }
+      goto mg_import_json_error;
+   }
+
+   if (!data) {
+      goto mg_import_json_error;
+   }
+
+   return mg_import_record(p_page, p_imp, part, parg0, key, keyn, data);
+
+mg_import_json_error:
+
+   if (name) {
+      zend_string_release(name);
+   }
+   if (data) {
+      zend_string_release(data);
+   }
+   while (keyn) {
+      zend_string_release(key[-- keyn]);
+   }
+   sprintf(p_page->p_srv->error_mess, "Invalid NDJSON record %lu: each line must be an object holding the subscripts (k) and the value (v)", p_imp->records + p_imp->recn + 1);
+   p_imp->stop = 2;
+
+   return 0;
+}
+
+
+char * mg_import_json_space(char *p, char *end)
+{
+   while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+      p ++;
+   }
+   return p;
+}
+
+
+/* A string, number or literal: null is read as an empty string, true and false as 1 and 0 */
+
+zend_string * mg_import_json_scalar(char **pp, char *end, MGBUF *p_buf)
+{
+   char *p;
+
+   p = *pp;
+   if (p < end && *p == '"') {
+      return mg_import_json_string(pp, end, p_buf);
+   }
+   while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+      if (*p == '[' || *p == '{' || *p == '"') {
+         return NULL;
+      }
+      p ++;
+   }
+   if (p == *pp) {
+      return NULL;
+   }
+   if ((p - *pp) == 4 && !strncmp(*pp, "null", 4)) {
+      *pp = p;
+      return zend_string_init("", 0, 0);
+   }
+   if ((p - *pp) == 4 && !strncmp(*pp, "true", 4)) {
+      *pp = p;
+      return zend_string_init("1", 1, 0);
+   }
+   if ((p - *pp) == 5 && !strncmp(*pp, "false", 5)) {
+      *pp = p;
+      return zend_string_init("0", 1, 0);
+   }
+   p_buf->data_size = 0;
+   mg_buf_cat(p_buf, *pp, (unsigned long) (p - *pp));
+   *pp = p;
+
+   return zend_string_init((char *) p_buf->p_buffer, p_buf->data_size, 0);
+}
+
+
+zend_string * mg_import_json_string(char **pp, char *end, MGBUF *p_buf)
+{
+   int n;
+   unsigned long ch, ch2;
+   char *p, *p0;
+   char buffer[8];
+
+   p = *pp;
+   if (p == end || *p != '"') {
+      return NULL;
+   }
+   p ++;
+   p_buf->data_size = 0;
+
+   for (;;) {
+      p0 = p;
+      while (p < end && *p != '"' && *p != '\\') {
+         p ++;
+      }
+      if (p > p0) {
+         mg_buf_cat(p_buf, p0, (unsigned long) (p - p0));
+      }
+      if (p == end) {
+         return NULL;
+      }
+      if (*p == '"') {
          break;
-      case 13:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12]);
+      }
+      if (++ p == end) {
+         return NULL;
+      }
+      n = 1;
+      switch (*p) {
+         case '"':
+         case '\\':
+         case '/':
+            buffer[0] = *p;
+            break;
+         case 'b':
+            buffer[0] = '\b';
+            break;
+         case 'f':
+            buffer[0] = '\f';
+            break;
+         case 'n':
+            buffer[0] = '\n';
+            break;
+         case 'r':
+            buffer[0] = '\r';
+            break;
+         case 't':
+            buffer[0] = '\t';
+            break;
+         case 'u':
+            ch = mg_import_json_hex(p + 1, end);
+            if (ch == 0xffffffff) {
+               return NULL;
+            }
+            p += 4;
+            /* a surrogate pair */
+            if (ch >= 0xd800 && ch <= 0xdbff && (end - p) > 6 && p[1] == '\\' && p[2] == 'u') {
+               ch2 = mg_import_json_hex(p + 3, end);
+               if (ch2 >= 0xdc00 && ch2 <= 0xdfff) {
+                  ch = 0x10000 + ((ch - 0xd800) << 10) + (ch2 - 0xdc00);
+                  p += 6;
+               }
+            }
+            if (ch < 0x80) {
+               buffer[0] = (char) ch;
+            }
+            else if (ch < 0x800) {
+               buffer[0] = (char) (0xc0 | (ch >> 6));
+               buffer[1] = (char) (0x80 | (ch & 0x3f));
+               n = 2;
+            }
+            else if (ch < 0x10000) {
+               buffer[0] = (char) (0xe0 | (ch >> 12));
+               buffer[1] = (char) (0x80 | ((ch >> 6) & 0x3f));
+               buffer[2] = (char) (0x80 | (ch & 0x3f));
+               n = 3;
+            }
+            else {
+               buffer[0] = (char) (0xf0 | (ch >> 18));
+               buffer[1] = (char) (0x80 | ((ch >> 12) & 0x3f));
+               buffer[2] = (char) (0x80 | ((ch >> 6) & 0x3f));
+               buffer[3] = (char) (0x80 | (ch & 0x3f));
+               n = 4;
+            }
+            break;
+         default:
+            return NULL;
+      }
+      mg_buf_cat(p_buf, buffer, (unsigned long) n);
+      p ++;
+   }
+   *pp = p + 1;
+
+   return zend_string_init((char *) p_buf->p_buffer, p_buf->data_size, 0);
+}
+
+
+unsigned long mg_import_json_hex(char *p, char *end)
+{
+   int n;
+   unsigned long ch;
+
+   if ((end - p) < 4) {
+      return 0xffffffff;
+   }
+   ch = 0;
+   for (n = 0; n < 4; n ++) {
+      ch <<= 4;
+      if (p[n] >= '0' && p[n] <= '9')
+         ch |= (unsigned long) (p[n] - '0');
+      else if (p[n] >= 'a' && p[n] <= 'f')
+         ch |= (unsigned long) (p[n] - 'a' + 10);
+      else if (p[n] >= 'A' && p[n] <= 'F')
+         ch |= (unsigned long) (p[n] - 'A' + 10);
+      else
+         return 0xffffffff;
+   }
+
+   return ch;
+}
+
+
+/* Add a record to the current batch: the strings are owned by the batch from here on */
+
+int mg_import_record(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, zend_string **key, int keyn, zend_string *data)
+{
+   int n;
+   MGIMPREC *p_rec;
+   MGIMPKEY *p_key;
+
+   if (keyn < 1 || keyn > MG_IMPORT_MAXKEY) {
+      for (n = 0; n < keyn; n ++) {
+         zend_string_release(key[n]);
+      }
+      zend_string_release(data);
+      sprintf(p_page->p_srv->error_mess, "Each record must have between 1 and %d subscripts", MG_IMPORT_MAXKEY);
+      p_imp->stop = 2;
+      return 0;
+   }
+
+   if ((p_imp->keyn + keyn) > p_imp->keymax) {
+      p_imp->keymax = (p_imp->keymax * 2) + keyn;
+      p_imp->key = (MGIMPKEY *) erealloc((void *) p_imp->key, sizeof(MGIMPKEY) * p_imp->keymax);
+   }
+
+   p_rec = &(p_imp->rec[p_imp->recn]);
+   p_rec->seq = p_imp->recn;
+   p_rec->keyn = keyn;
+   p_rec->key0 = p_imp->keyn;
+   p_rec->key = NULL;
+   p_rec->data = data;
+   for (n = 0; n < keyn; n ++) {
+      p_key = &(p_imp->key[p_imp->keyn ++]);
+      p_key->str = key[n];
+      /* numeric subscripts are converted once here rather than on every comparison */
+      p_key->num = (short) mg_canonical_number((unsigned char *) ZSTR_VAL(key[n]), (int) ZSTR_LEN(key[n]));
+      p_key->value = p_key->num ? strtod(ZSTR_VAL(key[n]), NULL) : 0;
+   }
+   p_imp->recn ++;
+
+   if (p_imp->recn == p_imp->batch) {
+      return mg_import_batch(p_page, p_imp, part, parg0);
+   }
+
+   return 1;
+}
+
+
+int mg_import_batch(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0)
+{
+   int n, rc, rec0, recn;
+
+   for (n = 0; n < p_imp->recn; n ++) {
+      p_imp->rec[n].key = p_imp->key + p_imp->rec[n].key0;
+   }
+   qsort((void *) p_imp->rec, (size_t) p_imp->recn, sizeof(MGIMPREC), mg_import_compare);
+
+   /* contiguous ranges of the sorted batch: the nodes under a first-level subscript are never split between connections */
+   rec0 = 0;
+   for (n = 0; n < p_imp->parts; n ++) {
+      recn = (n == (p_imp->parts - 1)) ? p_imp->recn : (((n + 1) * p_imp->recn) / p_imp->parts);
+      if (recn < rec0) {
+         recn = rec0;
+      }
+      while (recn > rec0 && recn < p_imp->recn && !mg_import_key_compare(p_imp->rec[recn].key, p_imp->rec[recn - 1].key)) {
+         recn ++;
+      }
+      part[n].rec0 = rec0;
+      part[n].recn = recn - rec0;
+      rec0 = recn;
+   }
+
+   rc = 1;
+   if (p_imp->tp) {
+      rc = mg_import_exchange(p_page, p_imp, part, parg0, "a");
+   }
+   if (rc) {
+      for (n = 0; n < p_imp->parts; n ++) {
+         if (part[n].recn) {
+            mg_import_encode(p_page, p_imp, &(part[n]), parg0);
+         }
+      }
+      rc = mg_import_exchange(p_page, p_imp, part, parg0, NULL);
+   }
+   if (p_imp->tp) {
+      if (rc) {
+         rc = mg_import_exchange(p_page, p_imp, part, parg0, "c");
+      }
+      else {
+         mg_import_exchange(p_page, p_imp, part, parg0, "d");
+      }
+   }
+   if (rc) {
+      p_imp->records += p_imp->recn;
+   }
+   mg_import_release(p_imp);
+
+   return rc;
+}
+
+
+/* Encode a range of the batch as a merge ('M') request using the m_merge_to_db() array record format */
+
+int mg_import_encode(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *p_part, zval *parg0)
+{
+   int n, keyn;
+   unsigned char *key[MG_IMPORT_MAXKEY];
+   int ksize[MG_IMPORT_MAXKEY];
+   MGIMPREC *p_rec;
+   MGBUF *p_buf;
+
+   p_buf = &(p_part->io);
+
+   mg_request_header_ex(p_page, p_buf, "M", MG_PRODUCT, parg0);
+   mg_buf_cat(p_buf, (char *) p_imp->ref.p_buffer, p_imp->ref.data_size);
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, NULL, 0, 0, MG_TX_AREC);
+   for (n = 0; n < p_part->recn; n ++) {
+      p_rec = &(p_imp->rec[p_part->rec0 + n]);
+      for (keyn = 0; keyn < p_rec->keyn; keyn ++) {
+         key[keyn] = (unsigned char *) ZSTR_VAL(p_rec->key[keyn].str);
+         ksize[keyn] = (int) ZSTR_LEN(p_rec->key[keyn].str);
+      }
+      mg_array_add_node(p_page, p_part->chndle, p_buf, key, ksize, p_rec->keyn, (unsigned char *) ZSTR_VAL(p_rec->data), (int) ZSTR_LEN(p_rec->data), 0);
+   }
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, NULL, 0, 0, MG_TX_EOD);
+   mg_request_add(p_page->p_srv, p_part->chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+
+   return 1;
+}
+
+
+/* Send the prepared (or, if a command is given, a parameterless) request on every connection with work in this batch, then collect the responses */
+
+int mg_import_exchange(MGPAGE *p_page, MGIMPORT *p_imp, MGIMPART *part, zval *parg0, char *command)
+{
+   int n, rc;
+
+   rc = 1;
+   for (n = 0; n < p_imp->parts; n ++) {
+      part[n].sent = 0;
+      if (!part[n].recn) {
+         continue;
+      }
+      if (command) {
+         mg_request_header_ex(p_page, &(part[n].io), command, MG_PRODUCT, parg0);
+      }
+      if (p_page->p_srv->mem_error == 1) {
+         strcpy(p_page->p_srv->error_mess, "Insufficient memory to process request");
+         rc = 0;
          break;
-      case 14:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13]);
+      }
+      if (!mg_db_send(p_page->p_srv, part[n].chndle, &(part[n].io), 1)) {
+         rc = 0;
          break;
-      case 15:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13], &parameter_array[14]);
+      }
+      part[n].sent = 1;
+   }
+
+   for (n = 0; n < p_imp->parts; n ++) {
+      if (!part[n].sent) {
+         continue;
+      }
+      mg_db_receive(p_page->p_srv, part[n].chndle, &(part[n].io), MG_BUFSIZE, 0);
+      if (!mg_response_error(p_page, &(part[n].io))) {
+         rc = 0;
+      }
+   }
+
+   if (!rc) {
+      p_imp->stop = 2;
+   }
+
+   return rc;
+}
+
+
+int mg_import_compare(const void *p1, const void *p2)
+{
+   int n, cmp;
+   MGIMPREC *p_rec1, *p_rec2;
+
+   p_rec1 = (MGIMPREC *) p1;
+   p_rec2 = (MGIMPREC *) p2;
+
+   for (n = 0; n < p_rec1->keyn && n < p_rec2->keyn; n ++) {
+      cmp = mg_import_key_compare(&(p_rec1->key[n]), &(p_rec2->key[n]));
+      if (cmp) {
+         return cmp;
+      }
+   }
+   if (p_rec1->keyn != p_rec2->keyn) {
+      return (p_rec1->keyn < p_rec2->keyn) ? -1 : 1;
+   }
+
+   /* duplicates are kept in input order so that the last one wins */
+   return (p_rec1->seq < p_rec2->seq) ? -1 : 1;
+}
+
+
+/* M collation (as mg_collate_compare): canonical numbers in numeric order, then strings in byte order */
+
+int mg_import_key_compare(MGIMPKEY *p_key1, MGIMPKEY *p_key2)
+{
+   int cmp;
+   size_t len1, len2;
+
+   if (p_key1->num && p_key2->num) {
+      return (p_key1->value < p_key2->value) ? -1 : ((p_key1->value > p_key2->value) ? 1 : 0);
+   }
+   len1 = ZSTR_LEN(p_key1->str);
+   len2 = ZSTR_LEN(p_key2->str);
+   if (p_key1->num) {
+      return len2 ? -1 : 1;
+   }
+   if (p_key2->num) {
+      return len1 ? 1 : -1;
+   }
+
+   cmp = memcmp((void *) ZSTR_VAL(p_key1->str), (void *) ZSTR_VAL(p_key2->str), (len1 < len2) ? len1 : len2);
+   if (cmp == 0) {
+      return (len1 < len2) ? -1 : ((len1 > len2) ? 1 : 0);
+   }
+
+   return (cmp < 0) ? -1 : 1;
+}
+
+
+int mg_import_release(MGIMPORT *p_imp)
+{
+   int n;
+
+   for (n = 0; n < p_imp->keyn; n ++) {
+      zend_string_release(p_imp->key[n].str);
+   }
+   for (n = 0; n < p_imp->recn; n ++) {
+      zend_string_release(p_imp->rec[n].data);
+   }
+   p_imp->keyn = 0;
+   p_imp->recn = 0;
+
+   return 1;
+}
+
+
+/* v3.4.63 Mg\Cursor and Mg\Query */
+
+zend_object * mg_cursor_create(zend_class_entry *ce)
+{
+   MGCURSOR *p_cursor;
+
+   p_cursor = (MGCURSOR *) ecalloc(1, sizeof(MGCURSOR) + zend_object_properties_size(ce));
+
+   zend_object_std_init(&(p_cursor->std), ce);
+   object_properties_init(&(p_cursor->std), ce);
+   p_cursor->std.handlers = &mg_cursor_handlers;
+
+   p_cursor->type = MG_CURSOR_ORDER;
+   p_cursor->direction = 1;
+   p_cursor->getvalue = 1;
+   p_cursor->eod = 0;
+   p_cursor->batch = MG_CURSOR_BATCH;
+   p_cursor->row_no = 0;
+   p_cursor->row_max = 0;
+   p_cursor->keyn = 0;
+   p_cursor->global_size = 0;
+   p_cursor->server[0] = '\0';
+   p_cursor->start = NULL;
+   p_cursor->stop = NULL;
+   mg_buf_init(&(p_cursor->ref), 256, 256);
+   ZVAL_UNDEF(&(p_cursor->rows));
+
+   return &(p_cursor->std);
+}
+
+
+void mg_cursor_free(zend_object *object)
+{
+   MGCURSOR *p_cursor;
+
+   p_cursor = mg_cursor_fetch(object);
+
+   mg_buf_free(&(p_cursor->ref));
+   if (p_cursor->start) {
+      zend_string_release(p_cursor->start);
+   }
+   if (p_cursor->stop) {
+      zend_string_release(p_cursor->stop);
+   }
+   if (!Z_ISUNDEF(p_cursor->rows)) {
+      zval_ptr_dtor(&(p_cursor->rows));
+   }
+
+   zend_object_std_dtor(object);
+}
+
+
+MGCURSOR * mg_cursor_fetch(zend_object *object)
+{
+   return (MGCURSOR *) ((char *) object - XtOffsetOf(MGCURSOR, std));
+}
+
+
+int mg_cursor_init(MGPAGE *p_page, MGCURSOR *p_cursor, zval *pref, zval *popt, short type)
+{
+   int n, len, offset;
+   char *data;
+   zval *item;
+   zend_string *str;
+
+   p_cursor->type = type;
+
+   ZVAL_DEREF(pref);
+   if (Z_TYPE_P(pref) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(pref)) < 1) {
+      php_error(E_USER_ERROR, "%s", "The global reference must be a non-empty array");
+      return 0;
+   }
+
+   n = 0;
+   offset = 0;
+   ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(pref), item) {
+      str = zval_get_string(item);
+      data = ZSTR_VAL(str);
+      len = (int) ZSTR_LEN(str);
+      if (n == 0 && len && len < (int) sizeof(p_cursor->server) && !strstr(data, "^") && !strstr(data, "$") && !strstr(data, ".")) {
+         strcpy(p_cursor->server, data);
+      }
+      else {
+         mg_request_add(p_page->p_srv, 0, &(p_cursor->ref), (unsigned char *) data, len, 0, MG_TX_DATA);
+         if (offset == 0) {
+            p_cursor->global_size = (int) p_cursor->ref.data_size;
+         }
+         else {
+            p_cursor->keyn ++;
+         }
+         offset ++;
+      }
+      zend_string_release(str);
+      n ++;
+   } ZEND_HASH_FOREACH_END();
+
+   if (!popt) {
+      return 1;
+   }
+   ZVAL_DEREF(popt);
+   if (Z_TYPE_P(popt) != IS_ARRAY) {
+      return 1;
+   }
+
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "batch", 5))) {
+      n = (int) zval_get_long(item);
+      p_cursor->batch = (n > 0) ? n : MG_CURSOR_BATCH;
+   }
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "direction", 9))) {
+      p_cursor->direction = (zval_get_long(item) < 0) ? -1 : 1;
+   }
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "reverse", 7))) {
+      p_cursor->direction = zend_is_true(item) ? -1 : 1;
+   }
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "values", 6))) {
+      p_cursor->getvalue = zend_is_true(item) ? 1 : 0;
+   }
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "start", 5))) {
+      p_cursor->start = zval_get_string(item);
+   }
+   if ((item = zend_hash_str_find(Z_ARRVAL_P(popt), "stop", 4))) {
+      p_cursor->stop = zval_get_string(item);
+   }
+
+   return 1;
+}
+
+
+zval * mg_cursor_item(MGCURSOR *p_cursor, int index)
+{
+   zval *row;
+
+   if (Z_ISUNDEF(p_cursor->rows) || p_cursor->row_no >= p_cursor->row_max) {
+      return NULL;
+   }
+   row = zend_hash_index_find(Z_ARRVAL(p_cursor->rows), p_cursor->row_no);
+   if (!row) {
+      return NULL;
+   }
+
+   return zend_hash_index_find(Z_ARRVAL_P(row), index);
+}
+
+
+/*
+   Fetch the next batch of (up to p_cursor->batch) rows following 'seed'
+   Mg\Cursor uses the batched $Order command ('N') and Mg\Query uses the batched $Query command ('Q')
+*/
+
+int mg_cursor_fill(MGPAGE *p_page, MGCURSOR *p_cursor, zval *seed, int inclusive)
+{
+   MGBUF mgbuf, *p_buf;
+   short byref, type;
+   int n, chndle, hlen, size, stride, itemn, rown;
+   unsigned long offset, total;
+   char buffer[32];
+   unsigned char *p;
+   zval server, row, subs, *item;
+   zend_string *str;
+
+   if (!Z_ISUNDEF(p_cursor->rows)) {
+      zval_ptr_dtor(&(p_cursor->rows));
+   }
+   array_init(&(p_cursor->rows));
+   p_cursor->row_no = 0;
+   p_cursor->row_max = 0;
+
+   p_buf = &mgbuf;
+   mg_buf_init(p_buf, MG_BUFSIZE, MG_BUFSIZE);
+
+   mg_log_request(p_page, p_cursor->type == MG_CURSOR_GLOBALS ? "Mg\\Globals" : (p_cursor->type == MG_CURSOR_QUERY ? "Mg\\Query" : "Mg\\Cursor"));
+
+   n = mg_db_connect(p_page->p_srv, &chndle, 1);
+   if (!n) {
+      p_cursor->eod = 1;
+      mg_buf_free(p_buf);
+      p_page->p_srv->stat.error = 1;
+      mg_stat_end(p_page, 0);
+      return 0;
+   }
+
+   if (p_cursor->server[0]) {
+      ZVAL_STRING(&server, p_cursor->server);
+   }
+   else {
+      ZVAL_NULL(&server);
+   }
+   mg_request_header_ex(p_page, p_buf, p_cursor->type == MG_CURSOR_GLOBALS ? "E" : (p_cursor->type == MG_CURSOR_QUERY ? "Q" : "N"), MG_PRODUCT, &server);
+
+   sprintf(buffer, "%d", p_cursor->batch);
+   mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+
+   if (p_cursor->type != MG_CURSOR_GLOBALS) {
+      sprintf(buffer, "%d", p_cursor->direction);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+   }
+
+   if (p_cursor->type == MG_CURSOR_GLOBALS) {
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) (seed ? "c" : ""), seed ? 1 : 0, 0, MG_TX_DATA);
+      if (p_cursor->start) {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(p_cursor->start), (int) ZSTR_LEN(p_cursor->start), 0, MG_TX_DATA);
+      }
+      else {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+      if (seed) {
+         str = zval_get_string(seed);
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+         zend_string_release(str);
+      }
+      else {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+   }
+   else if (p_cursor->type == MG_CURSOR_QUERY) {
+      strcpy(buffer, p_cursor->getvalue ? "v" : "");
+      if (!seed) {
+         strcat(buffer, "s");
+      }
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+      sprintf(buffer, "%d", p_cursor->keyn);
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+      if (seed && Z_TYPE_P(seed) == IS_ARRAY) {
+         mg_buf_cat(p_buf, (char *) p_cursor->ref.p_buffer, p_cursor->global_size);
+         ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(seed), item) {
+            str = zval_get_string(item);
+            mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+            zend_string_release(str);
+         } ZEND_HASH_FOREACH_END();
+      }
+      else {
+         mg_buf_cat(p_buf, (char *) p_cursor->ref.p_buffer, p_cursor->ref.data_size);
+      }
+   }
+   else {
+      strcpy(buffer, p_cursor->getvalue ? "dv" : "d");
+      if (inclusive) {
+         strcat(buffer, "i");
+      }
+      mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) buffer, (int) strlen(buffer), 0, MG_TX_DATA);
+      if (p_cursor->stop) {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(p_cursor->stop), (int) ZSTR_LEN(p_cursor->stop), 0, MG_TX_DATA);
+      }
+      else {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+      mg_buf_cat(p_buf, (char *) p_cursor->ref.p_buffer, p_cursor->ref.data_size);
+      if (seed) {
+         str = zval_get_string(seed);
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) ZSTR_VAL(str), (int) ZSTR_LEN(str), 0, MG_TX_DATA);
+         zend_string_release(str);
+      }
+      else {
+         mg_request_add(p_page->p_srv, chndle, p_buf, (unsigned char *) "", 0, 0, MG_TX_DATA);
+      }
+   }
+
+   /* a DB Superserver without the batched command: the batch is assembled with the stock commands */
+   n = mg_batch_exchange(p_page, chndle, p_buf, &server);
+   zval_ptr_dtor(&server);
+   if (!n) {
+      mg_db_disconnect(p_page->p_srv, chndle, 1);
+      p_cursor->eod = 1;
+      mg_buf_free(p_buf);
+      p_page->p_srv->stat.error = 1;
+      mg_stat_end(p_page, 0);
+      return 0;
+   }
+
+   mg_db_disconnect(p_page->p_srv, chndle, 1);
+
+   if (mg_php_error(p_page, (char *) p_buf->p_buffer)) {
+      p_cursor->eod = 1;
+      mg_buf_free(p_buf);
+      mg_stat_end(p_page, 0);
+      return 1;
+   }
+
+   p = p_buf->p_buffer + MG_RECV_HEAD;
+   total = (p_buf->data_size > MG_RECV_HEAD) ? (p_buf->data_size - MG_RECV_HEAD) : 0;
+   offset = 0;
+   rown = 0;
+
+   if (p_cursor->type == MG_CURSOR_QUERY) {
+      /* each row: number of subscripts, subscripts ... [, value] */
+      while (offset < total) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         offset += hlen;
+         if (size < 0 || size > 30 || (offset + size) > total) {
+            break;
+         }
+         strncpy(buffer, (char *) p + offset, size);
+         buffer[size] = '\0';
+         offset += size;
+         stride = (int) strtol(buffer, NULL, 10) + (p_cursor->getvalue ? 1 : 0);
+
+         array_init(&row);
+         array_init(&subs);
+         for (itemn = 0; itemn < stride && offset < total; itemn ++) {
+            hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+            offset += hlen;
+            if (size < 0 || (offset + size) > total) {
+               offset = total;
+               break;
+            }
+            if (p_cursor->getvalue && itemn == (stride - 1)) {
+               add_next_index_zval(&row, &subs);
+               ZVAL_UNDEF(&subs);
+               add_next_index_stringl(&row, (char *) p + offset, size);
+            }
+            else {
+               add_next_index_stringl(&subs, (char *) p + offset, size);
+            }
+            offset += size;
+         }
+         if (!Z_ISUNDEF(subs)) {
+            add_next_index_zval(&row, &subs);
+         }
+         if (itemn < stride) {
+            zval_ptr_dtor(&row);
+            break;
+         }
+         add_next_index_zval(&(p_cursor->rows), &row);
+         rown ++;
+      }
+   }
+   else {
+      /* each row: subscript, $Data [, value] or (Mg\\Globals) global name */
+      stride = (p_cursor->type == MG_CURSOR_GLOBALS) ? 1 : (p_cursor->getvalue ? 3 : 2);
+      itemn = 0;
+      ZVAL_UNDEF(&row);
+
+      while (offset < total) {
+         hlen = mg_decode_item_header(p + offset, &size, &byref, &type);
+         offset += hlen;
+         if (size < 0 || (offset + size) > total) {
+            break;
+         }
+         n = itemn % stride;
+         if (n == 0) {
+            array_init(&row);
+         }
+         if (n == 1) {
+            if (size > 30) {
+               size = 30;
+            }
+            strncpy(buffer, (char *) p + offset, size);
+            buffer[size] = '\0';
+            add_next_index_long(&row, (long) strtol(buffer, NULL, 10));
+         }
+         else {
+            add_next_index_stringl(&row, (char *) p + offset, size);
+         }
+         offset += size;
+         itemn ++;
+         if ((itemn % stride) == 0) {
+            add_next_index_zval(&(p_cursor->rows), &row);
+            ZVAL_UNDEF(&row);
+            rown ++;
+         }
+      }
+      if (!Z_ISUNDEF(row)) {
+         zval_ptr_dtor(&row);
+      }
+   }
+
+   p_cursor->row_max = rown;
+   if (rown < p_cursor->batch) {
+      p_cursor->eod = 1;
+   }
+
+   mg_buf_free(p_buf);
+   mg_stat_end(p_page, 0);
+
+   return 1;
+}
+
+
+int mg_cursor_error(MGPAGE *p_page, char *error)
+{
+   if (p_page && p_page->p_log->log_errors)
+      mg_log_event(p_page->p_log, error, "Error Condition", 0);
+   if (p_page && p_page->p_srv->error_mode == 1)
+      php_error(E_USER_WARNING, "%s", error);
+   else if (p_page && p_page->p_srv->error_mode == 9)
+      return 2;
+   else
+      php_error(E_USER_ERROR, "%s", error);
+
+   return 1;
+}
+
+
+
+/* v3.4.63 function statistics */
+
+int mg_stat_begin(MGPAGE *p_page, char *function)
+{
+   int fun;
+   MGSTATCALL *p_stat;
+
+   if (!p_page) {
+      return 0;
+   }
+   p_stat = &(p_page->p_srv->stat);
+
+   /* the previous function did not return normally */
+   if (p_stat->active) {
+      mg_stat_end(p_page, 1);
+   }
+
+   fun = mg_stat_function(function);
+   if (fun < 0) {
+      return 0;
+   }
+
+   memset((void *) p_stat, 0, sizeof(MGSTATCALL));
+   p_stat->fun = fun;
+   p_stat->chndle = -1;
+   p_stat->start = mg_time_ns();
+   p_stat->active = 1;
+
+   return 1;
+}
+
+
+/* context: 0 = normal return; 1 = the function did not return normally (no timings are recorded); 2 = bad arguments */
+
+int mg_stat_end(MGPAGE *p_page, int context)
+{
+   int n;
+   unsigned long long t1;
+   MGSTATCALL *p_stat;
+   MGSTATFUN *p_fun;
+
+   if (!p_page || !p_page->p_srv->stat.active) {
+      return 0;
+   }
+   p_stat = &(p_page->p_srv->stat);
+   p_stat->active = 0;
+
+   p_fun = mg_stat_fun[p_stat->fun];
+   if (!p_fun) {
+      return 0;
+   }
+
+   MG_STAT_ADD(&(p_fun->calls), 1);
+   if (context || p_stat->error) {
+      MG_STAT_ADD(&(p_fun->errors), 1);
+   }
+   MG_STAT_ADD(&(p_fun->bytes_sent), p_stat->bytes_sent);
+   MG_STAT_ADD(&(p_fun->bytes_recv), p_stat->bytes_recv);
+
+   if (context == 1) {
+      MG_PROBE3(function__return, p_fun->name, 0, 1);
+      mg_metrics_record(p_fun, p_stat, context);
+      return 1;
+   }
+
+   t1 = mg_time_ns();
+   p_stat->phase[MG_STAT_TOTAL] = t1 - p_stat->start;
+   if (p_stat->received) {
+      p_stat->phase[MG_STAT_DECODE] = t1 - p_stat->received;
+   }
+
+   MG_PROBE3(function__return, p_fun->name, p_stat->phase[MG_STAT_TOTAL], (context || p_stat->error));
+
+   /* phases not entered by this function (for example, m_set_log_level() does not connect) are not recorded */
+   for (n = 0; n < MG_STAT_PHASES; n ++) {
+      if (n != MG_STAT_TOTAL && !p_stat->phase[n]) {
+         continue;
+      }
+      MG_STAT_ADD(&(p_fun->sum[n]), p_stat->phase[n]);
+      MG_STAT_ADD(&(p_fun->hist[n][mg_stat_bucket(p_stat->phase[n])]), 1);
+   }
+
+   mg_metrics_record(p_fun, p_stat, context);
+
+   if (p_page->slow_ns && p_stat->phase[MG_STAT_TOTAL] >= p_page->slow_ns) {
+      mg_slowlog_record(p_page, p_fun, p_stat);
+   }
+   if (p_page->access_min) {
+      mg_access_record(p_page, p_fun, p_stat);
+   }
+   if (mg_hotkeys) {
+      mg_hotkeys_record(p_fun);
+   }
+
+   return 1;
+}
+
+
+/* find (or create) the statistics slot for a function: slots are never moved or released while the module is loaded */
+
+int mg_stat_function(char *function)
+{
+   int n, hash, fun;
+   char *p;
+   MGSTATFUN *p_fun;
+
+   hash = 0;
+   for (p = function; *p; p ++) {
+      hash = ((hash * 31) + (unsigned char) *p) & 0xffff;
+   }
+   hash = hash % MG_STAT_MAXFUN;
+
+   for (n = 0; n < MG_STAT_MAXFUN; n ++) {
+      fun = (hash + n) % MG_STAT_MAXFUN;
+      p_fun = mg_stat_fun[fun];
+      if (!p_fun) {
          break;
-      case 16:
-         n = zend_parse_parameters(argument_count, "z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/z/", &parameter_array[0], &parameter_array[1], &parameter_array[2], &parameter_array[3], &parameter_array[4], &parameter_array[5], &parameter_array[6], &parameter_array[7], &parameter_array[8], &parameter_array[9], &parameter_array[10], &parameter_array[11], &parameter_array[12], &parameter_array[13], &parameter_array[14], &parameter_array[15]);
+      }
+      if (!strcmp(p_fun->name, function)) {
+         return fun;
+      }
+   }
+   if (n == MG_STAT_MAXFUN) {
+      return -1;
+   }
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   for (; n < MG_STAT_MAXFUN; n ++) {
+      fun = (hash + n) % MG_STAT_MAXFUN;
+      p_fun = mg_stat_fun[fun];
+      if (!p_fun) {
+         /* not mg_malloc(): under ZTS that allocates from the request's memory */
+         p_fun = (MGSTATFUN *) malloc(sizeof(MGSTATFUN));
+         if (!p_fun) {
+            fun = -1;
+            break;
+         }
+         memset((void *) p_fun, 0, sizeof(MGSTATFUN));
+         strncpy(p_fun->name, function, sizeof(p_fun->name) - 1);
+         p_fun->metric = -1;
+         mg_stat_fun[fun] = p_fun;
          break;
-      default:
-         n = FAILURE;
+      }
+      if (!strcmp(p_fun->name, function)) {
          break;
+      }
    }
-   return n;
+   if (n == MG_STAT_MAXFUN) {
+      fun = -1;
+   }
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   return fun;
 }
 
 
-static const char *mg_array_lookup_string(HashTable *ht, const char *idx)
+/* values below 8ns have a bucket each; above that each power of 2 is divided into 8 equal buckets (a relative error of no more than 12.5%) */
+
+int mg_stat_bucket(unsigned long long value)
 {
-   zval *pvalue;
-   zend_string *key;
+   int e;
 
-   key = zend_string_init(idx, strlen(idx), 0);
-   if (ht && (pvalue = zend_hash_find(ht, key))) {
-      SEPARATE_ZVAL(pvalue);
-      convert_to_string_ex(pvalue);
-      zend_string_release(key);
-      return Z_STRVAL_P(pvalue);
+   if (value < MG_STAT_SUBBUCKETS) {
+      return (int) value;
    }
+   for (e = MG_STAT_SUBBITS; e < MG_STAT_MAXEXP && (value >> (e + 1)); e ++)
+      ;
+   if (value >> (e + 1)) {
+      return MG_STAT_BUCKETS - 1;
+   }
+   return ((e - MG_STAT_SUBBITS + 1) * MG_STAT_SUBBUCKETS) + (int) ((value >> (e - MG_STAT_SUBBITS)) & (MG_STAT_SUBBUCKETS - 1));
+}
 
-   return 0;
+
+/* the highest value counted in a bucket */
+
+unsigned long long mg_stat_bucket_value(int bucket)
+{
+   int e, sub;
+
+   if (bucket < MG_STAT_SUBBUCKETS) {
+      return (unsigned long long) bucket;
+   }
+   e = (bucket / MG_STAT_SUBBUCKETS) + MG_STAT_SUBBITS - 1;
+   sub = bucket % MG_STAT_SUBBUCKETS;
+
+   return ((unsigned long long) (MG_STAT_SUBBUCKETS + sub + 1) << (e - MG_STAT_SUBBITS)) - 1;
 }
 
 
-int mg_array_add_record(zval *ppa, MGAREC * p_arec, int mode)
+unsigned long long mg_stat_count(MGSTATFUN *p_fun, int phase)
 {
-   int kn;
-   unsigned long index;
-	zval *pk[MG_MAXKEY];
-   zval *zv = NULL;
-   zval *ppk[MG_MAXKEY];
-   HashTable *ht[MG_MAXKEY];
+   int n;
+   unsigned long long count;
 
-/* v3.3.59 */
-#if PHP_MAJOR_VERSION >= 8
-#else
-   TSRMLS_FETCH();
-#endif
+   count = 0;
+   for (n = 0; n < MG_STAT_BUCKETS; n ++) {
+      count += p_fun->hist[phase][n];
+   }
+   return count;
+}
 
-   if (p_arec->kn < 1) {
+
+unsigned long long mg_stat_percentile(MGSTATFUN *p_fun, int phase, unsigned long long count, double percentile)
+{
+   int n;
+   unsigned long long target, total;
+
+   if (!count) {
       return 0;
    }
+   target = (unsigned long long) (((double) count * percentile) / 100.0);
+   if (target < 1) {
+      target = 1;
+   }
 
-   mg_array_terminate_strings(p_arec);
+   total = 0;
+   for (n = 0; n < MG_STAT_BUCKETS; n ++) {
+      total += p_fun->hist[phase][n];
+      if (total >= target) {
+         return mg_stat_bucket_value(n);
+      }
+   }
+   return mg_stat_bucket_value(MG_STAT_BUCKETS - 1);
+}
 
-   for (kn = 0; p_arec->krec[kn]; kn ++) {
-      p_arec->krec_ex[kn] = zend_string_init(p_arec->krec[kn], strlen(p_arec->krec[kn]), 0);
+
+/* latencies are reported in microseconds; the histogram is keyed by the upper bound (nanoseconds) of each occupied bucket */
+
+int mg_stat_phase_array(zval *phase, MGSTATFUN *p_fun, int n)
+{
+   int b;
+   unsigned long long count, max;
+   zval hist;
+
+   count = mg_stat_count(p_fun, n);
+
+   array_init(phase);
+   add_assoc_long(phase, "count", (long) count);
+   add_assoc_double(phase, "mean", count ? ((double) p_fun->sum[n] / (double) count) / 1000.0 : 0.0);
+   add_assoc_double(phase, "p50", (double) mg_stat_percentile(p_fun, n, count, 50.0) / 1000.0);
+   add_assoc_double(phase, "p90", (double) mg_stat_percentile(p_fun, n, count, 90.0) / 1000.0);
+   add_assoc_double(phase, "p99", (double) mg_stat_percentile(p_fun, n, count, 99.0) / 1000.0);
+   add_assoc_double(phase, "p999", (double) mg_stat_percentile(p_fun, n, count, 99.9) / 1000.0);
+
+   max = 0;
+   array_init(&hist);
+   for (b = 0; b < MG_STAT_BUCKETS; b ++) {
+      if (p_fun->hist[n][b]) {
+         max = mg_stat_bucket_value(b);
+         add_index_long(&hist, (zend_ulong) max, (long) p_fun->hist[n][b]);
+      }
    }
+   add_assoc_double(phase, "max", (double) max / 1000.0);
+   add_assoc_zval(phase, "histogram", &hist);
 
-   ppk[0] = ppa;
-   for (kn = 0; p_arec->krec[kn]; kn ++) {
-      if (!p_arec->krec[kn + 1]) {
-         add_assoc_string(ppk[kn], p_arec->krec[kn], p_arec->vrec);
-         break;
+   return 1;
+}
+
+
+int mg_stat_reset(void)
+{
+   int n;
+   MGSTATFUN *p_fun;
+
+   for (n = 0; n < MG_STAT_MAXFUN; n ++) {
+      p_fun = mg_stat_fun[n];
+      if (p_fun) {
+         memset((void *) &(p_fun->calls), 0, sizeof(MGSTATFUN) - offsetof(MGSTATFUN, calls));
       }
+   }
+   mg_stat_since = time(NULL);
 
-	   ht[kn] = HASH_OF(ppk[kn]);
+   return 1;
+}
 
-      zv = NULL;
-      if (!strcmp(p_arec->krec[kn], "0")) {
-         index = 0;
-         zv = zend_hash_index_find(ht[kn], index);
-         if (zv == NULL) {
-            zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
-         }
+
+int mg_stat_release(void)
+{
+   int n;
+
+   for (n = 0; n < MG_STAT_MAXFUN; n ++) {
+      if (mg_stat_fun[n]) {
+         free((void *) mg_stat_fun[n]);
+         mg_stat_fun[n] = NULL;
+      }
+   }
+
+   return 1;
+}
+
+
+
+/* v3.4.63 metrics published for m_metrics_export() */
+
+int mg_metrics_init(int workers)
+{
+   size_t size;
+   MGMETRICS *p_metrics;
+
+   if (workers > MG_METRICS_MAXWORKERS) {
+      workers = MG_METRICS_MAXWORKERS;
+   }
+   size = offsetof(MGMETRICS, slot) + (sizeof(MGMETSLOT) * (workers > 0 ? workers : 1));
+
+   p_metrics = NULL;
+#if !defined(_WIN32)
+   /* created before the worker processes are forked, so that they all inherit the same memory */
+   if (workers > 0) {
+      p_metrics = (MGMETRICS *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (p_metrics == (MGMETRICS *) MAP_FAILED) {
+         p_metrics = NULL;
+         workers = 0;
+         size = offsetof(MGMETRICS, slot) + sizeof(MGMETSLOT);
+      }
+   }
+#else
+   workers = 0;
+   size = offsetof(MGMETRICS, slot) + sizeof(MGMETSLOT);
+#endif
+
+   if (!p_metrics) {
+      p_metrics = (MGMETRICS *) malloc(size);
+      if (!p_metrics) {
+         return 0;
+      }
+   }
+   memset((void *) p_metrics, 0, size);
+   p_metrics->shared = (workers > 0);
+   p_metrics->workers = (workers > 0 ? workers : 1);
+   p_metrics->size = size;
+
+   mg_metrics = p_metrics;
+
+   return 1;
+}
+
+
+/* called at the start of each request: a new (or forked) process claims a slot */
+
+int mg_metrics_attach(void)
+{
+   int n, pid;
+   MGMETSLOT *p_slot;
+
+   if (!mg_metrics) {
+      return 0;
+   }
+   if (mg_metrics_pid == mg_current_process_id()) {
+      if (mg_metrics_slot) {
+         MG_STAT_ADD(&(mg_metrics_slot->requests), 1);
+      }
+      return 1;
+   }
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+
+   if (mg_metrics_pid != mg_current_process_id()) {
+      mg_metrics_pid = mg_current_process_id();
+      mg_metrics_slot = NULL;
+
+      if (!mg_metrics->shared) {
+         mg_metrics_slot = &(mg_metrics->slot[0]);
+         memset((void *) mg_metrics_slot, 0, sizeof(MGMETSLOT));
+         mg_metrics_slot->pid = (int) mg_metrics_pid;
       }
+#if !defined(_WIN32)
       else {
-         index = (int) strtol(p_arec->krec[kn], NULL, 10);
-         if (index != 0) {
-            zv = zend_hash_index_find(ht[kn], index);
-            if (zv == NULL) {
-               zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
+         /* take a free slot, or one left by a worker that has exited; its counters carry on from where they were */
+         for (n = 0; n < mg_metrics->workers && !mg_metrics_slot; n ++) {
+            p_slot = &(mg_metrics->slot[n]);
+            pid = p_slot->pid;
+            if (pid && (kill((pid_t) pid, 0) == 0 || errno != ESRCH)) {
+               continue;
+            }
+            if (__sync_bool_compare_and_swap(&(p_slot->pid), pid, (int) mg_metrics_pid)) {
+               p_slot->pool.open = 0;
+               p_slot->pool.in_use = 0;
+               mg_metrics_slot = p_slot;
             }
-         }
-         else {
-            zv = zend_hash_find(ht[kn], (zend_string *) p_arec->krec_ex[kn]);
          }
       }
-/*
-      zend_printf("\r\n*** NEW zend_hash_find: kn=%d; ht[kn]=%p; p_arec->krec[kn]=%s; ppk[kn]=%p; zv=%p", kn, ht[kn], p_arec->krec[kn], ppk[kn], zv);
-*/
-      if (ht[kn] && zv != NULL) {
-         ppk[kn] = zv;
-         if (Z_TYPE_P(ppk[kn]) == IS_ARRAY) {
-            ppk[kn + 1] = ppk[kn];
+#endif
+
+      if (mg_metrics_slot) {
+         if (!mg_metrics_pool) {
+            mg_metrics_pool = dbx_pool_stat;
          }
-         else {
-/*
-	         MAKE_STD_ZVAL(pk[kn + 1]);
-            ZVAL_NEW_EMPTY_REF(pk[kn + 1]);
-*/
-            pk[kn + 1] = emalloc(sizeof(zval));
-            ppk[kn + 1] = pk[kn + 1];
-	         array_init(ppk[kn + 1]);
-            add_assoc_zval(ppk[kn], p_arec->krec[kn], ppk[kn + 1]);
+         dbx_pool_stat = &(mg_metrics_slot->pool);
+      }
+   }
+
+   if (mg_metrics_slot) {
+      MG_STAT_ADD(&(mg_metrics_slot->requests), 1);
+   }
+
+   mg_leave_critical_section((void *) &dbx_global_mutex);
+
+   return 1;
+}
+
+
+/* find (or add) a function in the table of names shared by all workers: 0 = free; 1 = being added; 2 = ready */
+
+int mg_metrics_function(char *function)
+{
+   int n, state;
+
+   for (n = 0; n < MG_METRICS_MAXFUN; n ++) {
+      state = mg_metrics->fun_state[n];
+      if (state == 0) {
+#if defined(_WIN32)
+         if (InterlockedCompareExchange((volatile LONG *) &(mg_metrics->fun_state[n]), 1, 0) != 0) {
+#else
+         if (!__sync_bool_compare_and_swap(&(mg_metrics->fun_state[n]), 0, 1)) {
+#endif
+            n --;
+            continue;
          }
-	   }
-      else {
-         pk[kn + 1] = emalloc(sizeof(zval));
-         ppk[kn + 1] = pk[kn + 1];
-	      array_init(ppk[kn + 1]);
-         add_assoc_zval(ppk[kn], p_arec->krec[kn], ppk[kn + 1]);
+         strncpy(mg_metrics->fun_name[n], function, sizeof(mg_metrics->fun_name[n]) - 1);
+#if defined(_WIN32)
+         MemoryBarrier();
+#else
+         __sync_synchronize();
+#endif
+         mg_metrics->fun_state[n] = 2;
+         return n;
+      }
+      while (mg_metrics->fun_state[n] == 1) {
+         mg_sleep(0);
+      }
+      if (!strcmp(mg_metrics->fun_name[n], function)) {
+         return n;
+      }
+   }
+
+   return -1;
+}
+
+
+int mg_metrics_record(MGSTATFUN *p_fun, MGSTATCALL *p_stat, int context)
+{
+   int n;
+   MGMETFUN *p_mfun;
+
+   if (!mg_metrics_slot) {
+      return 0;
+   }
+   if (p_fun->metric < 0) {
+      p_fun->metric = mg_metrics_function(p_fun->name);
+      if (p_fun->metric < 0) {
+         return 0;
       }
+   }
+   p_mfun = &(mg_metrics_slot->fun[p_fun->metric]);
 
+   MG_STAT_ADD(&(p_mfun->calls), 1);
+   if (context || p_stat->error) {
+      MG_STAT_ADD(&(p_mfun->errors), 1);
    }
+   MG_STAT_ADD(&(p_mfun->bytes_sent), p_stat->bytes_sent);
+   MG_STAT_ADD(&(p_mfun->bytes_recv), p_stat->bytes_recv);
 
-   for (kn = 0; p_arec->krec[kn]; kn ++) {
-      zend_string_release(p_arec->krec_ex[kn]);
+   if (context == 1) {
+      return 1;
    }
 
-   mg_array_reset_strings(p_arec);
+   MG_STAT_ADD(&(p_mfun->sum), p_stat->phase[MG_STAT_TOTAL]);
+   for (n = 0; n < MG_METRICS_BUCKETS && p_stat->phase[MG_STAT_TOTAL] > mg_metrics_le[n]; n ++)
+      ;
+   MG_STAT_ADD(&(p_mfun->bucket[n]), 1);
 
    return 1;
-
 }
 
 
-int mg_akey_init(MGAKEY *p_akey)
+int mg_metrics_family(MGBUF *p_buf, char *name, char *type, char *unit, char *help)
 {
-   int n;
+   char buffer[256];
 
-   for (n = 0; n < MG_MAXKEY; n ++) {
-      p_akey->krec[n] = NULL;
-      p_akey->ksize[n] = 0;
-      p_akey->kmemsize[n] = 0;
-      p_akey->zval_subarray[n] = NULL;
+   sprintf(buffer, "# TYPE %s %s\n", name, type);
+   mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+   if (unit) {
+      sprintf(buffer, "# UNIT %s %s\n", name, unit);
+      mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
    }
-   p_akey->kn = 0;
-   p_akey->zval_array = NULL;
-   return 0;
+   sprintf(buffer, "# HELP %s %s\n", name, help);
+   mg_buf_cat(p_buf, buffer, (unsigned long) strlen(buffer));
+
+   return 1;
 }
 
 
-int mg_akey_free(MGAKEY *p_akey)
+int mg_metrics_release(void)
 {
-   int n;
-
-   for (n = 0; n < MG_MAXKEY; n ++) {
-      if (p_akey->krec[n]) {
-         mg_free((void *) p_akey->krec[n], 0);
-      }
-      p_akey->krec[n] = NULL;
-      p_akey->ksize[n] = 0;
-      p_akey->kmemsize[n] = 0;
+   if (!mg_metrics) {
+      return 0;
    }
 
-   return 0;
-}
-
-
-zval * mg_array_subarray_zval(MGAKEY *p_akey, MGAREC * p_arec)
-{
-   int n, kn, newsub;
+   if (mg_metrics_pool) {
+      dbx_pool_stat = mg_metrics_pool;
+   }
 
-   if (p_arec->kn < 2) {
-      return p_akey->zval_array;
+#if !defined(_WIN32)
+   if (mg_metrics->shared) {
+      munmap((void *) mg_metrics, mg_metrics->size);
+   }
+   else {
+      free((void *) mg_metrics);
    }
+#else
+   free((void *) mg_metrics);
+#endif
+   mg_metrics = NULL;
+   mg_metrics_slot = NULL;
+   mg_metrics_pid = 0;
 
-   for (kn = 0; kn < (p_arec->kn - 1); kn ++) {
-      newsub = 0;
-      if (p_akey->zval_subarray[kn] == NULL) {
-         newsub = 1;
-      }
-      else if (p_akey->ksize[kn] == 0) {
-         newsub = 1;
-      }
-      else if (p_akey->ksize[kn] != p_arec->ksize[kn] || strcmp(p_akey->krec[kn], p_arec->krec[kn])) {
-         /*
-         zend_printf("\r\n   ===> Difference at kn=%d; p_akey->ksize[kn]=%d; p_arec->ksize[kn]=%d; p_akey->krec[kn]=%s; p_arec->krec[kn]=%s;", kn, p_akey->ksize[kn], p_arec->ksize[kn], p_akey->krec[kn], p_arec->krec[kn]);
-         */
-         newsub = 1;
-      }
+   return 1;
+}
 
-      if (newsub) {
 
-         p_akey->zval_subarray[kn + 1] = (zval *) emalloc(sizeof(zval));
-         array_init(p_akey->zval_subarray[kn + 1]);
 
-         add_assoc_zval(p_akey->zval_subarray[kn], p_arec->krec[kn], p_akey->zval_subarray[kn + 1]);
-         /*
-         zend_printf("\r\n      ===> New PHP array at kn=%d; zval=%p; name=%s; new_array=%p;", kn, p_akey->zval_subarray[kn], p_arec->krec[kn], p_akey->zval_subarray[kn + 1]);
-         */
-         /*
-         zend_printf("\r\n      ===> New PHP array at kn=%d; p_akey->ksize[kn]=%d; p_arec->ksize[kn]=%d; p_akey->krec[kn]=%s; p_arec->krec[kn]=%s;", kn, p_akey->ksize[kn], p_arec->ksize[kn], p_akey->krec[kn], p_arec->krec[kn]);
-         */
-         for (n = kn + 1; n < MG_MAXKEY; n ++) {
-            p_akey->ksize[n] = 0;
-         }
+/* v3.4.63 slow call log: the arguments and call site are taken from the PHP call frame, which is still current when the function returns */
 
-         if (p_akey->kmemsize[kn] < (p_arec->ksize[kn] + 32)) {
-            p_akey->kmemsize[kn] = p_arec->ksize[kn] + 126;
-            p_akey->krec[kn] = (unsigned char *) mg_malloc(p_akey->kmemsize[kn] * sizeof(char), 0);
-            if (!p_akey->krec[kn]) {
-               return NULL;
-            }
+int mg_slowlog_record(MGPAGE *p_page, MGSTATFUN *p_fun, MGSTATCALL *p_stat)
+{
+   int n, argc, len;
+   char buffer[512];
+   zend_execute_data *ex;
+   zval *arg;
+   MGSLOW *p_slow, slow;
+
+   memset((void *) &slow, 0, sizeof(MGSLOW));
+   slow.time = time(NULL);
+   slow.duration = p_stat->phase[MG_STAT_TOTAL];
+   slow.wait = p_stat->phase[MG_STAT_WAIT];
+   slow.bytes_sent = p_stat->bytes_sent;
+   slow.bytes_recv = p_stat->bytes_recv;
+   slow.chndle = p_stat->chndle;
+   strncpy(slow.function, p_fun->name, sizeof(slow.function) - 1);
+
+   if (p_page->p_srv->mode == 2) {
+      sprintf(slow.mpid, "%lu", (unsigned long) mg_current_process_id());
+   }
+   else if (p_stat->chndle >= 0 && p_stat->chndle < MG_MAXCON && p_page->p_srv->pcon[p_stat->chndle]) {
+      strncpy(slow.mpid, p_page->p_srv->pcon[p_stat->chndle]->mpid, sizeof(slow.mpid) - 1);
+   }
+
+   ex = EG(current_execute_data);
+   if (ex && ex->func && ex->func->type == ZEND_INTERNAL_FUNCTION) {
+      argc = (int) ZEND_CALL_NUM_ARGS(ex);
+      len = 0;
+      for (n = 0; n < argc && len < (int) sizeof(slow.args) - 8; n ++) {
+         arg = ZEND_CALL_ARG(ex, n + 1);
+         if (n) {
+            slow.args[len ++] = ',';
+            slow.args[len ++] = ' ';
          }
-
-         memcpy(p_akey->krec[kn], p_arec->krec[kn], p_arec->ksize[kn]);
-         p_akey->krec[kn][p_arec->ksize[kn]] = '\0';
-         p_akey->ksize[kn] = p_arec->ksize[kn];
+         len += mg_slowlog_arg(slow.args + len, (int) sizeof(slow.args) - len, arg, slow.name, (int) sizeof(slow.name), 0);
       }
    }
+   if (zend_is_executing()) {
+      strncpy(slow.file, zend_get_executed_filename(), sizeof(slow.file) - 1);
+      slow.line = (int) zend_get_executed_lineno();
+   }
 
-   /*
-   zend_printf("\r\n =========> sub array p_arec->kn=%d; p_arec->krec[kn-1]=%s; subarray=%p", p_arec->kn, p_arec->krec[kn-1], p_akey->zval_subarray[p_arec->kn - 1]); 
-   */
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+   p_slow = &(mg_slowlog[mg_slowlog_next % MG_SLOWLOG_SIZE]);
+   memcpy((void *) p_slow, (void *) &slow, sizeof(MGSLOW));
+   mg_slowlog_next ++;
+   mg_leave_critical_section((void *) &dbx_global_mutex);
 
-   return p_akey->zval_subarray[p_arec->kn - 1];
+   if (p_page->slow_log) {
+      snprintf(buffer, sizeof(buffer), "%s(%s) took %.3fms (wait %.3fms); sent=%llu; received=%llu; chndle=%d; server_pid=%s; at %s:%d", slow.function, slow.args, (double) slow.duration / 1000000.0, (double) slow.wait / 1000000.0, slow.bytes_sent, slow.bytes_recv, slow.chndle, slow.mpid, slow.file, slow.line);
+      mg_log_event(p_page->p_log, buffer, "Slow Call", 0);
+   }
+
+   return 1;
 }
 
 
-int mg_array_terminate_strings(MGAREC * p_arec)
+/* format an argument (truncated) for the slow call log: the first string containing '^' (a global or routine) is also taken as the name */
+
+int mg_slowlog_arg(char *buffer, int size, zval *arg, char *name, int name_size, int depth)
 {
-   int kn;
+   int len, n;
+   zval *item;
 
-   p_arec->krec[p_arec->kn] = NULL;
-   for (kn = 0; kn < p_arec->kn; kn ++) {
-      p_arec->kz[kn] = *(p_arec->krec[kn] + p_arec->ksize[kn]);
-      *(p_arec->krec[kn] + p_arec->ksize[kn]) = '\0';
+   if (size < 8) {
+      *buffer = '\0';
+      return 0;
    }
-   p_arec->vz = *(p_arec->vrec + p_arec->vsize);
-   *(p_arec->vrec + p_arec->vsize) = '\0';
-
-   return 0;
-}
 
+   ZVAL_DEREF(arg);
+   len = 0;
 
-int mg_array_reset_strings(MGAREC * p_arec)
-{
-   int kn;
-
-   for (kn = 0; kn < p_arec->kn; kn ++) {
-      *(p_arec->krec[kn] + p_arec->ksize[kn]) = p_arec->kz[kn];
+   switch (Z_TYPE_P(arg)) {
+      case IS_STRING:
+         if (!name[0] && memchr(Z_STRVAL_P(arg), '^', Z_STRLEN_P(arg))) {
+            strncpy(name, Z_STRVAL_P(arg), name_size - 1);
+            name[name_size - 1] = '\0';
+         }
+         n = (int) Z_STRLEN_P(arg);
+         if (n > MG_SLOWLOG_MAXARG) {
+            n = MG_SLOWLOG_MAXARG;
+         }
+         if (n > size - 6) {
+            n = size - 6;
+         }
+         buffer[len ++] = '"';
+         memcpy(buffer + len, Z_STRVAL_P(arg), n);
+         len += n;
+         if (n < (int) Z_STRLEN_P(arg)) {
+            buffer[len ++] = '.';
+            buffer[len ++] = '.';
+         }
+         buffer[len ++] = '"';
+         buffer[len] = '\0';
+         break;
+      case IS_LONG:
+         len = snprintf(buffer, size, "%ld", (long) Z_LVAL_P(arg));
+         break;
+      case IS_DOUBLE:
+         len = snprintf(buffer, size, "%g", Z_DVAL_P(arg));
+         break;
+      case IS_TRUE:
+         len = snprintf(buffer, size, "true");
+         break;
+      case IS_FALSE:
+         len = snprintf(buffer, size, "false");
+         break;
+      case IS_NULL:
+         len = snprintf(buffer, size, "null");
+         break;
+      case IS_ARRAY:
+         if (depth > 0) {
+            len = snprintf(buffer, size, "[...]");
+            break;
+         }
+         buffer[len ++] = '[';
+         n = 0;
+         ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arg), item) {
+            if (len > size - 16) {
+               break;
+            }
+            if (n ++) {
+               buffer[len ++] = ',';
+               buffer[len ++] = ' ';
+            }
+            len += mg_slowlog_arg(buffer + len, size - len - 2, item, name, name_size, depth + 1);
+         } ZEND_HASH_FOREACH_END();
+         buffer[len ++] = ']';
+         buffer[len] = '\0';
+         break;
+      default:
+         len = snprintf(buffer, size, "%s", zend_zval_type_name(arg));
+         break;
    }
-   *(p_arec->vrec + p_arec->vsize) = p_arec->vz;
 
-   return 0;
+   if (len >= size) {
+      len = size - 1;
+   }
+   return len;
 }
 
 
-int mg_array_parse(MGPAGE *p_page, int chndle, zval *ppa, MGBUF *p_buf, int mode, short byref)
+
+/* v3.4.63 access pattern report: single-node functions, and what to use instead of calling them in a loop */
+
+const char * mg_access_advice(char *function)
 {
-   short phase;
-   unsigned long num_key;		
-   int rc, n, type, len, string_key_len;
-   zval *current;
-   char *string_key = NULL;
-   char *string_data = NULL;
-   zend_string *string_key_ex = NULL;
-   char *data;
-   char num[32];
-   MGAKEYX *p_keyx;
+   int n;
+   static const char *advice[][2] = {
+      {"m_get", "fetch the nodes in batches with Mg\\Cursor or Mg\\Query, or the subtree with m_merge_from_db()"},
+      {"m_data", "fetch the nodes in batches with Mg\\Cursor (with the values option set to false)"},
+      {"m_defined", "fetch the nodes in batches with Mg\\Cursor (with the values option set to false)"},
+      {"m_order", "iterate with Mg\\Cursor, or enable m_set_readahead()"},
+      {"m_previous", "iterate with Mg\\Cursor (reverse), or enable m_set_readahead()"},
+      {"m_set", "write the nodes in a single call with m_merge_to_db() or m_import()"},
+      {"m_delete", "delete the parent node, or move the loop into an M routine"},
+      {"m_kill", "kill the parent node, or move the loop into an M routine"},
+      {"m_increment", "move the loop into an M routine"},
+      {"m_function", "move the loop into the M function, passing all the arguments in one call"},
+      {"m_proc", "move the loop into the M procedure, passing all the arguments in one call"},
+      {NULL, NULL}
+   };
+
+   for (n = 0; advice[n][0]; n ++) {
+      if (!strcmp(advice[n][0], function)) {
+         return advice[n][1];
+      }
+   }
+   return NULL;
+}
 
-   phase = 0;
 
-#ifdef _WIN32
-__try {
-#endif
+/* calls are grouped by call site, function and global; the arguments that differ between the calls in a group are noted */
 
-   rc = 1;
-   p_keyx = (MGAKEYX *) mg_malloc(sizeof(MGAKEYX) + MG_MAXKEYLEN + 32, 0);
-   if (!p_keyx) {
+int mg_access_record(MGPAGE *p_page, MGSTATFUN *p_fun, MGSTATCALL *p_stat)
+{
+   int n, argc, keylen;
+   char key[512], name[64], arg[MG_ACCESS_ARGSIZE];
+   const char *file;
+   unsigned int line;
+   zend_execute_data *ex;
+   MGACCESS *p_acc;
+
+   if (!mg_access_advice(p_fun->name) || !zend_is_executing()) {
+      return 0;
+   }
+   ex = EG(current_execute_data);
+   if (!ex || !ex->func || ex->func->type != ZEND_INTERNAL_FUNCTION) {
       return 0;
    }
-   memset((void *) p_keyx, 0, (sizeof(MGAKEYX) + MG_MAXKEYLEN + 32));
-   p_keyx->krec[0] = ((unsigned char *) p_keyx) + sizeof(MGAKEYX);
-   p_keyx->kmemoffs[0] = 0;
 
-/* v3.3.59 */
-#if PHP_MAJOR_VERSION >= 8
-#else
-   TSRMLS_FETCH();
-#endif
+   file = zend_get_executed_filename();
+   line = zend_get_executed_lineno();
 
-   phase = 1;
-   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, byref, MG_TX_AREC);
+   if (!p_page->p_access) {
+      ALLOC_HASHTABLE(p_page->p_access);
+      zend_hash_init(p_page->p_access, 32, NULL, NULL, 0);
+   }
 
-   p_keyx->kn = 0;
-   p_keyx->ht[p_keyx->kn] = HASH_OF(ppa);
-   phase = 2;
-   zend_hash_internal_pointer_reset_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+   argc = (int) ZEND_CALL_NUM_ARGS(ex);
+   if (argc > MG_ACCESS_MAXARG) {
+      argc = MG_ACCESS_MAXARG;
+   }
 
-   phase = 3;
-   for (;;) {
-      phase = 4;
-      current = zend_hash_get_current_data_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
-      if (current == NULL) {
-         if (p_keyx->kn) {
-            p_keyx->kn --;
-            phase = 5;
-            zend_hash_move_forward_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
-            continue;
-         }
-         else {
-            break;
-         }
+   /* the global (or routine) is part of the key so that one line calling for several globals is reported for each */
+   name[0] = '\0';
+   for (n = 0; n < argc; n ++) {
+      mg_slowlog_arg(arg, sizeof(arg), ZEND_CALL_ARG(ex, n + 1), name, sizeof(name), 0);
+      if (name[0]) {
+         break;
       }
+   }
+   keylen = snprintf(key, sizeof(key), "%s:%u:%s:%s", file, line, p_fun->name, name);
+   if (keylen >= (int) sizeof(key)) {
+      keylen = (int) sizeof(key) - 1;
+   }
 
-      if (Z_TYPE_P(current) == IS_ARRAY) {
-         string_key_ex = NULL;
-         string_key = NULL;
-
-         phase = 6;
-	      type = zend_hash_get_current_key_ex(p_keyx->ht[p_keyx->kn], &string_key_ex, (zend_ulong *) &num_key, &(p_keyx->hp[p_keyx->kn]));
-         if (string_key_ex) {
-            string_key = ZSTR_VAL(string_key_ex);
-            string_key_len = (int) strlen(string_key);
-         }
-         else {
-            sprintf(num, "%lu", num_key);
-            string_key = num;
-            string_key_len = (int) strlen(string_key);
-         }
-         /* zend_printf("\r\np_keyx->kn=%d; string_key=%s;", p_keyx->kn, string_key); */
-         if (p_keyx->kn > 0) {
-            p_keyx->krec[p_keyx->kn] = p_keyx->krec[0] + p_keyx->kmemoffs[p_keyx->kn];
-         }
-         p_keyx->kmemoffs[p_keyx->kn + 1] = p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 1;
-         if ((p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 32) > MG_MAXKEYLEN) {
-            sprintf(p_page->p_srv->error_mess, "Total length of keys may not exceed %d Bytes", MG_MAXKEYLEN - 32);
-            rc = 0;
-            break;
-         }
-         if ((p_keyx->kn + 2) > MG_MAXKEY) {
-            sprintf(p_page->p_srv->error_mess, "Total number of keys (nested arrays) may not exceed %d", MG_MAXKEY - 2);
-            rc = 0;
-            break;
-         }
-         strcpy(p_keyx->krec[p_keyx->kn], string_key);
-         p_keyx->ksize[p_keyx->kn] = string_key_len;
-         p_keyx->kn ++;
-	      p_keyx->ht[p_keyx->kn] = HASH_OF(current);
+   p_acc = (MGACCESS *) zend_hash_str_find_ptr(p_page->p_access, key, keylen);
+   if (!p_acc) {
+      p_acc = (MGACCESS *) emalloc(sizeof(MGACCESS));
+      memset((void *) p_acc, 0, sizeof(MGACCESS));
+      strncpy(p_acc->function, p_fun->name, sizeof(p_acc->function) - 1);
+      strncpy(p_acc->file, file, sizeof(p_acc->file) - 1);
+      p_acc->line = (int) line;
+      p_acc->argc = argc;
+      zend_hash_str_add_ptr(p_page->p_access, key, keylen, (void *) p_acc);
+   }
 
-         phase = 7;
-         zend_hash_internal_pointer_reset_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
+   for (n = 0; n < argc; n ++) {
+      if (p_acc->varied & (1 << n)) {
          continue;
       }
-      else {
-		   SEPARATE_ZVAL(current);
-         convert_to_string_ex(current);
-         string_key_ex = NULL;
-         string_key = NULL;
-         phase = 8;
-	      type = zend_hash_get_current_key_ex(p_keyx->ht[p_keyx->kn], &string_key_ex, (zend_ulong *) &num_key, &(p_keyx->hp[p_keyx->kn]));
-         string_data = Z_STRVAL_P(current);
-         if (string_key_ex) {
-            string_key = ZSTR_VAL(string_key_ex);
-            if (string_data) {
-               string_key_len = (int) strlen(string_key);
-            }
-            else {
-               strcpy(num, "");
-               string_key = num;
-               string_key_len = (int) strlen(string_key);
-            }
-         }
-         else {
-            sprintf(num, "%lu", num_key);
-            string_key = num;
-            string_key_len = (int) strlen(string_key);
-         }
+      mg_slowlog_arg(arg, sizeof(arg), ZEND_CALL_ARG(ex, n + 1), name, sizeof(name), 0);
+      if (!p_acc->count) {
+         strcpy(p_acc->args[n], arg);
+      }
+      else if (n >= p_acc->argc || strcmp(p_acc->args[n], arg)) {
+         p_acc->varied |= (1 << n);
+      }
+   }
+   if (argc != p_acc->argc) {
+      p_acc->varied |= (1 << MG_ACCESS_MAXARG);
+   }
 
-         if (p_keyx->kn > 0) {
-            p_keyx->krec[p_keyx->kn] = p_keyx->krec[0] + p_keyx->kmemoffs[p_keyx->kn];
-         }
-         p_keyx->kmemoffs[p_keyx->kn + 1] = p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 1;
-         if ((p_keyx->kmemoffs[p_keyx->kn] + string_key_len + 32) > MG_MAXKEYLEN) {
-            sprintf(p_page->p_srv->error_mess, "Total length of keys may not exceed %d Bytes", MG_MAXKEYLEN - 32);
-            rc = 0;
-            break;
-         }
-         strcpy(p_keyx->krec[p_keyx->kn], string_key);
-         p_keyx->ksize[p_keyx->kn] = string_key_len;
+   p_acc->count ++;
+   p_acc->duration += p_stat->phase[MG_STAT_TOTAL];
+   p_acc->wait += p_stat->phase[MG_STAT_WAIT];
 
-         for (n = 0; n <= p_keyx->kn; n ++) {
-            data = p_keyx->krec[n];
-            len = p_keyx->ksize[n];
+   return 1;
+}
 
-            mg_request_add(p_page->p_srv, chndle, p_buf, data, len, byref, MG_TX_AKEY);
-         }
 
-         if (string_data) {
-            data = string_data;
-            len = (int) strlen(data);
-            mg_request_add(p_page->p_srv, chndle, p_buf, data, len, byref, MG_TX_DATA);
-         }
-         phase = 9;
-         zend_hash_move_forward_ex(p_keyx->ht[p_keyx->kn], &(p_keyx->hp[p_keyx->kn]));
-      }
+/* the call with the arguments that varied shown as '*': m_get("^ORD", *, "x") */
+
+int mg_access_signature(MGACCESS *p_acc, char *buffer, int size)
+{
+   int n, len;
 
+   len = snprintf(buffer, size, "%s(", p_acc->function);
+   for (n = 0; n < p_acc->argc && len < size - 8; n ++) {
+      len += snprintf(buffer + len, size - len, "%s%s", n ? ", " : "", (p_acc->varied & (1 << n)) ? "*" : p_acc->args[n]);
+   }
+   if (len < size - 8) {
+      len += snprintf(buffer + len, size - len, "%s)", (p_acc->varied & (1 << MG_ACCESS_MAXARG)) ? ", ..." : "");
    }
+   return len;
+}
 
-   phase = 99;
-   mg_request_add(p_page->p_srv, chndle, p_buf, NULL, 0, byref, MG_TX_EOD);
 
-   if (p_keyx) {
-      mg_free((void *) p_keyx, 0);
+/* the call sites reaching the reporting threshold, most time spent waiting first (the array is freed by the caller) */
+
+int mg_access_sites(MGPAGE *p_page, MGACCESS ***p_sites)
+{
+   int sitesn;
+   MGACCESS *p_acc;
+
+   *p_sites = NULL;
+   sitesn = 0;
+   if (!p_page->p_access || !zend_hash_num_elements(p_page->p_access)) {
+      return 0;
    }
 
-   return rc;
+   *p_sites = (MGACCESS **) emalloc(sizeof(MGACCESS *) * zend_hash_num_elements(p_page->p_access));
+   ZEND_HASH_FOREACH_PTR(p_page->p_access, p_acc) {
+      if (p_acc->count >= (unsigned long) (p_page->access_min > 1 ? p_page->access_min : 2)) {
+         (*p_sites)[sitesn ++] = p_acc;
+      }
+   } ZEND_HASH_FOREACH_END();
 
-#ifdef _WIN32
+   qsort((void *) *p_sites, sitesn, sizeof(MGACCESS *), mg_access_compare);
+
+   return sitesn;
 }
-__except (EXCEPTION_EXECUTE_HANDLER ) {
 
-   DWORD code;
 
-   __try {
-      code = GetExceptionCode();
-      if (p_page) {
-         sprintf(p_page->p_srv->error_mess, "Exception caught in f:mg_array_parse: %x|%d", code, phase);
-      }
+int mg_access_compare(const void *p1, const void *p2)
+{
+   MGACCESS *p_acc1, *p_acc2;
+
+   p_acc1 = *((MGACCESS **) p1);
+   p_acc2 = *((MGACCESS **) p2);
+
+   if (p_acc1->wait > p_acc2->wait)
+      return -1;
+   else if (p_acc1->wait < p_acc2->wait)
+      return 1;
+   return 0;
+}
+
+
+int mg_access_report(MGPAGE *p_page)
+{
+   int n, sitesn;
+   char call[1024], buffer[2048];
+   MGACCESS **sites;
+
+   sitesn = mg_access_sites(p_page, &sites);
+   for (n = 0; n < sitesn; n ++) {
+      mg_access_signature(sites[n], call, sizeof(call));
+      snprintf(buffer, sizeof(buffer), "%s:%d: %lu calls to %s took %.3fms (waiting for the DB Server %.3fms): %s", sites[n]->file, sites[n]->line, sites[n]->count, call, (double) sites[n]->duration / 1000000.0, (double) sites[n]->wait / 1000000.0, mg_access_advice(sites[n]->function));
+      mg_log_event(p_page->p_log, buffer, "Access Pattern", 0);
    }
-   __except (EXCEPTION_EXECUTE_HANDLER ) {
-      ;
+   if (sites) {
+      efree((void *) sites);
    }
 
-   return 0;
+   return sitesn;
 }
-#endif
 
+
+int mg_access_release(MGPAGE *p_page)
+{
+   MGACCESS *p_acc;
+
+   if (!p_page->p_access) {
+      return 0;
+   }
+
+   ZEND_HASH_FOREACH_PTR(p_page->p_access, p_acc) {
+      efree((void *) p_acc);
+   } ZEND_HASH_FOREACH_END();
+
+   zend_hash_destroy(p_page->p_access);
+   FREE_HASHTABLE(p_page->p_access);
+   p_page->p_access = NULL;
+
+   return 1;
 }
 
 
-int mg_request_header_ex(MGPAGE *p_page, MGBUF *p_buf, char *command, char *product, zval *parg0)
+
+/* v3.4.63 hot keys: each worker has a slot, shared between processes (in the same order as the metrics slots) if mg_php.metrics_workers is set */
+
+int mg_hotkeys_init(int sample, int subscripts)
 {
-   int offset;
-#if !defined(MG_PHP_MGW)
-   int len;
-   char *data;
+   int workers;
+   size_t size;
+   MGHOTKEYS *p_hotkeys;
+
+   if (sample <= 0) {
+      return 0;
+   }
+   workers = (mg_metrics && mg_metrics->shared) ? mg_metrics->workers : 1;
+   size = offsetof(MGHOTKEYS, slot) + (sizeof(MGHOTSLOT) * workers);
+
+   p_hotkeys = NULL;
+#if !defined(_WIN32)
+   if (workers > 1) {
+      /* anonymous memory is zeroed by the system, and only the pages used by a worker are committed */
+      p_hotkeys = (MGHOTKEYS *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (p_hotkeys == (MGHOTKEYS *) MAP_FAILED) {
+         p_hotkeys = NULL;
+      }
+      else {
+         p_hotkeys->shared = 1;
+      }
+   }
 #endif
 
-   offset = 0;
+   if (!p_hotkeys) {
+      workers = 1;
+      size = offsetof(MGHOTKEYS, slot) + sizeof(MGHOTSLOT);
+      p_hotkeys = (MGHOTKEYS *) malloc(size);
+      if (!p_hotkeys) {
+         return 0;
+      }
+      memset((void *) p_hotkeys, 0, size);
+   }
+   p_hotkeys->workers = workers;
+   p_hotkeys->sample = sample;
+   p_hotkeys->subscripts = (subscripts >= 0 ? subscripts : 0);
+   p_hotkeys->size = size;
 
-   /* for mg_php */
-#if !defined(MG_PHP_MGW)
-   if (Z_TYPE_P(parg0) == IS_STRING) {
-      data = mg_get_string(parg0, NULL, &len);
-      if (data && len) {
-         if (!strstr(data, "^") && !strstr(data, "$") && !strstr(data,".")) {
-            offset = 1;
-            strcpy(p_page->p_srv->server, data);
+   mg_hotkeys = p_hotkeys;
+
+   return 1;
+}
+
+
+/* one call in 'sample' is counted: the key is the global (or routine) and its leading subscripts, for example ^ORD(1234) */
+
+int mg_hotkeys_record(MGSTATFUN *p_fun)
+{
+   int n, len, slot;
+   char key[MG_HOTKEYS_KEYSIZE];
+   unsigned int h1, h2, *p_count, count;
+   unsigned long long hash;
+   zend_execute_data *ex;
+   MGHOTSLOT *p_slot;
+   MGHOTKEY *p_key;
+
+   if ((++ mg_hotkeys_tick) % mg_hotkeys->sample) {
+      return 0;
+   }
+   if (!zend_is_executing()) {
+      return 0;
+   }
+   ex = EG(current_execute_data);
+   if (!ex || !ex->func || ex->func->type != ZEND_INTERNAL_FUNCTION) {
+      return 0;
+   }
+   len = mg_hotkeys_key(ex, p_fun->name, key, (int) sizeof(key));
+   if (len <= 0) {
+      return 0;
+   }
+
+   /* FNV-1a, finalised (as MurmurHash3) so that similar keys differ in the low bits: the halves of the hash give the row positions (h1 + (row * h2)) */
+   hash = 14695981039346656037ULL;
+   for (n = 0; n < len; n ++) {
+      hash = (hash ^ (unsigned char) key[n]) * 1099511628211ULL;
+   }
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   hash *= 0xc4ceb9fe1a85ec53ULL;
+   hash ^= hash >> 33;
+   h1 = (unsigned int) hash;
+   h2 = (unsigned int) (hash >> 32) | 1;
+
+   /* in shared memory each worker writes only to its own slot: a worker that did not get a metrics slot records nothing rather than sharing slot 0 */
+   slot = 0;
+   if (mg_hotkeys->shared) {
+      if (!mg_metrics_slot) {
+         return 0;
+      }
+      slot = (int) (mg_metrics_slot - mg_metrics->slot);
+      if (slot < 0 || slot >= mg_hotkeys->workers) {
+         return 0;
+      }
+   }
+   p_slot = &(mg_hotkeys->slot[slot]);
+
+   mg_enter_critical_section((void *) &dbx_global_mutex);
+
+   p_slot->samples ++;
+   count = 0xffffffff;
+   for (n = 0; n < MG_HOTKEYS_DEPTH; n ++) {
+      p_count = &(p_slot->sketch[n][(h1 + (n * h2)) % MG_HOTKEYS_WIDTH]);
+      if (*p_count < 0xffffffff) {
+         (*p_count) ++;
+      }
+      if (*p_count < count) {
+         count = *p_count;
+      }
+   }
+
+   for (n = 0; n < p_slot->topn; n ++) {
+      if (p_slot->top[n].hash == hash && !strcmp(p_slot->top[n].key, key)) {
+         break;
+      }
+   }
+   if (n < p_slot->topn) {
+      p_slot->top[n].count = count;
+      mg_hotkeys_sift(p_slot, n);
+   }
+   else if (p_slot->topn < MG_HOTKEYS_TOPK || count > p_slot->top[0].count) {
+      if (p_slot->topn < MG_HOTKEYS_TOPK) {
+         n = p_slot->topn ++;
+      }
+      else {
+         n = 0;
+      }
+      p_key = &(p_slot->top[n]);
+      p_key->hash = hash;
+      p_key->count = count;
+      strcpy(p_key->key, key);
+      if (n) {
+         /* a new entry at the end of the heap is moved up towards the root */
+         while (n > 0 && p_slot->top[(n - 1) / 2].count > p_slot->top[n].count) {
+            mg_hotkeys_swap(p_slot, n, (n - 1) / 2);
+            n = (n - 1) / 2;
          }
       }
+      else {
+         mg_hotkeys_sift(p_slot, 0);
+      }
    }
-#endif
 
-   mg_request_header(p_page->p_srv, p_buf, command, MG_PRODUCT);
-   strcpy(p_page->p_srv->server, p_page->server_base);
+   mg_leave_critical_section((void *) &dbx_global_mutex);
 
-   return offset;
+   return 1;
 }
 
 
-void * mg_ext_malloc(unsigned long size)
+/* the arguments following the data, lock timeout or merge array are not subscripts */
+
+int mg_hotkeys_key(zend_execute_data *ex, char *function, char *key, int size)
 {
-   void *p;
+   int n, argc, len, keyn;
+   zval *arg, *item;
 
-   p = NULL;
+   argc = (int) ZEND_CALL_NUM_ARGS(ex);
+   if (!strcmp(function, "m_set") || !strcmp(function, "m_increment") || !strcmp(function, "m_lock")) {
+      argc --;
+   }
+   else if (!strcmp(function, "m_merge_to_db") || !strcmp(function, "m_merge_from_db")) {
+      argc -= 2;
+   }
 
-#ifdef MG_EMALLOC
-   p = emalloc(size);
-#else
-#ifdef _WIN32
-   p = (void *) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size + 32);
-#else
-   p =  malloc(size);
-#endif
-#endif
+   len = 0;
+   keyn = -1;
+   key[0] = '\0';
+   for (n = 0; n < argc && keyn < mg_hotkeys->subscripts; n ++) {
+      arg = ZEND_CALL_ARG(ex, n + 1);
+      ZVAL_DEREF(arg);
+      if (Z_TYPE_P(arg) != IS_ARRAY) {
+         len = mg_hotkeys_key_item(arg, key, size, len, &keyn);
+         continue;
+      }
+      /* a global reference array: the key ends with the array */
+      ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(arg), item) {
+         if (keyn >= mg_hotkeys->subscripts) {
+            break;
+         }
+         len = mg_hotkeys_key_item(item, key, size, len, &keyn);
+      } ZEND_HASH_FOREACH_END();
+      if (keyn >= 0) {
+         break;
+      }
+   }
 
-   return p;
+   if (keyn < 0) {
+      return 0;
+   }
+   if (keyn > 0 && len < size - 1) {
+      key[len ++] = ')';
+      key[len] = '\0';
+   }
+   return len;
 }
 
 
-void * mg_ext_realloc(void *p_buffer, unsigned long size)
+/* keyn: -1 = the global has not been found; otherwise the number of subscripts added */
+
+int mg_hotkeys_key_item(zval *item, char *key, int size, int len, int *p_keyn)
 {
-   void *p;
+   int n;
+   char buffer[64];
 
-   p = NULL;
+   ZVAL_DEREF(item);
 
-#ifdef MG_EMALLOC
-   p = erealloc((void *) p_buffer, size);
-#else
-#ifdef _WIN32
-   p = (void *) HeapReAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (LPVOID) p_buffer, size + 32);
-#else
-   p = realloc(p_buffer, size);
-#endif
-#endif
-   return p;
+   if (*p_keyn < 0) {
+      if (Z_TYPE_P(item) != IS_STRING || !memchr(Z_STRVAL_P(item), '^', Z_STRLEN_P(item))) {
+         return len;
+      }
+      n = (int) Z_STRLEN_P(item);
+      if (n > size - 16) {
+         n = size - 16;
+      }
+      memcpy(key, Z_STRVAL_P(item), n);
+      key[n] = '\0';
+      /* a routine (label^routine) has no subscripts */
+      *p_keyn = (Z_STRVAL_P(item)[0] == '^') ? 0 : mg_hotkeys->subscripts;
+      return n;
+   }
+
+   switch (Z_TYPE_P(item)) {
+      case IS_STRING:
+         n = snprintf(buffer, sizeof(buffer), "\"%.*s\"", (int) (Z_STRLEN_P(item) < 48 ? Z_STRLEN_P(item) : 48), Z_STRVAL_P(item));
+         break;
+      case IS_LONG:
+         n = snprintf(buffer, sizeof(buffer), "%ld", (long) Z_LVAL_P(item));
+         break;
+      case IS_DOUBLE:
+         n = snprintf(buffer, sizeof(buffer), "%g", Z_DVAL_P(item));
+         break;
+      default:
+         n = snprintf(buffer, sizeof(buffer), "\"\"");
+         break;
+   }
+   if (len + n + 3 > size) {
+      /* no room: the key is taken as it stands */
+      *p_keyn = mg_hotkeys->subscripts;
+      return len;
+   }
+   key[len ++] = (*p_keyn == 0) ? '(' : ',';
+   memcpy(key + len, buffer, n);
+   len += n;
+   key[len] = '\0';
+   (*p_keyn) ++;
+
+   return len;
 }
 
 
-int mg_ext_free(void *p_buffer)
+int mg_hotkeys_swap(MGHOTSLOT *p_slot, int n1, int n2)
 {
-#ifdef MG_EMALLOC
-   efree((void *) p_buffer);
-#else
-#ifdef _WIN32
-   HeapFree(GetProcessHeap(), 0, p_buffer);
-#else
-   free((void *) p_buffer);
-#endif
-#endif
+   MGHOTKEY key;
+
+   memcpy((void *) &key, (void *) &(p_slot->top[n1]), sizeof(MGHOTKEY));
+   memcpy((void *) &(p_slot->top[n1]), (void *) &(p_slot->top[n2]), sizeof(MGHOTKEY));
+   memcpy((void *) &(p_slot->top[n2]), (void *) &key, sizeof(MGHOTKEY));
+
    return 1;
 }
 
 
-int mg_log_request(MGPAGE *p_page, char *function)
+/* move an entry whose count has increased down the heap, so that the least frequent is at the root */
+
+int mg_hotkeys_sift(MGHOTSLOT *p_slot, int n)
 {
-   char *p;
-   char buffer[32];
+   int child;
 
-   MG_PHP_GLOBAL(fun_no) ++;
-   p_page->p_log->req_no = MG_PHP_GLOBAL(req_no);
-   p_page->p_log->fun_no = MG_PHP_GLOBAL(fun_no);
-   p_page->p_log->log_errors = 0;
-   p_page->p_log->log_functions = 0;
-   p_page->p_log->log_transmissions = 0;
-   if (!p_page->p_log->log_level[0]) {
+   for (;;) {
+      child = (n * 2) + 1;
+      if (child >= p_slot->topn) {
+         break;
+      }
+      if (child + 1 < p_slot->topn && p_slot->top[child + 1].count < p_slot->top[child].count) {
+         child ++;
+      }
+      if (p_slot->top[n].count <= p_slot->top[child].count) {
+         break;
+      }
+      mg_hotkeys_swap(p_slot, n, child);
+      n = child;
+   }
+
+   return n;
+}
+
+
+int mg_hotkeys_compare(const void *p1, const void *p2)
+{
+   MGHOTKEY *p_key1, *p_key2;
+
+   p_key1 = (MGHOTKEY *) p1;
+   p_key2 = (MGHOTKEY *) p2;
+
+   if (p_key1->count > p_key2->count)
+      return -1;
+   else if (p_key1->count < p_key2->count)
+      return 1;
+   return 0;
+}
+
+
+int mg_hotkeys_release(void)
+{
+   if (!mg_hotkeys) {
       return 0;
    }
 
-   if (p_page->p_log->log_filter[0] && !strstr(p_page->p_log->log_filter, "*")) {
-      sprintf(buffer, ",%s,", function);
-      if (!strstr(p_page->p_log->log_filter, buffer)) {
-         return 0;
-      }
+#if !defined(_WIN32)
+   if (mg_hotkeys->shared) {
+      munmap((void *) mg_hotkeys, mg_hotkeys->size);
    }
-   p = p_page->p_log->log_level;
-   while (*p) {
-      if (*p == 'e')
-         p_page->p_log->log_errors = 1;
-      else if (*p == 'f')
-         p_page->p_log->log_functions = 1;
-      else if (*p == 't')
-         p_page->p_log->log_transmissions = 1;
-      p ++;
+   else {
+      free((void *) mg_hotkeys);
    }
+#else
+   free((void *) mg_hotkeys);
+#endif
+   mg_hotkeys = NULL;
 
-   p_page->p_srv->p_log = p_page->p_log;
-
-   if (p_page->p_log->log_functions) {  
-      mg_log_event(p_page->p_log, function, "function called", 0);
-   }
    return 1;
 }
 
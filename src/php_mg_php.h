@@ -53,6 +53,7 @@
 #include "ext/standard/info.h"
 #include "SAPI.h"
 #include "php_ini.h"
+#include "zend_interfaces.h"
 
 #if defined(MG_PHP_MGW)
 #define PHP_MG_PHP_VERSION    "2.1.55"
@@ -61,7 +62,7 @@
 #define MG_DEFAULT_PORT       7040
 #endif
 #else
-#define PHP_MG_PHP_VERSION    "3.3.62"
+#define PHP_MG_PHP_VERSION    "3.4.63"
 #define MG_EXT_NAME           "mg_php"
 #if !defined(MG_DEFAULT_PORT)
 #define MG_DEFAULT_PORT       7041
@@ -88,6 +89,9 @@ static PHP_FUNCTION(m_set_error_mode);
 static PHP_FUNCTION(m_set_storage_mode);
 static PHP_FUNCTION(m_set_timeout);
 static PHP_FUNCTION(m_set_no_retry);
+static PHP_FUNCTION(m_set_readahead);
+static PHP_FUNCTION(m_set_slowlog);
+static PHP_FUNCTION(m_set_access_report);
 static PHP_FUNCTION(m_set_host);
 static PHP_FUNCTION(m_set_server);
 static PHP_FUNCTION(m_set_uci);
@@ -96,6 +100,11 @@ static PHP_FUNCTION(m_bind_server_api);
 static PHP_FUNCTION(m_release_server_api);
 #endif
 static PHP_FUNCTION(m_get_last_error);
+static PHP_FUNCTION(m_stats);
+static PHP_FUNCTION(m_metrics_export);
+static PHP_FUNCTION(m_slowlog);
+static PHP_FUNCTION(m_access_report);
+static PHP_FUNCTION(m_hot_keys);
 static PHP_FUNCTION(m_set);
 static PHP_FUNCTION(m_get);
 static PHP_FUNCTION(m_delete);
@@ -104,7 +113,14 @@ static PHP_FUNCTION(m_defined);
 static PHP_FUNCTION(m_data);
 static PHP_FUNCTION(m_order);
 static PHP_FUNCTION(m_previous);
+static PHP_FUNCTION(m_query);
+static PHP_FUNCTION(m_globals);
 static PHP_FUNCTION(m_increment);
+static PHP_FUNCTION(m_lock);
+static PHP_FUNCTION(m_lock_many);
+static PHP_FUNCTION(m_unlock);
+static PHP_FUNCTION(m_unlock_many);
+static PHP_FUNCTION(m_unlock_all);
 static PHP_FUNCTION(m_tstart);
 static PHP_FUNCTION(m_tlevel);
 static PHP_FUNCTION(m_tcommit);
@@ -122,8 +138,24 @@ static PHP_FUNCTION(m_method);
 static PHP_FUNCTION(m_method_byref);
 static PHP_FUNCTION(m_merge_to_db);
 static PHP_FUNCTION(m_merge_from_db);
+static PHP_FUNCTION(m_merge);
+static PHP_FUNCTION(m_count);
+static PHP_FUNCTION(m_subtree_size);
+static PHP_FUNCTION(m_export);
+static PHP_FUNCTION(m_import);
 static PHP_FUNCTION(m_return_to_applet);
 static PHP_FUNCTION(m_return_to_client);
 static PHP_FUNCTION(m_array_test);
 
+/* v3.4.63 */
+static PHP_METHOD(MgCursor, __construct);
+static PHP_METHOD(MgCursor, rewind);
+static PHP_METHOD(MgCursor, valid);
+static PHP_METHOD(MgCursor, current);
+static PHP_METHOD(MgCursor, key);
+static PHP_METHOD(MgCursor, next);
+static PHP_METHOD(MgCursor, data);
+static PHP_METHOD(MgQuery, __construct);
+static PHP_METHOD(MgGlobals, __construct);
+
 #endif /* PHP_MG_PHP_H */
@@ -0,0 +1,594 @@
+/*
+   ----------------------------------------------------------------------------
+   | mg_bench                                                                 |
+   | Description: Benchmarks for the mg_dba protocol layer (without PHP)      |
+   | Author:      Chris Munt cmunt@mgateway.com                               |
+   |                         chris.e.munt@gmail.com                           |
+   | Copyright (c) 2019-2024 MGateway Ltd                                     |
+   | Surrey UK.                                                               |
+   | All rights reserved.                                                     |
+   |                                                                          |
+   | http://www.mgateway.com                                                  |
+   |                                                                          |
+   | Licensed under the Apache License, Version 2.0 (the "License"); you may  |
+   | not use this file except in compliance with the License.                 |
+   | You may obtain a copy of the License at                                  |
+   |                                                                          |
+   | http://www.apache.org/licenses/LICENSE-2.0                               |
+   |                                                                          |
+   | Unless required by applicable law or agreed to in writing, software      |
+   | distributed under the License is distributed on an "AS IS" BASIS,        |
+   | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. |
+   | See the License for the specific language governing permissions and      |
+   | limitations under the License.                                           |
+   |                                                                          |
+   ----------------------------------------------------------------------------
+*/
+
+/*
+   Build (links ../src/mg_dba.c):
+      make mg_bench
+
+   Usage:
+      mg_bench [-h host] [-p port] [-n iterations] [-r round_trips] [-d depth] [-t threads] [-b filter]
+
+   One JSON object is written per line for each benchmark, so that the results of successive
+   releases can be compared by a script:
+
+      {"version":"1.6.24","benchmark":"codec/encode_size","ops":1000000,"ns":125350000,"ns_per_op":125.35}
+
+   codec, buf, array and utf    in-process: see mg_benchmark() in mg_dba.c.
+   callin/ci, callin/cip        in-process YottaDB call-in of ifc_zmgsis by name and through a descriptor: these
+                                need $ydb_dist and a call-in table ($ydb_ci), and are reported as skipped without them.
+   roundtrip/sequential         one request at a time over one connection.
+   roundtrip/pipelined          'depth' requests are sent over one connection before their responses are read.
+   roundtrip/parallel           'threads' connections, each making requests one at a time.
+
+   The round trips are made to the DB Server at host:port (-h/-p) or, by default, to a responder
+   in this program listening on the loopback interface that returns a fixed response to each request.
+   The loopback figures are the cost of the client and the network stack alone.
+
+Version 1.0.1 19 October 2026:
+   First release.
+*/
+
+
+#include "mg_dbasys.h"
+#include "mg_dba.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MG_BENCH_MAXTHREADS      16
+#define MG_BENCH_PRODUCT         "z"   /* as sent by mg_php */
+
+typedef struct tagMGBENCH {
+   char                 host[64];
+   int                  port;
+   int                  loopback;
+   int                  depth;
+   int                  threads;
+   unsigned long        iterations;
+   unsigned long        round_trips;
+   char                 filter[64];
+} MGBENCH;
+
+typedef struct tagMGBCLIENT {
+   MGSRV                srv;
+   MGBUF                buf;
+   int                  chndle;
+   unsigned long        ops;
+   unsigned long        errors;
+   unsigned long long * latency;
+   MGBENCH *            p_bench;
+   pthread_t            tid;
+} MGBCLIENT;
+
+
+int                  mg_bench_run               (MGBENCH *p_bench, char *benchmark);
+int                  mg_bench_output            (char *benchmark, unsigned long ops, unsigned long long ns, char *extra);
+int                  mg_bench_codec             (MGBENCH *p_bench);
+int                  mg_bench_sequential        (MGBENCH *p_bench);
+int                  mg_bench_pipelined         (MGBENCH *p_bench);
+int                  mg_bench_parallel          (MGBENCH *p_bench);
+void *               mg_bench_parallel_thread   (void *arg);
+int                  mg_bench_client_open       (MGBENCH *p_bench, MGBCLIENT *p_cli);
+int                  mg_bench_client_close      (MGBCLIENT *p_cli);
+int                  mg_bench_request           (MGBCLIENT *p_cli, unsigned long n);
+int                  mg_bench_response          (MGBCLIENT *p_cli);
+int                  mg_bench_compare_ull       (const void *p1, const void *p2);
+int                  mg_bench_responder_start   (MGBENCH *p_bench);
+void *               mg_bench_responder         (void *arg);
+void *               mg_bench_responder_client  (void *arg);
+
+
+int main(int argc, char *argv[])
+{
+   int n;
+   MGBENCH bench;
+
+   memset((void *) &bench, 0, sizeof(MGBENCH));
+   bench.loopback = 1;
+   bench.port = 0;
+   bench.depth = 16;
+   bench.threads = 4;
+   bench.iterations = 1000000;
+   bench.round_trips = 20000;
+   strcpy(bench.host, MG_HOST);
+
+   for (n = 1; n < argc; n ++) {
+      if (!strcmp(argv[n], "-h") && (n + 1) < argc) {
+         strncpy(bench.host, argv[++ n], sizeof(bench.host) - 1);
+         bench.loopback = 0;
+      }
+      else if (!strcmp(argv[n], "-p") && (n + 1) < argc) {
+         bench.port = (int) strtol(argv[++ n], NULL, 10);
+         bench.loopback = 0;
+      }
+      else if (!strcmp(argv[n], "-n") && (n + 1) < argc) {
+         bench.iterations = strtoul(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-r") && (n + 1) < argc) {
+         bench.round_trips = strtoul(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-d") && (n + 1) < argc) {
+         bench.depth = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-t") && (n + 1) < argc) {
+         bench.threads = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-b") && (n + 1) < argc) {
+         strncpy(bench.filter, argv[++ n], sizeof(bench.filter) - 1);
+      }
+      else {
+         fprintf(stderr, "usage: %s [-h host] [-p port] [-n iterations] [-r round_trips] [-d depth] [-t threads] [-b filter]\n", argv[0]);
+         return 1;
+      }
+   }
+   if (!bench.loopback && !bench.port) {
+      bench.port = MG_PORT;
+   }
+   if (bench.depth < 1) {
+      bench.depth = 1;
+   }
+   if (bench.threads < 1) {
+      bench.threads = 1;
+   }
+   if (bench.threads > MG_BENCH_MAXTHREADS) {
+      bench.threads = MG_BENCH_MAXTHREADS;
+   }
+
+   dbx_init();
+
+   mg_bench_codec(&bench);
+
+   if (bench.round_trips && (mg_bench_run(&bench, "roundtrip/sequential") || mg_bench_run(&bench, "roundtrip/pipelined") || mg_bench_run(&bench, "roundtrip/parallel"))) {
+      if (bench.loopback && !mg_bench_responder_start(&bench)) {
+         fprintf(stderr, "cannot start the loopback responder\n");
+         return 1;
+      }
+      if (mg_bench_run(&bench, "roundtrip/sequential")) {
+         mg_bench_sequential(&bench);
+      }
+      if (mg_bench_run(&bench, "roundtrip/pipelined")) {
+         mg_bench_pipelined(&bench);
+      }
+      if (mg_bench_run(&bench, "roundtrip/parallel")) {
+         mg_bench_parallel(&bench);
+      }
+   }
+
+   return 0;
+}
+
+
+int mg_bench_run(MGBENCH *p_bench, char *benchmark)
+{
+   return (!p_bench->filter[0] || strstr(benchmark, p_bench->filter));
+}
+
+
+int mg_bench_output(char *benchmark, unsigned long ops, unsigned long long ns, char *extra)
+{
+   printf("{\"version\":\"%s\",\"benchmark\":\"%s\",\"ops\":%lu,\"ns\":%llu,\"ns_per_op\":%.2f%s}\n", DBX_VERSION, benchmark, ops, ns, ops ? (double) ns / (double) ops : 0.0, extra ? extra : "");
+   fflush(stdout);
+   return 1;
+}
+
+
+int mg_bench_codec(MGBENCH *p_bench)
+{
+   int n;
+   unsigned long ops;
+   unsigned long long ns;
+   static const char *benchmarks[][2] = {
+      {"codec/encode_size", "encode_size"},
+      {"codec/decode_size", "decode_size"},
+      {"codec/encode_item_header", "encode_item_header"},
+      {"codec/decode_item_header", "decode_item_header"},
+      {"buf/cat", "buf_cat"},
+      {"buf/grow", "buf_grow"},
+      {"array/encode", "array_encode"},
+      {"array/decode", "array_decode"},
+      {"utf/utf8_to_utf16", "utf8_to_utf16"},
+      {"utf/utf16_to_utf8", "utf16_to_utf8"},
+      {"callin/ci", "ydb_ci"},
+      {"callin/cip", "ydb_cip"},
+      {NULL, NULL}
+   };
+
+   for (n = 0; benchmarks[n][0]; n ++) {
+      if (!mg_bench_run(p_bench, (char *) benchmarks[n][0])) {
+         continue;
+      }
+      ns = mg_benchmark((char *) benchmarks[n][1], p_bench->iterations, &ops);
+      mg_bench_output((char *) benchmarks[n][0], ops, ns, ops ? NULL : ",\"skipped\":true");
+   }
+
+   return 1;
+}
+
+
+int mg_bench_sequential(MGBENCH *p_bench)
+{
+   unsigned long n;
+   unsigned long long t0, t1, t2;
+   char extra[128];
+   MGBCLIENT cli;
+
+   if (!mg_bench_client_open(p_bench, &cli)) {
+      return 0;
+   }
+   cli.latency = (unsigned long long *) malloc(sizeof(unsigned long long) * p_bench->round_trips);
+   if (!cli.latency) {
+      return 0;
+   }
+
+   t0 = mg_time_ns();
+   for (n = 0; n < p_bench->round_trips; n ++) {
+      t1 = mg_time_ns();
+      if (!mg_bench_request(&cli, n) || !mg_bench_response(&cli)) {
+         cli.errors ++;
+         break;
+      }
+      t2 = mg_time_ns();
+      cli.latency[cli.ops ++] = t2 - t1;
+   }
+   t2 = mg_time_ns();
+
+   sprintf(extra, ",\"errors\":%lu", cli.errors);
+   if (cli.ops) {
+      qsort((void *) cli.latency, cli.ops, sizeof(unsigned long long), mg_bench_compare_ull);
+      sprintf(extra, ",\"p50_ns\":%llu,\"p99_ns\":%llu,\"errors\":%lu", cli.latency[cli.ops / 2], cli.latency[(cli.ops * 99) / 100], cli.errors);
+   }
+   mg_bench_output("roundtrip/sequential", cli.ops, t2 - t0, extra);
+
+   free((void *) cli.latency);
+   mg_bench_client_close(&cli);
+
+   return 1;
+}
+
+
+int mg_bench_pipelined(MGBENCH *p_bench)
+{
+   int d;
+   unsigned long n;
+   unsigned long long t0, t1;
+   char extra[128];
+   MGBCLIENT cli;
+
+   if (!mg_bench_client_open(p_bench, &cli)) {
+      return 0;
+   }
+
+   t0 = mg_time_ns();
+   for (n = 0; n < p_bench->round_trips && !cli.errors; n += p_bench->depth) {
+      for (d = 0; d < p_bench->depth; d ++) {
+         if (!mg_bench_request(&cli, n + d)) {
+            cli.errors ++;
+            break;
+         }
+      }
+      for (d = 0; d < p_bench->depth && !cli.errors; d ++) {
+         if (!mg_bench_response(&cli)) {
+            cli.errors ++;
+            break;
+         }
+         cli.ops ++;
+      }
+   }
+   t1 = mg_time_ns();
+
+   sprintf(extra, ",\"depth\":%d,\"errors\":%lu", p_bench->depth, cli.errors);
+   mg_bench_output("roundtrip/pipelined", cli.ops, t1 - t0, extra);
+
+   mg_bench_client_close(&cli);
+
+   return 1;
+}
+
+
+/* ns_per_op is the elapsed time divided by the operations completed by all threads (the inverse of throughput) */
+
+int mg_bench_parallel(MGBENCH *p_bench)
+{
+   int t;
+   unsigned long ops, errors;
+   unsigned long long t0, t1;
+   char extra[128];
+   MGBCLIENT cli[MG_BENCH_MAXTHREADS];
+
+   for (t = 0; t < p_bench->threads; t ++) {
+      if (!mg_bench_client_open(p_bench, &(cli[t]))) {
+         return 0;
+      }
+   }
+
+   t0 = mg_time_ns();
+   for (t = 0; t < p_bench->threads; t ++) {
+      pthread_create(&(cli[t].tid), NULL, mg_bench_parallel_thread, (void *) &(cli[t]));
+   }
+   ops = 0;
+   errors = 0;
+   for (t = 0; t < p_bench->threads; t ++) {
+      pthread_join(cli[t].tid, NULL);
+      ops += cli[t].ops;
+      errors += cli[t].errors;
+   }
+   t1 = mg_time_ns();
+
+   sprintf(extra, ",\"threads\":%d,\"ops_per_sec\":%.0f,\"errors\":%lu", p_bench->threads, (t1 > t0) ? ((double) ops * 1000000000.0) / (double) (t1 - t0) : 0.0, errors);
+   mg_bench_output("roundtrip/parallel", ops, t1 - t0, extra);
+
+   for (t = 0; t < p_bench->threads; t ++) {
+      mg_bench_client_close(&(cli[t]));
+   }
+
+   return 1;
+}
+
+
+void * mg_bench_parallel_thread(void *arg)
+{
+   unsigned long n, max;
+   MGBCLIENT *p_cli;
+
+   p_cli = (MGBCLIENT *) arg;
+   max = p_cli->p_bench->round_trips / p_cli->p_bench->threads;
+
+   for (n = 0; n < max; n ++) {
+      if (!mg_bench_request(p_cli, n) || !mg_bench_response(p_cli)) {
+         p_cli->errors ++;
+         break;
+      }
+      p_cli->ops ++;
+   }
+
+   return NULL;
+}
+
+
+/* each client has its own server record and connection, as each PHP request does */
+
+int mg_bench_client_open(MGBENCH *p_bench, MGBCLIENT *p_cli)
+{
+   memset((void *) p_cli, 0, sizeof(MGBCLIENT));
+   p_cli->p_bench = p_bench;
+   strcpy(p_cli->srv.ip_address, p_bench->host);
+   p_cli->srv.port = p_bench->port;
+   strcpy(p_cli->srv.server, MG_SERVER);
+   strcpy(p_cli->srv.uci, MG_UCI);
+   strcpy(p_cli->srv.product, MG_BENCH_PRODUCT);
+   p_cli->srv.timeout = 30;
+
+   if (!mg_buf_init(&(p_cli->buf), MG_BUFSIZE, MG_BUFSIZE)) {
+      return 0;
+   }
+   if (!mg_db_connect(&(p_cli->srv), &(p_cli->chndle), 1)) {
+      fprintf(stderr, "cannot connect to %s:%d\n", p_bench->host, p_bench->port);
+      mg_buf_free(&(p_cli->buf));
+      return 0;
+   }
+
+   return 1;
+}
+
+
+int mg_bench_client_close(MGBCLIENT *p_cli)
+{
+   mg_db_disconnect(&(p_cli->srv), p_cli->chndle, 0);
+   mg_buf_free(&(p_cli->buf));
+
+   return 1;
+}
+
+
+/* the equivalent of m_get("^MGBench", n) */
+
+int mg_bench_request(MGBCLIENT *p_cli, unsigned long n)
+{
+   int len;
+   char key[32];
+
+   mg_request_header(&(p_cli->srv), &(p_cli->buf), "G", MG_BENCH_PRODUCT);
+   mg_request_add(&(p_cli->srv), p_cli->chndle, &(p_cli->buf), (unsigned char *) "^MGBench", 8, 0, MG_TX_DATA);
+   len = sprintf(key, "%lu", n);
+   mg_request_add(&(p_cli->srv), p_cli->chndle, &(p_cli->buf), (unsigned char *) key, len, 0, MG_TX_DATA);
+
+   return mg_db_send(&(p_cli->srv), p_cli->chndle, &(p_cli->buf), 1);
+}
+
+
+/* the response is read exactly (header first), so that pipelined responses are not read ahead */
+
+int mg_bench_response(MGBCLIENT *p_cli)
+{
+   int n;
+
+   /* mg_db_receive() expects one response for each request sent: clear its end of data flag for pipelined responses */
+   p_cli->srv.pcon[p_cli->chndle]->eod = 0;
+
+   n = mg_db_receive(&(p_cli->srv), p_cli->chndle, &(p_cli->buf), MG_RECV_HEAD, 1);
+   if (n < MG_RECV_HEAD || mg_get_error(&(p_cli->srv), (char *) p_cli->buf.p_buffer)) {
+      return 0;
+   }
+
+   return 1;
+}
+
+
+int mg_bench_compare_ull(const void *p1, const void *p2)
+{
+   unsigned long long v1, v2;
+
+   v1 = *((unsigned long long *) p1);
+   v2 = *((unsigned long long *) p2);
+
+   if (v1 < v2)
+      return -1;
+   else if (v1 > v2)
+      return 1;
+   return 0;
+}
+
+
+/* loopback responder: every request receives the same small response (as for m_get) */
+
+int mg_bench_responder_start(MGBENCH *p_bench)
+{
+   int *p_sock, flag;
+   struct sockaddr_in addr;
+   socklen_t len;
+   pthread_t tid;
+
+   p_sock = (int *) malloc(sizeof(int));
+   if (!p_sock) {
+      return 0;
+   }
+   *p_sock = (int) socket(AF_INET, SOCK_STREAM, 0);
+   if (*p_sock < 0) {
+      return 0;
+   }
+   flag = 1;
+   setsockopt(*p_sock, SOL_SOCKET, SO_REUSEADDR, (char *) &flag, sizeof(flag));
+
+   memset((void *) &addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   if (bind(*p_sock, (struct sockaddr *) &addr, sizeof(addr)) || listen(*p_sock, 64)) {
+      close(*p_sock);
+      return 0;
+   }
+   len = sizeof(addr);
+   getsockname(*p_sock, (struct sockaddr *) &addr, &len);
+
+   strcpy(p_bench->host, "127.0.0.1");
+   p_bench->port = (int) ntohs(addr.sin_port);
+
+   if (pthread_create(&tid, NULL, mg_bench_responder, (void *) p_sock)) {
+      close(*p_sock);
+      return 0;
+   }
+   pthread_detach(tid);
+
+   return 1;
+}
+
+
+void * mg_bench_responder(void *arg)
+{
+   int sock, *p_cli_sock, flag;
+   pthread_t tid;
+
+   sock = *((int *) arg);
+
+   for (;;) {
+      p_cli_sock = (int *) malloc(sizeof(int));
+      if (!p_cli_sock) {
+         break;
+      }
+      *p_cli_sock = (int) accept(sock, NULL, NULL);
+      if (*p_cli_sock < 0) {
+         free((void *) p_cli_sock);
+         break;
+      }
+      flag = 1;
+      setsockopt(*p_cli_sock, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(flag));
+      if (pthread_create(&tid, NULL, mg_bench_responder_client, (void *) p_cli_sock)) {
+         close(*p_cli_sock);
+         free((void *) p_cli_sock);
+         continue;
+      }
+      pthread_detach(tid);
+   }
+
+   return NULL;
+}
+
+
+/* a request is a header line (ending with the size of the data that follows, 5 characters in base 62) and the data */
+
+void * mg_bench_responder_client(void *arg)
+{
+   int sock, n, responses, rlen;
+   unsigned long len, used, size;
+   unsigned char *p, *eol, esize[8], head[MG_RECV_HEAD + 1], buffer[65536], response[4096];
+   static const char value[] = "Benchmark response";
+
+   sock = *((int *) arg);
+   free(arg);
+
+   /* response header: the size of the data in 5 characters of base 62, then the (c)ompletion and (v)alue flags */
+   n = mg_encode_size(esize, (int) (sizeof(value) - 1), MG_CHUNK_SIZE_BASE);
+   strcpy((char *) head, "00000cv\n");
+   memcpy(head + (5 - n), esize, n);
+   rlen = MG_RECV_HEAD + (int) (sizeof(value) - 1);
+
+   len = 0;
+   for (;;) {
+      n = (int) recv(sock, buffer + len, sizeof(buffer) - len, 0);
+      if (n <= 0) {
+         break;
+      }
+      len += n;
+
+      /* answer every complete request in the buffer with a single send */
+      used = 0;
+      responses = 0;
+      for (;;) {
+         p = buffer + used;
+         eol = (unsigned char *) memchr(p, '\n', len - used);
+         if (!eol || (eol - p) < 6) {
+            break;
+         }
+         size = (unsigned long) mg_decode_size(eol - 5, 5, MG_CHUNK_SIZE_BASE);
+         if ((unsigned long) ((eol + 1 + size) - buffer) > len) {
+            break;
+         }
+         used = (unsigned long) ((eol + 1 + size) - buffer);
+         if ((unsigned long) ((responses + 1) * rlen) > sizeof(response)) {
+            send(sock, response, responses * rlen, 0);
+            responses = 0;
+         }
+         p = response + (responses * rlen);
+         memcpy(p, head, MG_RECV_HEAD);
+         memcpy(p + MG_RECV_HEAD, value, sizeof(value) - 1);
+         responses ++;
+      }
+      if (responses) {
+         send(sock, response, responses * rlen, 0);
+      }
+      if (used) {
+         memmove(buffer, buffer + used, len - used);
+         len -= used;
+      }
+      if (len == sizeof(buffer)) {
+         break;
+      }
+   }
+   close(sock);
+
+   return NULL;
+}
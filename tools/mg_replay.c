@@ -0,0 +1,659 @@
+/*
+   ----------------------------------------------------------------------------
+   | mg_replay                                                                |
+   | Description: Replay a wire capture (mg_php.capture_file) against a DB    |
+   |              Server (%zmgsi) and report the latency distribution         |
+   | Author:      Chris Munt cmunt@mgateway.com                               |
+   |                         chris.e.munt@gmail.com                           |
+   | Copyright (c) 2019-2024 MGateway Ltd                                     |
+   | Surrey UK.                                                               |
+   | All rights reserved.                                                     |
+   |                                                                          |
+   | http://www.mgateway.com                                                  |
+   |                                                                          |
+   | Licensed under the Apache License, Version 2.0 (the "License"); you may  |
+   | not use this file except in compliance with the License.                 |
+   | You may obtain a copy of the License at                                  |
+   |                                                                          |
+   | http://www.apache.org/licenses/LICENSE-2.0                               |
+   |                                                                          |
+   | Unless required by applicable law or agreed to in writing, software      |
+   | distributed under the License is distributed on an "AS IS" BASIS,        |
+   | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. |
+   | See the License for the specific language governing permissions and      |
+   | limitations under the License.                                           |
+   |                                                                          |
+   ----------------------------------------------------------------------------
+*/
+
+/*
+   Build:
+      cc -O2 -o mg_replay mg_replay.c -lpthread
+
+   Usage:
+      mg_replay [-h host] [-p port] [-c connections] [-s speed] [-n loops] [-v] capture_file ...
+
+   The capture files are those written by each worker process (<mg_php.capture_file>.<pid>).
+   The requests are replayed in the order (and, by default, with the spacing) in which they were captured.
+   Requests captured on one connection are always replayed, in order, on one connection so that
+   transactions and locks are preserved.  The connections are shared between the replay threads (-c).
+
+   -s speed: 1 = as captured (the default); 2 = twice as fast; 0 = as fast as possible.
+   -n loops: the number of times the capture is replayed.
+   -v      : report the latency distribution for each protocol command.
+
+Version 1.0.1 19 October 2026:
+   First release.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/* the capture file format: as defined in mg_dba.h */
+#define MG_CAPTURE_MAGIC         "MGCAPT01"
+#define MG_CAPTURE_VERSION       1
+#define MG_CAPTURE_SEND          'S'
+#define MG_CAPTURE_RECEIVE       'R'
+
+#define MG_RECV_HEAD             8
+#define MG_CHUNK_SIZE_BASE       62
+#define MG_HOST                  "127.0.0.1"
+#define MG_PORT                  7041
+
+#define MG_REPLAY_MAXCON         65536
+
+typedef struct tagMGCAPHEAD {
+   char                 magic[8];
+   unsigned int         version;
+   unsigned int         pid;
+   unsigned long long   time_real;
+   unsigned long long   time_mono;
+} MGCAPHEAD;
+
+typedef struct tagMGCAPREC {
+   unsigned int         size;
+   unsigned char        type;
+   unsigned char        command;
+   unsigned short       chndle;
+   unsigned long long   time;
+} MGCAPREC;
+
+/* a captured request: time is relative to the first request (nanoseconds) */
+typedef struct tagMGREQ {
+   unsigned long long   seq;
+   unsigned long long   time;
+   unsigned long long   captured;
+   unsigned long        size;
+   int                  stream;
+   int                  command;
+   unsigned char *      frame;
+} MGREQ;
+
+typedef struct tagMGREPLAY {
+   char                 host[256];
+   int                  port;
+   int                  connections;
+   int                  loops;
+   int                  verbose;
+   double               speed;
+   int                  reqn;
+   int                  streamn;
+   MGREQ *              req;
+   unsigned long long   duration;
+   unsigned long long   start;
+} MGREPLAY;
+
+typedef struct tagMGTHREAD {
+   pthread_t            tid;
+   int                  no;
+   int                  sock;
+   int                  reqn;
+   int *                req;
+   unsigned long long * latency;
+   unsigned char *      command;
+   unsigned long long   lag;
+   unsigned long        done;
+   unsigned long        errors;
+   MGREPLAY *           p_replay;
+} MGTHREAD;
+
+
+int                  mg_replay_load             (MGREPLAY *p_replay, char *file, int *stream_map);
+int                  mg_replay_compare          (const void *p1, const void *p2);
+int                  mg_replay_compare_ull      (const void *p1, const void *p2);
+void *               mg_replay_thread           (void *arg);
+int                  mg_replay_connect          (MGREPLAY *p_replay);
+int                  mg_replay_request          (int sock, MGREQ *p_req, unsigned char **p_buffer, unsigned long *p_size);
+int                  mg_replay_read             (int sock, unsigned char *buffer, unsigned long size);
+unsigned long        mg_replay_decode_size      (unsigned char *esize, int len);
+unsigned long long   mg_replay_time_ns          (void);
+int                  mg_replay_sleep_until      (unsigned long long t);
+int                  mg_replay_report           (char *title, unsigned long long *latency, unsigned long n);
+
+
+int main(int argc, char *argv[])
+{
+   int n, t, *stream_map;
+   unsigned long total, errors, done, k;
+   unsigned long long elapsed, lag, *latency, *captured, *command_latency;
+   char title[64];
+   MGREPLAY replay;
+   MGTHREAD *threads;
+
+   memset((void *) &replay, 0, sizeof(MGREPLAY));
+   strcpy(replay.host, MG_HOST);
+   replay.port = MG_PORT;
+   replay.connections = 1;
+   replay.loops = 1;
+   replay.speed = 1.0;
+
+   stream_map = (int *) malloc(sizeof(int) * MG_REPLAY_MAXCON);
+   if (!stream_map) {
+      return 1;
+   }
+
+   for (n = 1; n < argc; n ++) {
+      if (!strcmp(argv[n], "-h") && (n + 1) < argc) {
+         strncpy(replay.host, argv[++ n], sizeof(replay.host) - 1);
+      }
+      else if (!strcmp(argv[n], "-p") && (n + 1) < argc) {
+         replay.port = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-c") && (n + 1) < argc) {
+         replay.connections = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-s") && (n + 1) < argc) {
+         replay.speed = strtod(argv[++ n], NULL);
+      }
+      else if (!strcmp(argv[n], "-n") && (n + 1) < argc) {
+         replay.loops = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-v")) {
+         replay.verbose = 1;
+      }
+      else if (argv[n][0] == '-') {
+         fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] [-s speed] [-n loops] [-v] capture_file ...\n", argv[0]);
+         return 1;
+      }
+      else {
+         if (mg_replay_load(&replay, argv[n], stream_map) < 0) {
+            return 1;
+         }
+      }
+   }
+   free((void *) stream_map);
+
+   if (!replay.reqn) {
+      fprintf(stderr, "%s: no requests to replay\n", argv[0]);
+      return 1;
+   }
+   if (replay.connections < 1) {
+      replay.connections = 1;
+   }
+   if (replay.loops < 1) {
+      replay.loops = 1;
+   }
+   if (replay.speed < 0) {
+      replay.speed = 0;
+   }
+
+   /* the capture files are merged into one time line */
+   qsort((void *) replay.req, replay.reqn, sizeof(MGREQ), mg_replay_compare);
+   elapsed = replay.req[0].time;
+   for (n = 0; n < replay.reqn; n ++) {
+      replay.req[n].time -= elapsed;
+   }
+   replay.duration = replay.req[replay.reqn - 1].time + 1;
+
+   threads = (MGTHREAD *) calloc(replay.connections, sizeof(MGTHREAD));
+   if (!threads) {
+      return 1;
+   }
+   for (t = 0; t < replay.connections; t ++) {
+      threads[t].no = t;
+      threads[t].p_replay = &replay;
+      threads[t].req = (int *) malloc(sizeof(int) * replay.reqn);
+      threads[t].latency = (unsigned long long *) malloc(sizeof(unsigned long long) * replay.reqn * replay.loops);
+      threads[t].command = (unsigned char *) malloc(sizeof(unsigned char) * replay.reqn * replay.loops);
+      if (!threads[t].req || !threads[t].latency || !threads[t].command) {
+         return 1;
+      }
+   }
+   for (n = 0; n < replay.reqn; n ++) {
+      t = replay.req[n].stream % replay.connections;
+      threads[t].req[threads[t].reqn ++] = n;
+   }
+
+   printf("Replaying %d requests (%d connections captured) to %s:%d over %d connections; speed=%g; loops=%d\n", replay.reqn, replay.streamn, replay.host, replay.port, replay.connections, replay.speed, replay.loops);
+
+   replay.start = mg_replay_time_ns() + 100000000ULL;
+   for (t = 0; t < replay.connections; t ++) {
+      if (pthread_create(&(threads[t].tid), NULL, mg_replay_thread, (void *) &(threads[t]))) {
+         fprintf(stderr, "cannot create thread %d\n", t);
+         return 1;
+      }
+   }
+   total = 0;
+   errors = 0;
+   lag = 0;
+   for (t = 0; t < replay.connections; t ++) {
+      pthread_join(threads[t].tid, NULL);
+      total += threads[t].done;
+      errors += threads[t].errors;
+      if (threads[t].lag > lag) {
+         lag = threads[t].lag;
+      }
+   }
+   elapsed = mg_replay_time_ns();
+   elapsed = (elapsed > replay.start) ? (elapsed - replay.start) : 0;
+
+   latency = (unsigned long long *) malloc(sizeof(unsigned long long) * (total + 1));
+   captured = (unsigned long long *) malloc(sizeof(unsigned long long) * (replay.reqn + 1));
+   command_latency = (unsigned long long *) malloc(sizeof(unsigned long long) * (total + 1));
+   if (!latency || !captured || !command_latency) {
+      return 1;
+   }
+
+   done = 0;
+   for (t = 0; t < replay.connections; t ++) {
+      memcpy((void *) (latency + done), (void *) threads[t].latency, sizeof(unsigned long long) * threads[t].done);
+      done += threads[t].done;
+   }
+   k = 0;
+   for (n = 0; n < replay.reqn; n ++) {
+      if (replay.req[n].captured) {
+         captured[k ++] = replay.req[n].captured;
+      }
+   }
+
+   printf("Elapsed: %.3fs; requests: %lu; errors: %lu; throughput: %.1f/s; maximum lag behind schedule: %.3fms\n", (double) elapsed / 1000000000.0, total, errors, elapsed ? ((double) total * 1000000000.0) / (double) elapsed : 0.0, (double) lag / 1000000.0);
+   mg_replay_report("replay", latency, done);
+   mg_replay_report("captured", captured, k);
+
+   if (replay.verbose) {
+      for (n = 1; n < 256; n ++) {
+         k = 0;
+         for (t = 0; t < replay.connections; t ++) {
+            for (done = 0; done < threads[t].done; done ++) {
+               if (threads[t].command[done] == n) {
+                  command_latency[k ++] = threads[t].latency[done];
+               }
+            }
+         }
+         if (k) {
+            sprintf(title, "command '%c'", (n >= 32 && n < 127) ? n : '?');
+            mg_replay_report(title, command_latency, k);
+         }
+      }
+   }
+
+   return (errors ? 2 : 0);
+}
+
+
+/* requests are paired with the response that follows them on the same connection, which gives the latency captured */
+
+int mg_replay_load(MGREPLAY *p_replay, char *file, int *stream_map)
+{
+   int n, last[MG_REPLAY_MAXCON / 256];
+   unsigned long long offset;
+   FILE *fp;
+   MGCAPHEAD head;
+   MGCAPREC rec;
+   MGREQ *p_req;
+   static unsigned long long seq = 0;
+
+   fp = fopen(file, "rb");
+   if (!fp) {
+      fprintf(stderr, "%s: %s\n", file, strerror(errno));
+      return -1;
+   }
+   if (fread((void *) &head, sizeof(MGCAPHEAD), 1, fp) != 1 || memcmp(head.magic, MG_CAPTURE_MAGIC, 8) || head.version != MG_CAPTURE_VERSION) {
+      fprintf(stderr, "%s: not a capture file\n", file);
+      fclose(fp);
+      return -1;
+   }
+
+   /* times are taken from the monotonic clock of the capturing process: they are converted to real time to merge the files */
+   offset = head.time_real - head.time_mono;
+
+   for (n = 0; n < MG_REPLAY_MAXCON; n ++) {
+      stream_map[n] = -1;
+   }
+   for (n = 0; n < (int) (sizeof(last) / sizeof(last[0])); n ++) {
+      last[n] = -1;
+   }
+
+   for (;;) {
+      if (fread((void *) &rec, sizeof(MGCAPREC), 1, fp) != 1) {
+         break;
+      }
+      if (rec.type == MG_CAPTURE_RECEIVE) {
+         if (rec.chndle < (int) (sizeof(last) / sizeof(last[0])) && last[rec.chndle] >= 0) {
+            p_req = &(p_replay->req[last[rec.chndle]]);
+            p_req->captured = (rec.time + offset) - p_req->time;
+            last[rec.chndle] = -1;
+         }
+         if (fseek(fp, rec.size, SEEK_CUR)) {
+            break;
+         }
+         continue;
+      }
+      if (rec.type != MG_CAPTURE_SEND) {
+         fprintf(stderr, "%s: invalid record (type=%d)\n", file, rec.type);
+         break;
+      }
+
+      if ((p_replay->reqn % 4096) == 0) {
+         p_req = (MGREQ *) realloc((void *) p_replay->req, sizeof(MGREQ) * (p_replay->reqn + 4096));
+         if (!p_req) {
+            fclose(fp);
+            return -1;
+         }
+         p_replay->req = p_req;
+      }
+      p_req = &(p_replay->req[p_replay->reqn]);
+      memset((void *) p_req, 0, sizeof(MGREQ));
+      p_req->frame = (unsigned char *) malloc(rec.size);
+      if (!p_req->frame || fread((void *) p_req->frame, 1, rec.size, fp) != rec.size) {
+         free((void *) p_req->frame);
+         break;
+      }
+      p_req->seq = seq ++;
+      p_req->time = rec.time + offset;
+      p_req->size = rec.size;
+      p_req->command = rec.command;
+      if (stream_map[rec.chndle] < 0) {
+         stream_map[rec.chndle] = p_replay->streamn ++;
+      }
+      p_req->stream = stream_map[rec.chndle];
+      if (rec.chndle < (int) (sizeof(last) / sizeof(last[0]))) {
+         last[rec.chndle] = p_replay->reqn;
+      }
+      p_replay->reqn ++;
+   }
+
+   fclose(fp);
+
+   return 0;
+}
+
+
+int mg_replay_compare(const void *p1, const void *p2)
+{
+   MGREQ *p_req1, *p_req2;
+
+   p_req1 = (MGREQ *) p1;
+   p_req2 = (MGREQ *) p2;
+
+   if (p_req1->time != p_req2->time)
+      return (p_req1->time < p_req2->time) ? -1 : 1;
+   if (p_req1->seq != p_req2->seq)
+      return (p_req1->seq < p_req2->seq) ? -1 : 1;
+   return 0;
+}
+
+
+int mg_replay_compare_ull(const void *p1, const void *p2)
+{
+   unsigned long long v1, v2;
+
+   v1 = *((unsigned long long *) p1);
+   v2 = *((unsigned long long *) p2);
+
+   if (v1 < v2)
+      return -1;
+   else if (v1 > v2)
+      return 1;
+   return 0;
+}
+
+
+void * mg_replay_thread(void *arg)
+{
+   int n, loop;
+   unsigned long size;
+   unsigned long long due, t0, t1;
+   unsigned char *buffer;
+   MGTHREAD *p_thread;
+   MGREPLAY *p_replay;
+   MGREQ *p_req;
+
+   p_thread = (MGTHREAD *) arg;
+   p_replay = p_thread->p_replay;
+   buffer = NULL;
+   size = 0;
+
+   if (!p_thread->reqn) {
+      return NULL;
+   }
+
+   p_thread->sock = mg_replay_connect(p_replay);
+   if (p_thread->sock < 0) {
+      p_thread->errors = (unsigned long) p_thread->reqn * p_replay->loops;
+      return NULL;
+   }
+
+   /* all threads start together, whatever the speed */
+   mg_replay_sleep_until(p_replay->start);
+
+   for (loop = 0; loop < p_replay->loops; loop ++) {
+      for (n = 0; n < p_thread->reqn; n ++) {
+         p_req = &(p_replay->req[p_thread->req[n]]);
+
+         if (p_replay->speed > 0) {
+            due = p_replay->start + (unsigned long long) ((double) ((p_replay->duration * loop) + p_req->time) / p_replay->speed);
+            t0 = mg_replay_time_ns();
+            if (t0 < due) {
+               mg_replay_sleep_until(due);
+            }
+            else if ((t0 - due) > p_thread->lag) {
+               p_thread->lag = t0 - due;
+            }
+         }
+
+         t0 = mg_replay_time_ns();
+         if (mg_replay_request(p_thread->sock, p_req, &buffer, &size) < 0) {
+            p_thread->errors ++;
+            close(p_thread->sock);
+            p_thread->sock = mg_replay_connect(p_replay);
+            if (p_thread->sock < 0) {
+               p_thread->errors += (unsigned long) (p_thread->reqn - (n + 1)) + ((unsigned long) p_thread->reqn * (p_replay->loops - (loop + 1)));
+               free((void *) buffer);
+               return NULL;
+            }
+            continue;
+         }
+         t1 = mg_replay_time_ns();
+         p_thread->command[p_thread->done] = (unsigned char) p_req->command;
+         p_thread->latency[p_thread->done ++] = t1 - t0;
+      }
+   }
+
+   close(p_thread->sock);
+   free((void *) buffer);
+
+   return NULL;
+}
+
+
+int mg_replay_connect(MGREPLAY *p_replay)
+{
+   int sock, flag;
+   char port[32];
+   struct addrinfo hints, *p_addr, *p;
+
+   memset((void *) &hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   sprintf(port, "%d", p_replay->port);
+   if (getaddrinfo(p_replay->host, port, &hints, &p_addr)) {
+      fprintf(stderr, "cannot resolve %s\n", p_replay->host);
+      return -1;
+   }
+
+   sock = -1;
+   for (p = p_addr; p; p = p->ai_next) {
+      sock = (int) socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+      if (sock < 0) {
+         continue;
+      }
+      if (connect(sock, p->ai_addr, p->ai_addrlen) == 0) {
+         break;
+      }
+      close(sock);
+      sock = -1;
+   }
+   freeaddrinfo(p_addr);
+
+   if (sock < 0) {
+      fprintf(stderr, "cannot connect to %s:%d: %s\n", p_replay->host, p_replay->port, strerror(errno));
+      return -1;
+   }
+   flag = 1;
+   setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(flag));
+
+   return sock;
+}
+
+
+/* the response is an 8 byte header (the first 5 bytes are the size of the data that follows in base 62) and the data */
+
+int mg_replay_request(int sock, MGREQ *p_req, unsigned char **p_buffer, unsigned long *p_size)
+{
+   long n;
+   unsigned long total, ssize;
+   unsigned char head[MG_RECV_HEAD];
+
+   for (total = 0; total < p_req->size; total += n) {
+      n = (long) send(sock, p_req->frame + total, p_req->size - total, 0);
+      if (n <= 0) {
+         return -1;
+      }
+   }
+
+   if (mg_replay_read(sock, head, MG_RECV_HEAD) < 0) {
+      return -1;
+   }
+   ssize = mg_replay_decode_size(head, 5);
+   if (ssize > *p_size) {
+      free((void *) *p_buffer);
+      *p_buffer = (unsigned char *) malloc(ssize);
+      if (!*p_buffer) {
+         *p_size = 0;
+         return -1;
+      }
+      *p_size = ssize;
+   }
+   if (ssize && mg_replay_read(sock, *p_buffer, ssize) < 0) {
+      return -1;
+   }
+
+   return (int) ssize;
+}
+
+
+int mg_replay_read(int sock, unsigned char *buffer, unsigned long size)
+{
+   long n;
+   unsigned long total;
+
+   for (total = 0; total < size; total += n) {
+      n = (long) recv(sock, buffer + total, size - total, 0);
+      if (n <= 0) {
+         return -1;
+      }
+   }
+   return 0;
+}
+
+
+unsigned long mg_replay_decode_size(unsigned char *esize, int len)
+{
+   int n, x;
+   unsigned long size;
+
+   size = 0;
+   for (n = 0; n < len; n ++) {
+      x = (int) esize[n];
+      if (x >= 48 && x < 58)
+         x = x - 48;
+      else if (x >= 65 && x < 91)
+         x = (x - 65) + 10;
+      else if (x >= 97 && x < 123)
+         x = (x - 97) + 36;
+      else
+         x = 0;
+      size = (size * MG_CHUNK_SIZE_BASE) + x;
+   }
+   return size;
+}
+
+
+unsigned long long mg_replay_time_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((unsigned long long) ts.tv_sec * 1000000000ULL) + (unsigned long long) ts.tv_nsec;
+}
+
+
+int mg_replay_sleep_until(unsigned long long t)
+{
+   unsigned long long now;
+   struct timespec ts;
+
+   now = mg_replay_time_ns();
+   if (now >= t) {
+      return 0;
+   }
+   ts.tv_sec = (time_t) ((t - now) / 1000000000ULL);
+   ts.tv_nsec = (long) ((t - now) % 1000000000ULL);
+   while (nanosleep(&ts, &ts) && errno == EINTR)
+      ;
+   return 1;
+}
+
+
+int mg_replay_report(char *title, unsigned long long *latency, unsigned long n)
+{
+   int p;
+   unsigned long long sum;
+   unsigned long k;
+   static const double percentile[] = {50.0, 90.0, 99.0, 99.9};
+
+   if (!n) {
+      printf("%-14s no requests\n", title);
+      return 0;
+   }
+
+   qsort((void *) latency, n, sizeof(unsigned long long), mg_replay_compare_ull);
+   sum = 0;
+   for (k = 0; k < n; k ++) {
+      sum += latency[k];
+   }
+
+   printf("%-14s n=%lu; mean=%.3fms", title, n, ((double) sum / (double) n) / 1000000.0);
+   for (p = 0; p < (int) (sizeof(percentile) / sizeof(percentile[0])); p ++) {
+      k = (unsigned long) ((percentile[p] / 100.0) * (double) n);
+      if (k >= n) {
+         k = n - 1;
+      }
+      printf("; p%g=%.3fms", percentile[p], (double) latency[k] / 1000000.0);
+   }
+   printf("; max=%.3fms\n", (double) latency[n - 1] / 1000000.0);
+
+   return 1;
+}
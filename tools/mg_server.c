@@ -0,0 +1,1935 @@
+/*
+   ----------------------------------------------------------------------------
+   | mg_server                                                                |
+   | Description: A local stand-in for the DB Superserver (%zmgsi)            |
+   | Author:      Chris Munt cmunt@mgateway.com                               |
+   |                         chris.e.munt@gmail.com                           |
+   | Copyright (c) 2019-2024 MGateway Ltd                                     |
+   | Surrey UK.                                                               |
+   | All rights reserved.                                                     |
+   |                                                                          |
+   | http://www.mgateway.com                                                  |
+   |                                                                          |
+   | Licensed under the Apache License, Version 2.0 (the "License"); you may  |
+   | not use this file except in compliance with the License.                 |
+   | You may obtain a copy of the License at                                  |
+   |                                                                          |
+   | http://www.apache.org/licenses/LICENSE-2.0                               |
+   |                                                                          |
+   | Unless required by applicable law or agreed to in writing, software      |
+   | distributed under the License is distributed on an "AS IS" BASIS,        |
+   | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. |
+   | See the License for the specific language governing permissions and      |
+   | limitations under the License.                                           |
+   |                                                                          |
+   ----------------------------------------------------------------------------
+*/
+
+/*
+   Build (links ../src/mg_dba.c):
+      make mg_server
+
+   Usage:
+      mg_server [-b address] [-p port] [-l latency_us] [-j jitter_us] [-c] [-v]
+
+   A server that speaks the network protocol of the DB Superserver (%zmgsi) and holds the globals
+   in memory, so that mg_php can be tested and benchmarked without a database.  Nothing is written
+   to disk: the globals are lost when the server stops.
+
+   Commands:
+      ^S^ and ^A^       connection handshake and 'are you there'
+      S G K D I         set, get, kill, $Data and $Increment
+      O P               $Order (forwards and backwards)
+      N Q E C           batched $Order, batched $Query, global directory and subtree counts
+      L U               incremental lock and unlock (released when the connection closes)
+      R M m             merge: global to global, PHP array to global and global to PHP array
+      a b c d           transactions: tstart, $tlevel, tcommit and trollback (undone from a log)
+      X                 the built-in functions below (no M code is run)
+
+   The DB Superserver (%zmgsi) does not implement N Q E C L U or R.  With -c they are rejected as it
+   rejects them, so that the fallbacks in mg_php for a DB Superserver without them can be tested.
+
+   Functions (m_function, m_proc: the label is used and the routine is ignored):
+      echo^x(a)         returns a
+      concat^x(a,...)   returns the arguments joined together
+      sleep^x(ms)       waits for ms milliseconds, returns ""
+      reset^x()         kills every global and releases every lock, returns 1
+      version^x()       returns the version of this server
+
+   Transactions are undone on rollback, but they are not isolated from other connections.
+
+   Latency:
+      Each response is delayed by latency_us microseconds plus a random period of up to jitter_us
+      microseconds, to simulate a DB Server across a network.
+
+Version 1.0.1 19 October 2026:
+   First release.
+*/
+
+
+#include "mg_dbasys.h"
+#include "mg_dba.h"
+
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MGS_VERSION              "1.0.1"
+#define MGS_MAXKEY               64
+#define MGS_SERVER_TYPE          "mg_server"
+
+typedef struct tagMGSREF {
+   int                  keyn;
+   unsigned char *      key[MGS_MAXKEY];
+   int                  ksize[MGS_MAXKEY];
+} MGSREF;
+
+/* a data node: undo log entries use the same record, with vsize -1 for a node that was not defined */
+
+typedef struct tagMGSNODE {
+   int                  keyn;
+   int                  vsize;
+   unsigned char **     key;
+   int *                ksize;
+   unsigned char *      value;
+} MGSNODE;
+
+typedef struct tagMGSITEM {
+   short                type;
+   int                  size;
+   unsigned char *      ps;
+} MGSITEM;
+
+typedef struct tagMGSLOCK {
+   MGSNODE *            p_ref;
+   int                  owner;
+   int                  count;
+} MGSLOCK;
+
+typedef struct tagMGSCON {
+   int                  sock;
+   int                  id;
+   int                  tlevel;
+   int                  undon;
+   int                  undo_size;
+   MGSNODE **           undo;
+   unsigned int         seed;
+   unsigned long        len;
+   unsigned long        size;
+   unsigned char *      buffer;
+   int                  itemn;
+   int                  item_size;
+   MGSITEM *            item;
+   char                 error[256];
+   MGBUF                res;
+} MGSCON;
+
+/* the globals, in collation order, and the lock table: both are protected by 'lock' */
+
+typedef struct tagMGSSTORE {
+   pthread_mutex_t      lock;
+   pthread_cond_t       unlocked;
+   int                  noden;
+   int                  node_size;
+   MGSNODE **           node;
+   int                  lockn;
+   int                  lock_size;
+   MGSLOCK *            locks;
+   int                  cons;
+   int                  latency;
+   int                  jitter;
+   int                  compat;
+   int                  verbose;
+} MGSSTORE;
+
+static MGSSTORE mgs;
+
+
+void *               mgs_connection             (void *arg);
+int                  mgs_connection_close       (MGSCON *p_con);
+int                  mgs_frame                  (MGSCON *p_con, unsigned char *frame, unsigned long hlen, unsigned long size);
+int                  mgs_handshake              (MGSCON *p_con, unsigned char *frame, unsigned long hlen);
+int                  mgs_command                (MGSCON *p_con, char command);
+int                  mgs_respond                (MGSCON *p_con);
+int                  mgs_items                  (MGSCON *p_con, unsigned char *data, unsigned long size);
+int                  mgs_ref                    (MGSCON *p_con, MGSREF *p_ref, MGSITEM *item, int itemn, int nullsub);
+int                  mgs_ref_node               (MGSREF *p_ref, MGSNODE *p_node, int keyn);
+int                  mgs_item_int               (MGSITEM *item);
+int                  mgs_error                  (MGSCON *p_con, char *error);
+int                  mgs_value                  (MGSCON *p_con, unsigned char *value, int vsize);
+
+int                  mgs_cmd_set                (MGSCON *p_con);
+int                  mgs_cmd_get                (MGSCON *p_con);
+int                  mgs_cmd_kill               (MGSCON *p_con);
+int                  mgs_cmd_data               (MGSCON *p_con);
+int                  mgs_cmd_order              (MGSCON *p_con, int direction);
+int                  mgs_cmd_increment          (MGSCON *p_con);
+int                  mgs_cmd_order_batch        (MGSCON *p_con);
+int                  mgs_order_row              (MGSCON *p_con, MGSREF *p_ref, int getdata, int getvalue);
+int                  mgs_cmd_query_batch        (MGSCON *p_con);
+int                  mgs_query_row              (MGSCON *p_con, MGSNODE *p_node, int getvalue);
+int                  mgs_cmd_globals            (MGSCON *p_con);
+int                  mgs_cmd_count              (MGSCON *p_con);
+int                  mgs_cmd_lock               (MGSCON *p_con);
+int                  mgs_cmd_unlock             (MGSCON *p_con);
+int                  mgs_cmd_merge              (MGSCON *p_con);
+int                  mgs_cmd_merge_to_db        (MGSCON *p_con);
+int                  mgs_cmd_merge_from_db      (MGSCON *p_con);
+int                  mgs_cmd_transaction        (MGSCON *p_con, char command);
+int                  mgs_cmd_function           (MGSCON *p_con);
+
+int                  mgs_compare                (int keyn1, unsigned char **key1, int *ksize1, int keyn2, unsigned char **key2, int *ksize2, int subtree);
+int                  mgs_lower_bound            (MGSREF *p_ref);
+int                  mgs_subtree_end            (MGSREF *p_ref);
+int                  mgs_in_subtree             (MGSNODE *p_node, MGSREF *p_ref);
+MGSNODE *            mgs_node_alloc             (MGSREF *p_ref, unsigned char *value, int vsize);
+MGSNODE *            mgs_node_copy              (MGSNODE *p_node);
+int                  mgs_node_free              (MGSNODE *p_node);
+MGSNODE *            mgs_get                    (MGSREF *p_ref);
+int                  mgs_data                   (MGSREF *p_ref);
+int                  mgs_set                    (MGSCON *p_con, MGSREF *p_ref, unsigned char *value, int vsize);
+int                  mgs_kill                   (MGSCON *p_con, MGSREF *p_ref);
+MGSNODE *            mgs_order                  (MGSREF *p_ref, int direction);
+int                  mgs_undo_log               (MGSCON *p_con, MGSREF *p_ref, MGSNODE *p_node);
+int                  mgs_undo                   (MGSCON *p_con);
+int                  mgs_undo_free              (MGSCON *p_con);
+int                  mgs_lock_node              (MGSCON *p_con, MGSREF *p_ref, int timeout);
+int                  mgs_unlock_node            (MGSCON *p_con, MGSREF *p_ref);
+int                  mgs_unlock_all             (int owner);
+int                  mgs_number                 (char *buffer, double value);
+int                  mgs_pause                  (MGSCON *p_con);
+
+
+int main(int argc, char *argv[])
+{
+   int n, sock, *p_sock, flag, port;
+   char address[64];
+   struct sockaddr_in addr;
+   pthread_t tid;
+
+   memset((void *) &mgs, 0, sizeof(MGSSTORE));
+   strcpy(address, MG_HOST);
+   port = MG_PORT;
+
+   for (n = 1; n < argc; n ++) {
+      if (!strcmp(argv[n], "-b") && (n + 1) < argc) {
+         strncpy(address, argv[++ n], sizeof(address) - 1);
+      }
+      else if (!strcmp(argv[n], "-p") && (n + 1) < argc) {
+         port = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-l") && (n + 1) < argc) {
+         mgs.latency = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-j") && (n + 1) < argc) {
+         mgs.jitter = (int) strtol(argv[++ n], NULL, 10);
+      }
+      else if (!strcmp(argv[n], "-c")) {
+         mgs.compat = 1;
+      }
+      else if (!strcmp(argv[n], "-v")) {
+         mgs.verbose = 1;
+      }
+      else {
+         fprintf(stderr, "usage: %s [-b address] [-p port] [-l latency_us] [-j jitter_us] [-c] [-v]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   dbx_init();
+   signal(SIGPIPE, SIG_IGN);
+   pthread_mutex_init(&(mgs.lock), NULL);
+   pthread_cond_init(&(mgs.unlocked), NULL);
+
+   sock = (int) socket(AF_INET, SOCK_STREAM, 0);
+   if (sock < 0) {
+      perror("socket");
+      return 1;
+   }
+   flag = 1;
+   setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *) &flag, sizeof(flag));
+
+   memset((void *) &addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short) port);
+   if (inet_pton(AF_INET, address, &(addr.sin_addr)) != 1) {
+      fprintf(stderr, "invalid address: %s\n", address);
+      return 1;
+   }
+   if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) || listen(sock, 128)) {
+      perror("bind");
+      return 1;
+   }
+   fprintf(stderr, "mg_server %s listening on %s:%d (latency=%dus; jitter=%dus%s)\n", MGS_VERSION, address, port, mgs.latency, mgs.jitter, mgs.compat ? "; %zmgsi commands only" : "");
+
+   for (;;) {
+      p_sock = (int *) malloc(sizeof(int));
+      if (!p_sock) {
+         break;
+      }
+      *p_sock = (int) accept(sock, NULL, NULL);
+      if (*p_sock < 0) {
+         free((void *) p_sock);
+         if (errno == EINTR) {
+            continue;
+         }
+         perror("accept");
+         break;
+      }
+      flag = 1;
+      setsockopt(*p_sock, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(flag));
+      if (pthread_create(&tid, NULL, mgs_connection, (void *) p_sock)) {
+         close(*p_sock);
+         free((void *) p_sock);
+         continue;
+      }
+      pthread_detach(tid);
+   }
+   close(sock);
+
+   return 1;
+}
+
+
+/* one thread for each connection (as %zmgsi has one process for each): requests are answered in the order received */
+
+void * mgs_connection(void *arg)
+{
+   int n;
+   unsigned long used, hlen, size;
+   unsigned char *p, *eol, *p_temp;
+   MGSCON *p_con;
+
+   p_con = (MGSCON *) calloc(1, sizeof(MGSCON));
+   if (!p_con) {
+      close(*((int *) arg));
+      free(arg);
+      return NULL;
+   }
+   p_con->sock = *((int *) arg);
+   free(arg);
+
+   pthread_mutex_lock(&(mgs.lock));
+   p_con->id = ++ mgs.cons;
+   pthread_mutex_unlock(&(mgs.lock));
+   p_con->seed = (unsigned int) (p_con->id * 2654435761u);
+
+   p_con->size = MG_BUFSIZE;
+   p_con->buffer = (unsigned char *) malloc(p_con->size + 1);
+   if (!p_con->buffer || !mg_buf_init(&(p_con->res), MG_BUFSIZE, MG_BUFSIZE)) {
+      mgs_connection_close(p_con);
+      return NULL;
+   }
+   if (mgs.verbose) {
+      fprintf(stderr, "[%d] connected\n", p_con->id);
+   }
+
+   for (;;) {
+      if (p_con->len == p_con->size) {
+         p_temp = (unsigned char *) realloc(p_con->buffer, (p_con->size * 2) + 1);
+         if (!p_temp) {
+            break;
+         }
+         p_con->buffer = p_temp;
+         p_con->size *= 2;
+      }
+      n = (int) recv(p_con->sock, p_con->buffer + p_con->len, p_con->size - p_con->len, 0);
+      if (n <= 0) {
+         break;
+      }
+      p_con->len += n;
+
+      used = 0;
+      while (used < p_con->len) {
+         p = p_con->buffer + used;
+         eol = (unsigned char *) memchr(p, '\n', p_con->len - used);
+         if (!eol) {
+            break;
+         }
+         hlen = (unsigned long) ((eol + 1) - p);
+         size = 0;
+         if (!strncmp((char *) p, "PHP", 3)) {
+            if (hlen < 9) {
+               break;
+            }
+            /* the size of the data that follows is in the last 5 characters of the header (base 62) */
+            size = (unsigned long) mg_decode_size(eol - 5, 5, MG_CHUNK_SIZE_BASE);
+         }
+         if ((used + hlen + size) > p_con->len) {
+            break;
+         }
+         if (!mgs_frame(p_con, p, hlen, size) || !mgs_respond(p_con)) {
+            mgs_connection_close(p_con);
+            return NULL;
+         }
+         used += (hlen + size);
+      }
+      if (used) {
+         memmove((void *) p_con->buffer, (void *) (p_con->buffer + used), (size_t) (p_con->len - used));
+         p_con->len -= used;
+      }
+   }
+
+   mgs_connection_close(p_con);
+
+   return NULL;
+}
+
+
+/* as the DB Server does when a connection is lost: roll back any open transaction and release the locks held */
+
+int mgs_connection_close(MGSCON *p_con)
+{
+   pthread_mutex_lock(&(mgs.lock));
+   if (p_con->tlevel > 0) {
+      mgs_undo(p_con);
+   }
+   mgs_unlock_all(p_con->id);
+   pthread_mutex_unlock(&(mgs.lock));
+
+   if (mgs.verbose) {
+      fprintf(stderr, "[%d] disconnected\n", p_con->id);
+   }
+
+   mgs_undo_free(p_con);
+   close(p_con->sock);
+   if (p_con->buffer) {
+      free((void *) p_con->buffer);
+   }
+   if (p_con->item) {
+      free((void *) p_con->item);
+   }
+   if (p_con->res.p_buffer) {
+      mg_buf_free(&(p_con->res));
+   }
+   free((void *) p_con);
+
+   return 1;
+}
+
+
+/* PHP<product>^P^<server>#<uci>#0#<timeout>#<no_retry>#<version>#<storage_mode>^<command>^<size:5>\n<items> */
+
+int mgs_frame(MGSCON *p_con, unsigned char *frame, unsigned long hlen, unsigned long size)
+{
+   char command;
+
+   mg_api_response_init(&(p_con->res));
+
+   if (strncmp((char *) frame, "PHP", 3)) {
+      return mgs_handshake(p_con, frame, hlen);
+   }
+
+   command = (char) frame[hlen - 8];
+   if (mgs.verbose) {
+      fprintf(stderr, "[%d] %c (%lu bytes)\n", p_con->id, command, size);
+   }
+
+   if (!mgs_items(p_con, frame + hlen, size)) {
+      mgs_error(p_con, "Invalid request: bad item");
+      return 1;
+   }
+
+   if (command == 'X') {
+      return mgs_cmd_function(p_con);
+   }
+
+   pthread_mutex_lock(&(mgs.lock));
+   mgs_command(p_con, command);
+   pthread_mutex_unlock(&(mgs.lock));
+
+   return 1;
+}
+
+
+/* ^S^version=...&timeout=...&nls=...&uci=...\n (connect) and ^A^...\n (are you there) */
+
+int mgs_handshake(MGSCON *p_con, unsigned char *frame, unsigned long hlen)
+{
+   int n;
+   char uci[64], buffer[256];
+   char *p;
+
+   if (mgs.verbose) {
+      fprintf(stderr, "[%d] %.3s\n", p_con->id, (char *) frame);
+   }
+   if (strncmp((char *) frame, "^S^", 3)) {
+      mg_api_response_end(&(p_con->res), 0);
+      return 1;
+   }
+
+   strcpy(uci, MG_UCI);
+   frame[hlen - 1] = '\0';
+   p = strstr((char *) frame, "uci=");
+   if (p) {
+      p += 4;
+      for (n = 0; p[n] && p[n] != '&' && n < (int) (sizeof(uci) - 1); n ++) {
+         uci[n] = p[n];
+      }
+      if (n) {
+         uci[n] = '\0';
+      }
+   }
+   frame[hlen - 1] = '\n';
+
+   sprintf(buffer, "pid=%d&uci=%s&server_type=%s&version=%s&child_port=0", (int) getpid(), uci, MGS_SERVER_TYPE, MGS_VERSION);
+   mg_buf_cat(&(p_con->res), buffer, (unsigned long) strlen(buffer));
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+int mgs_command(MGSCON *p_con, char command)
+{
+   char buffer[64];
+
+   /* the commands that the DB Superserver does not implement */
+   if (mgs.compat && command && strchr("NQECLUR", command)) {
+      sprintf(buffer, "Command not supported by %%zmgsi: %c", command);
+      return mgs_error(p_con, buffer);
+   }
+
+   switch (command) {
+      case 'S':
+         return mgs_cmd_set(p_con);
+      case 'G':
+         return mgs_cmd_get(p_con);
+      case 'K':
+         return mgs_cmd_kill(p_con);
+      case 'D':
+         return mgs_cmd_data(p_con);
+      case 'O':
+         return mgs_cmd_order(p_con, 1);
+      case 'P':
+         return mgs_cmd_order(p_con, -1);
+      case 'I':
+         return mgs_cmd_increment(p_con);
+      case 'N':
+         return mgs_cmd_order_batch(p_con);
+      case 'Q':
+         return mgs_cmd_query_batch(p_con);
+      case 'E':
+         return mgs_cmd_globals(p_con);
+      case 'C':
+         return mgs_cmd_count(p_con);
+      case 'L':
+         return mgs_cmd_lock(p_con);
+      case 'U':
+         return mgs_cmd_unlock(p_con);
+      case 'R':
+         return mgs_cmd_merge(p_con);
+      case 'M':
+         return mgs_cmd_merge_to_db(p_con);
+      case 'm':
+         return mgs_cmd_merge_from_db(p_con);
+      case 'a':
+      case 'b':
+      case 'c':
+      case 'd':
+         return mgs_cmd_transaction(p_con, command);
+      default:
+         sprintf(buffer, "Command not supported by mg_server: %c", command);
+         return mgs_error(p_con, buffer);
+   }
+}
+
+
+int mgs_respond(MGSCON *p_con)
+{
+   unsigned long sent;
+   int n;
+
+   mgs_pause(p_con);
+
+   for (sent = 0; sent < p_con->res.data_size; sent += n) {
+      n = (int) send(p_con->sock, p_con->res.p_buffer + sent, p_con->res.data_size - sent, 0);
+      if (n <= 0) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+
+/* the request items, in order: the records of an array (MG_TX_AREC) are included as AKEY, DATA ... EOD items */
+
+int mgs_items(MGSCON *p_con, unsigned char *data, unsigned long size)
+{
+   int isize, hlen;
+   short byref, type;
+   unsigned long offset;
+   MGSITEM *p_temp;
+
+   p_con->itemn = 0;
+   for (offset = 0; offset < size; offset += (hlen + isize)) {
+      if (p_con->itemn == p_con->item_size) {
+         p_temp = (MGSITEM *) realloc(p_con->item, sizeof(MGSITEM) * (p_con->item_size + 256));
+         if (!p_temp) {
+            return 0;
+         }
+         p_con->item = p_temp;
+         p_con->item_size += 256;
+      }
+      hlen = mg_decode_item_header(data + offset, &isize, &byref, &type);
+      if (isize < 0 || (offset + hlen + isize) > size) {
+         return 0;
+      }
+      p_con->item[p_con->itemn].type = type;
+      p_con->item[p_con->itemn].size = isize;
+      p_con->item[p_con->itemn].ps = data + offset + hlen;
+      p_con->itemn ++;
+   }
+
+   return 1;
+}
+
+
+/* a global reference from items: the global name (with or without the '^') and its subscripts */
+
+int mgs_ref(MGSCON *p_con, MGSREF *p_ref, MGSITEM *item, int itemn, int nullsub)
+{
+   int n;
+
+   p_ref->keyn = 0;
+   if (itemn < 1) {
+      mgs_error(p_con, "Invalid global reference: no global name");
+      return 0;
+   }
+   if (itemn > MGS_MAXKEY) {
+      mgs_error(p_con, "Invalid global reference: too many subscripts");
+      return 0;
+   }
+   for (n = 0; n < itemn; n ++) {
+      p_ref->key[n] = item[n].ps;
+      p_ref->ksize[n] = item[n].size;
+      if (n && !nullsub && !item[n].size) {
+         mgs_error(p_con, "<SUBSCRIPT> Null subscript");
+         return 0;
+      }
+   }
+   if (p_ref->ksize[0] && p_ref->key[0][0] == '^') {
+      p_ref->key[0] ++;
+      p_ref->ksize[0] --;
+   }
+   if (!p_ref->ksize[0]) {
+      mgs_error(p_con, "Invalid global reference: no global name");
+      return 0;
+   }
+   p_ref->keyn = itemn;
+
+   return 1;
+}
+
+
+int mgs_ref_node(MGSREF *p_ref, MGSNODE *p_node, int keyn)
+{
+   int n;
+
+   for (n = 0; n < keyn && n < p_node->keyn; n ++) {
+      p_ref->key[n] = p_node->key[n];
+      p_ref->ksize[n] = p_node->ksize[n];
+   }
+   p_ref->keyn = n;
+
+   return n;
+}
+
+
+int mgs_item_int(MGSITEM *item)
+{
+   char buffer[32];
+
+   if (item->size == 0 || item->size > 30) {
+      return 0;
+   }
+   memcpy((void *) buffer, (void *) item->ps, (size_t) item->size);
+   buffer[item->size] = '\0';
+
+   return (int) strtol(buffer, NULL, 10);
+}
+
+
+int mgs_error(MGSCON *p_con, char *error)
+{
+   if (mgs.verbose) {
+      fprintf(stderr, "[%d] error: %s\n", p_con->id, error);
+   }
+   mg_api_response_error(&(p_con->res), error);
+
+   return 1;
+}
+
+
+/* a single value, not item-encoded (as returned for m_get, m_order, etc.) */
+
+int mgs_value(MGSCON *p_con, unsigned char *value, int vsize)
+{
+   if (vsize > 0) {
+      mg_buf_cat(&(p_con->res), (char *) value, (unsigned long) vsize);
+   }
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* S: global, subscripts ..., data */
+
+int mgs_cmd_set(MGSCON *p_con)
+{
+   MGSREF ref;
+
+   if (p_con->itemn < 2) {
+      return mgs_error(p_con, "Invalid set request");
+   }
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn - 1, 0)) {
+      return 1;
+   }
+   if (!mgs_set(p_con, &ref, p_con->item[p_con->itemn - 1].ps, p_con->item[p_con->itemn - 1].size)) {
+      return mgs_error(p_con, "<STORE> Insufficient memory");
+   }
+
+   return mgs_value(p_con, NULL, 0);
+}
+
+
+int mgs_cmd_get(MGSCON *p_con)
+{
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn, 0)) {
+      return 1;
+   }
+   p_node = mgs_get(&ref);
+
+   return mgs_value(p_con, p_node ? p_node->value : NULL, p_node ? p_node->vsize : 0);
+}
+
+
+int mgs_cmd_kill(MGSCON *p_con)
+{
+   MGSREF ref;
+
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn, 0)) {
+      return 1;
+   }
+   mgs_kill(p_con, &ref);
+
+   return mgs_value(p_con, NULL, 0);
+}
+
+
+int mgs_cmd_data(MGSCON *p_con)
+{
+   char buffer[8];
+   MGSREF ref;
+
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn, 0)) {
+      return 1;
+   }
+   sprintf(buffer, "%d", mgs_data(&ref));
+
+   return mgs_value(p_con, (unsigned char *) buffer, (int) strlen(buffer));
+}
+
+
+/* O, P: global, subscripts ..., seed */
+
+int mgs_cmd_order(MGSCON *p_con, int direction)
+{
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 2) {
+      return mgs_error(p_con, "Invalid order request");
+   }
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn, 1)) {
+      return 1;
+   }
+   p_node = mgs_order(&ref, direction);
+
+   return mgs_value(p_con, p_node ? p_node->key[ref.keyn - 1] : NULL, p_node ? p_node->ksize[ref.keyn - 1] : 0);
+}
+
+
+/* I: global, subscripts ..., increment */
+
+int mgs_cmd_increment(MGSCON *p_con)
+{
+   char buffer[64];
+   double value;
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 2) {
+      return mgs_error(p_con, "Invalid increment request");
+   }
+   if (!mgs_ref(p_con, &ref, p_con->item, p_con->itemn - 1, 0)) {
+      return 1;
+   }
+   value = 0;
+   p_node = mgs_get(&ref);
+   if (p_node && p_node->vsize > 0 && p_node->vsize < 60) {
+      memcpy((void *) buffer, (void *) p_node->value, (size_t) p_node->vsize);
+      buffer[p_node->vsize] = '\0';
+      value = strtod(buffer, NULL);
+   }
+   if (p_con->item[p_con->itemn - 1].size > 0 && p_con->item[p_con->itemn - 1].size < 60) {
+      memcpy((void *) buffer, (void *) p_con->item[p_con->itemn - 1].ps, (size_t) p_con->item[p_con->itemn - 1].size);
+      buffer[p_con->item[p_con->itemn - 1].size] = '\0';
+      value += strtod(buffer, NULL);
+   }
+   mgs_number(buffer, value);
+   if (!mgs_set(p_con, &ref, (unsigned char *) buffer, (int) strlen(buffer))) {
+      return mgs_error(p_con, "<STORE> Insufficient memory");
+   }
+
+   return mgs_value(p_con, (unsigned char *) buffer, (int) strlen(buffer));
+}
+
+
+/*
+   Batched $Order (N): as mg_api_order() in mg_dba.c
+   Request items:  max, direction, flags ('d' $Data, 'v' value, 'i' include the seed), stop, global, subscripts ..., seed
+   Response items: key [, $Data] [, value] for each node found
+*/
+
+int mgs_cmd_order_batch(MGSCON *p_con)
+{
+   int n, max, rows, direction, getdata, getvalue, inclusive;
+   MGSREF ref;
+   MGSITEM *stop;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 6) {
+      return mgs_error(p_con, "Invalid batched order request");
+   }
+   max = mgs_item_int(&(p_con->item[0]));
+   if (max < 1) {
+      max = 1;
+   }
+   direction = (mgs_item_int(&(p_con->item[1])) < 0) ? -1 : 1;
+   getdata = 0;
+   getvalue = 0;
+   inclusive = 0;
+   for (n = 0; n < p_con->item[2].size; n ++) {
+      if (p_con->item[2].ps[n] == 'd')
+         getdata = 1;
+      else if (p_con->item[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (p_con->item[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+   stop = &(p_con->item[3]);
+   if (!mgs_ref(p_con, &ref, p_con->item + 4, p_con->itemn - 4, 1)) {
+      return 1;
+   }
+
+   rows = 0;
+   if (inclusive && ref.ksize[ref.keyn - 1] && mgs_data(&ref)) {
+      mgs_order_row(p_con, &ref, getdata, getvalue);
+      rows ++;
+   }
+   while (rows < max) {
+      p_node = mgs_order(&ref, direction);
+      if (!p_node) {
+         break;
+      }
+      ref.key[ref.keyn - 1] = p_node->key[ref.keyn - 1];
+      ref.ksize[ref.keyn - 1] = p_node->ksize[ref.keyn - 1];
+      if (stop->size) {
+         n = mg_collate_compare(ref.key[ref.keyn - 1], ref.ksize[ref.keyn - 1], stop->ps, stop->size);
+         if ((direction == 1 && n > 0) || (direction == -1 && n < 0)) {
+            break;
+         }
+      }
+      mgs_order_row(p_con, &ref, getdata, getvalue);
+      rows ++;
+   }
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+int mgs_order_row(MGSCON *p_con, MGSREF *p_ref, int getdata, int getvalue)
+{
+   int data;
+   char buffer[8];
+   MGSNODE *p_node;
+
+   mg_api_response_item(&(p_con->res), p_ref->key[p_ref->keyn - 1], p_ref->ksize[p_ref->keyn - 1]);
+   if (!getdata && !getvalue) {
+      return 1;
+   }
+   data = mgs_data(p_ref);
+   if (getdata) {
+      sprintf(buffer, "%d", data);
+      mg_api_response_item(&(p_con->res), (unsigned char *) buffer, (int) strlen(buffer));
+   }
+   if (getvalue) {
+      p_node = (data % 2) ? mgs_get(p_ref) : NULL;
+      mg_api_response_item(&(p_con->res), p_node ? p_node->value : NULL, p_node ? p_node->vsize : 0);
+   }
+
+   return 1;
+}
+
+
+/*
+   Batched $Query (Q): as mg_api_query() in mg_dba.c
+   Request items:  max, direction, flags ('v' value, 's' start of the walk, 'i' include the node itself), base, global, subscripts ...
+   Response items: number of subscripts, subscripts ... [, value] for each node found
+*/
+
+int mgs_cmd_query_batch(MGSCON *p_con)
+{
+   int n, idx, max, rows, direction, getvalue, start, inclusive, basen;
+   MGSREF ref, base;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 5) {
+      return mgs_error(p_con, "Invalid batched query request");
+   }
+   max = mgs_item_int(&(p_con->item[0]));
+   if (max < 1) {
+      max = 1;
+   }
+   direction = (mgs_item_int(&(p_con->item[1])) < 0) ? -1 : 1;
+   getvalue = 0;
+   start = 0;
+   inclusive = 0;
+   for (n = 0; n < p_con->item[2].size; n ++) {
+      if (p_con->item[2].ps[n] == 'v')
+         getvalue = 1;
+      else if (p_con->item[2].ps[n] == 's')
+         start = 1;
+      else if (p_con->item[2].ps[n] == 'i')
+         inclusive = 1;
+   }
+   if (!mgs_ref(p_con, &ref, p_con->item + 4, p_con->itemn - 4, 1)) {
+      return 1;
+   }
+   basen = mgs_item_int(&(p_con->item[3]));
+   if (basen < 0 || basen > (ref.keyn - 1)) {
+      basen = ref.keyn - 1;
+   }
+   base = ref;
+   base.keyn = basen + 1;
+
+   /* the data nodes are held in $Query order: walk them from the reference */
+   rows = 0;
+   if (direction == 1) {
+      idx = mgs_lower_bound(&ref);
+      p_node = mgs_get(&ref);
+      if (p_node) {
+         if (inclusive) {
+            mgs_query_row(p_con, p_node, getvalue);
+            rows ++;
+         }
+         idx ++;
+      }
+   }
+   else if (start) {
+      idx = mgs_subtree_end(&base) - 1;
+   }
+   else {
+      idx = mgs_lower_bound(&ref) - 1;
+   }
+
+   for (; idx >= 0 && idx < mgs.noden && rows < max; idx += direction) {
+      p_node = mgs.node[idx];
+      if (p_node->keyn <= base.keyn || !mgs_in_subtree(p_node, &base)) {
+         break;
+      }
+      mgs_query_row(p_con, p_node, getvalue);
+      rows ++;
+   }
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+int mgs_query_row(MGSCON *p_con, MGSNODE *p_node, int getvalue)
+{
+   int n;
+   char buffer[16];
+
+   sprintf(buffer, "%d", p_node->keyn - 1);
+   mg_api_response_item(&(p_con->res), (unsigned char *) buffer, (int) strlen(buffer));
+   for (n = 1; n < p_node->keyn; n ++) {
+      mg_api_response_item(&(p_con->res), p_node->key[n], p_node->ksize[n]);
+   }
+   if (getvalue) {
+      mg_api_response_item(&(p_con->res), p_node->value, p_node->vsize);
+   }
+
+   return 1;
+}
+
+
+/*
+   Global directory (E): as mg_api_globals() in mg_dba.c
+   Request items:  max (0 for no limit), flags, prefix, seed
+   Response items: global names (with the leading '^') following the seed
+*/
+
+int mgs_cmd_globals(MGSCON *p_con)
+{
+   int idx, max, rows, plen;
+   unsigned char name[256];
+   unsigned char *prefix;
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 4) {
+      return mgs_error(p_con, "Invalid global directory request");
+   }
+   max = mgs_item_int(&(p_con->item[0]));
+   prefix = p_con->item[2].ps;
+   plen = p_con->item[2].size;
+   if (plen && prefix[0] == '^') {
+      prefix ++;
+      plen --;
+   }
+
+   ref.keyn = 1;
+   if (p_con->item[3].size) {
+      ref.key[0] = p_con->item[3].ps;
+      ref.ksize[0] = p_con->item[3].size;
+      if (ref.key[0][0] == '^') {
+         ref.key[0] ++;
+         ref.ksize[0] --;
+      }
+      idx = mgs_subtree_end(&ref);
+   }
+   else if (plen) {
+      ref.key[0] = prefix;
+      ref.ksize[0] = plen;
+      idx = mgs_lower_bound(&ref);
+   }
+   else {
+      idx = 0;
+   }
+
+   rows = 0;
+   while (idx < mgs.noden && (max < 1 || rows < max)) {
+      p_node = mgs.node[idx];
+      if (plen && (p_node->ksize[0] < plen || memcmp((void *) p_node->key[0], (void *) prefix, (size_t) plen))) {
+         break;
+      }
+      if (p_node->ksize[0] < (int) sizeof(name) - 1) {
+         name[0] = '^';
+         memcpy((void *) (name + 1), (void *) p_node->key[0], (size_t) p_node->ksize[0]);
+         mg_api_response_item(&(p_con->res), name, p_node->ksize[0] + 1);
+         rows ++;
+      }
+      mgs_ref_node(&ref, p_node, 1);
+      idx = mgs_subtree_end(&ref);
+   }
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/*
+   Subtree aggregation (C): as mg_api_count() in mg_dba.c
+   Request items:  flags ('d' all the data nodes below, 's' total the data size), limit, global, subscripts ...
+   Response items: total
+*/
+
+int mgs_cmd_count(MGSCON *p_con)
+{
+   int n, idx, end, descend, size;
+   unsigned long total, limit;
+   char buffer[32];
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   if (p_con->itemn < 3) {
+      return mgs_error(p_con, "Invalid count request");
+   }
+   descend = 0;
+   size = 0;
+   for (n = 0; n < p_con->item[0].size; n ++) {
+      if (p_con->item[0].ps[n] == 'd')
+         descend = 1;
+      else if (p_con->item[0].ps[n] == 's')
+         size = 1;
+   }
+   limit = 0;
+   if (p_con->item[1].size > 0 && p_con->item[1].size < 30 && p_con->item[1].ps[0] != '-') {
+      memcpy((void *) buffer, (void *) p_con->item[1].ps, (size_t) p_con->item[1].size);
+      buffer[p_con->item[1].size] = '\0';
+      limit = strtoul(buffer, NULL, 10);
+   }
+   if (!mgs_ref(p_con, &ref, p_con->item + 2, p_con->itemn - 2, 0)) {
+      return 1;
+   }
+
+   total = 0;
+   idx = mgs_lower_bound(&ref);
+   end = mgs_subtree_end(&ref);
+   for (; idx < end && (!limit || total < limit); idx ++) {
+      p_node = mgs.node[idx];
+      if (size) {
+         total += (unsigned long) p_node->vsize;
+      }
+      else if (p_node->keyn == ref.keyn) {
+         continue;
+      }
+      else if (descend) {
+         total ++;
+      }
+      else {
+         /* count each subscript at the next level once */
+         total ++;
+         mgs_ref_node(&ref, p_node, ref.keyn + 1);
+         idx = mgs_subtree_end(&ref) - 1;
+         ref.keyn --;
+      }
+   }
+
+   sprintf(buffer, "%lu", total);
+   mg_api_response_item(&(p_con->res), (unsigned char *) buffer, (int) strlen(buffer));
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/*
+   Incremental lock (L): as mg_api_lock() in mg_dba.c
+   Request items:  timeout (milliseconds; -1 to wait indefinitely), then for each node: number of keys, global, subscripts ...
+   Response items: 1 if all the nodes were locked; 0 if the timeout expired (in which case none of them are held)
+*/
+
+int mgs_cmd_lock(MGSCON *p_con)
+{
+   int n, m, keyn, timeout, remaining, locked;
+   unsigned long start;
+   MGSREF ref;
+
+   if (p_con->itemn < 3) {
+      return mgs_error(p_con, "Invalid lock request");
+   }
+   timeout = mgs_item_int(&(p_con->item[0]));
+   start = mg_api_time_ms();
+
+   locked = 1;
+   for (n = 1; n < p_con->itemn; n += (keyn + 1)) {
+      keyn = mgs_item_int(&(p_con->item[n]));
+      if (keyn < 1 || (n + keyn) >= p_con->itemn || !mgs_ref(p_con, &ref, p_con->item + n + 1, keyn, 0)) {
+         locked = -1;
+         break;
+      }
+      remaining = timeout;
+      if (timeout > 0) {
+         remaining = timeout - (int) (mg_api_time_ms() - start);
+         if (remaining < 0) {
+            remaining = 0;
+         }
+      }
+      if (!mgs_lock_node(p_con, &ref, remaining)) {
+         locked = 0;
+         break;
+      }
+   }
+
+   /* all or nothing: release the nodes already locked */
+   if (locked < 1) {
+      for (m = 1; m < n; m += (keyn + 1)) {
+         keyn = mgs_item_int(&(p_con->item[m]));
+         mgs_ref(p_con, &ref, p_con->item + m + 1, keyn, 0);
+         mgs_unlock_node(p_con, &ref);
+      }
+   }
+   if (locked < 0) {
+      return mgs_error(p_con, "Invalid lock reference");
+   }
+
+   mg_api_response_item(&(p_con->res), (unsigned char *) (locked ? "1" : "0"), 1);
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* U: for each node: number of keys, global, subscripts ... */
+
+int mgs_cmd_unlock(MGSCON *p_con)
+{
+   int n, keyn;
+   MGSREF ref;
+
+   for (n = 0; n < p_con->itemn; n += (keyn + 1)) {
+      keyn = mgs_item_int(&(p_con->item[n]));
+      if (keyn < 1 || (n + keyn) >= p_con->itemn || !mgs_ref(p_con, &ref, p_con->item + n + 1, keyn, 0)) {
+         return mgs_error(p_con, "Invalid lock reference");
+      }
+      mgs_unlock_node(p_con, &ref);
+   }
+
+   mg_api_response_item(&(p_con->res), (unsigned char *) "1", 1);
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* R: to keyn, global, subscripts ..., from keyn, global, subscripts ... (MERGE ^to(...)=^from(...)) */
+
+int mgs_cmd_merge(MGSCON *p_con)
+{
+   int n, idx, end, to_keyn, from_keyn, copyn, rc;
+   MGSREF to, from, ref;
+   MGSNODE **copy;
+
+   to_keyn = (p_con->itemn > 0) ? mgs_item_int(&(p_con->item[0])) : 0;
+   from_keyn = (to_keyn > 0 && (to_keyn + 1) < p_con->itemn) ? mgs_item_int(&(p_con->item[to_keyn + 1])) : 0;
+   if (to_keyn < 1 || from_keyn < 1 || (to_keyn + from_keyn + 2) != p_con->itemn) {
+      return mgs_error(p_con, "Invalid merge request");
+   }
+   if (!mgs_ref(p_con, &to, p_con->item + 1, to_keyn, 0) || !mgs_ref(p_con, &from, p_con->item + to_keyn + 2, from_keyn, 0)) {
+      return 1;
+   }
+
+   /* copy the source first: the target may overlap it */
+   idx = mgs_lower_bound(&from);
+   end = mgs_subtree_end(&from);
+   copy = (MGSNODE **) malloc(sizeof(MGSNODE *) * ((end - idx) + 1));
+   if (!copy) {
+      return mgs_error(p_con, "<STORE> Insufficient memory");
+   }
+   for (copyn = 0; idx < end; idx ++) {
+      copy[copyn] = mgs_node_copy(mgs.node[idx]);
+      if (copy[copyn]) {
+         copyn ++;
+      }
+   }
+
+   rc = 1;
+   for (n = 0; n < copyn; n ++) {
+      ref = to;
+      for (idx = from_keyn; idx < copy[n]->keyn && ref.keyn < MGS_MAXKEY; idx ++) {
+         ref.key[ref.keyn] = copy[n]->key[idx];
+         ref.ksize[ref.keyn] = copy[n]->ksize[idx];
+         ref.keyn ++;
+      }
+      if (rc && !mgs_set(p_con, &ref, copy[n]->value, copy[n]->vsize)) {
+         rc = 0;
+      }
+      mgs_node_free(copy[n]);
+   }
+   free((void *) copy);
+
+   if (!rc) {
+      return mgs_error(p_con, "<STORE> Insufficient memory");
+   }
+   mg_api_response_item(&(p_con->res), (unsigned char *) "1", 1);
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* M: global, subscripts ..., AREC, (AKEY ... DATA) ..., EOD, options */
+
+int mgs_cmd_merge_to_db(MGSCON *p_con)
+{
+   int n, arec, basen;
+   MGSREF ref;
+
+   for (arec = 0; arec < p_con->itemn && p_con->item[arec].type != MG_TX_AREC; arec ++)
+      ;
+   if (arec == p_con->itemn || !mgs_ref(p_con, &ref, p_con->item, arec, 0)) {
+      return (arec == p_con->itemn) ? mgs_error(p_con, "Invalid merge request: no array") : 1;
+   }
+   basen = ref.keyn;
+
+   for (n = arec + 1; n < p_con->itemn && p_con->item[n].type != MG_TX_EOD; n ++) {
+      if (p_con->item[n].type == MG_TX_AKEY) {
+         if (ref.keyn == MGS_MAXKEY) {
+            return mgs_error(p_con, "Invalid global reference: too many subscripts");
+         }
+         ref.key[ref.keyn] = p_con->item[n].ps;
+         ref.ksize[ref.keyn] = p_con->item[n].size;
+         ref.keyn ++;
+      }
+      else {
+         if (ref.keyn > basen && !mgs_set(p_con, &ref, p_con->item[n].ps, p_con->item[n].size)) {
+            return mgs_error(p_con, "<STORE> Insufficient memory");
+         }
+         ref.keyn = basen;
+      }
+   }
+
+   mg_api_response_item(&(p_con->res), (unsigned char *) "1", 1);
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* m: global, subscripts ..., AREC (the PHP array), EOD, options: the response is the subtree as an array record */
+
+int mgs_cmd_merge_from_db(MGSCON *p_con)
+{
+   int n, idx, end, hlen;
+   unsigned char head[16];
+   MGSREF ref;
+   MGSNODE *p_node;
+
+   for (n = 0; n < p_con->itemn && p_con->item[n].type != MG_TX_AREC; n ++)
+      ;
+   if (!mgs_ref(p_con, &ref, p_con->item, n, 0)) {
+      return 1;
+   }
+
+   hlen = mg_encode_item_header(head, 0, 0, MG_TX_AREC);
+   mg_buf_cat(&(p_con->res), (char *) head, hlen);
+   idx = mgs_lower_bound(&ref);
+   end = mgs_subtree_end(&ref);
+   for (; idx < end; idx ++) {
+      p_node = mgs.node[idx];
+      if (p_node->keyn == ref.keyn) {
+         continue;
+      }
+      for (n = ref.keyn; n < p_node->keyn; n ++) {
+         mg_request_add(NULL, 0, &(p_con->res), p_node->key[n], p_node->ksize[n], 0, MG_TX_AKEY);
+      }
+      mg_request_add(NULL, 0, &(p_con->res), p_node->value, p_node->vsize, 0, MG_TX_DATA);
+   }
+   hlen = mg_encode_item_header(head, 0, 0, MG_TX_EOD);
+   mg_buf_cat(&(p_con->res), (char *) head, hlen);
+   mg_api_response_end(&(p_con->res), 0);
+
+   return 1;
+}
+
+
+/* a: tstart, b: $tlevel, c: tcommit, d: trollback */
+
+int mgs_cmd_transaction(MGSCON *p_con, char command)
+{
+   char buffer[16];
+
+   strcpy(buffer, "0");
+   if (command == 'a') {
+      p_con->tlevel ++;
+   }
+   else if (command == 'b') {
+      sprintf(buffer, "%d", p_con->tlevel);
+   }
+   else if (command == 'c') {
+      if (p_con->tlevel > 0) {
+         p_con->tlevel --;
+      }
+      if (p_con->tlevel == 0) {
+         mgs_undo_free(p_con);
+      }
+   }
+   else {
+      mgs_undo(p_con);
+   }
+
+   return mgs_value(p_con, (unsigned char *) buffer, (int) strlen(buffer));
+}
+
+
+/* X: function, arguments ...: the built-in functions (the response for an unknown function is an error) */
+
+int mgs_cmd_function(MGSCON *p_con)
+{
+   int n, len, msecs;
+   char label[32], buffer[256];
+   unsigned char *p;
+
+   if (p_con->itemn < 1) {
+      return mgs_error(p_con, "Invalid function request");
+   }
+   p = p_con->item[0].ps;
+   len = p_con->item[0].size;
+   while (len && *p == '$') {
+      p ++;
+      len --;
+   }
+   for (n = 0; n < len && n < (int) (sizeof(label) - 1) && p[n] != '^'; n ++) {
+      label[n] = (char) p[n];
+   }
+   label[n] = '\0';
+
+   if (!strcmp(label, "echo")) {
+      return mgs_value(p_con, (p_con->itemn > 1) ? p_con->item[1].ps : NULL, (p_con->itemn > 1) ? p_con->item[1].size : 0);
+   }
+   else if (!strcmp(label, "concat")) {
+      for (n = 1; n < p_con->itemn; n ++) {
+         if (p_con->item[n].type == MG_TX_DATA && p_con->item[n].size) {
+            mg_buf_cat(&(p_con->res), (char *) p_con->item[n].ps, (unsigned long) p_con->item[n].size);
+         }
+      }
+      return mgs_value(p_con, NULL, 0);
+   }
+   else if (!strcmp(label, "sleep")) {
+      msecs = (p_con->itemn > 1) ? mgs_item_int(&(p_con->item[1])) : 0;
+      if (msecs > 0) {
+         mg_sleep((unsigned long) msecs);
+      }
+      return mgs_value(p_con, NULL, 0);
+   }
+   else if (!strcmp(label, "reset")) {
+      pthread_mutex_lock(&(mgs.lock));
+      for (n = 0; n < mgs.noden; n ++) {
+         mgs_node_free(mgs.node[n]);
+      }
+      mgs.noden = 0;
+      for (n = 0; n < mgs.lockn; n ++) {
+         mgs_node_free(mgs.locks[n].p_ref);
+      }
+      mgs.lockn = 0;
+      pthread_cond_broadcast(&(mgs.unlocked));
+      pthread_mutex_unlock(&(mgs.lock));
+      mgs_undo_free(p_con);
+      p_con->tlevel = 0;
+      return mgs_value(p_con, (unsigned char *) "1", 1);
+   }
+   else if (!strcmp(label, "version")) {
+      return mgs_value(p_con, (unsigned char *) MGS_VERSION, (int) strlen(MGS_VERSION));
+   }
+
+   sprintf(buffer, "<NOLINE> Function not available in mg_server: %.*s", (int) (p_con->item[0].size > 64 ? 64 : p_con->item[0].size), (char *) p_con->item[0].ps);
+
+   return mgs_error(p_con, buffer);
+}
+
+
+/* the global name collates by byte value; subscripts in M collation (canonical numbers, then strings) */
+
+int mgs_compare(int keyn1, unsigned char **key1, int *ksize1, int keyn2, unsigned char **key2, int *ksize2, int subtree)
+{
+   int n, max, cmp;
+
+   max = (keyn1 < keyn2) ? keyn1 : keyn2;
+   for (n = 0; n < max; n ++) {
+      if (n == 0) {
+         cmp = memcmp((void *) key1[0], (void *) key2[0], (size_t) (ksize1[0] < ksize2[0] ? ksize1[0] : ksize2[0]));
+         if (!cmp) {
+            cmp = ksize1[0] - ksize2[0];
+         }
+      }
+      else {
+         cmp = mg_collate_compare(key1[n], ksize1[n], key2[n], ksize2[n]);
+      }
+      if (cmp) {
+         return (cmp < 0) ? -1 : 1;
+      }
+   }
+
+   /* in subtree mode, a descendant compares equal to its ancestor */
+   if (subtree && keyn1 >= keyn2) {
+      return 0;
+   }
+
+   return (keyn1 < keyn2) ? -1 : ((keyn1 > keyn2) ? 1 : 0);
+}
+
+
+/* the first node at or after the reference */
+
+int mgs_lower_bound(MGSREF *p_ref)
+{
+   int lo, hi, mid;
+
+   lo = 0;
+   hi = mgs.noden;
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (mgs_compare(mgs.node[mid]->keyn, mgs.node[mid]->key, mgs.node[mid]->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 0) < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return lo;
+}
+
+
+/* the first node after the reference and all of its descendants */
+
+int mgs_subtree_end(MGSREF *p_ref)
+{
+   int lo, hi, mid;
+
+   lo = 0;
+   hi = mgs.noden;
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (mgs_compare(mgs.node[mid]->keyn, mgs.node[mid]->key, mgs.node[mid]->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 1) <= 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return lo;
+}
+
+
+int mgs_in_subtree(MGSNODE *p_node, MGSREF *p_ref)
+{
+   return (p_node->keyn >= p_ref->keyn && mgs_compare(p_node->keyn, p_node->key, p_node->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 1) == 0);
+}
+
+
+/* the node and its keys are allocated as one block; the value separately (it may be replaced) */
+
+MGSNODE * mgs_node_alloc(MGSREF *p_ref, unsigned char *value, int vsize)
+{
+   int n;
+   unsigned long size;
+   unsigned char *p;
+   MGSNODE *p_node;
+
+   size = sizeof(MGSNODE) + (p_ref->keyn * (sizeof(unsigned char *) + sizeof(int)));
+   for (n = 0; n < p_ref->keyn; n ++) {
+      size += p_ref->ksize[n];
+   }
+   p_node = (MGSNODE *) malloc(size);
+   if (!p_node) {
+      return NULL;
+   }
+   p_node->keyn = p_ref->keyn;
+   p_node->key = (unsigned char **) (((unsigned char *) p_node) + sizeof(MGSNODE));
+   p_node->ksize = (int *) (((unsigned char *) p_node->key) + (p_ref->keyn * sizeof(unsigned char *)));
+   p = ((unsigned char *) p_node->ksize) + (p_ref->keyn * sizeof(int));
+   for (n = 0; n < p_ref->keyn; n ++) {
+      p_node->key[n] = p;
+      p_node->ksize[n] = p_ref->ksize[n];
+      if (p_ref->ksize[n]) {
+         memcpy((void *) p, (void *) p_ref->key[n], (size_t) p_ref->ksize[n]);
+      }
+      p += p_ref->ksize[n];
+   }
+
+   p_node->vsize = vsize;
+   p_node->value = NULL;
+   if (vsize >= 0) {
+      p_node->value = (unsigned char *) malloc(vsize + 1);
+      if (!p_node->value) {
+         free((void *) p_node);
+         return NULL;
+      }
+      if (vsize) {
+         memcpy((void *) p_node->value, (void *) value, (size_t) vsize);
+      }
+      p_node->value[vsize] = '\0';
+   }
+
+   return p_node;
+}
+
+
+MGSNODE * mgs_node_copy(MGSNODE *p_node)
+{
+   MGSREF ref;
+
+   mgs_ref_node(&ref, p_node, p_node->keyn);
+
+   return mgs_node_alloc(&ref, p_node->value, p_node->vsize);
+}
+
+
+int mgs_node_free(MGSNODE *p_node)
+{
+   if (!p_node) {
+      return 0;
+   }
+   if (p_node->value) {
+      free((void *) p_node->value);
+   }
+   free((void *) p_node);
+
+   return 1;
+}
+
+
+MGSNODE * mgs_get(MGSREF *p_ref)
+{
+   int idx;
+
+   idx = mgs_lower_bound(p_ref);
+   if (idx < mgs.noden && !mgs_compare(mgs.node[idx]->keyn, mgs.node[idx]->key, mgs.node[idx]->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 0)) {
+      return mgs.node[idx];
+   }
+
+   return NULL;
+}
+
+
+int mgs_data(MGSREF *p_ref)
+{
+   int idx, data;
+
+   data = 0;
+   idx = mgs_lower_bound(p_ref);
+   if (idx < mgs.noden && !mgs_compare(mgs.node[idx]->keyn, mgs.node[idx]->key, mgs.node[idx]->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 0)) {
+      data = 1;
+      idx ++;
+   }
+   if (idx < mgs.noden && mgs.node[idx]->keyn > p_ref->keyn && mgs_in_subtree(mgs.node[idx], p_ref)) {
+      data += 10;
+   }
+
+   return data;
+}
+
+
+int mgs_set(MGSCON *p_con, MGSREF *p_ref, unsigned char *value, int vsize)
+{
+   int idx;
+   unsigned char *p;
+   MGSNODE *p_node, **p_temp;
+
+   idx = mgs_lower_bound(p_ref);
+   p_node = NULL;
+   if (idx < mgs.noden && !mgs_compare(mgs.node[idx]->keyn, mgs.node[idx]->key, mgs.node[idx]->ksize, p_ref->keyn, p_ref->key, p_ref->ksize, 0)) {
+      p_node = mgs.node[idx];
+   }
+   if (p_con && p_con->tlevel > 0 && !mgs_undo_log(p_con, p_ref, p_node)) {
+      return 0;
+   }
+
+   if (p_node) {
+      p = (unsigned char *) malloc(vsize + 1);
+      if (!p) {
+         return 0;
+      }
+      if (vsize) {
+         memcpy((void *) p, (void *) value, (size_t) vsize);
+      }
+      p[vsize] = '\0';
+      free((void *) p_node->value);
+      p_node->value = p;
+      p_node->vsize = vsize;
+      return 1;
+   }
+
+   if (mgs.noden == mgs.node_size) {
+      p_temp = (MGSNODE **) realloc(mgs.node, sizeof(MGSNODE *) * (mgs.node_size ? (mgs.node_size * 2) : 1024));
+      if (!p_temp) {
+         return 0;
+      }
+      mgs.node = p_temp;
+      mgs.node_size = mgs.node_size ? (mgs.node_size * 2) : 1024;
+   }
+   p_node = mgs_node_alloc(p_ref, value, vsize);
+   if (!p_node) {
+      return 0;
+   }
+   memmove((void *) (mgs.node + idx + 1), (void *) (mgs.node + idx), sizeof(MGSNODE *) * (mgs.noden - idx));
+   mgs.node[idx] = p_node;
+   mgs.noden ++;
+
+   return 1;
+}
+
+
+int mgs_kill(MGSCON *p_con, MGSREF *p_ref)
+{
+   int n, idx, end;
+   MGSREF ref;
+
+   idx = mgs_lower_bound(p_ref);
+   end = mgs_subtree_end(p_ref);
+   if (idx >= end) {
+      return 0;
+   }
+   for (n = idx; n < end; n ++) {
+      if (p_con && p_con->tlevel > 0) {
+         mgs_ref_node(&ref, mgs.node[n], mgs.node[n]->keyn);
+         mgs_undo_log(p_con, &ref, mgs.node[n]);
+      }
+      mgs_node_free(mgs.node[n]);
+   }
+   memmove((void *) (mgs.node + idx), (void *) (mgs.node + end), sizeof(MGSNODE *) * (mgs.noden - end));
+   mgs.noden -= (end - idx);
+
+   return (end - idx);
+}
+
+
+/* $Order: the last key of the reference is the seed; returns a node holding the next subscript at that level */
+
+MGSNODE * mgs_order(MGSREF *p_ref, int direction)
+{
+   int idx, depth;
+   MGSREF parent;
+   MGSNODE *p_node;
+
+   depth = p_ref->keyn - 1;
+   parent = *p_ref;
+   parent.keyn = depth;
+
+   if (direction == 1) {
+      if (p_ref->ksize[depth]) {
+         idx = mgs_subtree_end(p_ref);
+      }
+      else {
+         idx = mgs_lower_bound(&parent);
+         if (idx < mgs.noden && mgs.node[idx]->keyn == depth && mgs_in_subtree(mgs.node[idx], &parent)) {
+            idx ++;
+         }
+      }
+   }
+   else {
+      if (p_ref->ksize[depth]) {
+         idx = mgs_lower_bound(p_ref) - 1;
+      }
+      else {
+         idx = mgs_subtree_end(&parent) - 1;
+      }
+   }
+
+   if (idx < 0 || idx >= mgs.noden) {
+      return NULL;
+   }
+   p_node = mgs.node[idx];
+   if (p_node->keyn <= depth || !mgs_in_subtree(p_node, &parent)) {
+      return NULL;
+   }
+
+   return p_node;
+}
+
+
+/* the state of a node before its first change in a transaction (vsize -1 if it was not defined) */
+
+int mgs_undo_log(MGSCON *p_con, MGSREF *p_ref, MGSNODE *p_node)
+{
+   MGSNODE **p_temp;
+
+   if (p_con->undon == p_con->undo_size) {
+      p_temp = (MGSNODE **) realloc(p_con->undo, sizeof(MGSNODE *) * (p_con->undo_size + 1024));
+      if (!p_temp) {
+         return 0;
+      }
+      p_con->undo = p_temp;
+      p_con->undo_size += 1024;
+   }
+   p_con->undo[p_con->undon] = p_node ? mgs_node_copy(p_node) : mgs_node_alloc(p_ref, NULL, -1);
+   if (!p_con->undo[p_con->undon]) {
+      return 0;
+   }
+   p_con->undon ++;
+
+   return 1;
+}
+
+
+/* roll back: restore the nodes changed, most recent first */
+
+int mgs_undo(MGSCON *p_con)
+{
+   int n, idx;
+   MGSREF ref;
+   MGSNODE *p_undo;
+
+   for (n = p_con->undon - 1; n >= 0; n --) {
+      p_undo = p_con->undo[n];
+      mgs_ref_node(&ref, p_undo, p_undo->keyn);
+      if (p_undo->vsize >= 0) {
+         mgs_set(NULL, &ref, p_undo->value, p_undo->vsize);
+      }
+      else if (mgs_get(&ref)) {
+         idx = mgs_lower_bound(&ref);
+         mgs_node_free(mgs.node[idx]);
+         memmove((void *) (mgs.node + idx), (void *) (mgs.node + idx + 1), sizeof(MGSNODE *) * (mgs.noden - (idx + 1)));
+         mgs.noden --;
+      }
+   }
+   mgs_undo_free(p_con);
+   p_con->tlevel = 0;
+
+   return 1;
+}
+
+
+int mgs_undo_free(MGSCON *p_con)
+{
+   int n;
+
+   for (n = 0; n < p_con->undon; n ++) {
+      mgs_node_free(p_con->undo[n]);
+   }
+   p_con->undon = 0;
+   if (p_con->undo) {
+      free((void *) p_con->undo);
+   }
+   p_con->undo = NULL;
+   p_con->undo_size = 0;
+
+   return 1;
+}
+
+
+/* M lock semantics: a node cannot be locked while another connection holds a lock on it, an ancestor or a descendant */
+
+int mgs_lock_node(MGSCON *p_con, MGSREF *p_ref, int timeout)
+{
+   int n, conflict, own;
+   struct timespec deadline;
+   MGSLOCK *p_temp;
+
+   if (timeout > 0) {
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += (timeout / 1000);
+      deadline.tv_nsec += ((long) (timeout % 1000) * 1000000L);
+      if (deadline.tv_nsec >= 1000000000L) {
+         deadline.tv_sec ++;
+         deadline.tv_nsec -= 1000000000L;
+      }
+   }
+
+   for (;;) {
+      conflict = 0;
+      own = -1;
+      for (n = 0; n < mgs.lockn; n ++) {
+         if (mgs.locks[n].owner == p_con->id) {
+            if (mgs.locks[n].p_ref->keyn == p_ref->keyn && mgs_in_subtree(mgs.locks[n].p_ref, p_ref)) {
+               own = n;
+            }
+            continue;
+         }
+         if (mgs_in_subtree(mgs.locks[n].p_ref, p_ref) || (p_ref->keyn > mgs.locks[n].p_ref->keyn && mgs_compare(p_ref->keyn, p_ref->key, p_ref->ksize, mgs.locks[n].p_ref->keyn, mgs.locks[n].p_ref->key, mgs.locks[n].p_ref->ksize, 1) == 0)) {
+            conflict = 1;
+            break;
+         }
+      }
+      if (!conflict) {
+         break;
+      }
+      if (timeout == 0) {
+         return 0;
+      }
+      if (timeout < 0) {
+         pthread_cond_wait(&(mgs.unlocked), &(mgs.lock));
+      }
+      else if (pthread_cond_timedwait(&(mgs.unlocked), &(mgs.lock), &deadline) == ETIMEDOUT) {
+         return 0;
+      }
+   }
+
+   if (own >= 0) {
+      mgs.locks[own].count ++;
+      return 1;
+   }
+   if (mgs.lockn == mgs.lock_size) {
+      p_temp = (MGSLOCK *) realloc(mgs.locks, sizeof(MGSLOCK) * (mgs.lock_size + 64));
+      if (!p_temp) {
+         return 0;
+      }
+      mgs.locks = p_temp;
+      mgs.lock_size += 64;
+   }
+   mgs.locks[mgs.lockn].p_ref = mgs_node_alloc(p_ref, NULL, -1);
+   if (!mgs.locks[mgs.lockn].p_ref) {
+      return 0;
+   }
+   mgs.locks[mgs.lockn].owner = p_con->id;
+   mgs.locks[mgs.lockn].count = 1;
+   mgs.lockn ++;
+
+   return 1;
+}
+
+
+int mgs_unlock_node(MGSCON *p_con, MGSREF *p_ref)
+{
+   int n;
+
+   for (n = 0; n < mgs.lockn; n ++) {
+      if (mgs.locks[n].owner == p_con->id && mgs.locks[n].p_ref->keyn == p_ref->keyn && mgs_in_subtree(mgs.locks[n].p_ref, p_ref)) {
+         mgs.locks[n].count --;
+         if (mgs.locks[n].count < 1) {
+            mgs_node_free(mgs.locks[n].p_ref);
+            mgs.locks[n] = mgs.locks[mgs.lockn - 1];
+            mgs.lockn --;
+            pthread_cond_broadcast(&(mgs.unlocked));
+         }
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+
+int mgs_unlock_all(int owner)
+{
+   int n, released;
+
+   released = 0;
+   for (n = 0; n < mgs.lockn; ) {
+      if (mgs.locks[n].owner == owner) {
+         mgs_node_free(mgs.locks[n].p_ref);
+         mgs.locks[n] = mgs.locks[mgs.lockn - 1];
+         mgs.lockn --;
+         released ++;
+         continue;
+      }
+      n ++;
+   }
+   if (released) {
+      pthread_cond_broadcast(&(mgs.unlocked));
+   }
+
+   return released;
+}
+
+
+/* M canonical form: integers without a decimal point, no leading zero before the point, no trailing zeros */
+
+int mgs_number(char *buffer, double value)
+{
+   int len;
+
+   if (value == (double) ((long long) value) && value > -1e15 && value < 1e15) {
+      return sprintf(buffer, "%lld", (long long) value);
+   }
+   len = sprintf(buffer, "%.15g", value);
+   if (!strncmp(buffer, "0.", 2)) {
+      memmove((void *) buffer, (void *) (buffer + 1), (size_t) len);
+      len --;
+   }
+   else if (!strncmp(buffer, "-0.", 3)) {
+      memmove((void *) (buffer + 1), (void *) (buffer + 2), (size_t) (len - 1));
+      len --;
+   }
+
+   return len;
+}
+
+
+int mgs_pause(MGSCON *p_con)
+{
+   long usecs;
+   struct timespec ts;
+
+   usecs = mgs.latency;
+   if (mgs.jitter > 0) {
+      usecs += (long) (rand_r(&(p_con->seed)) % (mgs.jitter + 1));
+   }
+   if (usecs <= 0) {
+      return 0;
+   }
+   ts.tv_sec = usecs / 1000000L;
+   ts.tv_nsec = (usecs % 1000000L) * 1000L;
+   nanosleep(&ts, NULL);
+
+   return 1;
+}